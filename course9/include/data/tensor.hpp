@@ -20,7 +20,10 @@ class Tensor<uint8_t> {
 template<>
 class Tensor<float> {
  public:
-  explicit Tensor() = default;
+  /**
+   * 创建一个空张量
+   */
+  explicit Tensor();
 
   /**
    * 创建张量
@@ -49,6 +52,28 @@ class Tensor<float> {
    */
   explicit Tensor(const std::vector<uint32_t> &shapes);
 
+  /**
+   * 在外部内存上创建张量，张量不拥有这块内存，也不会对其进行拷贝
+   * @param raw_ptr 外部内存的起始地址
+   * @param channels 张量的通道数
+   * @param rows 张量的行数
+   * @param cols 张量的列数
+   */
+  explicit Tensor(float *raw_ptr, uint32_t channels, uint32_t rows,
+                  uint32_t cols);
+
+  /**
+   * 在外部内存上创建张量，张量不拥有这块内存，也不会对其进行拷贝
+   * @param raw_ptr 外部内存的起始地址
+   * @param shapes 张量的维度
+   */
+  explicit Tensor(float *raw_ptr, const std::vector<uint32_t> &shapes);
+
+  /**
+   * 拷贝张量，拷贝后的张量和原张量共享数据，直到其中一方被修改时才拷贝数据(写时拷贝)
+   * 建立在外部内存上的张量在拷贝时直接拷贝数据
+   * @param tensor 被拷贝的张量
+   */
   Tensor(const Tensor &tensor);
 
   Tensor(Tensor &&tensor) noexcept;
@@ -57,6 +82,24 @@ class Tensor<float> {
 
   Tensor<float> &operator=(const Tensor &tensor);
 
+  /**
+   * 深拷贝张量，返回的张量拥有独立的数据
+   * @return 深拷贝得到的张量
+   */
+  Tensor<float> Clone() const;
+
+  /**
+   * 返回张量的数据是否和其他张量共享
+   * @return 是否共享数据
+   */
+  bool is_shared() const;
+
+  /**
+   * 返回进程启动以来张量分配数据内存的累计次数，用于统计每次推理的内存分配
+   * @return 累计的分配次数
+   */
+  static uint64_t allocation_count();
+
   /**
    * 返回张量的行数
    * @return 张量的行数
@@ -120,7 +163,8 @@ class Tensor<float> {
   const std::vector<uint32_t> &raw_shapes() const;
 
   /**
-   * 返回张量中的数据
+   * 返回张量中的数据，数据和其他张量共享时会先拷贝一份独立的数据
+   * 返回的引用在张量被再次拷贝之后不应继续用于写入
    * @return 张量中的数据
    */
   arma::fcube &data();
@@ -242,9 +286,23 @@ class Tensor<float> {
    */
   float *matrix_raw_ptr(uint32_t index);
 
+  /**
+   * 返回第index个矩阵的只读起始地址，数据和其他张量共享时不会拷贝
+   * @param index 第index个矩阵
+   * @return 第index个矩阵的起始地址
+   */
+  const float *matrix_raw_ptr(uint32_t index) const;
+
+ private:
+  /**
+   * 数据和其他张量共享时，拷贝一份独立的数据，在修改数据之前调用
+   */
+  void Detach();
+
  private:
-  std::vector<uint32_t> raw_shapes_;  // 张量数据的实际尺寸大小
-  arma::fcube data_;                  // 张量数据
+  std::vector<uint32_t> raw_shapes_;   // 张量数据的实际尺寸大小
+  std::shared_ptr<arma::fcube> data_;  // 张量数据，拷贝的张量之间共享
+  bool external_memory_ = false;       // 张量是否建立在外部内存上
 };
 
 using ftensor = Tensor<float>;
@@ -27,6 +27,18 @@ std::shared_ptr<Tensor<float>> TensorPadding(
     const std::shared_ptr<Tensor<float>>& tensor,
     const std::vector<uint32_t>& pads, float padding_value);
 
+/**
+ * 将张量拷贝到带边框的缓冲区内部并写入边框，缓冲区为空或者尺寸不符时重新分配，
+ * 否则直接复用，缓冲区可以建立在和其他张量共享的内存上
+ * @param tensor 待填充的张量
+ * @param pads 填充的大小，依次为上下左右
+ * @param padding_value 边框的值
+ * @param padded 带边框的缓冲区
+ */
+void TensorPaddingInto(const std::shared_ptr<Tensor<float>>& tensor,
+                       const std::vector<uint32_t>& pads, float padding_value,
+                       std::shared_ptr<Tensor<float>>& padded);
+
 /**
  * 比较tensor的值是否相同
  * @param a 输入张量1
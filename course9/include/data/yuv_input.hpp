@@ -0,0 +1,67 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_DATA_YUV_INPUT_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_YUV_INPUT_HPP_
+#include <cstdint>
+#include <memory>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+
+/// YUV420图像的内存排布
+enum class YuvFormat {
+  kNV12 = 0,  /// Y平面之后是交错存放的UV平面
+  kI420 = 1,  /// Y平面之后依次是U平面和V平面
+};
+
+/// 一帧YUV420图像，色度平面的宽和高都是亮度平面的一半(向上取整)
+struct YuvFrame {
+  YuvFormat format = YuvFormat::kNV12;
+  uint32_t width = 0;   /// 图像的宽度
+  uint32_t height = 0;  /// 图像的高度
+  const uint8_t *y = nullptr;  /// 亮度平面
+  uint32_t y_stride = 0;       /// 亮度平面每行的字节数
+  const uint8_t *u = nullptr;  /// U平面，NV12时为交错的UV平面
+  uint32_t u_stride = 0;       /// U平面或者UV平面每行的字节数
+  const uint8_t *v = nullptr;  /// V平面，只用于I420
+  uint32_t v_stride = 0;       /// V平面每行的字节数
+};
+
+/// YUV图像转换为模型输入时的预处理参数
+struct YuvPreprocessOptions {
+  uint32_t output_h = 640;   /// 输入张量的高度
+  uint32_t output_w = 640;   /// 输入张量的宽度
+  bool letterbox = true;     /// 是否等比缩放并在两侧填充，否则直接拉伸到输入的大小
+  bool scale_up = false;     /// 等比缩放时是否允许放大
+  float pad_value = 114.f;   /// 填充区域的像素值
+  bool bgr = false;          /// 输出的通道顺序是否为BGR，否则为RGB
+  float mean[3]{0.f, 0.f, 0.f};        /// 按输出通道顺序，像素值减去的均值
+  float std[3]{255.f, 255.f, 255.f};   /// 按输出通道顺序，减去均值后除以的值
+};
+
+/// 预处理后图像内容在输入张量中的位置，用于把检测框映射回原图
+struct YuvPreprocessInfo {
+  float scale = 1.f;          /// 原图到输入张量的缩放比例，拉伸时为宽度方向的比例
+  uint32_t top = 0;           /// 图像内容上方填充的行数
+  uint32_t left = 0;          /// 图像内容左侧填充的列数
+  uint32_t content_h = 0;     /// 缩放后图像内容的高度
+  uint32_t content_w = 0;     /// 缩放后图像内容的宽度
+};
+
+/**
+ * 把一帧NV12或者I420图像直接转换为模型的CHW输入张量，颜色转换(BT.601 limited range)、
+ * 双线性缩放或者Letterbox以及归一化在一次遍历中完成，按输出的行分块多线程处理
+ * @param frame 输入的YUV图像
+ * @param options 预处理参数
+ * @param output 输出的3 x output_h x output_w张量，为空时创建，不为空时形状需要一致
+ * @param info 图像内容在输入张量中的位置，可以为空
+ * @return 是否转换成功
+ */
+bool YuvToTensor(const YuvFrame &frame, const YuvPreprocessOptions &options,
+                 std::shared_ptr<Tensor<float>> &output,
+                 YuvPreprocessInfo *info = nullptr);
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_DATA_YUV_INPUT_HPP_
@@ -24,6 +24,7 @@
 #ifndef KUIPER_INFER_SOURCE_LAYER_LAYER_HPP_
 #define KUIPER_INFER_SOURCE_LAYER_LAYER_HPP_
 #include <glog/logging.h>
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -95,12 +96,94 @@ class Layer {
    */
   virtual void set_bias(const std::vector<float>& bias);
 
+  /**
+   * 设置Layer计算时所能使用的临时空间上限，例如卷积中im2col展开的矩阵
+   * @param workspace_limit 临时空间的字节数，为0时表示不做限制
+   */
+  virtual void set_workspace_limit(uint64_t workspace_limit);
+
+  /**
+   * 返回Layer计算时所能使用的临时空间上限
+   * @return 临时空间的字节数，为0时表示不做限制
+   */
+  uint64_t workspace_limit() const { return this->workspace_limit_; }
+
+  /**
+   * 返回推理时实际使用过的临时空间的最大字节数，用于统计内存峰值
+   * @return 临时空间的字节数
+   */
+  virtual uint64_t workspace_peak() const { return this->workspace_peak_; }
+
+  /**
+   * 返回层在多次推理之间持有的缓冲区字节数，不包括权重，例如检测头各阶段的中间结果，
+   * 这些缓冲区不在内存规划的内存块中，需要单独计入内存峰值
+   * @return 缓冲区的字节数
+   */
+  virtual uint64_t persistent_bytes() const { return 0; }
+
+  /**
+   * 返回推理时需要的、可以交给内存规划分配的缓冲区形状，例如卷积带边框的输入，为空表示不需要
+   * 缓冲区只在当前节点执行期间使用，可以和生命周期不重叠的节点输出共享同一块内存
+   * @return 缓冲区的形状，依次为通道、行、列
+   */
+  virtual std::vector<uint32_t> scratch_shapes() const { return {}; }
+
+  /**
+   * 设置内存规划分配的缓冲区，缓冲区中的数据在两次推理之间可能被其他节点改写
+   * @param scratch 缓冲区
+   */
+  virtual void set_scratch(const std::shared_ptr<Tensor<float>>& scratch) {
+    this->scratch_ = scratch;
+  }
+
   /**
    * 返回层的名称
    * @return 层的名称
    */
   virtual const std::string& layer_name() const { return this->layer_name_; }
 
+  /**
+   * 返回层当前选用的计算方式，用于导出计算图时标注，默认为层的名称
+   * @return 计算方式的名称
+   */
+  virtual std::string kernel_name() const { return this->layer_name_; }
+
+  /**
+   * 完成推迟到第一次推理时的初始化，例如卷积权重的展开，
+   * 在fork之前调用后，子进程的推理不再写入权重所在的内存页
+   */
+  virtual void Prepare() {}
+
+  /**
+   * 返回推理时只读的常量需要的float数量，包括权重、偏移以及Prepare之后展开的权重，
+   * 每个常量按64字节对齐，在fork之前用于把常量移动到只读的内存页中
+   * @return 常量的float数量
+   */
+  virtual uint64_t constant_floats() const { return 0; }
+
+  /**
+   * 把推理时只读的常量复制到arena中，之后推理改为读取arena中的副本，需要在Prepare之后调用
+   * @param arena 常量的目标内存，至少有constant_floats()个float，按64字节对齐
+   * @return 使用的float数量，不超过constant_floats()
+   */
+  virtual uint64_t MoveConstants(float* arena) { return 0; }
+
+  /**
+   * 把紧跟在该层之后的激活函数融合到该层的计算中，在构建计算图时调用
+   * @param activation_type 激活函数节点的类型，例如nn.ReLU
+   * @return 是否融合成功，融合成功后激活函数节点不再计算
+   */
+  virtual bool FuseActivation(const std::string& activation_type) {
+    return false;
+  }
+
+  /**
+   * 返回层的输出是否是输入内存上的视图，视图节点不拷贝数据，
+   * 内存规划时不为其分配内存，而是把输入的内存保留到视图最后一次被使用
+   * @return 输出是否是输入的视图
+   */
+  virtual bool output_is_view() const { return false; }
+
   /**
    * 设置层的执行算子
    * @param runtime_operator 该层的执行算子
@@ -109,8 +192,26 @@ class Layer {
       const std::shared_ptr<RuntimeOperator>& runtime_operator);
 
  protected:
+  /**
+   * 返回一个常量按64字节对齐之后占用的float数量
+   * @param size 常量的float数量
+   * @return 对齐之后的float数量
+   */
+  static uint64_t AlignConstant(uint64_t size) { return (size + 15) / 16 * 16; }
+
+  /**
+   * 记录一次临时空间的使用，更新临时空间的最大字节数
+   * @param bytes 本次使用的字节数
+   */
+  void RecordWorkspace(uint64_t bytes) const {
+    this->workspace_peak_ = std::max(this->workspace_peak_, bytes);
+  }
+
   std::weak_ptr<RuntimeOperator> runtime_operator_;
   std::string layer_name_;  /// Layer的名称
+  uint64_t workspace_limit_ = 0;  /// Layer临时空间的上限，0表示不限制
+  mutable uint64_t workspace_peak_ = 0;  /// 实际使用过的临时空间的最大字节数
+  std::shared_ptr<Tensor<float>> scratch_;  /// 内存规划分配的缓冲区
 };
 
 }  // namespace kuiper_infer
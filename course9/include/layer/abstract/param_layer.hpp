@@ -88,6 +88,10 @@ class ParamLayer : public Layer {
   void set_bias(
       const std::vector<std::shared_ptr<Tensor<float>>> &bias) override;
 
+  uint64_t constant_floats() const override;
+
+  uint64_t MoveConstants(float *arena) override;
+
  protected:
   std::vector<std::shared_ptr<Tensor<float>>> weights_;
   std::vector<std::shared_ptr<Tensor<float>>> bias_;
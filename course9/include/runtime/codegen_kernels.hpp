@@ -0,0 +1,305 @@
+//
+// Created by fss on 23-9-13.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_CODEGEN_KERNELS_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_CODEGEN_KERNELS_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// RuntimeCodegen生成的代码所使用的内核，所有形状都是模板参数，
+/// 只依赖标准库，张量按KuiperInfer的排布存放，即逐个通道存放列主序的矩阵
+namespace kuiper_infer {
+namespace codegen {
+
+/// 卷积每次计算的输出位置数量
+constexpr int kConvTile = 64;
+
+/// 卷积临时空间支持的最大线程数
+constexpr int kMaxThreads = 64;
+
+/// 卷积之后融合的激活函数
+enum class Activation { kNone = 0, kReLU = 1, kSiLU = 2 };
+
+/**
+ * 返回内核使用的线程数
+ * @return 线程数，不超过kMaxThreads
+ */
+inline int ThreadCount() {
+#ifdef _OPENMP
+  return std::min(omp_get_max_threads(), kMaxThreads);
+#else
+  return 1;
+#endif
+}
+
+/**
+ * 返回当前线程的编号，用于选择线程私有的临时空间
+ * @return 线程编号
+ */
+inline int ThreadIndex() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+inline float Sigmoid(float x) { return 1.f / (1.f + std::exp(-x)); }
+
+template <Activation A>
+inline float Activate(float x) {
+  if constexpr (A == Activation::kReLU) {
+    return std::max(x, 0.f);
+  } else if constexpr (A == Activation::kSiLU) {
+    return x * Sigmoid(x);
+  } else {
+    return x;
+  }
+}
+
+/**
+ * 每个线程卷积所需临时空间的大小
+ * @return float的数量
+ */
+template <int IC, int KH, int KW, int G>
+constexpr int ConvWorkspace() {
+  return IC / G * KH * KW * kConvTile;
+}
+
+/**
+ * 计算N个输出通道在一块输出位置上的结果，col是kConvTile列、行间隔为col_stride的im2col矩阵
+ */
+template <int N, int K, int P, Activation A>
+inline void ConvTileRows(const float* col, int col_stride, const float* weight,
+                         const float* bias, float* output, int count) {
+  float acc[N][kConvTile];
+  for (int n = 0; n < N; ++n) {
+    const float b = bias != nullptr ? bias[n] : 0.f;
+    for (int t = 0; t < kConvTile; ++t) {
+      acc[n][t] = b;
+    }
+  }
+  for (int k = 0; k < K; ++k) {
+    const float* col_row = col + k * col_stride;
+    for (int n = 0; n < N; ++n) {
+      const float w = weight[n * K + k];
+      for (int t = 0; t < kConvTile; ++t) {
+        acc[n][t] += w * col_row[t];
+      }
+    }
+  }
+  for (int n = 0; n < N; ++n) {
+    float* output_row = output + n * P;
+    for (int t = 0; t < count; ++t) {
+      output_row[t] = Activate<A>(acc[n][t]);
+    }
+  }
+}
+
+/**
+ * 卷积，输出位置按kConvTile分块，各块并行地展开为im2col矩阵后和权重相乘
+ * 1x1、步长为1且没有填充的卷积直接读取输入，不需要展开
+ * @param input 输入，IC个IHxIW的通道
+ * @param weight 权重，按(OC, IC/G, KH, KW)行主序存放
+ * @param bias 偏置，没有偏置时为nullptr
+ * @param output 输出，OC个通道
+ * @param workspace 临时空间，每个线程ConvWorkspace()个float
+ */
+template <int IC, int IH, int IW, int OC, int KH, int KW, int SH, int SW,
+          int PH, int PW, int G, Activation A>
+void Conv2d(const float* input, const float* weight, const float* bias,
+            float* output, float* workspace) {
+  static_assert(IC % G == 0 && OC % G == 0, "Wrong groups of convolution");
+  constexpr int OH = (IH + 2 * PH - KH) / SH + 1;
+  constexpr int OW = (IW + 2 * PW - KW) / SW + 1;
+  constexpr int P = OH * OW;
+  constexpr int ICG = IC / G;
+  constexpr int OCG = OC / G;
+  constexpr int K = ICG * KH * KW;
+  constexpr int kTiles = (P + kConvTile - 1) / kConvTile;
+  constexpr bool kPointwise =
+      KH == 1 && KW == 1 && SH == 1 && SW == 1 && PH == 0 && PW == 0;
+
+#pragma omp parallel for num_threads(ThreadCount()) schedule(static)
+  for (int task = 0; task < G * kTiles; ++task) {
+    const int g = task / kTiles;
+    const int p0 = task % kTiles * kConvTile;
+    const int count = std::min(kConvTile, P - p0);
+    const float* group_input = input + g * ICG * IH * IW;
+    float* col = workspace + ThreadIndex() * K * kConvTile;
+
+    const float* col_ptr = col;
+    int col_stride = kConvTile;
+    if (kPointwise && count == kConvTile) {
+      col_ptr = group_input + p0;
+      col_stride = P;
+    } else {
+      // 每个输出位置对应的输入起点，超出输出范围的位置读取填充值
+      int ih0[kConvTile];
+      int iw0[kConvTile];
+      for (int t = 0; t < kConvTile; ++t) {
+        const int p = p0 + t;
+        if (p < P) {
+          ih0[t] = p % OH * SH - PH;
+          iw0[t] = p / OH * SW - PW;
+        } else {
+          ih0[t] = -IH - KH;
+          iw0[t] = -IW - KW;
+        }
+      }
+      for (int ic = 0; ic < ICG; ++ic) {
+        const float* input_channel = group_input + ic * IH * IW;
+        for (int kh = 0; kh < KH; ++kh) {
+          for (int kw = 0; kw < KW; ++kw) {
+            float* col_row = col + ((ic * KH + kh) * KW + kw) * kConvTile;
+            for (int t = 0; t < kConvTile; ++t) {
+              const int ih = ih0[t] + kh;
+              const int iw = iw0[t] + kw;
+              col_row[t] = uint32_t(ih) < uint32_t(IH) && uint32_t(iw) < uint32_t(IW)
+                               ? input_channel[iw * IH + ih]
+                               : 0.f;
+            }
+          }
+        }
+      }
+    }
+
+    const float* group_weight = weight + g * OCG * K;
+    const float* group_bias = bias != nullptr ? bias + g * OCG : nullptr;
+    float* group_output = output + g * OCG * P + p0;
+    int oc = 0;
+    for (; oc + 4 <= OCG; oc += 4) {
+      ConvTileRows<4, K, P, A>(col_ptr, col_stride, group_weight + oc * K,
+                               group_bias != nullptr ? group_bias + oc : nullptr,
+                               group_output + oc * P, count);
+    }
+    for (; oc < OCG; ++oc) {
+      ConvTileRows<1, K, P, A>(col_ptr, col_stride, group_weight + oc * K,
+                               group_bias != nullptr ? group_bias + oc : nullptr,
+                               group_output + oc * P, count);
+    }
+  }
+}
+
+/**
+ * 最大池化，填充的位置不参与比较
+ */
+template <int C, int IH, int IW, int KH, int KW, int SH, int SW, int PH, int PW>
+void MaxPool2d(const float* input, float* output) {
+  constexpr int OH = (IH + 2 * PH - KH) / SH + 1;
+  constexpr int OW = (IW + 2 * PW - KW) / SW + 1;
+#pragma omp parallel for num_threads(ThreadCount()) schedule(static)
+  for (int c = 0; c < C; ++c) {
+    const float* input_channel = input + c * IH * IW;
+    float* output_channel = output + c * OH * OW;
+    for (int ow = 0; ow < OW; ++ow) {
+      const int iw_start = std::max(ow * SW - PW, 0);
+      const int iw_end = std::min(ow * SW - PW + KW, IW);
+      for (int oh = 0; oh < OH; ++oh) {
+        const int ih_start = std::max(oh * SH - PH, 0);
+        const int ih_end = std::min(oh * SH - PH + KH, IH);
+        float max_value = std::numeric_limits<float>::lowest();
+        for (int iw = iw_start; iw < iw_end; ++iw) {
+          const float* input_col = input_channel + iw * IH;
+          for (int ih = ih_start; ih < ih_end; ++ih) {
+            max_value = std::max(max_value, input_col[ih]);
+          }
+        }
+        output_channel[ow * OH + oh] = max_value;
+      }
+    }
+  }
+}
+
+/**
+ * 整数倍的最近邻上采样
+ */
+template <int C, int IH, int IW, int SH, int SW>
+void UpsampleNearest(const float* input, float* output) {
+  constexpr int OH = IH * SH;
+  constexpr int OW = IW * SW;
+#pragma omp parallel for num_threads(ThreadCount()) schedule(static)
+  for (int c = 0; c < C; ++c) {
+    const float* input_channel = input + c * IH * IW;
+    float* output_channel = output + c * OH * OW;
+    for (int ow = 0; ow < OW; ++ow) {
+      const float* input_col = input_channel + ow / SW * IH;
+      float* output_col = output_channel + ow * OH;
+      for (int oh = 0; oh < OH; ++oh) {
+        output_col[oh] = input_col[oh / SH];
+      }
+    }
+  }
+}
+
+/**
+ * 逐元素计算，function(i)返回第i个输出
+ */
+template <int N, typename Function>
+void Elementwise(float* output, Function function) {
+#pragma omp parallel for num_threads(ThreadCount()) schedule(static)
+  for (int i = 0; i < N; ++i) {
+    output[i] = function(i);
+  }
+}
+
+/**
+ * 逐元素的激活函数
+ */
+template <int N, Activation A>
+void ActivateTensor(const float* input, float* output) {
+  Elementwise<N>(output, [input](int i) { return Activate<A>(input[i]); });
+}
+
+/**
+ * 把一段输入拷贝到输出中，用于按通道拼接
+ */
+template <int N>
+void Copy(const float* input, float* output) {
+  std::copy(input, input + N, output);
+}
+
+/**
+ * yolo检测头的解码，输入为一个尺度上检测卷积的输出，结果写入(rows, NO)的输出矩阵中
+ * @param input 检测卷积的输出，NA * NO个HxW的通道
+ * @param grid 网格坐标，按(NA, H, W, 2)行主序存放
+ * @param anchor_grid 锚框大小，按(NA, H, W, 2)行主序存放
+ * @param stride 当前尺度的步长
+ * @param output 输出矩阵，列主序
+ * @param row_offset 当前尺度在输出矩阵中的起始行
+ * @param rows 输出矩阵的总行数
+ */
+template <int H, int W, int NA, int NO>
+void DetectDecode(const float* input, const float* grid,
+                  const float* anchor_grid, float stride, float* output,
+                  int row_offset, int rows) {
+#pragma omp parallel for num_threads(ThreadCount()) schedule(static)
+  for (int a = 0; a < NA; ++a) {
+    for (int h = 0; h < H; ++h) {
+      for (int w = 0; w < W; ++w) {
+        const int row = (a * H + h) * W + w;
+        float* output_row = output + row_offset + row;
+        for (int k = 0; k < NO; ++k) {
+          const float value = Sigmoid(input[(a * NO + k) * H * W + w * H + h]);
+          float result = value;
+          if (k < 2) {
+            result = (value * 2.f + grid[row * 2 + k]) * stride;
+          } else if (k < 4) {
+            result = (value * 2.f) * (value * 2.f) * anchor_grid[row * 2 + k - 2];
+          }
+          output_row[k * rows] = result;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace codegen
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_CODEGEN_KERNELS_HPP_
@@ -0,0 +1,162 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_BATCHER_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_BATCHER_HPP_
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+class RuntimeGraph;
+
+/// 一个请求中原始图片的大小
+struct BatchRequest {
+  uint32_t height = 0;
+  uint32_t width = 0;
+};
+
+/// 一个分辨率桶的统计信息
+struct BucketReport {
+  uint32_t height = 0;
+  uint32_t width = 0;
+  uint32_t batch_size = 0;      /// 计算图的批次大小
+  uint32_t requests = 0;        /// 分到该桶的请求数量
+  uint32_t batches = 0;         /// 执行Forward的次数
+  uint32_t empty_slots = 0;     /// 最后一个批次中凑数的位置
+  uint64_t image_pixels = 0;    /// 缩放后图片内容的像素数
+  uint64_t padding_pixels = 0;  /// 填充的像素数
+  double forward_ms = 0.;       /// Forward的累计耗时
+};
+
+/// 分辨率分桶批处理的统计信息
+struct BatchingReport {
+  std::vector<BucketReport> buckets;
+  uint32_t requests = 0;
+  uint32_t rejected = 0;  /// 无法分桶或者所在的桶构建失败而被拒绝的请求数量
+  uint64_t image_pixels = 0;
+  uint64_t padding_pixels = 0;
+  uint64_t single_bucket_padding_pixels = 0;  /// 全部填充到最大的桶时的填充像素数
+  double elapsed_ms = 0.;                     /// 预处理和推理的总耗时
+  double throughput = 0.;                     /// 每秒完成的请求数量
+
+  /**
+   * 返回填充像素占输入像素的比例
+   * @return 填充的比例
+   */
+  double padding_ratio() const;
+
+  /**
+   * 返回全部填充到最大的桶时填充像素占输入像素的比例
+   * @return 填充的比例
+   */
+  double single_bucket_padding_ratio() const;
+};
+
+/**
+ * 预处理函数，把第index个请求的图片等比缩放并填充为bucket_h x bucket_w的输入张量
+ */
+using BucketPreprocess = std::function<sftensor(
+    uint32_t index, uint32_t bucket_h, uint32_t bucket_w)>;
+
+/**
+ * 按分辨率分桶的批处理
+ * 计算图的形状在导出时就已经固定，所以每个桶对应一组按该分辨率导出的模型文件，
+ * 每个桶的计算图在第一次用到时构建，之后一直缓存，内存规划等构建结果在同一个桶的请求间复用。
+ * 请求按图片的长宽比分到填充最少的桶中，同一个桶的请求按计算图的批次大小合并执行Forward
+ */
+class RuntimeBatcher {
+ public:
+  /**
+   * @param input_name 计算图输入节点的名称
+   * @param output_name 计算图输出节点的名称
+   */
+  RuntimeBatcher(std::string input_name, std::string output_name);
+
+  ~RuntimeBatcher();
+
+  /**
+   * 添加一个分辨率桶
+   * @param height 桶的高度
+   * @param width 桶的宽度
+   * @param param_path 按该分辨率导出的结构文件
+   * @param bin_path 按该分辨率导出的权重文件
+   * @return 是否添加成功，大小为0或者和已有的桶重复时返回false
+   */
+  bool AddBucket(uint32_t height, uint32_t width, const std::string &param_path,
+                 const std::string &bin_path);
+
+  /**
+   * 设置每个桶的计算图的内存预算，需要在第一次Forward之前设置
+   * @param memory_budget 内存预算的字节数，0表示不限制
+   */
+  void set_memory_budget(uint64_t memory_budget);
+
+  /**
+   * 为图片选择分辨率桶，先保证缩放比例和最大的桶相同，不因为分桶损失分辨率，
+   * 再从中选择填充最少的桶
+   * @param height 图片的高度
+   * @param width 图片的宽度
+   * @return 桶的序号，没有桶时返回-1
+   */
+  int32_t SelectBucket(uint32_t height, uint32_t width) const;
+
+  /**
+   * 分桶执行推理
+   * @param requests 各请求的图片大小
+   * @param preprocess 预处理函数
+   * @return 按请求顺序排列的输出，每个请求一个张量，无法分桶的请求(例如图片大小为0)和
+   * 计算图构建失败的桶中的请求被拒绝，对应的输出为空，其余请求照常执行
+   */
+  std::vector<sftensor> Forward(const std::vector<BatchRequest> &requests,
+                                const BucketPreprocess &preprocess);
+
+  /**
+   * 返回最近一次Forward的统计信息
+   * @return 统计信息
+   */
+  const BatchingReport &report() const;
+
+ private:
+  /// 分辨率桶以及缓存的计算图
+  struct Bucket {
+    uint32_t height = 0;
+    uint32_t width = 0;
+    std::string param_path;
+    std::string bin_path;
+    std::unique_ptr<RuntimeGraph> graph;  /// 第一次用到时构建
+    uint32_t batch_size = 0;              /// 计算图的批次大小
+  };
+
+  /**
+   * 返回桶的计算图，第一次调用时构建，构建成功之后才缓存，失败时下次调用重新构建
+   * @param bucket 分辨率桶
+   * @return 构建好的计算图，预算放不下或者输入的形状和桶不一致时返回空
+   */
+  RuntimeGraph *BucketGraph(Bucket &bucket);
+
+ private:
+  std::string input_name_;
+  std::string output_name_;
+  uint64_t memory_budget_ = 0;
+  std::vector<Bucket> buckets_;
+  BatchingReport report_;
+};
+
+/**
+ * 计算图片按Letterbox等比缩放到桶中之后的内容像素数，图片不会被放大
+ * @param height 图片的高度
+ * @param width 图片的宽度
+ * @param bucket_h 桶的高度
+ * @param bucket_w 桶的宽度
+ * @return 缩放后图片内容的像素数
+ */
+uint64_t LetterboxContentPixels(uint32_t height, uint32_t width,
+                                uint32_t bucket_h, uint32_t bucket_w);
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_BATCHER_HPP_
@@ -0,0 +1,131 @@
+//
+// Created by fss on 23-9-13.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CODEGEN_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CODEGEN_HPP_
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "runtime/runtime_op.hpp"
+
+namespace kuiper_infer {
+
+/// 代码生成的统计信息
+struct CodegenReport {
+  uint32_t kernels = 0;            /// 生成的内核调用数量
+  uint32_t fused_activations = 0;  /// 融合到卷积中的激活函数数量
+  uint64_t unplanned_bytes = 0;    /// 不复用时所有中间结果的字节数
+  uint64_t arena_bytes = 0;        /// 静态内存区的字节数
+  uint64_t workspace_bytes = 0;    /// 卷积临时空间的字节数
+  uint64_t weight_bytes = 0;       /// 权重文件的字节数
+};
+
+/**
+ * 把形状固定的pnnx模型编译为一个独立的C++源文件和一个权重文件
+ * 生成的代码中形状都是常量，节点按拓扑顺序展开为对codegen_kernels.hpp中模板内核的调用，
+ * 中间结果放在预先计算好偏移的静态内存区中，权重在Load时通过mmap映射，推理时没有任何内存分配
+ *
+ * 生成的源文件提供以下接口，name为生成时指定的名称:
+ * namespace name { bool Load(const char*); void Unload(); void Forward(const float*, float*); }
+ * 以及供dlopen使用的extern "C"函数name_load、name_unload和name_forward
+ * 输入和输出按KuiperInfer张量的排布存放，可以直接传入Tensor::raw_ptr()
+ */
+class RuntimeCodegen {
+ public:
+  /**
+   * @param param_path 计算图的结构文件
+   * @param bin_path 计算图的权重文件
+   */
+  RuntimeCodegen(std::string param_path, std::string bin_path);
+
+  /**
+   * 生成源文件和权重文件
+   * @param name 生成代码的命名空间，也是导出函数的前缀，需要是合法的标识符
+   * @param source_path 生成的源文件路径
+   * @param weight_path 生成的权重文件路径
+   * @return 是否生成成功，模型中有不支持的节点、批次不为1或者形状不固定时返回false
+   */
+  bool Generate(const std::string &name, const std::string &source_path,
+                const std::string &weight_path);
+
+  /**
+   * 返回最近一次生成的统计信息
+   * @return 统计信息
+   */
+  const CodegenReport &report() const;
+
+ private:
+  /// 生成代码中的一个中间结果
+  struct CodegenValue {
+    uint64_t size = 0;        /// float的数量
+    int32_t first_use = -1;   /// 写入该结果的步骤
+    int32_t last_use = -1;    /// 最后读取该结果的步骤
+    uint64_t offset = 0;      /// 在静态内存区中的偏移
+    std::string pointer;      /// 生成代码中指向该结果的表达式
+  };
+
+  /**
+   * 为节点生成内核调用
+   * @param op 计算节点
+   * @param step 节点的执行序号
+   * @return 是否支持该节点
+   */
+  bool EmitOperator(const std::shared_ptr<RuntimeOperator> &op, int32_t step);
+
+  /**
+   * 把权重追加到权重文件的内容中
+   * @param op 计算节点
+   * @param name 权重的名称
+   * @param expect_size 期望的float数量
+   * @return 生成代码中指向该权重的表达式，找不到权重或者大小不一致时为空
+   */
+  std::string AppendWeight(const std::shared_ptr<RuntimeOperator> &op,
+                           const std::string &name, uint64_t expect_size);
+
+  /**
+   * 申请一个中间结果
+   * @param name 中间结果的名称
+   * @param size float的数量
+   * @param step 写入该结果的步骤
+   * @return 生成代码中指向该结果的表达式，偏移在规划内存后以常量的形式给出
+   */
+  std::string DefineValue(const std::string &name, uint64_t size,
+                          int32_t step);
+
+  /**
+   * 读取一个中间结果并更新它的生命周期
+   * @param name 中间结果的名称，即产生它的节点名称
+   * @param step 读取该结果的步骤
+   * @return 生成代码中指向该结果的表达式
+   */
+  std::string UseValue(const std::string &name, int32_t step);
+
+  /**
+   * 按生命周期为中间结果分配静态内存区中的偏移
+   * @return 静态内存区中float的数量
+   */
+  uint64_t PlanArena();
+
+ private:
+  std::string param_path_;
+  std::string bin_path_;
+  CodegenReport report_;
+
+  std::map<std::string, std::shared_ptr<RuntimeOperator>> operators_;
+  std::map<std::string, std::vector<int32_t>> shapes_;  /// 各节点输出的形状
+  std::string input_name_;                        /// 计算图的输入节点
+  std::string output_producer_;                   /// 计算图输出节点的前驱
+  std::set<std::string> fused_activations_;       /// 已经融合到卷积中的激活节点
+  std::map<std::string, CodegenValue> values_;    /// 所有的中间结果
+  std::vector<std::string> value_order_;          /// 中间结果的定义顺序
+  std::vector<float> weights_;                    /// 权重文件的内容
+  std::vector<std::string> lines_;                /// Forward函数体
+  uint64_t workspace_size_ = 0;                   /// 每个线程卷积临时空间中float的数量
+};
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CODEGEN_HPP_
@@ -0,0 +1,68 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_FORK_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_FORK_HPP_
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace kuiper_infer {
+
+/// RuntimeGraph::PrepareFork的统计信息
+struct ForkReport {
+  uint32_t prepared_layers = 0;  /// 完成延迟初始化的Layer数量
+  uint64_t frozen_bytes = 0;     /// 移动到只读内存页中的常量字节数，包括展开之后的权重
+  uint64_t arena_address = 0;    /// 只读内存页的起始地址，没有常量时为0
+  uint64_t arena_bytes = 0;      /// 只读内存页的字节数
+  double prepare_ms = 0.;        /// 准备的耗时
+};
+
+/// 进程的内存占用，单位为KB
+struct ProcessMemory {
+  uint64_t rss = 0;            /// 驻留在物理内存中的大小
+  uint64_t pss = 0;            /// 共享的内存页按共享的进程数均摊后的大小
+  uint64_t shared_clean = 0;   /// 和其他进程共享且没有被修改的内存页
+  uint64_t shared_dirty = 0;   /// 和其他进程共享且被修改过的内存页
+  uint64_t private_clean = 0;  /// 进程独占且没有被修改的内存页
+  uint64_t private_dirty = 0;  /// 进程独占且被修改过的内存页，包括写时复制产生的副本
+};
+
+/**
+ * 读取进程的内存占用，优先读取/proc/<pid>/smaps_rollup，不存在时累加/proc/<pid>/smaps
+ * @param pid 进程号，0表示当前进程
+ * @param memory 读取到的内存占用
+ * @return 是否读取成功
+ */
+bool ReadProcessMemory(int32_t pid, ProcessMemory &memory);
+
+/**
+ * 读取进程中包含某个地址的内存映射的内存占用，从/proc/<pid>/smaps中查找该映射
+ * @param pid 进程号，0表示当前进程
+ * @param address 映射中的任意地址，例如ForkReport::arena_address
+ * @param memory 读取到的内存占用
+ * @return 是否找到了包含该地址的映射
+ */
+bool ReadRegionMemory(int32_t pid, uint64_t address, ProcessMemory &memory);
+
+/**
+ * 启动预先fork的工作进程，子进程执行worker(index)后以其返回值退出，不会回到调用方
+ * 需要在计算图Build和PrepareFork之后调用，子进程通过写时复制共享权重，
+ * 工作进程之间按进程并行，每个工作进程中的OpenMP只使用一个线程
+ * @param workers 工作进程的数量
+ * @param worker 子进程中执行的函数，参数为工作进程的序号，返回值为进程的退出码
+ * @return 各工作进程的进程号，fork失败时只包含已经启动的进程
+ */
+std::vector<int32_t> ForkWorkers(uint32_t workers,
+                                 const std::function<int(uint32_t)> &worker);
+
+/**
+ * 等待工作进程退出
+ * @param pids 工作进程的进程号
+ * @return 是否所有工作进程都正常退出且退出码为0
+ */
+bool WaitWorkers(const std::vector<int32_t> &pids);
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_FORK_HPP_
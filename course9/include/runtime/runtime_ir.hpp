@@ -1,4 +1,9 @@
 #include "ir.h"
+#include "runtime/runtime_memory.hpp"
+#include "runtime/runtime_metrics.hpp"
+#include "runtime/runtime_fork.hpp"
+#include "runtime/runtime_record.hpp"
+#include "runtime/runtime_trace.hpp"
 #include "runtime/runtime_operand.hpp"
 #include "runtime_op.hpp"
 #include <glog/logging.h>
@@ -44,6 +49,52 @@ class RuntimeGraph {
    */
   const std::string &bin_path() const;
 
+  /**
+   * 设置计算图的内存预算，需要在Build之前设置
+   * 设置预算后，Build时会复用生命周期不重叠的节点输出、让逐元素节点原地计算，
+   * 剩余的预算作为卷积等Layer的临时空间上限，节点仍然按拓扑顺序逐个执行
+   * @param memory_budget 节点输出和临时空间的字节数上限，0表示不限制
+   */
+  void set_memory_budget(uint64_t memory_budget);
+
+  /**
+   * 返回计算图的内存预算
+   * @return 内存预算的字节数，0表示不限制
+   */
+  uint64_t memory_budget() const;
+
+  /**
+   * 设置调整执行顺序时每一步保留的部分顺序数量，需要在Build之前设置
+   * 设置内存预算后，Build时先在拓扑顺序中搜索节点输出存活峰值较小的执行顺序，
+   * 只有内存规划的字节数比深度优先的顺序小时才采用，推理时按调整之后的顺序执行
+   * @param beam_width 每一步保留的部分顺序数量，0表示保持深度优先的拓扑顺序
+   */
+  void set_schedule_beam_width(uint32_t beam_width);
+
+  /**
+   * 返回调整执行顺序时每一步保留的部分顺序数量
+   * @return 部分顺序的数量，0表示不调整
+   */
+  uint32_t schedule_beam_width() const;
+
+  /**
+   * 设置构建时是否把激活函数融合到前一个节点，需要在Build之前设置
+   * @param fuse_activations 是否融合，默认融合
+   */
+  void set_fuse_activations(bool fuse_activations);
+
+  /**
+   * 返回构建时是否把激活函数融合到前一个节点
+   * @return 是否融合
+   */
+  bool fuse_activations() const;
+
+  /**
+   * 返回内存预算下的内存规划结果
+   * @return 内存规划的统计信息
+   */
+  const RuntimeMemoryReport &memory_report() const;
+
   /**
    * 计算图的初始化
    * @return 是否初始化成功
@@ -56,8 +107,9 @@ class RuntimeGraph {
    * 构建计算图
    * @param input_name 计算图输入节点的名称
    * @param output_name  计算图输出节点的名称
+   * @return 是否构建成功，初始化失败或者内存预算不够时返回false，之后可以调整预算重新构建
    */
-  void Build(const std::string &input_name, const std::string &output_name);
+  bool Build(const std::string &input_name, const std::string &output_name);
 
   const std::vector<std::shared_ptr<RuntimeOperator>> &get_topo_queues() const;
 
@@ -72,7 +124,120 @@ class RuntimeGraph {
   std::vector<std::shared_ptr<Tensor<float>>> Forward(
       const std::vector<std::shared_ptr<Tensor<float>>> &inputs, bool debug);
 
+  /**
+   * 绑定计算图的输入，需要在Build之后调用
+   * 输入张量可以建立在调用方的内存上，Forward时直接读取这块内存，不做拷贝
+   * @param inputs 计算图的输入张量，数量和计算图的批次大小相同
+   */
+  void BindInputs(const std::vector<std::shared_ptr<Tensor<float>>> &inputs);
+
+  /**
+   * 绑定计算图的输出，需要在Build之后调用
+   * 输出节点的前驱直接把结果写入绑定的张量，绑定的张量可以建立在调用方的内存上，
+   * 前驱的输出是输入的视图等会替换输出张量的情况下，推理之后多做一次拷贝写入绑定的张量
+   * @param outputs 计算图的输出张量，数量和形状需要与输出节点的操作数一致
+   */
+  void BindOutputs(const std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+  /**
+   * 使用绑定的输入和输出执行推理，结果写入绑定的输出张量中
+   * @param debug 是否为调试模式
+   */
+  void Forward(bool debug);
+
+  /**
+   * 预热计算图，需要在Build之后调用
+   * 用全为0.5的输入执行runs次推理，让节点输出的缺页中断，以及卷积权重的展开、im2col和
+   * 填充的临时空间等延迟创建的内存在预热时发生，预热时的推理不计入运行时指标、追踪、录制和逐节点计时，
+   * 也不写入绑定的输出
+   * @param runs 推理的次数，至少为1
+   * @param lock_memory 是否把节点输出锁定在物理内存中，锁定的内存在计算图析构或者再次预热时解锁
+   * @return 预热的统计信息
+   */
+  WarmupReport Warmup(uint32_t runs, bool lock_memory);
+
+  /**
+   * 让构建好的计算图可以在fork之后被子进程共享，需要在Build之后、第一次Forward之前调用
+   * 完成所有Layer的延迟初始化，再把各Layer的权重、偏移以及展开之后的权重(包括检测头内部的卷积)
+   * 移动到只读的内存页中，之后子进程的推理不会写入这些内存页，权重通过写时复制在各进程间共享。
+   * 调用时不能有其他线程在使用计算图，正在进行的录制会被停止，以免多个进程写入同一个日志，
+   * 运行中的指标导出器和已注册的追踪信号处理函数有后台线程，存在时直接报错
+   * @return 准备的统计信息
+   */
+  ForkReport PrepareFork();
+
+  /**
+   * 返回Build或者Warmup之后第一次推理的耗时
+   * @return 耗时的毫秒数，还没有推理时为0
+   */
+  double first_forward_ms() const;
+
+  /**
+   * 打开运行时指标，推理延迟、各类型层的执行时间、内存分配次数等记录到全局的RuntimeMetrics中
+   * @param model_name 指标中模型的名称
+   */
+  void EnableMetrics(const std::string &model_name);
+
+  /**
+   * 打开推理追踪，每sample_every次推理把各节点的耗时写入全局的RuntimeTracer，
+   * 耗时超过阈值的推理总是被写入
+   * @param sample_every 采样间隔，0表示只记录超过阈值的推理
+   * @param slow_threshold_ms 延迟阈值，单位为毫秒，0表示不按阈值记录
+   */
+  void EnableTracing(uint32_t sample_every, double slow_threshold_ms);
+
+  /**
+   * 开始录制，之后每次推理的输入张量和耗时都追加写入二进制日志
+   * @param path 日志文件的路径
+   * @return 是否打开日志文件成功
+   */
+  bool StartRecording(const std::string &path);
+
+  /**
+   * 停止录制并关闭日志文件
+   */
+  void StopRecording();
+
+  /**
+   * 打开逐节点计时，累计的耗时用于导出计算图时标注各节点的平均耗时
+   */
+  void EnableProfiling();
+
+  /**
+   * 把执行顺序下的计算图导出为DOT格式，节点上标注类型、计算方式、输出形状、
+   * 输出字节数、平均耗时以及原地计算和复用的内存，耗时越长的节点颜色越红
+   * @return DOT格式的文本
+   */
+  std::string ExportDot() const;
+
+  /**
+   * 把计算图写入文件，路径以.svg结尾时调用graphviz的dot命令转换为SVG，否则写入DOT文本
+   * @param path 导出文件的路径
+   * @return 是否导出成功
+   */
+  bool ExportGraph(const std::string &path) const;
+
  private:
+  /**
+   * 得到产生操作数的计算节点名称，有多个输出的pnnx节点拆分后按输出的序号命名
+   * @param operand pnnx中的操作数
+   * @return 产生该操作数的计算节点名称
+   */
+  static std::string OperandProducerName(const pnnx::Operand *operand);
+
+  /**
+   * 把pnnx图中view(b, g, c / g, h, w) -> transpose(1, 2) -> view(b, c, h, w)的通道重排
+   * 改写为一个nn.ChannelShuffle节点，中间的5维张量不再出现在计算图中
+   */
+  void FuseChannelShuffle();
+
+  /**
+   * 把有多个输出的torch.chunk和torch.split节点拆分为每个输出一个的Tensor.slice计算节点
+   * @param op pnnx中有多个输出的节点
+   * @return 是否拆分成功
+   */
+  bool InitSplitOperators(const pnnx::Operator *op);
+
   /**
    * 初始化kuiper infer计算图节点中的输入操作数
    * @param inputs pnnx中的输入操作数
@@ -111,6 +276,22 @@ class RuntimeGraph {
 
   void ReverseTopo(const std::shared_ptr<RuntimeOperator> &root_op);
 
+  /**
+   * 把只有一个后继的节点和后继的激活函数融合，激活函数节点的Layer替换为不做计算的IdentityLayer，
+   * 激活函数的后继是计算图的输出时不融合，以免绑定的输出不被写入
+   */
+  void FuseActivations();
+
+  /**
+   * 预算模式下在推理之后统计Layer持有的缓冲区和实际使用过的临时空间，更新内存规划的统计信息
+   */
+  void UpdateMemoryReport();
+
+  /**
+   * 在全局的RuntimeMetrics中查找或者创建计算图用到的指标，推理时只需要原子操作
+   */
+  void InitMetrics();
+
   /**
  * 探查下一层的计算节点
  * @param current_op 当前计算节点
@@ -134,17 +315,52 @@ class RuntimeGraph {
    */
   GraphState graph_state() const;
  private:
+  /// 只读的权重内存页，需要在持有权重的节点之后析构
+  std::shared_ptr<void> weight_arena_;
+
   GraphState graph_state_ = GraphState::NeedInit;
   std::string input_name_;  /// 计算图输入节点的名称
   std::string output_name_; /// 计算图输出节点的名称
   std::string param_path_;  /// 计算图的结构文件
   std::string bin_path_;    /// 计算图的权重文件
+  uint64_t memory_budget_ = 0; /// 计算图的内存预算，0表示不限制
+  uint32_t schedule_beam_width_ = 8; /// 调整执行顺序时保留的部分顺序数量
+  bool fuse_activations_ = true;     /// 构建时是否融合激活函数
 
   std::vector<std::shared_ptr<RuntimeOperator>> operators_;
   std::map<std::string, std::shared_ptr<RuntimeOperator>> operators_maps_;
   std::vector<std::shared_ptr<RuntimeOperator>> topo_operators_;
 
   std::unique_ptr<pnnx::Graph> graph_; /// pnnx的graph
+  std::vector<pnnx::Operand *> pnnx_outputs_; /// 和operators_一一对应的pnnx输出操作数
+  RuntimeMemoryPlanner memory_planner_; /// 内存预算下的内存规划
+  RuntimeMemoryReport memory_report_;   /// 内存规划的统计信息
+
+  std::vector<std::shared_ptr<Tensor<float>>> bound_inputs_;  /// 绑定的输入
+  std::vector<std::shared_ptr<Tensor<float>>> bound_outputs_; /// 绑定的输出
+  LockedMemory locked_memory_; /// 预热时锁定的节点输出，需要在节点输出之前析构
+
+  std::string metrics_name_;                   /// 指标中模型的名称，为空时不记录指标
+  ModelMetrics *model_metrics_ = nullptr;      /// 模型的指标
+  std::vector<LayerTypeMetrics *> layer_metrics_; /// 按执行顺序排列的各节点所属类型的指标
+  std::map<uint32_t, MetricsHistogram *> forward_latency_; /// 各批次大小的推理延迟
+
+  bool trace_enabled_ = false;        /// 是否打开推理追踪
+  uint32_t trace_sample_every_ = 0;   /// 追踪的采样间隔
+  int64_t trace_slow_threshold_ns_ = 0; /// 慢推理的阈值
+  int64_t trace_graph_id_ = -1;       /// 在RuntimeTracer中注册的编号
+  uint64_t trace_runs_ = 0;           /// 打开追踪以来的推理次数
+  std::vector<TraceSpan> trace_spans_; /// 按执行顺序排列的各节点耗时
+
+  std::unique_ptr<ForwardRecorder> recorder_; /// 录制推理输入的日志，为空时不录制
+
+  bool executed_ = false;              /// 是否执行过推理，推理之后进程中可能已经有OpenMP的线程池
+  bool first_forward_pending_ = true;  /// 是否还没有记录第一次推理的耗时
+  double first_forward_ms_ = 0.;       /// Build或者Warmup之后第一次推理的耗时
+
+  bool profile_enabled_ = false;        /// 是否打开逐节点计时
+  uint64_t profile_runs_ = 0;           /// 打开计时以来的推理次数
+  std::vector<int64_t> op_profile_ns_;  /// 按执行顺序排列的各节点累计耗时
 };
 
 } // namespace kuiper_infer
\ No newline at end of file
@@ -0,0 +1,164 @@
+//
+// Created by fss on 23-9-2.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
+#include <memory>
+#include <vector>
+#include "data/tensor.hpp"
+#include "runtime_op.hpp"
+
+namespace kuiper_infer {
+
+/// 计算图内存规划的统计信息
+struct RuntimeMemoryReport {
+  uint64_t memory_budget = 0;     /// 内存预算的字节数，0表示不限制
+  uint64_t unplanned_bytes = 0;   /// 不做复用时所有节点输出所需的字节数
+  uint64_t planned_bytes = 0;     /// 复用之后节点输出实际占用的字节数
+  uint64_t workspace_limit = 0;   /// 分给Layer临时空间的上限，0表示不限制
+  uint32_t memory_blocks = 0;     /// 被复用的内存块数量
+  uint32_t inplace_operators = 0; /// 原地计算的节点数量
+  uint32_t view_operators = 0;    /// 输出是输入视图、不占用内存的节点数量
+  uint32_t scratch_operators = 0; /// 缓冲区由内存规划分配的节点数量
+  uint64_t topo_peak_bytes = 0;       /// 深度优先的拓扑顺序下同时存活的节点输出字节数的峰值
+  uint64_t scheduled_peak_bytes = 0;  /// 调整执行顺序之后同时存活的节点输出字节数的峰值
+  uint64_t topo_planned_bytes = 0;    /// 深度优先的拓扑顺序下复用之后节点输出占用的字节数
+  uint64_t layer_buffer_bytes = 0;    /// Layer自己持有、在多次推理之间复用的缓冲区的字节数
+  uint64_t workspace_peak_bytes = 0;  /// 推理时单个Layer实际使用过的临时空间的最大字节数
+
+  /**
+   * 返回预算模式下实际测得的运行时内存峰值，即节点输出、Layer持有的缓冲区和临时空间的峰值之和，
+   * 临时空间和缓冲区在推理之后才会更新，Build之后只包含已知的部分
+   * @return 内存峰值的字节数
+   */
+  uint64_t peak_bytes() const {
+    return planned_bytes + layer_buffer_bytes + workspace_peak_bytes;
+  }
+};
+
+/// 计算图预热的统计信息
+struct WarmupReport {
+  uint64_t locked_bytes = 0;      /// 锁定在物理内存中的字节数
+  uint32_t runs = 0;              /// 预热时推理的次数
+  double lock_ms = 0.;            /// 锁定内存页的耗时
+  double cold_forward_ms = 0.;    /// 预热时第一次推理的耗时，即不预热时首个请求的延迟
+  double warm_forward_ms = 0.;    /// 预热时最后一次推理的耗时，接近稳态的延迟
+};
+
+/// 锁定在物理内存中的内存区域，析构或者Unlock时逐个解锁
+class LockedMemory {
+ public:
+  LockedMemory() = default;
+
+  ~LockedMemory();
+
+  LockedMemory(const LockedMemory&) = delete;
+
+  LockedMemory& operator=(const LockedMemory&) = delete;
+
+  /**
+   * 把张量所在的内存页锁定在物理内存中，锁定失败时只输出警告
+   * @param tensor 需要锁定的张量
+   * @return 锁定成功的字节数
+   */
+  uint64_t Lock(const std::shared_ptr<Tensor<float>>& tensor);
+
+  /**
+   * 解锁所有锁定过的内存区域
+   */
+  void Unlock();
+
+  /**
+   * 返回当前锁定的字节数
+   * @return 锁定的字节数
+   */
+  uint64_t locked_bytes() const;
+
+ private:
+  std::vector<std::pair<void*, uint64_t>> ranges_;  /// 锁定的起始地址和字节数
+};
+
+struct LivenessGraph;
+
+struct MemoryLayout;
+
+/// 在内存预算下为计算图的节点输出分配内存
+class RuntimeMemoryPlanner {
+ public:
+  /**
+   * 按执行顺序分析节点输出的生命周期，让生命周期不重叠的输出复用同一块内存，
+   * 逐元素计算的节点直接在唯一前驱的输出上原地计算，Layer执行期间的缓冲区(例如卷积带边框的输入)
+   * 也从内存块中分配，扣除Layer自己持有的缓冲区之后，
+   * 剩余的预算作为Layer的临时空间上限
+   * @param topo_operators 按执行顺序排列的计算节点，节点的输出空间需已初始化
+   * @param memory_budget 内存预算的字节数，0表示只做复用不限制临时空间
+   * @param report 内存规划的统计信息
+   * @return 是否规划成功，预算放不下节点输出和Layer的缓冲区时返回false，节点的输出保持不变
+   */
+  bool Plan(const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+            uint64_t memory_budget, RuntimeMemoryReport& report);
+
+  /**
+   * 按执行顺序估计同时存活的节点输出字节数的峰值，输出在最后一个后继节点执行完之后释放，
+   * 视图和原地计算的节点不占用新的内存，只延长所在内存的生命周期，图的输入不计入
+   * @param topo_operators 按执行顺序排列的计算节点，节点的输出空间需已初始化
+   * @return 峰值的字节数
+   */
+  static uint64_t PeakLiveBytes(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators);
+
+  /**
+   * 按Plan的规则为节点输出分配内存块，返回复用之后节点输出占用的字节数，不修改节点的输出
+   * @param topo_operators 按执行顺序排列的计算节点，节点的输出空间需已初始化
+   * @return 复用之后节点输出占用的字节数
+   */
+  static uint64_t PlannedBytes(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators);
+
+  /**
+   * 在计算图的所有拓扑顺序中搜索内存规划结果较小的执行顺序
+   * 每一步把束中的部分顺序分别接上一个可以执行的节点，按存活峰值、当前存活的字节数和节点在原顺序中的位置
+   * 排序后保留前beam_width个，beam_width为1时退化为贪心；部分顺序只记录相对父节点多执行的节点，
+   * 切换时在同一个状态上撤销和执行节点。搜索结束后按PlannedBytes比较束中的完整顺序和原来的顺序，
+   * 返回规划字节数最小的，结果不比原来的顺序大
+   * @param topo_operators 按拓扑顺序排列的计算节点，节点的输出空间需已初始化
+   * @param beam_width 每一步保留的部分顺序数量
+   * @return 调整之后的执行顺序
+   */
+  static std::vector<std::shared_ptr<RuntimeOperator>> Schedule(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+      uint32_t beam_width);
+
+ private:
+  /**
+   * 分析节点之间的依赖、输出的字节数以及视图和原地计算的节点输出所在的内存
+   * @param topo_operators 按拓扑顺序排列的计算节点
+   * @return 以节点在topo_operators中的位置为索引的依赖和内存信息
+   */
+  static LivenessGraph BuildLivenessGraph(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators);
+
+  /**
+   * 按执行顺序分析节点输出的生命周期，为节点输出和Layer的缓冲区分配内存块，不修改节点
+   * @param topo_operators 按执行顺序排列的计算节点，节点的输出空间需已初始化
+   * @param report 填入输出的字节数、内存块、原地计算和视图节点的统计信息
+   * @return 内存块的大小以及节点输出和缓冲区所在的内存块
+   */
+  static MemoryLayout AssignBlocks(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+      RuntimeMemoryReport& report);
+
+  /**
+   * 判断节点是否可以在输入上原地计算
+   * @param op 计算节点
+   * @return 是否可以原地计算
+   */
+  static bool IsInplaceOperator(const std::shared_ptr<RuntimeOperator>& op);
+
+ private:
+  std::vector<std::vector<float>> memory_blocks_;  /// 节点输出复用的内存块
+};
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
@@ -0,0 +1,183 @@
+//
+// Created by fss on 23-9-9.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace kuiper_infer {
+
+/// 直方图，各个桶的计数和总和都是原子变量，记录时不加锁
+class MetricsHistogram {
+ public:
+  /**
+   * @param bounds 各个桶的上界，需要递增排列，最后隐含一个+Inf桶
+   */
+  explicit MetricsHistogram(std::vector<double> bounds);
+
+  /**
+   * 记录一次观测值
+   * @param value 观测值
+   */
+  void Observe(double value);
+
+  /**
+   * 返回各个桶的上界
+   * @return 桶的上界
+   */
+  const std::vector<double>& bounds() const;
+
+  /**
+   * 返回小于等于第index个桶上界的观测次数，index等于bounds().size()时为总次数
+   * @param index 桶的序号
+   * @return 累计的观测次数
+   */
+  uint64_t cumulative_count(uint32_t index) const;
+
+  /**
+   * 返回观测值的总和
+   * @return 观测值的总和
+   */
+  double sum() const;
+
+ private:
+  std::vector<double> bounds_;
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets_;  /// 每个桶各自的计数
+  std::atomic<double> sum_{0.};
+};
+
+/// 某一类型的层在某个模型中累计的执行次数和时间
+struct LayerTypeMetrics {
+  std::atomic<uint64_t> calls{0};        /// 执行次数
+  std::atomic<uint64_t> nanoseconds{0};  /// 执行时间的纳秒数
+};
+
+/// 某个模型的指标，由RuntimeGraph在推理时更新
+struct ModelMetrics {
+  std::atomic<int64_t> queue_depth{0};        /// 正在执行的推理数量
+  std::atomic<uint64_t> pool_memory_bytes{0}; /// 节点输出占用的内存
+  MetricsHistogram allocations;               /// 每次推理中张量分配内存的次数
+
+  ModelMetrics();
+};
+
+/// 进程内全局的运行时指标，按Prometheus文本格式导出
+class RuntimeMetrics {
+ public:
+  static RuntimeMetrics& Instance();
+
+  /**
+   * 返回模型在某个批次大小下的推理延迟直方图，单位为秒，不存在时创建
+   * @param model 模型的名称
+   * @param batch 批次大小
+   * @return 直方图，地址在进程生命周期内不变
+   */
+  MetricsHistogram* ForwardLatency(const std::string& model, uint32_t batch);
+
+  /**
+   * 返回模型中某一类型的层的统计，不存在时创建
+   * @param model 模型的名称
+   * @param layer_type 层的类型
+   * @return 层的统计，地址在进程生命周期内不变
+   */
+  LayerTypeMetrics* LayerType(const std::string& model,
+                              const std::string& layer_type);
+
+  /**
+   * 返回模型的指标，不存在时创建
+   * @param model 模型的名称
+   * @return 模型的指标，地址在进程生命周期内不变
+   */
+  ModelMetrics* Model(const std::string& model);
+
+  /**
+   * 按Prometheus文本格式输出所有指标
+   * @return 文本格式的指标
+   */
+  std::string Exposition() const;
+
+  /**
+   * 把所有指标写入文件，先写入临时文件再重命名，读取方不会看到写了一半的内容
+   * @param path 文件路径
+   * @return 是否写入成功
+   */
+  bool WriteTo(const std::string& path) const;
+
+ private:
+  RuntimeMetrics() = default;
+
+  mutable std::mutex mutex_;  /// 只在创建和导出指标时加锁
+  std::map<std::tuple<std::string, uint32_t>, std::unique_ptr<MetricsHistogram>>
+      forward_latency_;
+  std::map<std::tuple<std::string, std::string>,
+           std::unique_ptr<LayerTypeMetrics>>
+      layer_types_;
+  std::map<std::string, std::unique_ptr<ModelMetrics>> models_;
+};
+
+/// 在后台线程中导出运行时指标，可以监听本机的HTTP端口或者定期写入文件
+class MetricsExporter {
+ public:
+  MetricsExporter() = default;
+
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  /**
+   * 在127.0.0.1上监听HTTP请求，GET /metrics返回文本格式的指标
+   * @param port 监听的端口，0表示由系统分配
+   * @return 是否启动成功
+   */
+  bool StartHttp(uint16_t port);
+
+  /**
+   * 每隔interval_ms毫秒把指标写入文件
+   * @param path 文件路径
+   * @param interval_ms 写入的间隔
+   * @return 是否启动成功
+   */
+  bool StartFile(const std::string& path, uint32_t interval_ms);
+
+  /**
+   * 停止后台线程并关闭监听的端口
+   */
+  void Stop();
+
+  /**
+   * 返回实际监听的HTTP端口
+   * @return 端口号，没有监听时为0
+   */
+  uint16_t port() const;
+
+  /**
+   * 返回进程中正在运行后台线程的导出器数量，fork之前需要为0
+   * @return 导出器的数量
+   */
+  static uint32_t running_exporters();
+
+ private:
+  void ServeHttp();
+
+  void WriteFile(const std::string& path, uint32_t interval_ms);
+
+ private:
+  std::atomic<bool> running_{false};
+  int listen_fd_ = -1;   /// 监听的socket
+  uint16_t port_ = 0;    /// 实际监听的端口
+  std::thread worker_;   /// 导出指标的后台线程
+};
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
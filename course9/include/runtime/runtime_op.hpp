@@ -73,11 +73,11 @@ public:
   /**
    * 如果图是第一次运行，则根据节点输出operand的形状准备好后续Layer计算中所需要的Tensor
    * 如果图是第二次以上运行，则检查输出operand的形状和operand中张量的形状是否匹配
-   * @param pnnx_operators pnnx图节点
+   * @param pnnx_outputs 和计算节点一一对应的pnnx输出操作数，节点没有输出时为空指针
    * @param operators KuiperInfer计算图中的计算节点
    */
   static void InitOperatorOutput(
-      const std::vector<pnnx::Operator*>& pnnx_operators,
+      const std::vector<pnnx::Operand*>& pnnx_outputs,
       const std::vector<std::shared_ptr<RuntimeOperator>>& operators);
 };
 
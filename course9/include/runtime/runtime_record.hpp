@@ -0,0 +1,143 @@
+//
+// Created by fss on 23-9-11.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_RECORD_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_RECORD_HPP_
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+class RuntimeGraph;
+
+/// 录制的一次推理，包括输入张量和当时的耗时
+struct ForwardRecord {
+  int64_t offset_ns = 0;   /// 相对于录制开始的时间
+  int64_t latency_ns = 0;  /// 录制时推理的耗时
+  std::vector<sftensor> inputs;
+};
+
+/// 把推理的输入和耗时追加写入二进制日志，多个线程可以同时写入
+/// 推理线程只把输入的拷贝放入有界队列，由后台的写线程写入文件，队列满时丢弃新的记录
+class ForwardRecorder {
+ public:
+  /**
+   * 创建日志文件并写入文件头，文件打开成功时启动写线程
+   * @param path 日志文件的路径
+   * @param queue_capacity 等待写入的记录数量上限
+   */
+  explicit ForwardRecorder(const std::string& path,
+                           uint32_t queue_capacity = 16);
+
+  /**
+   * 写完队列中剩余的记录之后停止写线程
+   */
+  ~ForwardRecorder();
+
+  ForwardRecorder(const ForwardRecorder&) = delete;
+
+  ForwardRecorder& operator=(const ForwardRecorder&) = delete;
+
+  /**
+   * 返回日志文件是否打开成功
+   * @return 是否打开成功
+   */
+  bool is_open() const;
+
+  /**
+   * 追加一次推理的记录，只拷贝输入并放入队列，不等待写入文件
+   * @param inputs 推理的输入张量
+   * @param start_ns 推理开始的时间，steady_clock的纳秒数
+   * @param latency_ns 推理的耗时
+   */
+  void Record(const std::vector<sftensor>& inputs, int64_t start_ns,
+              int64_t latency_ns);
+
+  /**
+   * 等待队列中的记录全部写入文件
+   */
+  void Flush();
+
+  /**
+   * 返回已经写入文件的记录数量
+   * @return 记录数量
+   */
+  uint64_t records() const;
+
+  /**
+   * 返回队列满时被丢弃的记录数量
+   * @return 记录数量
+   */
+  uint64_t dropped() const;
+
+ private:
+  /**
+   * 写线程的主循环，逐条取出队列中的记录写入文件
+   */
+  void WriteLoop();
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable queue_cv_;    /// 有新记录或者需要停止时通知写线程
+  std::condition_variable drained_cv_;  /// 队列写空时通知等待的线程
+  std::deque<ForwardRecord> queue_;     /// 等待写入的记录，offset_ns为相对时间
+  uint32_t queue_capacity_ = 0;
+  bool writing_ = false;  /// 写线程是否正在写入一条已经出队的记录
+  bool stop_ = false;
+  std::ofstream file_;
+  int64_t first_start_ns_ = -1;  /// 第一条记录的开始时间
+  uint64_t records_ = 0;
+  uint64_t dropped_ = 0;
+  std::thread writer_;
+};
+
+/**
+ * 读取录制的二进制日志
+ * @param path 日志文件的路径
+ * @param records 读取到的记录
+ * @return 是否读取成功，文件末尾不完整的记录会被忽略
+ */
+bool LoadForwardRecords(const std::string& path,
+                        std::vector<ForwardRecord>& records);
+
+/// 延迟分布的统计，单位为毫秒
+struct LatencyReport {
+  uint32_t samples = 0;
+  double mean = 0.;
+  double p50 = 0.;
+  double p90 = 0.;
+  double p99 = 0.;
+  double max = 0.;
+  double throughput = 0.;  /// 每秒完成的推理数量
+
+  /**
+   * 根据延迟样本计算分布
+   * @param latencies 各次推理的延迟，单位为毫秒
+   * @param elapsed_ms 完成这些推理所用的总时间
+   * @return 延迟分布
+   */
+  static LatencyReport FromSamples(std::vector<double> latencies,
+                                   double elapsed_ms);
+};
+
+/**
+ * 把录制的输入按原来的节奏或者尽可能快地送入计算图
+ * @param graph 已经构建完成的计算图
+ * @param records 录制的记录
+ * @param recorded_rate 为true时按录制时的时间间隔发送，否则连续执行
+ * @return 回放时的延迟分布
+ */
+LatencyReport ReplayForwardRecords(RuntimeGraph& graph,
+                                   const std::vector<ForwardRecord>& records,
+                                   bool recorded_rate);
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_RECORD_HPP_
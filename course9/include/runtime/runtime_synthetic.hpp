@@ -0,0 +1,63 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_SYNTHETIC_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_SYNTHETIC_HPP_
+#include <cstdint>
+#include <string>
+
+namespace kuiper_infer {
+
+/// 随机计算图的生成参数
+struct SyntheticGraphOptions {
+  uint32_t depth = 8;             /// 主干上串联的阶段数
+  uint32_t branches = 2;          /// 每个阶段最多的并行分支数，大于1时分支的输出沿通道拼接
+  uint32_t branch_length = 2;     /// 每个分支中最多串联的卷积数量
+  float residual_density = 0.5f;  /// 每个阶段的输出和之前同形状的某个张量相加的概率
+  uint32_t pool_every = 0;        /// 每隔多少个阶段做一次步长为2的最大池化，0表示不池化
+  uint32_t input_channels = 3;    /// 输入的通道数
+  uint32_t channels = 16;         /// 主干和各分支的通道数
+  uint32_t input_h = 32;          /// 输入的高度
+  uint32_t input_w = 32;          /// 输入的宽度
+  uint32_t batch = 1;             /// 批次大小，不影响权重，相同的种子在不同批次下生成相同的权重
+  uint32_t seed = 0;              /// 随机种子，相同的参数和种子生成相同的计算图
+};
+
+/// 随机计算图的统计信息
+struct SyntheticGraphReport {
+  uint32_t operators = 0;     /// 节点数量，包括输入和输出节点
+  uint32_t operands = 0;      /// 张量数量
+  uint32_t convolutions = 0;  /// 卷积节点数量
+  uint32_t activations = 0;   /// ReLU节点数量
+  uint32_t concats = 0;       /// 拼接节点数量
+  uint32_t residuals = 0;     /// 残差相加的表达式节点数量
+  uint32_t pools = 0;         /// 最大池化节点数量
+  uint64_t activation_bytes = 0;  /// 所有张量不复用时的字节数
+  uint64_t weight_bytes = 0;      /// 权重的字节数
+  uint32_t output_channels = 0;   /// 输出的通道数
+  uint32_t output_h = 0;          /// 输出的高度
+  uint32_t output_w = 0;          /// 输出的宽度
+};
+
+/**
+ * 生成一个随机的pnnx计算图，只使用已经注册的nn.Conv2d、nn.ReLU、pnnx.Expression、
+ * torch.cat和nn.MaxPool2d，用来给拓扑排序、内存规划和执行器做规模化的测试和性能测试
+ *
+ * 计算图的结构: 输入 -> 卷积 + ReLU -> depth个阶段 -> 输出，每个阶段随机分为1到branches个分支，
+ * 每个分支是1到branch_length个卷积 + ReLU，多个分支的输出拼接后用1x1卷积恢复通道数，
+ * 阶段的输出按residual_density的概率和之前任意一个同形状的张量相加，形成跨多个阶段的长残差
+ * 输入节点为pnnx_input_0，输出节点为pnnx_output_0
+ * @param options 生成参数
+ * @param param_path 生成的结构文件路径
+ * @param bin_path 生成的权重文件路径
+ * @param report 生成的计算图的统计信息，可以为空
+ * @return 是否生成成功，参数不合法或者写文件失败时返回false
+ */
+bool GenerateSyntheticGraph(const SyntheticGraphOptions &options,
+                            const std::string &param_path,
+                            const std::string &bin_path,
+                            SyntheticGraphReport *report = nullptr);
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_SYNTHETIC_HPP_
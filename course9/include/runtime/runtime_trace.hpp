@@ -0,0 +1,129 @@
+//
+// Created by fss on 23-9-10.
+//
+
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_TRACE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_TRACE_HPP_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "runtime_op.hpp"
+
+namespace kuiper_infer {
+
+/// 一次推理中单个节点的执行时间
+struct TraceSpan {
+  int64_t start_ns = 0;     /// 开始时间，steady_clock的纳秒数
+  int64_t duration_ns = 0;  /// 执行时间的纳秒数
+};
+
+/// 追踪记录的一个事件，op_index为-1时表示整次推理
+struct TraceEvent {
+  uint64_t run_id = 0;
+  uint32_t graph_id = 0;
+  int32_t op_index = -1;
+  int64_t start_ns = 0;
+  int64_t duration_ns = 0;
+  bool slow = false;  /// 是否因为超过延迟阈值而被记录
+};
+
+/// 进程内全局的推理追踪，事件写入固定大小的无锁环形缓冲区，旧的事件会被覆盖
+class RuntimeTracer {
+ public:
+  static RuntimeTracer& Instance();
+
+  /**
+   * 注册计算图中按执行顺序排列的节点，导出时用于查找节点的名称和类型
+   * @param topo_operators 按执行顺序排列的计算节点
+   * @return 计算图的编号
+   */
+  uint32_t RegisterGraph(
+      const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators);
+
+  /**
+   * 分配一个全局唯一的推理编号
+   * @return 推理编号
+   */
+  uint64_t NextRunId();
+
+  /**
+   * 把一次推理的整体耗时和各节点的耗时写入环形缓冲区，多个线程可以同时写入
+   * @param graph_id 计算图的编号
+   * @param run_id 推理编号
+   * @param run_span 整次推理的耗时
+   * @param spans 按执行顺序排列的各节点耗时
+   * @param slow 是否因为超过延迟阈值而被记录
+   */
+  void Commit(uint32_t graph_id, uint64_t run_id, const TraceSpan& run_span,
+              const std::vector<TraceSpan>& spans, bool slow);
+
+  /**
+   * 读取环形缓冲区中完整的事件，写入过程中的事件会被跳过
+   * @return 按推理编号和开始时间排序的事件
+   */
+  std::vector<TraceEvent> Snapshot() const;
+
+  /**
+   * 按Chrome Trace Event格式导出环形缓冲区中的事件
+   * @return JSON格式的追踪记录
+   */
+  std::string DumpJson() const;
+
+  /**
+   * 把JSON格式的追踪记录写入文件
+   * @param path 文件路径
+   * @return 是否写入成功
+   */
+  bool DumpToFile(const std::string& path) const;
+
+  /**
+   * 注册SIGUSR1的处理函数，收到信号后由后台线程把追踪记录写入文件
+   * @param path 文件路径
+   * @return 是否注册成功
+   */
+  bool InstallSignalHandler(const std::string& path);
+
+  /**
+   * 返回是否已经注册了SIGUSR1的处理函数，注册之后进程中一直有写追踪文件的后台线程
+   * @return 是否已经注册
+   */
+  bool signal_handler_installed() const;
+
+  /**
+   * 返回环形缓冲区可以保存的事件数量
+   * @return 事件数量
+   */
+  uint32_t capacity() const;
+
+ private:
+  RuntimeTracer();
+
+  /// 环形缓冲区的槽位，sequence为奇数时表示正在写入，字段都是原子变量以便并发读取
+  struct TraceSlot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> run_id{0};
+    std::atomic<uint32_t> graph_id{0};
+    std::atomic<int32_t> op_index{-1};
+    std::atomic<int64_t> start_ns{0};
+    std::atomic<int64_t> duration_ns{0};
+    std::atomic<bool> slow{false};
+  };
+
+  void Write(const TraceEvent& event);
+
+ private:
+  std::unique_ptr<TraceSlot[]> slots_;  /// 环形缓冲区
+  uint32_t capacity_ = 0;
+  std::atomic<uint64_t> head_{0};       /// 下一个写入位置
+  std::atomic<uint64_t> run_id_{0};
+
+  mutable std::mutex graphs_mutex_;  /// 只在注册和导出时加锁
+  std::vector<std::vector<std::pair<std::string, std::string>>> graphs_;
+  std::string signal_path_;  /// 收到信号时写入的文件
+};
+
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_TRACE_HPP_
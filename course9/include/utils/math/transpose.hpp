@@ -0,0 +1,64 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-7.
+
+#ifndef KUIPER_INFER_INCLUDE_UTILS_MATH_TRANSPOSE_HPP_
+#define KUIPER_INFER_INCLUDE_UTILS_MATH_TRANSPOSE_HPP_
+#include <cstdint>
+
+namespace kuiper_infer {
+/**
+ * 转置一个列主序矩阵，结果同样按列主序存放
+ * 列主序的rows x cols矩阵转置后，内存排布和该矩阵的行主序排布相同，可用于行主序和列主序之间的转换
+ * @param src 源矩阵，rows x cols，列主序
+ * @param dst 目标矩阵，cols x rows，列主序，不能和源矩阵重叠
+ * @param rows 源矩阵的行数
+ * @param cols 源矩阵的列数
+ */
+void Transpose(const float* src, float* dst, uint32_t rows, uint32_t cols);
+
+/**
+ * 转置一个列之间有间隔的列主序矩阵，用于在张量的任意两个维度之间转置
+ * 源矩阵中(r, c)位于src[r + c * src_stride]，转置后位于dst[c + r * dst_stride]
+ * @param src 源矩阵，rows x cols，每列连续存放
+ * @param src_stride 源矩阵相邻两列的间隔，不小于rows
+ * @param dst 目标矩阵，cols x rows，每列连续存放，不能和源矩阵重叠
+ * @param dst_stride 目标矩阵相邻两列的间隔，不小于cols
+ * @param rows 源矩阵的行数
+ * @param cols 源矩阵的列数
+ */
+void TransposeStrided(const float* src, uint64_t src_stride, float* dst,
+                      uint64_t dst_stride, uint32_t rows, uint32_t cols);
+
+/**
+ * 依次转置多个连续存放的列主序矩阵，例如张量的各个通道
+ * @param src 源矩阵，planes个rows x cols的矩阵连续存放
+ * @param dst 目标矩阵，planes个cols x rows的矩阵连续存放，不能和源矩阵重叠
+ * @param rows 源矩阵的行数
+ * @param cols 源矩阵的列数
+ * @param planes 矩阵的数量
+ */
+void TransposePlanes(const float* src, float* dst, uint32_t rows,
+                     uint32_t cols, uint32_t planes);
+}  // namespace kuiper_infer
+
+#endif  // KUIPER_INFER_INCLUDE_UTILS_MATH_TRANSPOSE_HPP_
@@ -83,6 +83,10 @@ InferStatus Layer::Forward() {
   return status;
 }
 
+void Layer::set_workspace_limit(uint64_t workspace_limit) {
+  this->workspace_limit_ = workspace_limit;
+}
+
 void Layer::set_runtime_operator(
     const std::shared_ptr<RuntimeOperator>& runtime_operator) {
   CHECK(runtime_operator != nullptr);
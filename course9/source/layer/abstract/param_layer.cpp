@@ -23,6 +23,8 @@
 
 #include "layer/abstract/param_layer.hpp"
 #include <glog/logging.h>
+#include <algorithm>
+#include <utility>
 
 namespace kuiper_infer {
 ParamLayer::ParamLayer(const std::string& layer_name) : Layer(layer_name) {}
@@ -126,4 +128,34 @@ void ParamLayer::set_bias(const std::vector<float>& bias) {
   }
 }
 
+uint64_t ParamLayer::constant_floats() const {
+  uint64_t floats = 0;
+  for (const auto* params : {&this->weights_, &this->bias_}) {
+    for (const auto& param : *params) {
+      if (param != nullptr && !param->empty()) {
+        floats += AlignConstant(param->size());
+      }
+    }
+  }
+  return floats;
+}
+
+uint64_t ParamLayer::MoveConstants(float* arena) {
+  CHECK(arena != nullptr);
+  uint64_t offset = 0;
+  for (auto* params : {&this->weights_, &this->bias_}) {
+    for (const auto& param : *params) {
+      if (param == nullptr || param->empty()) {
+        continue;
+      }
+      const uint64_t size = param->size();
+      const float* data = std::as_const(*param).data().memptr();
+      std::copy(data, data + size, arena + offset);
+      *param = Tensor<float>(arena + offset, param->raw_shapes());
+      offset += AlignConstant(size);
+    }
+  }
+  return offset;
+}
+
 }  // namespace kuiper_infer
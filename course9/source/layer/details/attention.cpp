@@ -0,0 +1,302 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "attention.hpp"
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+#include "utils/math/fmath.hpp"
+
+namespace kuiper_infer {
+/// 每个任务处理的query数量
+static constexpr uint32_t kAttentionQueryBlock = 64;
+
+/// 每次计算的key数量，一块注意力分数为64 x 128个float，可以留在L2缓存中
+static constexpr uint32_t kAttentionKeyBlock = 128;
+
+/**
+ * 对一列注意力分数中[begin, end)范围内的行计算column[r] = exp(column[r] - max[r])，
+ * 并累加到sum[r]中
+ */
+static void ExpSubAccumulate(float* column, const float* max, float* sum,
+                             uint32_t begin, uint32_t end) {
+  uint32_t r = begin;
+#if defined(__AVX2__)
+  for (; r + 8 <= end; r += 8) {
+    const __m256 value = fmath::exp_ps256(
+        _mm256_sub_ps(_mm256_loadu_ps(column + r), _mm256_loadu_ps(max + r)));
+    _mm256_storeu_ps(column + r, value);
+    _mm256_storeu_ps(sum + r, _mm256_add_ps(_mm256_loadu_ps(sum + r), value));
+  }
+#elif defined(__SSE2__)
+  for (; r + 4 <= end; r += 4) {
+    const __m128 value = fmath::exp_ps(
+        _mm_sub_ps(_mm_loadu_ps(column + r), _mm_loadu_ps(max + r)));
+    _mm_storeu_ps(column + r, value);
+    _mm_storeu_ps(sum + r, _mm_add_ps(_mm_loadu_ps(sum + r), value));
+  }
+#endif
+  for (; r < end; ++r) {
+    column[r] = fmath::exp(column[r] - max[r]);
+    sum[r] += column[r];
+  }
+}
+
+/**
+ * 计算一个头中[begin, end)范围内query的注意力输出
+ * 张量按列存储，矩阵的一行是一个token，所以query块和key块都是连续的若干行
+ * @param query 当前头的query，形状为L x D
+ * @param key 当前头的key，形状为S x D
+ * @param value 当前头的value，形状为S x Dv
+ * @param begin 起始query
+ * @param end 结束query
+ * @param scale 缩放系数
+ * @param is_causal 第r个query是否只关注前r个key
+ * @param output 当前头的输出，形状为L x Dv
+ */
+static void AttentionBlock(const arma::fmat& query, const arma::fmat& key,
+                           const arma::fmat& value, uint32_t begin,
+                           uint32_t end, float scale, bool is_causal,
+                           arma::fmat& output) {
+  const uint32_t rows = end - begin;
+  const uint32_t key_size = key.n_rows;
+  // 缩放系数合并到query中，每个query块只乘一次
+  const arma::fmat scaled_query = query.rows(begin, end - 1) * scale;
+  arma::fvec row_max(rows);
+  row_max.fill(-std::numeric_limits<float>::infinity());
+  arma::fvec row_sum(rows, arma::fill::zeros);
+  arma::fvec new_max(rows);
+  std::vector<float> correction(rows);
+  arma::fmat accumulate(rows, value.n_cols, arma::fill::zeros);
+  arma::fmat scores;
+
+  for (uint32_t key_begin = 0; key_begin < key_size;
+       key_begin += kAttentionKeyBlock) {
+    // 因果掩码下，整个key块都在最后一个query之后时不再计算
+    if (is_causal && key_begin > end - 1) {
+      break;
+    }
+    const uint32_t key_end = std::min(key_begin + kAttentionKeyBlock, key_size);
+    scores = scaled_query * key.rows(key_begin, key_end - 1).t();
+
+    // 第j个key对行号不小于first_rows[j]的query可见
+    const auto first_row = [&](uint32_t j) -> uint32_t {
+      if (!is_causal || key_begin + j <= begin) {
+        return 0;
+      }
+      return std::min(key_begin + j - begin, rows);
+    };
+
+    float* new_max_ptr = new_max.memptr();
+    std::copy(row_max.begin(), row_max.end(), new_max_ptr);
+    for (uint32_t j = 0; j < scores.n_cols; ++j) {
+      const float* column = scores.colptr(j);
+      const uint32_t first = first_row(j);
+#pragma omp simd
+      for (uint32_t r = first; r < rows; ++r) {
+        new_max_ptr[r] = std::max(new_max_ptr[r], column[r]);
+      }
+    }
+
+    // 行最大值变大时，之前累加的结果和分母都需要乘上exp(old_max - new_max)
+    for (uint32_t r = 0; r < rows; ++r) {
+      correction[r] = std::exp(row_max[r] - new_max_ptr[r]);
+      row_sum[r] *= correction[r];
+    }
+    for (uint32_t j = 0; j < scores.n_cols; ++j) {
+      float* column = scores.colptr(j);
+      const uint32_t first = first_row(j);
+      std::fill(column, column + first, 0.f);
+      ExpSubAccumulate(column, new_max_ptr, row_sum.memptr(), first, rows);
+    }
+    for (uint32_t d = 0; d < accumulate.n_cols; ++d) {
+      float* column = accumulate.colptr(d);
+#pragma omp simd
+      for (uint32_t r = 0; r < rows; ++r) {
+        column[r] *= correction[r];
+      }
+    }
+    accumulate += scores * value.rows(key_begin, key_end - 1);
+    row_max = new_max;
+  }
+  for (uint32_t d = 0; d < accumulate.n_cols; ++d) {
+    const float* column = accumulate.colptr(d);
+    float* output_column = output.colptr(d) + begin;
+    for (uint32_t r = 0; r < rows; ++r) {
+      output_column[r] = column[r] / row_sum[r];
+    }
+  }
+}
+
+ScaledDotProductAttentionLayer::ScaledDotProductAttentionLayer(bool is_causal,
+                                                               float scale)
+    : NonParamLayer("ScaledDotProductAttention"),
+      is_causal_(is_causal),
+      scale_(scale) {}
+
+InferStatus ScaledDotProductAttentionLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the attention layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  // 输入按操作数排列，依次是query、key和value
+  if (inputs.size() != outputs.size() * 3) {
+    LOG(ERROR) << "The input and output tensor array size of the attention "
+                  "layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = outputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& query = inputs.at(i);
+    const sftensor& key = inputs.at(i + batch_size);
+    const sftensor& value = inputs.at(i + batch_size * 2);
+    if (query == nullptr || query->empty() || key == nullptr ||
+        key->empty() || value == nullptr || value->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the attention layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (query->cols() != key->cols() || key->rows() != value->rows()) {
+      LOG(ERROR) << "The query, key and value shapes of the attention layer do "
+                    "not match "
+                 << i << " th";
+      return InferStatus::kInferFailedShapeParameterError;
+    }
+    // key和value的头数可以少于query，多个query头共享一组key和value
+    if (key->channels() != value->channels() ||
+        query->channels() % key->channels() != 0) {
+      LOG(ERROR) << "The heads of the attention layer do not match "
+                 << i << " th";
+      return InferStatus::kInferFailedChannelParameterError;
+    }
+    const sftensor& output = outputs.at(i);
+    if (output != nullptr && !output->empty()) {
+      if (output->channels() != query->channels() ||
+          output->rows() != query->rows() || output->cols() != value->cols()) {
+        LOG(ERROR) << "The output tensor shape of the attention layer is wrong "
+                   << i << " th";
+        return InferStatus::kInferFailedOutputSizeError;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& query = inputs.at(i);
+    const sftensor& key = inputs.at(i + batch_size);
+    const sftensor& value = inputs.at(i + batch_size * 2);
+    const uint32_t heads = query->channels();
+    const uint32_t query_size = query->rows();
+    const uint32_t key_size = key->rows();
+    const uint32_t head_dim = query->cols();
+    const uint32_t value_dim = value->cols();
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(heads, query_size, value_dim);
+      outputs.at(i) = output;
+    }
+
+    float* query_ptr =
+        const_cast<float*>(std::as_const(*query).data().memptr());
+    float* key_ptr = const_cast<float*>(std::as_const(*key).data().memptr());
+    float* value_ptr =
+        const_cast<float*>(std::as_const(*value).data().memptr());
+    float* output_ptr = output->raw_ptr();
+    const uint32_t group = heads / key->channels();
+    const float scale =
+        scale_ > 0.f ? scale_ : 1.f / std::sqrt(float(head_dim));
+    const bool is_causal = is_causal_;
+    const uint32_t query_blocks =
+        (query_size + kAttentionQueryBlock - 1) / kAttentionQueryBlock;
+    const uint32_t tasks = heads * query_blocks;
+#pragma omp parallel for if (tasks > 1)
+    for (uint32_t task = 0; task < tasks; ++task) {
+      const uint32_t h = task / query_blocks;
+      const uint32_t kv_h = h / group;
+      const uint32_t begin = (task % query_blocks) * kAttentionQueryBlock;
+      const uint32_t end = std::min(begin + kAttentionQueryBlock, query_size);
+      const arma::fmat query_matrix(
+          query_ptr + uint64_t(h) * query_size * head_dim, query_size,
+          head_dim, false, true);
+      const arma::fmat key_matrix(
+          key_ptr + uint64_t(kv_h) * key_size * head_dim, key_size, head_dim,
+          false, true);
+      const arma::fmat value_matrix(
+          value_ptr + uint64_t(kv_h) * key_size * value_dim, key_size,
+          value_dim, false, true);
+      arma::fmat output_matrix(
+          output_ptr + uint64_t(h) * query_size * value_dim, query_size,
+          value_dim, false, true);
+      AttentionBlock(query_matrix, key_matrix, value_matrix, begin, end, scale,
+                     is_causal, output_matrix);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+std::string ScaledDotProductAttentionLayer::kernel_name() const {
+  return is_causal_ ? "blockwise_attention_causal" : "blockwise_attention";
+}
+
+ParseParameterAttrStatus ScaledDotProductAttentionLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& attention_layer) {
+  CHECK(op != nullptr) << "Attention operator is nullptr";
+  if (op->input_operands_seq.size() != 3) {
+    LOG(ERROR) << "The attention layer needs query, key and value, attention "
+                  "mask is not supported";
+    return ParseParameterAttrStatus::kParameterMissingUnknown;
+  }
+
+  const auto& params = op->params;
+  bool is_causal = false;
+  if (params.find("is_causal") != params.end()) {
+    auto causal_param =
+        std::dynamic_pointer_cast<RuntimeParameterBool>(params.at("is_causal"));
+    is_causal = causal_param != nullptr && causal_param->value;
+  }
+  // scale=None时pnnx不会导出浮点数，使用默认的1 / sqrt(D)
+  float scale = 0.f;
+  if (params.find("scale") != params.end()) {
+    auto scale_param =
+        std::dynamic_pointer_cast<RuntimeParameterFloat>(params.at("scale"));
+    if (scale_param != nullptr) {
+      scale = scale_param->value;
+    }
+  }
+  // 推理时不使用dropout_p
+  attention_layer =
+      std::make_shared<ScaledDotProductAttentionLayer>(is_causal, scale);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kAttentionGetInstance(
+    "F.scaled_dot_product_attention",
+    ScaledDotProductAttentionLayer::GetInstance);
+
+}  // namespace kuiper_infer
@@ -0,0 +1,60 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_ATTENTION_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_ATTENTION_HPP_
+#include "layer/abstract/non_param_layer.hpp"
+
+namespace kuiper_infer {
+/// F.scaled_dot_product_attention，计算softmax(Q * K^T * scale) * V
+/// Q、K和V的形状分别为(heads, L, D)、(kv_heads, S, D)和(kv_heads, S, Dv)
+class ScaledDotProductAttentionLayer : public NonParamLayer {
+ public:
+  /**
+   * @param is_causal 是否只关注当前位置及之前的key
+   * @param scale 缩放系数，小于等于0时使用1 / sqrt(D)
+   */
+  explicit ScaledDotProductAttentionLayer(bool is_causal = false,
+                                          float scale = 0.f);
+
+  /**
+   * 按query块和key块分块计算，每个query块维护行最大值和行累加和，
+   * 遇到新的key块时修正之前的累加结果(online softmax)，
+   * 不需要生成L x S的完整注意力矩阵
+   */
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  std::string kernel_name() const override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &attention_layer);
+
+ private:
+  bool is_causal_ = false;
+  float scale_ = 0.f;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_ATTENTION_HPP_
@@ -0,0 +1,279 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "batchnorm2d.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "data/tensor_util.hpp"
+#include "layer/abstract/layer_factory.hpp"
+#include "utils/math/fmath.hpp"
+
+namespace kuiper_infer {
+/// 元素数量超过该值时，按通道多线程计算
+static constexpr uint64_t kBatchNormParallelElements = 1 << 16;
+
+/**
+ * 对一个通道逐元素计算output = input * scale + shift，再应用融合的激活函数，
+ * 缩放、偏移和激活函数在同一次遍历中完成，SiLU使用fmath的向量化exp
+ * input和output可以是同一块内存
+ * @param input 输入通道的起始地址
+ * @param output 输出通道的起始地址
+ * @param size 通道中元素的数量
+ * @param scale 通道的缩放
+ * @param shift 通道的偏移
+ * @param activation 融合的激活函数
+ */
+static void ScaleShift(const float* input, float* output, uint64_t size,
+                       float scale, float shift,
+                       BatchNorm2dLayer::Activation activation) {
+  const bool relu = activation == BatchNorm2dLayer::Activation::kReLU;
+  const bool silu = activation == BatchNorm2dLayer::Activation::kSiLU;
+  uint64_t j = 0;
+#if defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128 shift4 = _mm_set1_ps(shift);
+  const __m128 zero4 = _mm_setzero_ps();
+  const __m128 one4 = _mm_set1_ps(1.f);
+  for (; j + 4 <= size; j += 4) {
+    __m128 value =
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input + j), scale4), shift4);
+    if (relu) {
+      value = _mm_max_ps(value, zero4);
+    } else if (silu) {
+      const __m128 exp4 = fmath::exp_ps(_mm_sub_ps(zero4, value));
+      value = _mm_div_ps(value, _mm_add_ps(one4, exp4));
+    }
+    _mm_storeu_ps(output + j, value);
+  }
+#endif
+  for (; j < size; ++j) {
+    const float value = input[j] * scale + shift;
+    if (relu) {
+      output[j] = std::max(value, 0.f);
+    } else if (silu) {
+      output[j] = value / (1.f + fmath::exp(-value));
+    } else {
+      output[j] = value;
+    }
+  }
+}
+
+BatchNorm2dLayer::BatchNorm2dLayer(uint32_t num_features, float eps,
+                                   const std::vector<float>& running_mean,
+                                   const std::vector<float>& running_var,
+                                   const std::vector<float>& affine_weight,
+                                   const std::vector<float>& affine_bias)
+    : ParamLayer("BatchNorm2d"), num_features_(num_features), eps_(eps) {
+  CHECK(running_mean.size() == num_features &&
+        running_var.size() == num_features)
+      << "The size of running mean or var does not match the num features";
+  CHECK(affine_weight.empty() || affine_weight.size() == num_features)
+      << "The size of affine weight does not match the num features";
+  CHECK(affine_bias.empty() || affine_bias.size() == num_features)
+      << "The size of affine bias does not match the num features";
+
+  // weights_和bias_中存放折叠后每个通道的缩放和偏移
+  sftensor scale = TensorCreate(std::vector<uint32_t>{num_features});
+  sftensor shift = TensorCreate(std::vector<uint32_t>{num_features});
+  float* scale_ptr = scale->raw_ptr();
+  float* shift_ptr = shift->raw_ptr();
+  for (uint32_t c = 0; c < num_features; ++c) {
+    const float gamma = affine_weight.empty() ? 1.f : affine_weight.at(c);
+    const float beta = affine_bias.empty() ? 0.f : affine_bias.at(c);
+    scale_ptr[c] = gamma / std::sqrt(running_var.at(c) + eps_);
+    shift_ptr[c] = beta - running_mean.at(c) * scale_ptr[c];
+  }
+  this->weights_ = {scale};
+  this->bias_ = {shift};
+}
+
+InferStatus BatchNorm2dLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the batchnorm layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the batchnorm "
+                  "layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  if (this->weights_.size() != 1 || this->bias_.size() != 1 ||
+      this->weights_.front()->size() != num_features_ ||
+      this->bias_.front()->size() != num_features_) {
+    LOG(ERROR) << "The scale and shift of the batchnorm layer are wrong";
+    return InferStatus::kInferFailedWeightParameterError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input_data = inputs.at(i);
+    const sftensor& output_data = outputs.at(i);
+    if (input_data == nullptr || input_data->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the batchnorm layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (input_data->channels() != num_features_) {
+      LOG(ERROR) << "The channels of input tensor in the batchnorm layer does "
+                    "not match the num features "
+                 << i << " th";
+      return InferStatus::kInferFailedChannelParameterError;
+    }
+    if (output_data != nullptr && !output_data->empty()) {
+      if (input_data->shapes() != output_data->shapes()) {
+        LOG(ERROR) << "The input and output tensor shapes of the batchnorm "
+                      "layer do not match "
+                   << i << " th";
+        return InferStatus::kInferFailedInputOutSizeMatchError;
+      }
+    }
+  }
+
+  const float* scale_ptr = std::as_const(*weights_.front()).data().memptr();
+  const float* shift_ptr = std::as_const(*bias_.front()).data().memptr();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->shapes());
+      outputs.at(i) = output;
+    }
+
+    // 内存规划时输出和输入可以是同一个张量，此时原地计算
+    float* output_ptr = output->raw_ptr();
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    const uint64_t plane = uint64_t(input->rows()) * input->cols();
+    const uint32_t channels = num_features_;
+    const Activation activation = activation_;
+#pragma omp parallel for if (channels * plane >= kBatchNormParallelElements)
+    for (uint32_t c = 0; c < channels; ++c) {
+      ScaleShift(input_ptr + c * plane, output_ptr + c * plane, plane,
+                 scale_ptr[c], shift_ptr[c], activation);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+bool BatchNorm2dLayer::FuseActivation(const std::string& activation_type) {
+  if (activation_ != Activation::kNone) {
+    return false;
+  }
+  if (activation_type == "nn.ReLU") {
+    activation_ = Activation::kReLU;
+    return true;
+  } else if (activation_type == "nn.SiLU") {
+    activation_ = Activation::kSiLU;
+    return true;
+  }
+  return false;
+}
+
+std::string BatchNorm2dLayer::kernel_name() const {
+  if (activation_ == Activation::kReLU) {
+    return "scale_shift_relu";
+  } else if (activation_ == Activation::kSiLU) {
+    return "scale_shift_silu";
+  }
+  return "scale_shift";
+}
+
+ParseParameterAttrStatus BatchNorm2dLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& batch_layer) {
+  CHECK(op != nullptr) << "BatchNorm operator is nullptr";
+  const auto& params = op->params;
+  if (params.find("eps") == params.end()) {
+    LOG(ERROR) << "Can not find the eps parameter";
+    return ParseParameterAttrStatus::kParameterMissingEps;
+  }
+  auto eps = std::dynamic_pointer_cast<RuntimeParameterFloat>(params.at("eps"));
+  if (!eps) {
+    LOG(ERROR) << "Can not find the eps parameter";
+    return ParseParameterAttrStatus::kParameterMissingEps;
+  }
+
+  if (params.find("num_features") == params.end()) {
+    LOG(ERROR) << "Can not find the num features parameter";
+    return ParseParameterAttrStatus::kParameterMissingNumFeatures;
+  }
+  auto num_features =
+      std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("num_features"));
+  if (!num_features || num_features->value <= 0) {
+    LOG(ERROR) << "Can not find the num features parameter";
+    return ParseParameterAttrStatus::kParameterMissingNumFeatures;
+  }
+
+  bool affine = false;
+  if (params.find("affine") != params.end()) {
+    auto affine_param =
+        std::dynamic_pointer_cast<RuntimeParameterBool>(params.at("affine"));
+    affine = affine_param != nullptr && affine_param->value;
+  }
+
+  const auto& attrs = op->attribute;
+  const uint32_t features = num_features->value;
+  if (attrs.find("running_mean") == attrs.end() ||
+      attrs.at("running_mean")->weight_data.size() !=
+          features * sizeof(float)) {
+    LOG(ERROR) << "Can not find the running mean attribute";
+    return ParseParameterAttrStatus::kAttrMissingRunningMean;
+  }
+  if (attrs.find("running_var") == attrs.end() ||
+      attrs.at("running_var")->weight_data.size() != features * sizeof(float)) {
+    LOG(ERROR) << "Can not find the running var attribute";
+    return ParseParameterAttrStatus::kAttrMissingRunningVar;
+  }
+
+  std::vector<float> affine_weight;
+  std::vector<float> affine_bias;
+  if (affine) {
+    if (attrs.find("weight") == attrs.end() ||
+        attrs.at("weight")->weight_data.size() != features * sizeof(float)) {
+      LOG(ERROR) << "Can not find the affine weight attribute";
+      return ParseParameterAttrStatus::kAttrMissingWeight;
+    }
+    if (attrs.find("bias") == attrs.end() ||
+        attrs.at("bias")->weight_data.size() != features * sizeof(float)) {
+      LOG(ERROR) << "Can not find the affine bias attribute";
+      return ParseParameterAttrStatus::kAttrMissingBias;
+    }
+    affine_weight = attrs.at("weight")->get<float>();
+    affine_bias = attrs.at("bias")->get<float>();
+  }
+
+  batch_layer = std::make_shared<BatchNorm2dLayer>(
+      features, eps->value, attrs.at("running_mean")->get<float>(),
+      attrs.at("running_var")->get<float>(), affine_weight, affine_bias);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kBatchNorm2dGetInstance("nn.BatchNorm2d",
+                                               BatchNorm2dLayer::GetInstance);
+
+}  // namespace kuiper_infer
@@ -0,0 +1,68 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_BATCHNORM2D_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_BATCHNORM2D_HPP_
+#include "layer/abstract/param_layer.hpp"
+
+namespace kuiper_infer {
+class BatchNorm2dLayer : public ParamLayer {
+ public:
+  /// 融合到批归一化之后的激活函数
+  enum class Activation { kNone = 0, kReLU = 1, kSiLU = 2 };
+
+  /**
+   * 创建时把均值、方差和仿射参数折叠为每个通道的缩放和偏移，
+   * 推理时每个元素只需要一次乘加: y = x * scale + shift
+   * @param num_features 通道数
+   * @param eps 加在方差上的小量
+   * @param running_mean 每个通道的均值
+   * @param running_var 每个通道的方差
+   * @param affine_weight 仿射变换的缩放，为空时表示没有仿射变换
+   * @param affine_bias 仿射变换的偏移，为空时表示没有仿射变换
+   */
+  BatchNorm2dLayer(uint32_t num_features, float eps,
+                   const std::vector<float> &running_mean,
+                   const std::vector<float> &running_var,
+                   const std::vector<float> &affine_weight,
+                   const std::vector<float> &affine_bias);
+
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  bool FuseActivation(const std::string &activation_type) override;
+
+  std::string kernel_name() const override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &batch_layer);
+
+ private:
+  uint32_t num_features_ = 0;
+  float eps_ = 1e-5f;
+  Activation activation_ = Activation::kNone;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_BATCHNORM2D_HPP_
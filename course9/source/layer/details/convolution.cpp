@@ -23,23 +23,57 @@
 
 #include "convolution.hpp"
 #include <glog/logging.h>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
 #include "data/tensor_util.hpp"
 #include "layer/abstract/layer_factory.hpp"
 #include "runtime/runtime_ir.hpp"
 
 namespace kuiper_infer {
+/**
+ * 卷积核大小和步长为模板参数的im2col，输入已经带有零边框，卷积核位置的循环在编译期展开
+ */
+template <uint32_t KH, uint32_t KW, uint32_t SH, uint32_t SW>
+static void Im2ColFixed(const float* input_channel_ptr, uint32_t input_h,
+                        uint32_t output_h, uint32_t col_start,
+                        uint32_t col_len, float* matrix_ptr,
+                        uint32_t matrix_rows) {
+  uint32_t w = col_start / output_h;
+  uint32_t r = col_start % output_h;
+  for (uint32_t col = 0; col < col_len; ++col) {
+    const float* region_ptr = input_channel_ptr + input_h * w * SW + r * SH;
+    float* col_ptr = matrix_ptr + uint64_t(col) * matrix_rows;
+    for (uint32_t kw = 0; kw < KW; ++kw) {
+      const float* region_col_ptr = region_ptr + kw * input_h;
+      for (uint32_t kh = 0; kh < KH; ++kh) {
+        col_ptr[kw * KH + kh] = region_col_ptr[kh];
+      }
+    }
+    r += 1;
+    if (r == output_h) {
+      r = 0;
+      w += 1;
+    }
+  }
+}
+
 ConvolutionLayer::ConvolutionLayer(uint32_t output_channel, uint32_t in_channel,
                                    uint32_t kernel_h, uint32_t kernel_w,
                                    uint32_t padding_h, uint32_t padding_w,
                                    uint32_t stride_h, uint32_t stride_w,
-                                   uint32_t groups, bool use_bias)
+                                   uint32_t groups, bool use_bias,
+                                   uint32_t dilation_h, uint32_t dilation_w)
     : ParamLayer("Convolution"),
       use_bias_(use_bias),
       groups_(groups),
       padding_h_(padding_h),
       padding_w_(padding_w),
       stride_h_(stride_h),
-      stride_w_(stride_w) {
+      stride_w_(stride_w),
+      dilation_h_(dilation_h),
+      dilation_w_(dilation_w) {
   if (groups != 1) {
     in_channel /= groups;
   }
@@ -80,6 +114,12 @@ InferStatus ConvolutionLayer::Forward(
     return InferStatus::kInferFailedStrideParameterError;
   }
 
+  if (!dilation_h_ || !dilation_w_) {
+    LOG(ERROR) << "The dilation parameter is set incorrectly. It must always "
+                  "be greater than 0";
+    return InferStatus::kInferFailedDimensionParameterError;
+  }
+
   const uint32_t kernel_count = this->weights_.size();
   const uint32_t kernel_h = this->weights_.at(0)->rows();
   const uint32_t kernel_w = this->weights_.at(0)->cols();
@@ -98,7 +138,7 @@ InferStatus ConvolutionLayer::Forward(
   const uint32_t kernel_count_group = kernel_count / groups_;
   const uint32_t batch_size = inputs.size();
 
-  if (kernel_matrix_arr_.empty()) {
+  if (kernel_matrix_arr_.empty() || tap_offsets_h_.size() != row_len) {
     this->InitIm2ColWeight();
   }
 
@@ -119,14 +159,25 @@ InferStatus ConvolutionLayer::Forward(
            "tensor "
         << i << " th";
 
-    const uint32_t input_c = input->channels();
-    const uint32_t input_padded_h = input->rows() + 2 * padding_h_;
-    const uint32_t input_padded_w = input->cols() + 2 * padding_w_;
+    // 输入先拷贝到带零边框的缓冲区中，im2col展开时不再需要判断边界
+    sftensor padded_input = input;
+    if (padding_h_ > 0 || padding_w_ > 0) {
+      TensorPaddingInto(input, {padding_h_, padding_h_, padding_w_, padding_w_},
+                        0.f, padded_input_);
+      padded_input = padded_input_;
+    }
 
-    const uint32_t output_h =
-        std::floor((int(input_padded_h) - int(kernel_h)) / stride_h_ + 1);
-    const uint32_t output_w =
-        std::floor((int(input_padded_w) - int(kernel_w)) / stride_w_ + 1);
+    const uint32_t input_c = input->channels();
+    const uint32_t input_padded_h = padded_input->rows();
+    const uint32_t input_padded_w = padded_input->cols();
+
+    // 空洞卷积的卷积核在输入上覆盖的范围
+    const uint32_t kernel_extent_h = dilation_h_ * (kernel_h - 1) + 1;
+    const uint32_t kernel_extent_w = dilation_w_ * (kernel_w - 1) + 1;
+    const uint32_t output_h = std::floor(
+        (int(input_padded_h) - int(kernel_extent_h)) / stride_h_ + 1);
+    const uint32_t output_w = std::floor(
+        (int(input_padded_w) - int(kernel_extent_w)) / stride_w_ + 1);
     CHECK(output_h > 0 && output_w > 0)
         << "The size of the output tensor should be greater than zero " << i
         << " th";
@@ -145,10 +196,16 @@ InferStatus ConvolutionLayer::Forward(
     CHECK(input_c_group == kernel_c) << "The number of channel for the kernel "
                                         "matrix and input tensor do not match";
 
+    // 设置了临时空间上限时，im2col矩阵按列分块展开，每块最多col_tile列
+    uint32_t col_tile = col_len;
+    if (this->workspace_limit_ > 0) {
+      const uint64_t col_bytes =
+          uint64_t(input_c_group) * row_len * sizeof(float);
+      col_tile = uint32_t(std::max<uint64_t>(
+          1, std::min<uint64_t>(col_len, this->workspace_limit_ / col_bytes)));
+    }
+
     for (uint32_t g = 0; g < groups_; ++g) {
-      const auto& input_matrix =
-          Im2Col(input, kernel_w, kernel_h, input->cols(), input->rows(),
-                 input_c_group, g, row_len, col_len);
       std::shared_ptr<Tensor<float>> output_tensor = outputs.at(i);
       if (output_tensor == nullptr || output_tensor->empty()) {
         output_tensor =
@@ -163,56 +220,163 @@ InferStatus ConvolutionLayer::Forward(
              "incorrectly sized tensor "
           << i << "th";
 
+      if (pointwise_) {
+        ConvPointwise(input, output_tensor, g, input_c_group,
+                      kernel_count_group);
+        continue;
+      }
+
       const uint32_t kernel_count_group_start = kernel_count_group * g;
-      for (uint32_t k = 0; k < kernel_count_group; ++k) {
-        arma::frowvec kernel;
-        if (groups_ == 1) {
-          kernel = kernel_matrix_arr_.at(k);
-        } else {
-          kernel = kernel_matrix_arr_.at(kernel_count_group_start + k);
+      for (uint32_t col_start = 0; col_start < col_len;
+           col_start += col_tile) {
+        const uint32_t tile_len = std::min(col_tile, col_len - col_start);
+        RecordWorkspace(uint64_t(input_c_group) * row_len * tile_len *
+                        sizeof(float));
+        const auto& input_matrix =
+            Im2Col(padded_input, kernel_w, kernel_h, input_padded_w,
+                   input_padded_h, input_c_group, g, row_len, output_h,
+                   col_start, tile_len);
+        for (uint32_t k = 0; k < kernel_count_group; ++k) {
+          const arma::frowvec& kernel =
+              kernel_matrix_arr_.at(kernel_count_group_start + k);
+          ConvGemmBias(input_matrix, output_tensor, g, k, kernel_count_group,
+                       kernel, col_start, tile_len);
         }
-        ConvGemmBias(input_matrix, output_tensor, g, k, kernel_count_group,
-                     kernel, output_w, output_h);
       }
     }
   }
   return InferStatus::kInferSuccess;
 }
 
+void ConvolutionLayer::Prepare() {
+  if (kernel_matrix_arr_.empty() || tap_offsets_h_.empty()) {
+    this->InitIm2ColWeight();
+  }
+}
+
+uint64_t ConvolutionLayer::constant_floats() const {
+  uint64_t floats = ParamLayer::constant_floats();
+  for (const arma::frowvec& kernel_matrix : kernel_matrix_arr_) {
+    floats += AlignConstant(kernel_matrix.n_elem);
+  }
+  for (const arma::fmat& pointwise_weight : pointwise_weights_) {
+    floats += AlignConstant(pointwise_weight.n_elem);
+  }
+  return floats;
+}
+
+uint64_t ConvolutionLayer::MoveConstants(float* arena) {
+  uint64_t offset = ParamLayer::MoveConstants(arena);
+  // 展开之后的权重改为使用arena中的内存，strict的矩阵不会再改变大小或者重新分配
+  std::vector<arma::frowvec> kernel_matrix_arr;
+  kernel_matrix_arr.reserve(kernel_matrix_arr_.size());
+  for (const arma::frowvec& kernel_matrix : kernel_matrix_arr_) {
+    float* data = arena + offset;
+    std::copy(kernel_matrix.begin(), kernel_matrix.end(), data);
+    kernel_matrix_arr.emplace_back(data, kernel_matrix.n_elem, false, true);
+    offset += AlignConstant(kernel_matrix.n_elem);
+  }
+  this->kernel_matrix_arr_ = std::move(kernel_matrix_arr);
+
+  std::vector<arma::fmat> pointwise_weights;
+  pointwise_weights.reserve(pointwise_weights_.size());
+  for (const arma::fmat& pointwise_weight : pointwise_weights_) {
+    float* data = arena + offset;
+    std::copy(pointwise_weight.begin(), pointwise_weight.end(), data);
+    pointwise_weights.emplace_back(data, pointwise_weight.n_rows,
+                                   pointwise_weight.n_cols, false, true);
+    offset += AlignConstant(pointwise_weight.n_elem);
+  }
+  this->pointwise_weights_ = std::move(pointwise_weights);
+  return offset;
+}
+
+uint64_t ConvolutionLayer::persistent_bytes() const {
+  // 内存规划分配的缓冲区已经计入节点输出的内存块
+  if (padded_input_ == nullptr || padded_input_->empty() ||
+      padded_input_ == scratch_) {
+    return 0;
+  }
+  return uint64_t(padded_input_->size()) * sizeof(float);
+}
+
+std::vector<uint32_t> ConvolutionLayer::scratch_shapes() const {
+  const auto& runtime_operator = runtime_operator_.lock();
+  if ((padding_h_ == 0 && padding_w_ == 0) || runtime_operator == nullptr ||
+      runtime_operator->input_operands_seq.size() != 1) {
+    return {};
+  }
+  const std::vector<int32_t>& input_shapes =
+      runtime_operator->input_operands_seq.front()->shapes;
+  if (input_shapes.size() != 4) {
+    return {};
+  }
+  return {uint32_t(input_shapes.at(1)),
+          uint32_t(input_shapes.at(2)) + 2 * padding_h_,
+          uint32_t(input_shapes.at(3)) + 2 * padding_w_};
+}
+
+void ConvolutionLayer::set_scratch(const std::shared_ptr<Tensor<float>>& scratch) {
+  Layer::set_scratch(scratch);
+  this->padded_input_ = scratch;
+}
+
+std::string ConvolutionLayer::kernel_name() const {
+  if (pointwise_) {
+    return "pointwise_gemm";
+  }
+  std::string kernel_name = "im2col_gemm";
+  if (im2col_kernel_ != nullptr) {
+    kernel_name += "_" + im2col_kernel_name_;
+  }
+  if (padding_h_ > 0 || padding_w_ > 0) {
+    kernel_name += "_halo";
+  }
+  if (workspace_limit_ > 0) {
+    kernel_name += "_tiled";
+  }
+  return kernel_name;
+}
+
 arma::fmat ConvolutionLayer::Im2Col(sftensor input, uint32_t kernel_w,
                                     uint32_t kernel_h, uint32_t input_w,
                                     uint32_t input_h, uint32_t input_c_group,
                                     uint32_t group, uint32_t row_len,
+                                    uint32_t output_h, uint32_t col_start,
                                     uint32_t col_len) const {
   arma::fmat input_matrix(input_c_group * row_len, col_len);
-  const uint32_t input_padded_h = input_h + 2 * padding_h_;
-  const uint32_t input_padded_w = input_w + 2 * padding_w_;
-  const float padding_value = 0.f;
+  // 只读地访问输入，输入和其他张量共享数据时不拷贝
+  const Tensor<float>& input_tensor = *input;
+
+  // 卷积核位置在输入通道中的线性偏移，由预先计算的行列偏移得到
+  std::vector<uint32_t> tap_offsets(row_len);
+  for (uint32_t t = 0; t < row_len; ++t) {
+    tap_offsets.at(t) = tap_offsets_w_.at(t) * input_h + tap_offsets_h_.at(t);
+  }
+
+  // 常见的卷积核大小和步长使用特化的实现
+  if (im2col_kernel_ != nullptr) {
+    for (uint32_t ic = 0; ic < input_c_group; ++ic) {
+      im2col_kernel_(input_tensor.matrix_raw_ptr(ic + group * input_c_group),
+                     input_h, output_h, col_start, col_len,
+                     input_matrix.memptr() + ic * row_len, input_matrix.n_rows);
+    }
+    return input_matrix;
+  }
+
+  // 输入已经带有零边框，所有卷积核位置都落在缓冲区内部
   for (uint32_t ic = 0; ic < input_c_group; ++ic) {
-    float* input_channel_ptr =
-        input->matrix_raw_ptr(ic + group * input_c_group);
-    uint32_t current_col = 0;
+    const float* input_channel_ptr =
+        input_tensor.matrix_raw_ptr(ic + group * input_c_group);
     uint32_t channel_row = ic * row_len;
-    for (uint32_t w = 0; w < input_padded_w - kernel_w + 1; w += stride_w_) {
-      for (uint32_t r = 0; r < input_padded_h - kernel_h + 1; r += stride_h_) {
-        float* input_matrix_ptr =
-            input_matrix.colptr(current_col) + channel_row;
-        current_col += 1;
-        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
-          const uint32_t region_w = input_h * (w + kw - padding_w_);
-          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
-            if ((kh + r >= padding_h_ && kw + w >= padding_w_) &&
-                (kh + r < input_h + padding_h_ &&
-                 kw + w < input_w + padding_w_)) {
-              float* region_ptr =
-                  input_channel_ptr + region_w + (r + kh - padding_h_);
-              *input_matrix_ptr = *region_ptr;
-            } else {
-              *input_matrix_ptr = padding_value;  // only support zero mode
-            }
-            input_matrix_ptr += 1;
-          }
-        }
+    for (uint32_t col = 0; col < col_len; ++col) {
+      // 第col_start + col列对应输出特征图中的位置(r, w)
+      const uint32_t w = (col_start + col) / output_h * stride_w_;
+      const uint32_t r = (col_start + col) % output_h * stride_h_;
+      float* input_matrix_ptr = input_matrix.colptr(col) + channel_row;
+      const float* region_ptr = input_channel_ptr + input_h * w + r;
+      for (uint32_t t = 0; t < row_len; ++t) {
+        input_matrix_ptr[t] = region_ptr[tap_offsets[t]];
       }
     }
   }
@@ -222,14 +386,16 @@ arma::fmat ConvolutionLayer::Im2Col(sftensor input, uint32_t kernel_w,
 void ConvolutionLayer::ConvGemmBias(
     const arma::fmat& input_matrix, sftensor output_tensor, uint32_t group,
     uint32_t kernel_index, uint32_t kernel_count_group,
-    const arma::frowvec& kernel, uint32_t output_w, uint32_t output_h) const {
+    const arma::frowvec& kernel, uint32_t col_start, uint32_t col_len) const {
+  // 输出特征图按列主序排列，第col_start列开始的col_len个元素对应当前分块
   arma::fmat output(
-      output_tensor->matrix_raw_ptr(kernel_index + group * kernel_count_group),
-      output_h, output_w, false, true);
+      output_tensor->matrix_raw_ptr(kernel_index + group * kernel_count_group) +
+          col_start,
+      1, col_len, false, true);
 
-  CHECK(output.size() == output_h * output_w)
-      << "Output_h x output_w for the convolution layer "
-         "should be output tensor size";
+  CHECK(output.size() == input_matrix.n_cols)
+      << "The column of im2col matrix for the convolution layer "
+         "should be same to the output block size";
 
   if (!this->bias_.empty() && this->use_bias_) {
     std::shared_ptr<Tensor<float>> bias;
@@ -245,6 +411,61 @@ void ConvolutionLayer::ConvGemmBias(
   }
 }
 
+void ConvolutionLayer::ConvPointwise(const sftensor& input,
+                                     const sftensor& output_tensor,
+                                     uint32_t group, uint32_t input_c_group,
+                                     uint32_t kernel_count_group) const {
+  CHECK(group < pointwise_weights_.size());
+  const uint32_t col_len = output_tensor->rows() * output_tensor->cols();
+  CHECK(input->rows() * input->cols() == col_len);
+
+  // 输入和输出的每个通道都是列主序矩阵中的一列，只读地引用输入的内存
+  const float* input_ptr = std::as_const(*input).data().memptr() +
+                           uint64_t(group) * input_c_group * col_len;
+  const arma::fmat input_matrix(const_cast<float*>(input_ptr), col_len,
+                                input_c_group, false, true);
+  arma::fmat output(output_tensor->matrix_raw_ptr(group * kernel_count_group),
+                    col_len, kernel_count_group, false, true);
+  output = input_matrix * pointwise_weights_.at(group);
+
+  if (!this->bias_.empty() && this->use_bias_) {
+    for (uint32_t k = 0; k < kernel_count_group; ++k) {
+      const auto& bias = this->bias_.at(k + group * kernel_count_group);
+      CHECK(bias != nullptr && !bias->empty())
+          << "Bias tensor is empty or nullptr";
+      output.col(k) += bias->index(0);
+    }
+  }
+}
+
+void ConvolutionLayer::SelectKernel() {
+  const uint32_t kernel_h = this->weights_.at(0)->rows();
+  const uint32_t kernel_w = this->weights_.at(0)->cols();
+  pointwise_ = kernel_h == 1 && kernel_w == 1 && stride_h_ == 1 &&
+               stride_w_ == 1 && padding_h_ == 0 && padding_w_ == 0;
+
+  // 分派表的键依次为kernel_h、kernel_w、stride_h和stride_w，
+  // 填充由带零边框的输入缓冲区处理，因此不需要作为模板参数
+  using KernelKey = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>;
+  static const std::map<KernelKey, std::pair<Im2ColKernel, std::string>>
+      kIm2ColKernels = {
+          {{1, 1, 1, 1}, {&Im2ColFixed<1, 1, 1, 1>, "k1x1s1"}},
+          {{3, 3, 1, 1}, {&Im2ColFixed<3, 3, 1, 1>, "k3x3s1"}},
+          {{3, 3, 2, 2}, {&Im2ColFixed<3, 3, 2, 2>, "k3x3s2"}},
+          {{6, 6, 2, 2}, {&Im2ColFixed<6, 6, 2, 2>, "k6x6s2"}},
+      };
+  im2col_kernel_ = nullptr;
+  im2col_kernel_name_.clear();
+  if (dilation_h_ == 1 && dilation_w_ == 1) {
+    const auto& kernel = kIm2ColKernels.find(
+        KernelKey{kernel_h, kernel_w, stride_h_, stride_w_});
+    if (kernel != kIm2ColKernels.end()) {
+      im2col_kernel_ = kernel->second.first;
+      im2col_kernel_name_ = kernel->second.second;
+    }
+  }
+}
+
 void ConvolutionLayer::InitIm2ColWeight() {
   const uint32_t kernel_count = this->weights_.size();
   CHECK(kernel_count > 0) << "kernel count must greater than zero";
@@ -294,6 +515,31 @@ void ConvolutionLayer::InitIm2ColWeight() {
     CHECK(kernel_matrix_arr.size() == kernel_count);
     this->kernel_matrix_arr_ = std::move(kernel_matrix_arr);
   }
+
+  // im2col矩阵中每一列按卷积核的列主序排列，空洞卷积的卷积核位置间隔dilation
+  this->tap_offsets_h_.resize(row_len);
+  this->tap_offsets_w_.resize(row_len);
+  for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+    for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+      this->tap_offsets_h_.at(kw * kernel_h + kh) = kh * dilation_h_;
+      this->tap_offsets_w_.at(kw * kernel_h + kh) = kw * dilation_w_;
+    }
+  }
+
+  this->SelectKernel();
+  pointwise_weights_.clear();
+  if (pointwise_) {
+    // 1x1卷积的每个卷积核是一行长度为kernel_c的向量，按组拼接为kernel_c x kernel_count_group的矩阵
+    const uint32_t kernel_count_group = kernel_count / groups_;
+    for (uint32_t g = 0; g < groups_; ++g) {
+      arma::fmat pointwise_weight(kernel_c, kernel_count_group);
+      for (uint32_t k = 0; k < kernel_count_group; ++k) {
+        pointwise_weight.col(k) =
+            kernel_matrix_arr_.at(k + g * kernel_count_group).t();
+      }
+      pointwise_weights_.push_back(std::move(pointwise_weight));
+    }
+  }
 }
 
 ParseParameterAttrStatus ConvolutionLayer::GetInstance(
@@ -316,8 +562,11 @@ ParseParameterAttrStatus ConvolutionLayer::GetInstance(
     return ParseParameterAttrStatus::kParameterMissingDilation;
   }
 
-  CHECK(dilation_param->value.at(0) != 1 || dilation_param->value.at(1))
-      << "Only support dilation value equals to one!";
+  const std::vector<int>& dilations = dilation_param->value;
+  if (dilations.at(0) <= 0 || dilations.at(1) <= 0) {
+    LOG(ERROR) << "The dilation parameter should be greater than zero";
+    return ParseParameterAttrStatus::kParameterMissingDilation;
+  }
 
   if (params.find("in_channels") == params.end()) {
     LOG(ERROR) << "Can not find the in channel parameter";
@@ -435,7 +684,7 @@ ParseParameterAttrStatus ConvolutionLayer::GetInstance(
   conv_layer = std::make_shared<ConvolutionLayer>(
       out_channel->value, in_channel->value, kernels.at(0), kernels.at(1),
       paddings.at(0), paddings.at(1), strides.at(0), strides.at(1),
-      groups->value, use_bias->value);
+      groups->value, use_bias->value, dilations.at(0), dilations.at(1));
 
   // load weights
   const std::map<std::string, std::shared_ptr<RuntimeAttribute>>& attrs =
@@ -32,7 +32,8 @@ class ConvolutionLayer : public ParamLayer {
                             uint32_t kernel_h, uint32_t kernel_w,
                             uint32_t padding_h, uint32_t padding_w,
                             uint32_t stride_h, uint32_t stride_w,
-                            uint32_t groups, bool use_bias = true);
+                            uint32_t groups, bool use_bias = true,
+                            uint32_t dilation_h = 1, uint32_t dilation_w = 1);
 
   static ParseParameterAttrStatus GetInstance(
       const std::shared_ptr<RuntimeOperator>& op,
@@ -43,19 +44,66 @@ class ConvolutionLayer : public ParamLayer {
       std::vector<std::shared_ptr<Tensor<float>>>& outputs) override;
 
   /**
-   * 初始化kernel的im2col排布
+   * 初始化kernel的im2col排布，同时预先计算空洞卷积中每个卷积核位置的偏移
    */
   void InitIm2ColWeight();
 
+  std::string kernel_name() const override;
+
+  void Prepare() override;
+
+  uint64_t constant_floats() const override;
+
+  uint64_t MoveConstants(float* arena) override;
+
+  uint64_t persistent_bytes() const override;
+
+  std::vector<uint32_t> scratch_shapes() const override;
+
+  void set_scratch(const std::shared_ptr<Tensor<float>>& scratch) override;
+
  private:
   void ConvGemmBias(const arma::fmat& input_matrix, sftensor output_tensor,
                     uint32_t group, uint32_t kernel_index,
                     uint32_t kernel_count_group, const arma::frowvec& kernel,
-                    uint32_t output_w, uint32_t output_h) const;
+                    uint32_t col_start, uint32_t col_len) const;
 
   arma::fmat Im2Col(sftensor input, uint32_t kernel_w, uint32_t kernel_h,
                     uint32_t input_w, uint32_t input_h, uint32_t input_c_group,
-                    uint32_t group, uint32_t row_len, uint32_t col_len) const;
+                    uint32_t group, uint32_t row_len, uint32_t output_h,
+                    uint32_t col_start, uint32_t col_len) const;
+
+  /**
+   * 1x1、步长为1且没有填充的卷积，输入通道本身就是im2col矩阵的转置，整组输出由一次gemm得到
+   * @param input 输入张量
+   * @param output_tensor 输出张量
+   * @param group 当前计算的组
+   * @param input_c_group 每组的输入通道数
+   * @param kernel_count_group 每组的卷积核数量
+   */
+  void ConvPointwise(const sftensor& input, const sftensor& output_tensor,
+                     uint32_t group, uint32_t input_c_group,
+                     uint32_t kernel_count_group) const;
+
+  /**
+   * 根据卷积核大小和步长从分派表中选择特化的im2col实现，不在表中时使用通用实现
+   */
+  void SelectKernel();
+
+  /**
+   * 卷积核大小和步长为编译期常量的im2col实现，把一个输入通道展开到im2col矩阵的对应行中
+   * @param input_channel_ptr 带零边框的输入通道
+   * @param input_h 输入通道的高度
+   * @param output_h 输出特征图的高度
+   * @param col_start 当前分块的起始列
+   * @param col_len 当前分块的列数
+   * @param matrix_ptr im2col矩阵中该通道第一行的地址
+   * @param matrix_rows im2col矩阵的行数
+   */
+  using Im2ColKernel = void (*)(const float* input_channel_ptr,
+                                uint32_t input_h, uint32_t output_h,
+                                uint32_t col_start, uint32_t col_len,
+                                float* matrix_ptr, uint32_t matrix_rows);
 
  private:
   bool use_bias_ = false;
@@ -64,7 +112,16 @@ class ConvolutionLayer : public ParamLayer {
   uint32_t padding_w_ = 0;
   uint32_t stride_h_ = 1;
   uint32_t stride_w_ = 1;
+  uint32_t dilation_h_ = 1;
+  uint32_t dilation_w_ = 1;
   std::vector<arma::frowvec> kernel_matrix_arr_;
+  std::vector<uint32_t> tap_offsets_h_;  /// 按im2col顺序排列的卷积核位置在行方向的偏移
+  std::vector<uint32_t> tap_offsets_w_;  /// 按im2col顺序排列的卷积核位置在列方向的偏移
+  sftensor padded_input_;  /// 带零边框的输入缓冲区，在多次推理之间复用
+  bool pointwise_ = false;               /// 是否为1x1、步长为1且没有填充的卷积
+  Im2ColKernel im2col_kernel_ = nullptr;  /// 特化的im2col实现，为空时使用通用实现
+  std::string im2col_kernel_name_;        /// 特化实现的名称，例如k3x3s1
+  std::vector<arma::fmat> pointwise_weights_;  /// 1x1卷积每组的权重，大小为in_channel_group x kernel_count_group
 };
 
 }  // namespace kuiper_infer
@@ -0,0 +1,555 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-5.
+
+#include "deconvolution.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+#include "runtime/runtime_ir.hpp"
+
+namespace kuiper_infer {
+/// 每组的输入通道数不超过该值时，gemm的累加维度太小，直接计算更快
+static constexpr uint32_t kDirectMaxInChannels = 8;
+
+DeconvolutionLayer::DeconvolutionLayer(
+    uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
+    uint32_t kernel_w, uint32_t padding_h, uint32_t padding_w,
+    uint32_t stride_h, uint32_t stride_w, uint32_t output_padding_h,
+    uint32_t output_padding_w, uint32_t dilation_h, uint32_t dilation_w,
+    uint32_t groups, bool use_bias)
+    : ParamLayer("Deconvolution"),
+      use_bias_(use_bias),
+      groups_(groups),
+      in_channel_(in_channel),
+      output_channel_(output_channel),
+      kernel_h_(kernel_h),
+      kernel_w_(kernel_w),
+      padding_h_(padding_h),
+      padding_w_(padding_w),
+      stride_h_(stride_h),
+      stride_w_(stride_w),
+      output_padding_h_(output_padding_h),
+      output_padding_w_(output_padding_w),
+      dilation_h_(dilation_h),
+      dilation_w_(dilation_w) {
+  CHECK(groups_ > 0 && in_channel % groups_ == 0 &&
+        output_channel % groups_ == 0)
+      << "The channels of the deconvolution layer should be divisible by groups";
+  // 权重的排布和pytorch相同，为in_channel x (output_channel / groups) x kh x kw
+  this->InitWeightParam(in_channel, output_channel / groups, kernel_h,
+                        kernel_w);
+  if (use_bias_) {
+    this->InitBiasParam(output_channel, 1, 1, 1);
+  }
+}
+
+InferStatus DeconvolutionLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the deconvolution layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the "
+                  "deconvolution layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  if (weights_.size() != in_channel_) {
+    LOG(ERROR) << "The number of kernel matrix in the deconvolution layer "
+                  "should be equal to the input channel";
+    return InferStatus::kInferFailedWeightParameterError;
+  }
+
+  if (this->use_bias_ && this->bias_.size() != output_channel_) {
+    LOG(ERROR) << "The number of bias matrix and output channel do not match";
+    return InferStatus::kInferFailedBiasParameterError;
+  }
+
+  if (!stride_h_ || !stride_w_ || !dilation_h_ || !dilation_w_) {
+    LOG(ERROR) << "The stride and dilation parameter is set incorrectly. It "
+                  "must always be greater than 0";
+    return InferStatus::kInferFailedStrideParameterError;
+  }
+
+  if (gemm_weights_.empty()) {
+    this->InitGemmWeight();
+  }
+  CHECK(gemm_weights_.size() == groups_)
+      << "The number of gemm weight and groups do not match";
+
+  const uint32_t batch_size = inputs.size();
+  const uint32_t in_c_group = in_channel_ / groups_;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const std::shared_ptr<Tensor<float>>& input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR) << "The input tensor array in the deconvolution layer has an "
+                    "empty tensor "
+                 << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (input->channels() != in_channel_) {
+      LOG(ERROR) << "The channel of input tensor and kernel matrix do not "
+                    "match in the deconvolution layer "
+                 << i << " th";
+      return InferStatus::kInferFailedChannelParameterError;
+    }
+
+    const int32_t output_h =
+        int32_t((input->rows() - 1) * stride_h_ +
+                dilation_h_ * (kernel_h_ - 1) + output_padding_h_ + 1) -
+        int32_t(2 * padding_h_);
+    const int32_t output_w =
+        int32_t((input->cols() - 1) * stride_w_ +
+                dilation_w_ * (kernel_w_ - 1) + output_padding_w_ + 1) -
+        int32_t(2 * padding_w_);
+    if (output_h <= 0 || output_w <= 0) {
+      LOG(ERROR) << "The size of the output tensor should be greater than "
+                    "zero "
+                 << i << " th";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+
+    std::shared_ptr<Tensor<float>> output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(output_channel_, output_h,
+                                               output_w);
+      outputs.at(i) = output;
+    }
+    if (output->channels() != output_channel_ ||
+        output->rows() != uint32_t(output_h) ||
+        output->cols() != uint32_t(output_w)) {
+      LOG(ERROR) << "The output tensor array in the deconvolution layer has an "
+                    "incorrectly sized tensor "
+                 << i << " th";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+
+    // 偏置作为输出的初始值，之后的计算直接在上面累加
+    for (uint32_t oc = 0; oc < output_channel_; ++oc) {
+      float bias_value = 0.f;
+      if (use_bias_) {
+        const sftensor& bias = this->bias_.at(oc);
+        CHECK(bias != nullptr && !bias->empty())
+            << "Bias tensor is empty or nullptr";
+        bias_value = bias->index(0);
+      }
+      output->slice(oc).fill(bias_value);
+    }
+
+    for (uint32_t g = 0; g < groups_; ++g) {
+      if (in_c_group <= kDirectMaxInChannels) {
+        DeconvDirect(input, output, g);
+      } else {
+        DeconvGemm(input, output, g);
+      }
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+void DeconvolutionLayer::DeconvGemm(const sftensor& input,
+                                    const sftensor& output,
+                                    uint32_t group) const {
+  const uint32_t input_h = input->rows();
+  const uint32_t input_w = input->cols();
+  const uint32_t output_h = output->rows();
+  const uint32_t output_w = output->cols();
+  const uint32_t in_c_group = in_channel_ / groups_;
+  const uint32_t out_c_group = output_channel_ / groups_;
+  const uint32_t kernel_size = kernel_h_ * kernel_w_;
+  const uint32_t input_plane = input_h * input_w;
+  const uint32_t output_plane = output_h * output_w;
+
+  // 输入的每个通道是矩阵中的一列，矩阵的每一行是输入特征图中的一个位置
+  // 只读地使用输入的内存，输入和其他张量共享数据时不拷贝
+  const arma::fmat input_matrix(
+      const_cast<float*>(std::as_const(*input).matrix_raw_ptr(
+          group * in_c_group)),
+      input_plane, in_c_group, false, true);
+  const arma::fmat& gemm_weight = gemm_weights_.at(group);
+  CHECK(gemm_weight.n_rows == in_c_group &&
+        gemm_weight.n_cols == out_c_group * kernel_size);
+
+  // 设置了临时空间上限时，按输出通道分块计算gemm和col2im
+  uint32_t channel_tile = out_c_group;
+  if (this->workspace_limit_ > 0) {
+    const uint64_t channel_bytes =
+        uint64_t(input_plane) * kernel_size * sizeof(float);
+    channel_tile = uint32_t(std::max<uint64_t>(
+        1, std::min<uint64_t>(out_c_group,
+                              this->workspace_limit_ / channel_bytes)));
+  }
+
+  float* output_ptr = output->matrix_raw_ptr(group * out_c_group);
+  for (uint32_t oc_start = 0; oc_start < out_c_group; oc_start += channel_tile) {
+    const uint32_t tile_len = std::min(channel_tile, out_c_group - oc_start);
+    RecordWorkspace(uint64_t(input_plane) * tile_len * kernel_size *
+                    sizeof(float));
+    const arma::fmat col =
+        input_matrix * gemm_weight.cols(oc_start * kernel_size,
+                                        (oc_start + tile_len) * kernel_size - 1);
+
+    // 每个输出通道的所有卷积核位置依次累加到同一个输出平面上，输出平面始终留在缓存中
+#pragma omp parallel for
+    for (uint32_t oc = 0; oc < tile_len; ++oc) {
+      float* output_channel = output_ptr + (oc_start + oc) * output_plane;
+      for (uint32_t kw = 0; kw < kernel_w_; ++kw) {
+        for (uint32_t kh = 0; kh < kernel_h_; ++kh) {
+          const float* col_ptr =
+              col.colptr(oc * kernel_size + kw * kernel_h_ + kh);
+          Col2ImTap(col_ptr, input_h, input_w, kh, kw, output_channel,
+                    output_h, output_w, 1.f);
+        }
+      }
+    }
+  }
+}
+
+void DeconvolutionLayer::DeconvDirect(const sftensor& input,
+                                      const sftensor& output,
+                                      uint32_t group) const {
+  const uint32_t input_h = input->rows();
+  const uint32_t input_w = input->cols();
+  const uint32_t output_h = output->rows();
+  const uint32_t output_w = output->cols();
+  const uint32_t in_c_group = in_channel_ / groups_;
+  const uint32_t out_c_group = output_channel_ / groups_;
+  const uint32_t kernel_size = kernel_h_ * kernel_w_;
+  const uint32_t input_plane = input_h * input_w;
+  const uint32_t output_plane = output_h * output_w;
+
+  const float* input_ptr =
+      std::as_const(*input).matrix_raw_ptr(group * in_c_group);
+  float* output_ptr = output->matrix_raw_ptr(group * out_c_group);
+  const arma::fmat& gemm_weight = gemm_weights_.at(group);
+
+#pragma omp parallel for
+  for (uint32_t oc = 0; oc < out_c_group; ++oc) {
+    float* output_channel = output_ptr + oc * output_plane;
+    for (uint32_t ic = 0; ic < in_c_group; ++ic) {
+      const float* input_channel = input_ptr + ic * input_plane;
+      for (uint32_t kw = 0; kw < kernel_w_; ++kw) {
+        for (uint32_t kh = 0; kh < kernel_h_; ++kh) {
+          const float weight =
+              gemm_weight.at(ic, oc * kernel_size + kw * kernel_h_ + kh);
+          Col2ImTap(input_channel, input_h, input_w, kh, kw, output_channel,
+                    output_h, output_w, weight);
+        }
+      }
+    }
+  }
+}
+
+void DeconvolutionLayer::Col2ImTap(const float* col, uint32_t input_h,
+                                   uint32_t input_w, uint32_t kh, uint32_t kw,
+                                   float* output_channel, uint32_t output_h,
+                                   uint32_t output_w, float scale) const {
+  // 输入位置(ih, iw)在输出中的位置为(ih * stride + offset)，offset由卷积核位置决定
+  const int32_t offset_h = int32_t(kh * dilation_h_) - int32_t(padding_h_);
+  const int32_t offset_w = int32_t(kw * dilation_w_) - int32_t(padding_w_);
+  if (offset_h >= int32_t(output_h) || offset_w >= int32_t(output_w)) {
+    return;
+  }
+
+  // 预先求出落在输出范围内的输入区间，内层循环不需要做边界判断
+  const auto valid_range = [](int32_t offset, uint32_t stride, uint32_t input,
+                              uint32_t output) {
+    const uint32_t start =
+        offset >= 0 ? 0 : (uint32_t(-offset) + stride - 1) / stride;
+    const uint32_t end = std::min<uint32_t>(
+        input, (uint32_t(int32_t(output) - offset) + stride - 1) / stride);
+    return std::make_pair(start, std::max(start, end));
+  };
+  const auto [ih_start, ih_end] =
+      valid_range(offset_h, stride_h_, input_h, output_h);
+  const auto [iw_start, iw_end] =
+      valid_range(offset_w, stride_w_, input_w, output_w);
+
+  for (uint32_t iw = iw_start; iw < iw_end; ++iw) {
+    const float* col_ptr = col + iw * input_h;
+    float* output_col =
+        output_channel + (int32_t(iw * stride_w_) + offset_w) * output_h;
+    if (stride_h_ == 1) {
+      for (uint32_t ih = ih_start; ih < ih_end; ++ih) {
+        output_col[int32_t(ih) + offset_h] += scale * col_ptr[ih];
+      }
+    } else {
+      for (uint32_t ih = ih_start; ih < ih_end; ++ih) {
+        output_col[int32_t(ih * stride_h_) + offset_h] += scale * col_ptr[ih];
+      }
+    }
+  }
+}
+
+void DeconvolutionLayer::Prepare() {
+  if (gemm_weights_.empty()) {
+    this->InitGemmWeight();
+  }
+}
+
+uint64_t DeconvolutionLayer::constant_floats() const {
+  uint64_t floats = ParamLayer::constant_floats();
+  for (const arma::fmat& gemm_weight : gemm_weights_) {
+    floats += AlignConstant(gemm_weight.n_elem);
+  }
+  return floats;
+}
+
+uint64_t DeconvolutionLayer::MoveConstants(float* arena) {
+  uint64_t offset = ParamLayer::MoveConstants(arena);
+  std::vector<arma::fmat> gemm_weights;
+  gemm_weights.reserve(gemm_weights_.size());
+  for (const arma::fmat& gemm_weight : gemm_weights_) {
+    float* data = arena + offset;
+    std::copy(gemm_weight.begin(), gemm_weight.end(), data);
+    gemm_weights.emplace_back(data, gemm_weight.n_rows, gemm_weight.n_cols,
+                              false, true);
+    offset += AlignConstant(gemm_weight.n_elem);
+  }
+  this->gemm_weights_ = std::move(gemm_weights);
+  return offset;
+}
+
+std::string DeconvolutionLayer::kernel_name() const {
+  if (in_channel_ / groups_ <= kDirectMaxInChannels) {
+    return "direct";
+  }
+  return "gemm_col2im";
+}
+
+void DeconvolutionLayer::InitGemmWeight() {
+  const uint32_t in_c_group = in_channel_ / groups_;
+  const uint32_t out_c_group = output_channel_ / groups_;
+  const uint32_t kernel_size = kernel_h_ * kernel_w_;
+  CHECK(this->weights_.size() == in_channel_)
+      << "The number of kernel matrix should be equal to the input channel";
+
+  std::vector<arma::fmat> gemm_weights(groups_);
+  for (uint32_t g = 0; g < groups_; ++g) {
+    arma::fmat gemm_weight(in_c_group, out_c_group * kernel_size);
+    for (uint32_t ic = 0; ic < in_c_group; ++ic) {
+      const sftensor& kernel = this->weights_.at(g * in_c_group + ic);
+      CHECK(kernel->channels() == out_c_group && kernel->rows() == kernel_h_ &&
+            kernel->cols() == kernel_w_);
+      // 每个输出通道的卷积核按列主序展开，依次排在第ic行中
+      const float* kernel_ptr = std::as_const(*kernel).data().memptr();
+      for (uint32_t j = 0; j < out_c_group * kernel_size; ++j) {
+        gemm_weight.at(ic, j) = kernel_ptr[j];
+      }
+    }
+    gemm_weights.at(g) = std::move(gemm_weight);
+  }
+  this->gemm_weights_ = std::move(gemm_weights);
+}
+
+ParseParameterAttrStatus DeconvolutionLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& deconv_layer) {
+  CHECK(op != nullptr) << "Deconvolution operator is nullptr";
+  const std::map<std::string, std::shared_ptr<RuntimeParameter>>& params =
+      op->params;
+
+  if (params.find("in_channels") == params.end()) {
+    LOG(ERROR) << "Can not find the in channel parameter";
+    return ParseParameterAttrStatus::kParameterMissingInChannel;
+  }
+  auto in_channel =
+      std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("in_channels"));
+  if (!in_channel) {
+    LOG(ERROR) << "Can not find the in channel parameter";
+    return ParseParameterAttrStatus::kParameterMissingInChannel;
+  }
+
+  if (params.find("out_channels") == params.end()) {
+    LOG(ERROR) << "Can not find the out channel parameter";
+    return ParseParameterAttrStatus::kParameterMissingOutChannel;
+  }
+  auto out_channel =
+      std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("out_channels"));
+  if (!out_channel) {
+    LOG(ERROR) << "Can not find the out channel parameter";
+    return ParseParameterAttrStatus::kParameterMissingOutChannel;
+  }
+
+  if (params.find("padding") == params.end()) {
+    LOG(ERROR) << "Can not find the padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingPadding;
+  }
+  auto padding =
+      std::dynamic_pointer_cast<RuntimeParameterIntArray>(params.at("padding"));
+  if (!padding) {
+    LOG(ERROR) << "Can not find the padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingPadding;
+  }
+
+  if (params.find("output_padding") == params.end()) {
+    LOG(ERROR) << "Can not find the output padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingOutputPadding;
+  }
+  auto output_padding = std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+      params.at("output_padding"));
+  if (!output_padding) {
+    LOG(ERROR) << "Can not find the output padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingOutputPadding;
+  }
+
+  if (params.find("bias") == params.end()) {
+    LOG(ERROR) << "Can not find the bias parameter";
+    return ParseParameterAttrStatus::kParameterMissingUseBias;
+  }
+  auto use_bias =
+      std::dynamic_pointer_cast<RuntimeParameterBool>(params.at("bias"));
+  if (!use_bias) {
+    LOG(ERROR) << "Can not find the bias parameter";
+    return ParseParameterAttrStatus::kParameterMissingUseBias;
+  }
+
+  if (params.find("stride") == params.end()) {
+    LOG(ERROR) << "Can not find the stride parameter";
+    return ParseParameterAttrStatus::kParameterMissingStride;
+  }
+  auto stride =
+      std::dynamic_pointer_cast<RuntimeParameterIntArray>(params.at("stride"));
+  if (!stride) {
+    LOG(ERROR) << "Can not find the stride parameter";
+    return ParseParameterAttrStatus::kParameterMissingStride;
+  }
+
+  if (params.find("dilation") == params.end()) {
+    LOG(ERROR) << "Can not find the dilation parameter";
+    return ParseParameterAttrStatus::kParameterMissingDilation;
+  }
+  auto dilation = std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+      params.at("dilation"));
+  if (!dilation) {
+    LOG(ERROR) << "Can not find the dilation parameter";
+    return ParseParameterAttrStatus::kParameterMissingDilation;
+  }
+
+  if (params.find("kernel_size") == params.end()) {
+    LOG(ERROR) << "Can not find the kernel parameter";
+    return ParseParameterAttrStatus::kParameterMissingKernel;
+  }
+  auto kernel = std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+      params.at("kernel_size"));
+  if (!kernel) {
+    LOG(ERROR) << "Can not find the kernel parameter";
+    return ParseParameterAttrStatus::kParameterMissingKernel;
+  }
+
+  if (params.find("groups") == params.end()) {
+    LOG(ERROR) << "Can not find the groups parameter";
+    return ParseParameterAttrStatus::kParameterMissingGroups;
+  }
+  auto groups =
+      std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("groups"));
+  if (!groups) {
+    LOG(ERROR) << "Can not find the groups parameter";
+    return ParseParameterAttrStatus::kParameterMissingGroups;
+  }
+
+  const uint32_t dims = 2;
+  const std::vector<int>& kernels = kernel->value;
+  const std::vector<int>& paddings = padding->value;
+  const std::vector<int>& output_paddings = output_padding->value;
+  const std::vector<int>& strides = stride->value;
+  const std::vector<int>& dilations = dilation->value;
+  if (paddings.size() != dims) {
+    LOG(ERROR) << "Can not find the right padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingPadding;
+  }
+
+  if (output_paddings.size() != dims) {
+    LOG(ERROR) << "Can not find the right output padding parameter";
+    return ParseParameterAttrStatus::kParameterMissingOutputPadding;
+  }
+
+  if (strides.size() != dims) {
+    LOG(ERROR) << "Can not find the right stride parameter";
+    return ParseParameterAttrStatus::kParameterMissingStride;
+  }
+
+  if (dilations.size() != dims) {
+    LOG(ERROR) << "Can not find the right dilation parameter";
+    return ParseParameterAttrStatus::kParameterMissingDilation;
+  }
+
+  if (kernels.size() != dims) {
+    LOG(ERROR) << "Can not find the right kernel size parameter";
+    return ParseParameterAttrStatus::kParameterMissingKernel;
+  }
+
+  deconv_layer = std::make_shared<DeconvolutionLayer>(
+      out_channel->value, in_channel->value, kernels.at(0), kernels.at(1),
+      paddings.at(0), paddings.at(1), strides.at(0), strides.at(1),
+      output_paddings.at(0), output_paddings.at(1), dilations.at(0),
+      dilations.at(1), groups->value, use_bias->value);
+
+  // load weights
+  const std::map<std::string, std::shared_ptr<RuntimeAttribute>>& attrs =
+      op->attribute;
+  if (use_bias->value) {
+    if (attrs.find("bias") == attrs.end()) {
+      LOG(ERROR) << "Can not find the bias attribute";
+      return ParseParameterAttrStatus::kAttrMissingBias;
+    }
+    const auto& bias = attrs.at("bias");
+    const std::vector<int>& bias_shape = bias->shape;
+    if (bias_shape.empty() || bias_shape.at(0) != out_channel->value) {
+      LOG(ERROR) << "The attribute of bias shape is wrong";
+      return ParseParameterAttrStatus::kAttrMissingBias;
+    }
+
+    const std::vector<float>& bias_values = bias->get<float>();
+    deconv_layer->set_bias(bias_values);
+  }
+
+  if (attrs.find("weight") == attrs.end()) {
+    LOG(ERROR) << "Can not find the weight attribute";
+    return ParseParameterAttrStatus::kAttrMissingWeight;
+  }
+
+  const auto& weight = attrs.at("weight");
+  const std::vector<int>& weight_shape = weight->shape;
+  if (weight_shape.size() != 4 || weight_shape.at(0) != in_channel->value) {
+    LOG(ERROR) << "The attribute of weight shape is wrong";
+    return ParseParameterAttrStatus::kAttrMissingWeight;
+  }
+
+  const std::vector<float>& weight_values = weight->get<float>();
+  deconv_layer->set_weights(weight_values);
+
+  auto deconv_layer_derived =
+      std::dynamic_pointer_cast<DeconvolutionLayer>(deconv_layer);
+  CHECK(deconv_layer_derived != nullptr);
+  deconv_layer_derived->InitGemmWeight();
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kDeconvGetInstance("nn.ConvTranspose2d",
+                                          DeconvolutionLayer::GetInstance);
+}  // namespace kuiper_infer
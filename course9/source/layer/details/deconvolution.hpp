@@ -0,0 +1,117 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-5.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DECONVOLUTION_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DECONVOLUTION_HPP_
+#include "layer/abstract/param_layer.hpp"
+
+namespace kuiper_infer {
+class DeconvolutionLayer : public ParamLayer {
+ public:
+  explicit DeconvolutionLayer(uint32_t output_channel, uint32_t in_channel,
+                              uint32_t kernel_h, uint32_t kernel_w,
+                              uint32_t padding_h, uint32_t padding_w,
+                              uint32_t stride_h, uint32_t stride_w,
+                              uint32_t output_padding_h,
+                              uint32_t output_padding_w, uint32_t dilation_h,
+                              uint32_t dilation_w, uint32_t groups,
+                              bool use_bias = true);
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator>& op,
+      std::shared_ptr<Layer>& deconv_layer);
+
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+      std::vector<std::shared_ptr<Tensor<float>>>& outputs) override;
+
+  /**
+   * 初始化kernel的gemm排布，每组的权重排布为in_channel_group x
+   * (output_channel_group * kernel_h * kernel_w)的矩阵
+   */
+  void InitGemmWeight();
+
+  std::string kernel_name() const override;
+
+  void Prepare() override;
+
+  uint64_t constant_floats() const override;
+
+  uint64_t MoveConstants(float* arena) override;
+
+ private:
+  /**
+   * 用gemm计算每个输入位置对所有输出通道、所有卷积核位置的贡献，再用col2im累加到输出中
+   * @param input 输入张量
+   * @param output 输出张量，需已用偏置初始化
+   * @param group 当前计算的组
+   */
+  void DeconvGemm(const sftensor& input, const sftensor& output,
+                  uint32_t group) const;
+
+  /**
+   * 直接把输入的每个位置乘以卷积核后累加到输出中，适用于输入通道较少的情况
+   * @param input 输入张量
+   * @param output 输出张量，需已用偏置初始化
+   * @param group 当前计算的组
+   */
+  void DeconvDirect(const sftensor& input, const sftensor& output,
+                    uint32_t group) const;
+
+  /**
+   * 把一个卷积核位置上所有输入位置的贡献累加到输出通道中
+   * @param col 卷积核位置(kh, kw)上每个输入位置的贡献，按列主序排列
+   * @param input_h 输入的高度
+   * @param input_w 输入的宽度
+   * @param kh 卷积核位置的行
+   * @param kw 卷积核位置的列
+   * @param output_channel 输出通道的起始地址
+   * @param output_h 输出的高度
+   * @param output_w 输出的宽度
+   * @param scale 累加之前乘上的系数
+   */
+  void Col2ImTap(const float* col, uint32_t input_h, uint32_t input_w,
+                 uint32_t kh, uint32_t kw, float* output_channel,
+                 uint32_t output_h, uint32_t output_w, float scale) const;
+
+ private:
+  bool use_bias_ = false;
+  uint32_t groups_ = 1;
+  uint32_t in_channel_ = 0;
+  uint32_t output_channel_ = 0;
+  uint32_t kernel_h_ = 0;
+  uint32_t kernel_w_ = 0;
+  uint32_t padding_h_ = 0;
+  uint32_t padding_w_ = 0;
+  uint32_t stride_h_ = 1;
+  uint32_t stride_w_ = 1;
+  uint32_t output_padding_h_ = 0;
+  uint32_t output_padding_w_ = 0;
+  uint32_t dilation_h_ = 1;
+  uint32_t dilation_w_ = 1;
+  std::vector<arma::fmat> gemm_weights_;  /// 每组权重的gemm排布
+};
+
+}  // namespace kuiper_infer
+
+#endif  // KUIPER_INFER_SOURCE_LAYER_DECONVOLUTION_HPP_
@@ -23,6 +23,7 @@
 
 #include "expression.hpp"
 #include <stack>
+#include <utility>
 #include "data/tensor_util.hpp"
 #include "layer/abstract/layer_factory.hpp"
 
@@ -70,13 +71,13 @@ InferStatus ExpressionLayer::Forward(
                   << i << "th";
       return InferStatus::kInferFailedOutputEmpty;
     }
-    outputs.at(i)->Fill(0.f);
   }
 
   std::stack<std::vector<std::shared_ptr<Tensor<float>>>> op_stack;
   const std::vector<std::shared_ptr<TokenNode>>& token_nodes =
       this->parser_->Generate();
-  for (const auto& token_node : token_nodes) {
+  for (uint32_t t = 0; t < token_nodes.size(); ++t) {
+    const auto& token_node = token_nodes.at(t);
     if (token_node->num_index >= 0) {
       // process operator
       uint32_t start_pos = token_node->num_index * batch_size;
@@ -111,11 +112,22 @@ InferStatus ExpressionLayer::Forward(
           << batch_size;
       op_stack.pop();
 
+      // 最后一次运算直接写入输出张量，绑定的输出和内存规划分配的输出因此不会被替换
+      const bool last_token = t + 1 == token_nodes.size();
       std::vector<std::shared_ptr<Tensor<float>>> output_token_nodes(
           batch_size);
       for (uint32_t i = 0; i < batch_size; ++i) {
         // do execution
-        if (op == int(TokenType::TokenAdd)) {
+        if (last_token) {
+          output_token_nodes.at(i) = outputs.at(i);
+          if (op == int(TokenType::TokenAdd)) {
+            TensorElementAdd(input_node1.at(i), input_node2.at(i),
+                             output_token_nodes.at(i));
+          } else {
+            TensorElementMultiply(input_node1.at(i), input_node2.at(i),
+                                  output_token_nodes.at(i));
+          }
+        } else if (op == int(TokenType::TokenAdd)) {
           output_token_nodes.at(i) =
               TensorElementAdd(input_node1.at(i), input_node2.at(i));
         } else if (op == int(TokenType::TokenMul)) {
@@ -136,7 +148,9 @@ InferStatus ExpressionLayer::Forward(
   for (int i = 0; i < batch_size; ++i) {
     CHECK(outputs.at(i) != nullptr && !outputs.at(i)->empty());
     CHECK(outputs.at(i)->shapes() == output_node.at(i)->shapes());
-    outputs.at(i) = output_node.at(i);
+    if (outputs.at(i) != output_node.at(i)) {
+      outputs.at(i)->set_data(std::as_const(*output_node.at(i)).data());
+    }
   }
   return InferStatus::kInferSuccess;
 }
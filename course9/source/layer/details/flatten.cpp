@@ -22,6 +22,7 @@
 // Created by fss on 22-12-9.
 #include "flatten.hpp"
 #include <numeric>
+#include <utility>
 #include "data/tensor_util.hpp"
 #include "layer/abstract/layer_factory.hpp"
 
@@ -75,8 +76,9 @@ InferStatus FlattenLayer::Forward(
         std::accumulate(shapes.begin() + start_dim,
                         shapes.begin() + end_dim + 1, 1, std::multiplies());
 
-    std::shared_ptr<Tensor<float>> output = outputs.at(i);
-    output = TensorClone(input);
+    // 输出已经分配好时(绑定的输出或者内存规划的内存块)，展平之后写回原来的张量
+    const std::shared_ptr<Tensor<float>> allocated_output = outputs.at(i);
+    std::shared_ptr<Tensor<float>> output = TensorClone(input);
     CHECK(input->size() == output->size())
         << "The output and input shapes of the flatten layer do "
            "not match "
@@ -95,6 +97,11 @@ InferStatus FlattenLayer::Forward(
       LOG(FATAL) << "Wrong flatten dim: "
                  << "start dim: " << start_dim << " end dim: " << end_dim;
     }
+    if (allocated_output != nullptr && !allocated_output->empty() &&
+        allocated_output->shapes() == output->shapes()) {
+      allocated_output->set_data(std::as_const(*output).data());
+      outputs.at(i) = allocated_output;
+    }
   }
   return InferStatus::kInferSuccess;
 }
@@ -0,0 +1,251 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "gelu.hpp"
+#include <cmath>
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+#include "utils/math/fmath.hpp"
+
+namespace kuiper_infer {
+/// 元素数量超过该值时多线程计算
+static constexpr uint64_t kGeluParallelElements = 1 << 16;
+
+/// 每个线程一次处理的元素数量
+static constexpr uint64_t kGeluChunk = 1 << 14;
+
+// erf(z) ≈ 1 - (a1*t + a2*t^2 + a3*t^3 + a4*t^4 + a5*t^5) * exp(-z^2),
+// t = 1 / (1 + p*z), z >= 0，最大绝对误差1.5e-7 (Abramowitz & Stegun 7.1.26)
+static constexpr float kErfP = 0.3275911f;
+static constexpr float kErfA1 = 0.254829592f;
+static constexpr float kErfA2 = -0.284496736f;
+static constexpr float kErfA3 = 1.421413741f;
+static constexpr float kErfA4 = -1.453152027f;
+static constexpr float kErfA5 = 1.061405429f;
+static constexpr float kInvSqrt2 = 0.70710678f;
+/// tanh近似中的sqrt(2/pi)
+static constexpr float kSqrt2DivPi = 0.79788456f;
+static constexpr float kGeluCubic = 0.044715f;
+
+/**
+ * 精确的GELU: x * 0.5 * (1 + erf(x / sqrt(2)))
+ * 记q = 0.5 * (1 - erf(|x| / sqrt(2)))，x >= 0时结果为x * (1 - q)，否则为x * q
+ */
+static inline float GeluErf(float x) {
+  const float z = std::fabs(x) * kInvSqrt2;
+  const float t = 1.f / (1.f + kErfP * z);
+  const float poly =
+      ((((kErfA5 * t + kErfA4) * t + kErfA3) * t + kErfA2) * t + kErfA1) * t;
+  const float q = 0.5f * poly * fmath::exp(-z * z);
+  return x >= 0.f ? x * (1.f - q) : x * q;
+}
+
+/// tanh近似的GELU，0.5 * (1 + tanh(u)) = 1 / (1 + exp(-2u))
+static inline float GeluTanh(float x) {
+  const float u = kSqrt2DivPi * (x + kGeluCubic * x * x * x);
+  return x / (1.f + fmath::exp(-2.f * u));
+}
+
+#if defined(__AVX2__)
+static inline __m256 GeluErf8(__m256 x) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.f);
+  const __m256 z = _mm256_mul_ps(_mm256_andnot_ps(sign_mask, x),
+                                 _mm256_set1_ps(kInvSqrt2));
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 t = _mm256_div_ps(
+      one, _mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(kErfP), z)));
+  __m256 poly = _mm256_set1_ps(kErfA5);
+  poly = _mm256_add_ps(_mm256_mul_ps(poly, t), _mm256_set1_ps(kErfA4));
+  poly = _mm256_add_ps(_mm256_mul_ps(poly, t), _mm256_set1_ps(kErfA3));
+  poly = _mm256_add_ps(_mm256_mul_ps(poly, t), _mm256_set1_ps(kErfA2));
+  poly = _mm256_add_ps(_mm256_mul_ps(poly, t), _mm256_set1_ps(kErfA1));
+  poly = _mm256_mul_ps(poly, t);
+  const __m256 exp_z =
+      fmath::exp_ps256(_mm256_xor_ps(_mm256_mul_ps(z, z), sign_mask));
+  const __m256 q = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(poly, exp_z));
+  const __m256 positive = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OQ);
+  return _mm256_mul_ps(x, _mm256_blendv_ps(q, _mm256_sub_ps(one, q), positive));
+}
+
+static inline __m256 GeluTanh8(__m256 x) {
+  const __m256 x3 = _mm256_mul_ps(_mm256_mul_ps(x, x), x);
+  const __m256 u = _mm256_mul_ps(
+      _mm256_set1_ps(-2.f * kSqrt2DivPi),
+      _mm256_add_ps(x, _mm256_mul_ps(_mm256_set1_ps(kGeluCubic), x3)));
+  return _mm256_div_ps(
+      x, _mm256_add_ps(_mm256_set1_ps(1.f), fmath::exp_ps256(u)));
+}
+#elif defined(__SSE2__)
+static inline __m128 GeluErf4(__m128 x) {
+  const __m128 sign_mask = _mm_set1_ps(-0.f);
+  const __m128 z =
+      _mm_mul_ps(_mm_andnot_ps(sign_mask, x), _mm_set1_ps(kInvSqrt2));
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 t =
+      _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(kErfP), z)));
+  __m128 poly = _mm_set1_ps(kErfA5);
+  poly = _mm_add_ps(_mm_mul_ps(poly, t), _mm_set1_ps(kErfA4));
+  poly = _mm_add_ps(_mm_mul_ps(poly, t), _mm_set1_ps(kErfA3));
+  poly = _mm_add_ps(_mm_mul_ps(poly, t), _mm_set1_ps(kErfA2));
+  poly = _mm_add_ps(_mm_mul_ps(poly, t), _mm_set1_ps(kErfA1));
+  poly = _mm_mul_ps(poly, t);
+  const __m128 exp_z = fmath::exp_ps(_mm_xor_ps(_mm_mul_ps(z, z), sign_mask));
+  const __m128 q = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(poly, exp_z));
+  // SSE2没有blendv，用掩码选择1 - q或q
+  const __m128 positive = _mm_cmpge_ps(x, _mm_setzero_ps());
+  const __m128 factor = _mm_or_ps(_mm_and_ps(positive, _mm_sub_ps(one, q)),
+                                  _mm_andnot_ps(positive, q));
+  return _mm_mul_ps(x, factor);
+}
+
+static inline __m128 GeluTanh4(__m128 x) {
+  const __m128 x3 = _mm_mul_ps(_mm_mul_ps(x, x), x);
+  const __m128 u =
+      _mm_mul_ps(_mm_set1_ps(-2.f * kSqrt2DivPi),
+                 _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(kGeluCubic), x3)));
+  return _mm_div_ps(x, _mm_add_ps(_mm_set1_ps(1.f), fmath::exp_ps(u)));
+}
+#endif
+
+/**
+ * 逐元素计算GELU，input和output可以是同一块内存
+ * @param input 输入的起始地址
+ * @param output 输出的起始地址
+ * @param size 元素的数量
+ * @param tanh_approximate 是否使用tanh近似
+ */
+static void Gelu(const float* input, float* output, uint64_t size,
+                 bool tanh_approximate) {
+  uint64_t j = 0;
+#if defined(__AVX2__)
+  for (; j + 8 <= size; j += 8) {
+    const __m256 x = _mm256_loadu_ps(input + j);
+    _mm256_storeu_ps(output + j, tanh_approximate ? GeluTanh8(x) : GeluErf8(x));
+  }
+#elif defined(__SSE2__)
+  for (; j + 4 <= size; j += 4) {
+    const __m128 x = _mm_loadu_ps(input + j);
+    _mm_storeu_ps(output + j, tanh_approximate ? GeluTanh4(x) : GeluErf4(x));
+  }
+#endif
+  for (; j < size; ++j) {
+    output[j] = tanh_approximate ? GeluTanh(input[j]) : GeluErf(input[j]);
+  }
+}
+
+GeluLayer::GeluLayer(bool tanh_approximate)
+    : NonParamLayer("GELU"), tanh_approximate_(tanh_approximate) {}
+
+InferStatus GeluLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the gelu layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the gelu layer do "
+                  "not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input_data = inputs.at(i);
+    const sftensor& output_data = outputs.at(i);
+    if (input_data == nullptr || input_data->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the gelu layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (output_data != nullptr && !output_data->empty()) {
+      if (input_data->shapes() != output_data->shapes()) {
+        LOG(ERROR) << "The input and output tensor shapes of the gelu "
+                      "layer do not match "
+                   << i << " th";
+        return InferStatus::kInferFailedInputOutSizeMatchError;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->shapes());
+      outputs.at(i) = output;
+    }
+
+    // 内存规划时输出和输入可以是同一个张量，此时原地计算
+    float* output_ptr = output->raw_ptr();
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    const uint64_t size = input->size();
+    const uint64_t chunks = (size + kGeluChunk - 1) / kGeluChunk;
+    const bool tanh_approximate = tanh_approximate_;
+#pragma omp parallel for if (size >= kGeluParallelElements)
+    for (uint64_t chunk = 0; chunk < chunks; ++chunk) {
+      const uint64_t begin = chunk * kGeluChunk;
+      const uint64_t end = std::min(begin + kGeluChunk, size);
+      Gelu(input_ptr + begin, output_ptr + begin, end - begin,
+           tanh_approximate);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+std::string GeluLayer::kernel_name() const {
+  return tanh_approximate_ ? "gelu_tanh" : "gelu_erf";
+}
+
+ParseParameterAttrStatus GeluLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& gelu_layer) {
+  CHECK(op != nullptr) << "GELU operator is nullptr";
+  bool tanh_approximate = false;
+  // 旧版本的pnnx没有approximate参数，此时为精确的GELU
+  const auto& params = op->params;
+  if (params.find("approximate") != params.end()) {
+    auto approximate = std::dynamic_pointer_cast<RuntimeParameterString>(
+        params.at("approximate"));
+    if (approximate != nullptr) {
+      if (approximate->value == "tanh") {
+        tanh_approximate = true;
+      } else if (approximate->value != "none") {
+        LOG(ERROR) << "Unknown approximate parameter of the gelu layer: "
+                   << approximate->value;
+        return ParseParameterAttrStatus::kParameterMissingUnknown;
+      }
+    }
+  }
+  gelu_layer = std::make_shared<GeluLayer>(tanh_approximate);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kGeluGetInstance("nn.GELU", GeluLayer::GetInstance);
+
+LayerRegistererWrapper kFunctionalGeluGetInstance("F.gelu",
+                                                  GeluLayer::GetInstance);
+
+}  // namespace kuiper_infer
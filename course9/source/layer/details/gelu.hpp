@@ -0,0 +1,51 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_GELU_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_GELU_HPP_
+#include "layer/abstract/non_param_layer.hpp"
+
+namespace kuiper_infer {
+class GeluLayer : public NonParamLayer {
+ public:
+  /**
+   * @param tanh_approximate 为true时使用tanh近似，对应approximate='tanh'，
+   * 否则使用erf计算精确的GELU
+   */
+  explicit GeluLayer(bool tanh_approximate = false);
+
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  std::string kernel_name() const override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &gelu_layer);
+
+ private:
+  bool tanh_approximate_ = false;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_GELU_HPP_
@@ -0,0 +1,58 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "identity.hpp"
+
+namespace kuiper_infer {
+
+IdentityLayer::IdentityLayer() : NonParamLayer("Identity") {}
+
+InferStatus IdentityLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+    std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the identity layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the identity "
+                  "layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor &input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the identity layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    outputs.at(i) = input;
+  }
+  return InferStatus::kInferSuccess;
+}
+
+}  // namespace kuiper_infer
@@ -0,0 +1,266 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "layernorm.hpp"
+#include <cmath>
+#include <utility>
+#include "data/tensor_util.hpp"
+#include "layer/abstract/layer_factory.hpp"
+
+namespace kuiper_infer {
+/// 每次归一化的token数量，统计量放在栈上，一块token的数据可以留在缓存中
+static constexpr uint32_t kLayerNormTokenBlock = 64;
+
+/// 元素数量超过该值时，按token块多线程计算
+static constexpr uint64_t kLayerNormParallelElements = 1 << 15;
+
+/**
+ * 对一个通道中[begin, end)范围内的token做归一化
+ * 张量按列存储，同一个特征的各个token是连续的，所以统计量按token向量化累加
+ * input和output可以是同一块内存
+ * @param input 输入通道的起始地址
+ * @param output 输出通道的起始地址
+ * @param tokens 通道中token的数量，也是一列的长度
+ * @param begin 起始token
+ * @param end 结束token
+ * @param features 特征的数量
+ * @param gamma 每个特征的缩放
+ * @param beta 每个特征的偏移
+ * @param eps 加在方差上的小量
+ */
+static void LayerNormBlock(const float* input, float* output, uint32_t tokens,
+                           uint32_t begin, uint32_t end, uint32_t features,
+                           const float* gamma, const float* beta, float eps) {
+  const uint32_t block = end - begin;
+  float mean[kLayerNormTokenBlock] = {0.f};
+  float rstd[kLayerNormTokenBlock] = {0.f};
+  for (uint32_t f = 0; f < features; ++f) {
+    const float* column = input + uint64_t(f) * tokens + begin;
+#pragma omp simd
+    for (uint32_t t = 0; t < block; ++t) {
+      mean[t] += column[t];
+    }
+  }
+  const float inv_features = 1.f / float(features);
+  for (uint32_t t = 0; t < block; ++t) {
+    mean[t] *= inv_features;
+  }
+
+  // 减去均值之后再求方差，避免E[x^2]-E[x]^2的相消误差
+  for (uint32_t f = 0; f < features; ++f) {
+    const float* column = input + uint64_t(f) * tokens + begin;
+#pragma omp simd
+    for (uint32_t t = 0; t < block; ++t) {
+      const float diff = column[t] - mean[t];
+      rstd[t] += diff * diff;
+    }
+  }
+  for (uint32_t t = 0; t < block; ++t) {
+    rstd[t] = 1.f / std::sqrt(rstd[t] * inv_features + eps);
+  }
+
+  for (uint32_t f = 0; f < features; ++f) {
+    const float* column = input + uint64_t(f) * tokens + begin;
+    float* output_column = output + uint64_t(f) * tokens + begin;
+    const float g = gamma[f];
+    const float b = beta[f];
+#pragma omp simd
+    for (uint32_t t = 0; t < block; ++t) {
+      output_column[t] = (column[t] - mean[t]) * rstd[t] * g + b;
+    }
+  }
+}
+
+LayerNormLayer::LayerNormLayer(uint32_t normalized_features, float eps,
+                               const std::vector<float>& affine_weight,
+                               const std::vector<float>& affine_bias)
+    : ParamLayer("LayerNorm"),
+      normalized_features_(normalized_features),
+      eps_(eps) {
+  CHECK_GT(normalized_features_, 0);
+  CHECK(affine_weight.empty() || affine_weight.size() == normalized_features)
+      << "The size of affine weight does not match the normalized shape";
+  CHECK(affine_bias.empty() || affine_bias.size() == normalized_features)
+      << "The size of affine bias does not match the normalized shape";
+
+  // 没有仿射变换时缩放为1、偏移为0，推理时不需要区分
+  sftensor gamma = TensorCreate(std::vector<uint32_t>{normalized_features});
+  sftensor beta = TensorCreate(std::vector<uint32_t>{normalized_features});
+  gamma->Fill(1.f);
+  beta->Fill(0.f);
+  if (!affine_weight.empty()) {
+    std::copy(affine_weight.begin(), affine_weight.end(), gamma->raw_ptr());
+  }
+  if (!affine_bias.empty()) {
+    std::copy(affine_bias.begin(), affine_bias.end(), beta->raw_ptr());
+  }
+  this->weights_ = {gamma};
+  this->bias_ = {beta};
+}
+
+InferStatus LayerNormLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the layernorm layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the layernorm "
+                  "layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  if (this->weights_.size() != 1 || this->bias_.size() != 1 ||
+      this->weights_.front()->size() != normalized_features_ ||
+      this->bias_.front()->size() != normalized_features_) {
+    LOG(ERROR) << "The weight and bias of the layernorm layer are wrong";
+    return InferStatus::kInferFailedWeightParameterError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input_data = inputs.at(i);
+    const sftensor& output_data = outputs.at(i);
+    if (input_data == nullptr || input_data->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the layernorm layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (input_data->cols() != normalized_features_) {
+      LOG(ERROR) << "The last dimension of input tensor in the layernorm layer "
+                    "does not match the normalized shape "
+                 << i << " th";
+      return InferStatus::kInferFailedShapeParameterError;
+    }
+    if (output_data != nullptr && !output_data->empty()) {
+      if (input_data->shapes() != output_data->shapes()) {
+        LOG(ERROR) << "The input and output tensor shapes of the layernorm "
+                      "layer do not match "
+                   << i << " th";
+        return InferStatus::kInferFailedInputOutSizeMatchError;
+      }
+    }
+  }
+
+  const float* gamma = std::as_const(*weights_.front()).data().memptr();
+  const float* beta = std::as_const(*bias_.front()).data().memptr();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->shapes());
+      outputs.at(i) = output;
+    }
+
+    // 内存规划时输出和输入可以是同一个张量，此时原地计算
+    float* output_ptr = output->raw_ptr();
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    const uint32_t channels = input->channels();
+    const uint32_t tokens = input->rows();
+    const uint32_t features = normalized_features_;
+    const uint64_t plane = uint64_t(tokens) * features;
+    const uint32_t token_blocks =
+        (tokens + kLayerNormTokenBlock - 1) / kLayerNormTokenBlock;
+    const uint32_t tasks = channels * token_blocks;
+    const float eps = eps_;
+#pragma omp parallel for if (channels * plane >= kLayerNormParallelElements)
+    for (uint32_t task = 0; task < tasks; ++task) {
+      const uint32_t c = task / token_blocks;
+      const uint32_t begin = (task % token_blocks) * kLayerNormTokenBlock;
+      const uint32_t end = std::min(begin + kLayerNormTokenBlock, tokens);
+      LayerNormBlock(input_ptr + c * plane, output_ptr + c * plane, tokens,
+                     begin, end, features, gamma, beta, eps);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+ParseParameterAttrStatus LayerNormLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& layer_norm_layer) {
+  CHECK(op != nullptr) << "LayerNorm operator is nullptr";
+  const auto& params = op->params;
+  if (params.find("eps") == params.end()) {
+    LOG(ERROR) << "Can not find the eps parameter";
+    return ParseParameterAttrStatus::kParameterMissingEps;
+  }
+  auto eps = std::dynamic_pointer_cast<RuntimeParameterFloat>(params.at("eps"));
+  if (!eps) {
+    LOG(ERROR) << "Can not find the eps parameter";
+    return ParseParameterAttrStatus::kParameterMissingEps;
+  }
+
+  if (params.find("normalized_shape") == params.end()) {
+    LOG(ERROR) << "Can not find the normalized shape parameter";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+  auto normalized_shape = std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+      params.at("normalized_shape"));
+  // 只支持在最后一维上归一化，这也是Transformer中的用法
+  if (!normalized_shape || normalized_shape->value.size() != 1 ||
+      normalized_shape->value.front() <= 0) {
+    LOG(ERROR) << "The layernorm layer only support normalizing the last "
+                  "dimension";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+
+  bool affine = false;
+  if (params.find("elementwise_affine") != params.end()) {
+    auto affine_param = std::dynamic_pointer_cast<RuntimeParameterBool>(
+        params.at("elementwise_affine"));
+    affine = affine_param != nullptr && affine_param->value;
+  }
+
+  const auto& attrs = op->attribute;
+  const uint32_t features = normalized_shape->value.front();
+  std::vector<float> affine_weight;
+  std::vector<float> affine_bias;
+  if (affine) {
+    if (attrs.find("weight") == attrs.end() ||
+        attrs.at("weight")->weight_data.size() != features * sizeof(float)) {
+      LOG(ERROR) << "Can not find the affine weight attribute";
+      return ParseParameterAttrStatus::kAttrMissingWeight;
+    }
+    affine_weight = attrs.at("weight")->get<float>();
+    // bias=False时只有缩放
+    if (attrs.find("bias") != attrs.end()) {
+      if (attrs.at("bias")->weight_data.size() != features * sizeof(float)) {
+        LOG(ERROR) << "Can not find the affine bias attribute";
+        return ParseParameterAttrStatus::kAttrMissingBias;
+      }
+      affine_bias = attrs.at("bias")->get<float>();
+    }
+  }
+
+  layer_norm_layer = std::make_shared<LayerNormLayer>(features, eps->value,
+                                                      affine_weight, affine_bias);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kLayerNormGetInstance("nn.LayerNorm",
+                                             LayerNormLayer::GetInstance);
+
+}  // namespace kuiper_infer
@@ -0,0 +1,55 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_LAYERNORM_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_LAYERNORM_HPP_
+#include "layer/abstract/param_layer.hpp"
+
+namespace kuiper_infer {
+class LayerNormLayer : public ParamLayer {
+ public:
+  /**
+   * 在最后一维上做归一化，输入的形状为(channels, tokens, features)
+   * @param normalized_features 最后一维的大小
+   * @param eps 加在方差上的小量
+   * @param affine_weight 仿射变换的缩放，为空时表示没有仿射变换
+   * @param affine_bias 仿射变换的偏移，为空时表示没有偏移
+   */
+  LayerNormLayer(uint32_t normalized_features, float eps,
+                 const std::vector<float> &affine_weight,
+                 const std::vector<float> &affine_bias);
+
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &layer_norm_layer);
+
+ private:
+  uint32_t normalized_features_ = 0;
+  float eps_ = 1e-5f;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_LAYERNORM_HPP_
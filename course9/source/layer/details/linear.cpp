@@ -79,7 +79,6 @@ InferStatus LinearLayer::Forward(
   const std::shared_ptr<Tensor<float>>& weight = weights_.front();
   arma::fmat weight_data(weight->raw_ptr(), out_features_, in_features_, false,
                          true);
-  const arma::fmat& weight_data_t = weight_data.t();
 
   for (uint32_t i = 0; i < batch; ++i) {
     const std::shared_ptr<Tensor<float>>& input = inputs.at(i);
@@ -100,7 +99,7 @@ InferStatus LinearLayer::Forward(
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
-      output = std::make_shared<Tensor<float>>(1, out_features_, feature_dims);
+      output = std::make_shared<Tensor<float>>(1, feature_dims, out_features_);
       outputs.at(i) = output;
     }
     CHECK(output->channels() == 1 && output->rows() == feature_dims &&
@@ -118,7 +117,8 @@ InferStatus LinearLayer::Forward(
     }
 
     arma::fmat& result = output->slice(0);
-    result = input_vec * weight_data_t;
+    // 转置由gemm直接处理，不再每次拷贝出转置后的权重
+    result = input_vec * weight_data.t();
     if (use_bias_) {
       CHECK(!this->bias_.empty() && this->bias_.size() == 1)
           << "The bias tensor is empty, but use_bias is true";
@@ -0,0 +1,134 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "matmul.hpp"
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+
+namespace kuiper_infer {
+/// 乘加次数超过该值时按通道多线程计算
+static constexpr uint64_t kMatMulParallelFlops = 1 << 20;
+
+MatMulLayer::MatMulLayer() : NonParamLayer("MatMul") {}
+
+InferStatus MatMulLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the matmul layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  // 输入按操作数排列，前一半是左矩阵，后一半是右矩阵
+  if (inputs.size() != outputs.size() * 2) {
+    LOG(ERROR) << "The input and output tensor array size of the matmul layer "
+                  "do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = outputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& left = inputs.at(i);
+    const sftensor& right = inputs.at(i + batch_size);
+    if (left == nullptr || left->empty() || right == nullptr ||
+        right->empty()) {
+      LOG(ERROR)
+          << "The input tensor array in the matmul layer has an empty tensor "
+          << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    if (left->cols() != right->rows()) {
+      LOG(ERROR) << "The inner dimensions of the matmul layer do not match "
+                 << left->cols() << " and " << right->rows() << ", " << i
+                 << " th";
+      return InferStatus::kInferFailedShapeParameterError;
+    }
+    if (left->channels() != right->channels() && left->channels() != 1 &&
+        right->channels() != 1) {
+      LOG(ERROR) << "The channels of the matmul layer can not be broadcast "
+                 << i << " th";
+      return InferStatus::kInferFailedChannelParameterError;
+    }
+    const sftensor& output = outputs.at(i);
+    if (output != nullptr && !output->empty()) {
+      if (output->channels() !=
+              std::max(left->channels(), right->channels()) ||
+          output->rows() != left->rows() || output->cols() != right->cols()) {
+        LOG(ERROR) << "The output tensor shape of the matmul layer is wrong "
+                   << i << " th";
+        return InferStatus::kInferFailedOutputSizeError;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& left = inputs.at(i);
+    const sftensor& right = inputs.at(i + batch_size);
+    const uint32_t channels = std::max(left->channels(), right->channels());
+    const uint32_t m = left->rows();
+    const uint32_t k = left->cols();
+    const uint32_t n = right->cols();
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(channels, m, n);
+      outputs.at(i) = output;
+    }
+
+    // 每个通道是一个按列存储的矩阵，通道之间的步长固定，广播的一方步长为0
+    float* left_ptr = const_cast<float*>(std::as_const(*left).data().memptr());
+    float* right_ptr =
+        const_cast<float*>(std::as_const(*right).data().memptr());
+    const uint64_t left_stride = left->channels() == 1 ? 0 : uint64_t(m) * k;
+    const uint64_t right_stride = right->channels() == 1 ? 0 : uint64_t(k) * n;
+    float* output_ptr = output->raw_ptr();
+    const uint64_t flops = uint64_t(channels) * m * k * n;
+#pragma omp parallel for if (channels > 1 && flops >= kMatMulParallelFlops)
+    for (uint32_t c = 0; c < channels; ++c) {
+      const arma::fmat left_matrix(left_ptr + c * left_stride, m, k, false,
+                                   true);
+      const arma::fmat right_matrix(right_ptr + c * right_stride, k, n, false,
+                                    true);
+      arma::fmat output_matrix(output_ptr + c * uint64_t(m) * n, m, n, false,
+                               true);
+      output_matrix = left_matrix * right_matrix;
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+ParseParameterAttrStatus MatMulLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& matmul_layer) {
+  CHECK(op != nullptr) << "MatMul operator is nullptr";
+  if (op->input_operands_seq.size() != 2) {
+    LOG(ERROR) << "The matmul layer needs two input operands";
+    return ParseParameterAttrStatus::kParameterMissingUnknown;
+  }
+  matmul_layer = std::make_shared<MatMulLayer>();
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kMatMulGetInstance("torch.matmul",
+                                          MatMulLayer::GetInstance);
+
+}  // namespace kuiper_infer
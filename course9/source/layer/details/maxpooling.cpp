@@ -22,6 +22,8 @@
 // Created by fss on 22-11-18.
 
 #include "maxpooling.hpp"
+#include <limits>
+#include <utility>
 #include "data/tensor_util.hpp"
 #include "layer/abstract/layer_factory.hpp"
 #include "runtime/runtime_ir.hpp"
@@ -103,10 +105,16 @@ InferStatus MaxPoolingLayer::Forward(
            "empty tensor "
         << i << "th";
 
-    const uint32_t input_h = input_data->rows();
-    const uint32_t input_w = input_data->cols();
-    const uint32_t input_padded_h = input_data->rows() + 2 * padding_h_;
-    const uint32_t input_padded_w = input_data->cols() + 2 * padding_w_;
+    // 输入先拷贝到以最小值为边框的缓冲区中，取最大值时不再需要判断边界
+    std::shared_ptr<Tensor<float>> padded_input = input_data;
+    if (padding_h_ > 0 || padding_w_ > 0) {
+      TensorPaddingInto(input_data,
+                        {padding_h_, padding_h_, padding_w_, padding_w_},
+                        std::numeric_limits<float>::lowest(), padded_input_);
+      padded_input = padded_input_;
+    }
+    const uint32_t input_padded_h = padded_input->rows();
+    const uint32_t input_padded_w = padded_input->cols();
 
     const uint32_t input_c = input_data->channels();
 
@@ -128,27 +136,21 @@ InferStatus MaxPoolingLayer::Forward(
            "has an incorrectly sized tensor "
         << i << "th";
 
+    const arma::fcube& padded_cube = std::as_const(*padded_input).data();
     for (uint32_t ic = 0; ic < input_c; ++ic) {
-      const arma::fmat& input_channel = input_data->slice(ic);
+      const arma::fmat& input_channel = padded_cube.slice(ic);
       arma::fmat& output_channel = output_data->slice(ic);
       for (uint32_t c = 0; c < input_padded_w - pooling_w + 1; c += stride_w_) {
         int output_col = int(c / stride_w_);
+        float* output_channel_ptr = output_channel.colptr(output_col);
         for (uint32_t r = 0; r < input_padded_h - pooling_h + 1;
              r += stride_h_) {
           int output_row = int(r / stride_h_);
-          float* output_channel_ptr = output_channel.colptr(output_col);
           float max_value = std::numeric_limits<float>::lowest();
           for (uint32_t w = 0; w < pooling_w; ++w) {
-            const float* col_ptr = input_channel.colptr(c + w - padding_w_);
+            const float* col_ptr = input_channel.colptr(c + w) + r;
             for (uint32_t h = 0; h < pooling_h; ++h) {
-              float current_value = 0.f;
-              if ((h + r >= padding_h_ && w + c >= padding_w_) &&
-                  (h + r < input_h + padding_h_ &&
-                   w + c < input_w + padding_w_)) {
-                current_value = *(col_ptr + r + h - padding_h_);
-              } else {
-                current_value = std::numeric_limits<float>::lowest();
-              }
+              const float current_value = col_ptr[h];
               max_value = max_value > current_value ? max_value : current_value;
             }
           }
@@ -160,6 +162,36 @@ InferStatus MaxPoolingLayer::Forward(
   return InferStatus::kInferSuccess;
 }
 
+uint64_t MaxPoolingLayer::persistent_bytes() const {
+  // 内存规划分配的缓冲区已经计入节点输出的内存块
+  if (padded_input_ == nullptr || padded_input_->empty() ||
+      padded_input_ == scratch_) {
+    return 0;
+  }
+  return uint64_t(padded_input_->size()) * sizeof(float);
+}
+
+std::vector<uint32_t> MaxPoolingLayer::scratch_shapes() const {
+  const auto& runtime_operator = runtime_operator_.lock();
+  if ((padding_h_ == 0 && padding_w_ == 0) || runtime_operator == nullptr ||
+      runtime_operator->input_operands_seq.size() != 1) {
+    return {};
+  }
+  const std::vector<int32_t>& input_shapes =
+      runtime_operator->input_operands_seq.front()->shapes;
+  if (input_shapes.size() != 4) {
+    return {};
+  }
+  return {uint32_t(input_shapes.at(1)),
+          uint32_t(input_shapes.at(2)) + 2 * padding_h_,
+          uint32_t(input_shapes.at(3)) + 2 * padding_w_};
+}
+
+void MaxPoolingLayer::set_scratch(const std::shared_ptr<Tensor<float>>& scratch) {
+  Layer::set_scratch(scratch);
+  this->padded_input_ = scratch;
+}
+
 ParseParameterAttrStatus MaxPoolingLayer::GetInstance(
     const std::shared_ptr<RuntimeOperator>& op,
     std::shared_ptr<Layer>& max_layer) {
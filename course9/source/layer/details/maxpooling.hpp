@@ -39,6 +39,12 @@ class MaxPoolingLayer : public NonParamLayer {
       const std::shared_ptr<RuntimeOperator>& op,
       std::shared_ptr<Layer>& max_layer);
 
+  uint64_t persistent_bytes() const override;
+
+  std::vector<uint32_t> scratch_shapes() const override;
+
+  void set_scratch(const std::shared_ptr<Tensor<float>>& scratch) override;
+
  private:
   uint32_t padding_h_ = 0;
   uint32_t padding_w_ = 0;
@@ -46,6 +52,7 @@ class MaxPoolingLayer : public NonParamLayer {
   uint32_t pooling_size_w_ = 0;
   uint32_t stride_h_ = 1;
   uint32_t stride_w_ = 1;
+  sftensor padded_input_;  /// 以最小值为边框的输入缓冲区，在多次推理之间复用
 };
 }  // namespace kuiper_infer
 #endif  // KUIPER_INFER_SOURCE_LAYER_MAX_POOLING_
@@ -0,0 +1,395 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "permute.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+#include "utils/math/transpose.hpp"
+
+namespace kuiper_infer {
+/// 输出元素数量超过该值时多线程拷贝
+static constexpr uint64_t kPermuteParallelElements = 1 << 16;
+
+/**
+ * 按输入的形状创建或者复用视图，视图的维度数和输入相同
+ */
+static void AssignView(const sftensor& input, const std::vector<uint32_t>& shapes,
+                       sftensor& output) {
+  float* view_ptr = const_cast<float*>(std::as_const(*input).data().memptr());
+  if (output != nullptr && !output->empty() &&
+      std::as_const(*output).data().memptr() == view_ptr &&
+      output->shapes() == shapes) {
+    return;
+  }
+  std::vector<uint32_t> raw_shapes = shapes;
+  while (raw_shapes.size() > input->raw_shapes().size() &&
+         raw_shapes.front() == 1) {
+    raw_shapes.erase(raw_shapes.begin());
+  }
+  output = std::make_shared<Tensor<float>>(view_ptr, raw_shapes);
+}
+
+/**
+ * 检查输出的形状，输出为空时创建，维度数和输入相同
+ */
+static bool PrepareOutput(const sftensor& input,
+                          const std::vector<uint32_t>& shapes,
+                          sftensor& output) {
+  if (output == nullptr || output->empty()) {
+    std::vector<uint32_t> raw_shapes = shapes;
+    while (raw_shapes.size() > input->raw_shapes().size() &&
+           raw_shapes.front() == 1) {
+      raw_shapes.erase(raw_shapes.begin());
+    }
+    output = std::make_shared<Tensor<float>>(raw_shapes);
+  }
+  return output->shapes() == shapes;
+}
+
+PermuteLayer::PermuteLayer(std::vector<uint32_t> axes, bool output_view)
+    : NonParamLayer("Permute"),
+      axes_(std::move(axes)),
+      output_view_(output_view) {
+  std::vector<uint32_t> sorted_axes = axes_;
+  std::sort(sorted_axes.begin(), sorted_axes.end());
+  CHECK(sorted_axes == std::vector<uint32_t>({0, 1, 2}))
+      << "The axes of the permute layer should be a permutation of 0, 1, 2";
+}
+
+bool PermuteLayer::output_is_view() const { return output_view_; }
+
+std::string PermuteLayer::kernel_name() const {
+  if (output_view_) {
+    return "permute_view";
+  }
+  return axes_.at(1) == 1 ? "permute_copy" : "permute_blocked_transpose";
+}
+
+bool PermuteLayer::KeepsMemoryOrder(const std::vector<uint32_t>& axes,
+                                    const std::vector<uint32_t>& shapes) {
+  CHECK(axes.size() == 3 && shapes.size() == 3);
+  // 张量在内存中从外到内依次是通道、列和行，大小为1的维度不影响顺序
+  const std::vector<uint32_t> input_order{0, 2, 1};
+  const std::vector<uint32_t> output_order{axes.at(0), axes.at(2), axes.at(1)};
+  std::vector<uint32_t> input_axes;
+  std::vector<uint32_t> output_axes;
+  for (uint32_t i = 0; i < 3; ++i) {
+    if (shapes.at(input_order.at(i)) > 1) {
+      input_axes.push_back(input_order.at(i));
+    }
+    if (shapes.at(output_order.at(i)) > 1) {
+      output_axes.push_back(output_order.at(i));
+    }
+  }
+  return input_axes == output_axes;
+}
+
+InferStatus PermuteLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the permute layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the permute "
+                  "layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR) << "The input tensor array in the permute layer has an empty "
+                    "tensor "
+                 << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+
+    const std::vector<uint32_t>& input_shapes = input->shapes();
+    const std::vector<uint32_t> output_shapes{input_shapes.at(axes_.at(0)),
+                                              input_shapes.at(axes_.at(1)),
+                                              input_shapes.at(axes_.at(2))};
+    if (output_view_ && KeepsMemoryOrder(axes_, input_shapes)) {
+      AssignView(input, output_shapes, outputs.at(i));
+      continue;
+    }
+
+    sftensor& output = outputs.at(i);
+    if (!PrepareOutput(input, output_shapes, output)) {
+      LOG(ERROR) << "The output tensor shape of the permute layer do not match "
+                 << i << " th";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+
+    const uint64_t rows = input_shapes.at(1);
+    const uint64_t input_strides[3]{rows * input_shapes.at(2), 1, rows};
+    const uint64_t output_rows = output_shapes.at(1);
+    const uint64_t output_strides[3]{output_rows * output_shapes.at(2), 1,
+                                     output_rows};
+    // 输出的各个维度在输入中对应的间隔
+    const uint64_t source_strides[3]{input_strides[axes_.at(0)],
+                                     input_strides[axes_.at(1)],
+                                     input_strides[axes_.at(2)]};
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    float* output_ptr = output->raw_ptr();
+    const bool parallel = output->size() >= kPermuteParallelElements;
+
+    if (axes_.at(1) == 1) {
+      // 输出的每一列都是输入中连续的一段
+      const uint32_t output_channels = output_shapes.at(0);
+      const uint32_t output_cols = output_shapes.at(2);
+#pragma omp parallel for collapse(2) if (parallel)
+      for (uint32_t c = 0; c < output_channels; ++c) {
+        for (uint32_t w = 0; w < output_cols; ++w) {
+          std::memcpy(output_ptr + c * output_strides[0] + w * output_strides[2],
+                      input_ptr + c * source_strides[0] + w * source_strides[2],
+                      sizeof(float) * output_rows);
+        }
+      }
+      continue;
+    }
+
+    // 输入的行(连续)对应输出的第transpose_axis维，输出的行(连续)对应输入中有间隔的维度，
+    // 两者之间分块转置，第outer_axis维在外层循环
+    const uint32_t transpose_axis = axes_.at(0) == 1 ? 0 : 2;
+    const uint32_t outer_axis = 2 - transpose_axis;
+    const uint32_t outer_size = output_shapes.at(outer_axis);
+    const uint32_t transpose_rows = output_shapes.at(transpose_axis);
+    const uint32_t transpose_cols = output_shapes.at(1);
+    // 外层维度较小时不在外层并行，由TransposeStrided在块之间并行
+#pragma omp parallel for if (parallel && outer_size >= 4)
+    for (uint32_t k = 0; k < outer_size; ++k) {
+      TransposeStrided(input_ptr + k * source_strides[outer_axis],
+                       source_strides[1],
+                       output_ptr + k * output_strides[outer_axis],
+                       output_strides[transpose_axis], transpose_rows,
+                       transpose_cols);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+ParseParameterAttrStatus PermuteLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& permute_layer) {
+  CHECK(op != nullptr) << "Permute operator is nullptr";
+  if (op->input_operands_seq.empty()) {
+    LOG(ERROR) << "The input operand of the permute layer is empty";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+  const std::vector<int32_t>& input_shapes =
+      op->input_operands_seq.front()->shapes;
+  const int32_t rank = int32_t(input_shapes.size());
+  if (rank < 2 || rank > 4) {
+    LOG(ERROR) << "The permute layer do not support a rank " << rank
+               << " tensor";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+
+  // pnnx中包含批次维度的置换
+  std::vector<int32_t> dims(rank);
+  const auto& params = op->params;
+  if (op->type == "torch.transpose") {
+    auto dim0 = params.find("dim0") == params.end()
+                    ? nullptr
+                    : std::dynamic_pointer_cast<RuntimeParameterInt>(
+                          params.at("dim0"));
+    auto dim1 = params.find("dim1") == params.end()
+                    ? nullptr
+                    : std::dynamic_pointer_cast<RuntimeParameterInt>(
+                          params.at("dim1"));
+    if (dim0 == nullptr || dim1 == nullptr) {
+      LOG(ERROR) << "Can not find the dim0 or dim1 parameter of the transpose "
+                    "layer";
+      return ParseParameterAttrStatus::kParameterMissingDim;
+    }
+    const int32_t first = dim0->value < 0 ? dim0->value + rank : dim0->value;
+    const int32_t second = dim1->value < 0 ? dim1->value + rank : dim1->value;
+    if (first < 0 || first >= rank || second < 0 || second >= rank) {
+      LOG(ERROR) << "The dims of the transpose layer are out of range";
+      return ParseParameterAttrStatus::kParameterMissingDim;
+    }
+    for (int32_t d = 0; d < rank; ++d) {
+      dims.at(d) = d;
+    }
+    std::swap(dims.at(first), dims.at(second));
+  } else {
+    auto dims_param = params.find("dims") == params.end()
+                          ? nullptr
+                          : std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+                                params.at("dims"));
+    if (dims_param == nullptr || int32_t(dims_param->value.size()) != rank) {
+      LOG(ERROR) << "Can not find the dims parameter of the permute layer";
+      return ParseParameterAttrStatus::kParameterMissingDim;
+    }
+    for (int32_t d = 0; d < rank; ++d) {
+      const int32_t dim = dims_param->value.at(d);
+      dims.at(d) = dim < 0 ? dim + rank : dim;
+    }
+  }
+
+  std::vector<int32_t> sorted_dims = dims;
+  std::sort(sorted_dims.begin(), sorted_dims.end());
+  for (int32_t d = 0; d < rank; ++d) {
+    if (sorted_dims.at(d) != d) {
+      LOG(ERROR) << "The dims of the permute layer are not a permutation";
+      return ParseParameterAttrStatus::kParameterMissingDim;
+    }
+  }
+  if (dims.front() != 0) {
+    LOG(ERROR) << "The permute layer do not support moving the batch dim";
+    return ParseParameterAttrStatus::kParameterMissingDim;
+  }
+
+  // 张量的维度向右对齐到通道、行和列，缺少的维度大小为1且位置不变
+  std::vector<uint32_t> axes{0, 1, 2};
+  std::vector<uint32_t> shapes{1, 1, 1};
+  for (int32_t d = 1; d < rank; ++d) {
+    axes.at(3 - (rank - d)) = uint32_t(3 - (rank - dims.at(d)));
+    shapes.at(3 - (rank - d)) = uint32_t(input_shapes.at(d));
+  }
+  permute_layer = std::make_shared<PermuteLayer>(
+      axes, KeepsMemoryOrder(axes, shapes));
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+ChannelShuffleLayer::ChannelShuffleLayer(uint32_t groups, bool output_view)
+    : NonParamLayer("ChannelShuffle"),
+      groups_(groups),
+      output_view_(output_view) {
+  CHECK(groups_ > 0) << "The groups of the channel shuffle layer is zero";
+}
+
+bool ChannelShuffleLayer::output_is_view() const { return output_view_; }
+
+std::string ChannelShuffleLayer::kernel_name() const {
+  return output_view_ ? "channel_shuffle_view" : "channel_shuffle_copy";
+}
+
+InferStatus ChannelShuffleLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the channel shuffle layer is "
+                  "empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the channel "
+                  "shuffle layer do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR) << "The input tensor array in the channel shuffle layer has "
+                    "an empty tensor "
+                 << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+
+    const uint32_t channels = input->channels();
+    if (channels % groups_ != 0) {
+      LOG(ERROR) << "The channels " << channels
+                 << " of the channel shuffle layer can not be divided by the "
+                    "groups "
+                 << groups_;
+      return InferStatus::kInferFailedChannelParameterError;
+    }
+    const uint32_t group_channels = channels / groups_;
+    if (output_view_ && (groups_ == 1 || group_channels == 1)) {
+      AssignView(input, input->shapes(), outputs.at(i));
+      continue;
+    }
+
+    sftensor& output = outputs.at(i);
+    if (!PrepareOutput(input, input->shapes(), output)) {
+      LOG(ERROR) << "The output tensor shape of the channel shuffle layer do "
+                    "not match "
+                 << i << " th";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+
+    const uint64_t plane = uint64_t(input->rows()) * input->cols();
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    float* output_ptr = output->raw_ptr();
+    const uint32_t groups = groups_;
+#pragma omp parallel for if (output->size() >= kPermuteParallelElements)
+    for (uint32_t c = 0; c < channels; ++c) {
+      const uint32_t source_channel =
+          (c % groups) * group_channels + c / groups;
+      std::memcpy(output_ptr + c * plane, input_ptr + source_channel * plane,
+                  sizeof(float) * plane);
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+ParseParameterAttrStatus ChannelShuffleLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& channel_shuffle_layer) {
+  CHECK(op != nullptr) << "Channel shuffle operator is nullptr";
+  const auto& params = op->params;
+  auto groups = params.find("groups") == params.end()
+                    ? nullptr
+                    : std::dynamic_pointer_cast<RuntimeParameterInt>(
+                          params.at("groups"));
+  if (groups == nullptr || groups->value <= 0) {
+    LOG(ERROR) << "Can not find the groups parameter of the channel shuffle "
+                  "layer";
+    return ParseParameterAttrStatus::kParameterMissingGroups;
+  }
+  if (op->input_operands_seq.empty() ||
+      op->input_operands_seq.front()->shapes.size() != 4) {
+    LOG(ERROR) << "The input of the channel shuffle layer should be a rank 4 "
+                  "tensor";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+  const int32_t channels = op->input_operands_seq.front()->shapes.at(1);
+  const bool output_view = groups->value == 1 || groups->value == channels;
+  channel_shuffle_layer =
+      std::make_shared<ChannelShuffleLayer>(groups->value, output_view);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kPermuteGetInstance("torch.permute",
+                                           PermuteLayer::GetInstance);
+
+LayerRegistererWrapper kTensorPermuteGetInstance("Tensor.permute",
+                                                 PermuteLayer::GetInstance);
+
+LayerRegistererWrapper kTransposeGetInstance("torch.transpose",
+                                             PermuteLayer::GetInstance);
+
+LayerRegistererWrapper kChannelShuffleGetInstance(
+    "nn.ChannelShuffle", ChannelShuffleLayer::GetInstance);
+
+}  // namespace kuiper_infer
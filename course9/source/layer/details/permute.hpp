@@ -0,0 +1,96 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_PERMUTE_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_PERMUTE_HPP_
+#include "layer/abstract/non_param_layer.hpp"
+
+namespace kuiper_infer {
+class PermuteLayer : public NonParamLayer {
+ public:
+  /**
+   * @param axes 输出的通道、行和列分别来自输入的哪个维度，0为通道，1为行，2为列
+   * @param output_view 输入的形状使置换不改变元素在内存中的顺序(被移动的维度大小为1)，
+   * 此时输出直接是输入上的视图，由GetInstance根据输入的形状确定
+   */
+  explicit PermuteLayer(std::vector<uint32_t> axes, bool output_view = false);
+
+  /**
+   * 输出最内层(行)来自输入的行时按连续的列拷贝，否则对输入的行和输出的行所在的两个维度
+   * 分块转置，第三个维度在外层循环
+   */
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  std::string kernel_name() const override;
+
+  bool output_is_view() const override;
+
+  /**
+   * 判断置换是否保持元素在内存中的顺序
+   * @param axes 置换的维度
+   * @param shapes 输入的通道数、行数和列数
+   * @return 是否保持内存中的顺序
+   */
+  static bool KeepsMemoryOrder(const std::vector<uint32_t> &axes,
+                               const std::vector<uint32_t> &shapes);
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &permute_layer);
+
+ private:
+  std::vector<uint32_t> axes_;
+  bool output_view_ = false;
+};
+
+class ChannelShuffleLayer : public NonParamLayer {
+ public:
+  /**
+   * @param groups 分组的数量，输出的第p * groups + q个通道来自输入的第q * (channels / groups) + p个通道
+   * @param output_view 分组数为1或者等于通道数时通道顺序不变，输出直接是输入上的视图
+   */
+  explicit ChannelShuffleLayer(uint32_t groups, bool output_view = false);
+
+  /**
+   * 每个通道在内存中是连续的，通道重排按整个通道拷贝
+   */
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  std::string kernel_name() const override;
+
+  bool output_is_view() const override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &channel_shuffle_layer);
+
+ private:
+  uint32_t groups_ = 1;
+  bool output_view_ = false;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_PERMUTE_HPP_
@@ -21,6 +21,7 @@
 
 // Created by fss on 22-11-18.
 #include "relu.hpp"
+#include <utility>
 #include "layer/abstract/layer_factory.hpp"
 
 namespace kuiper_infer {
@@ -74,9 +75,12 @@ InferStatus ReluLayer::Forward(
     CHECK(output->shapes() == input->shapes())
             << "The input and output tensor shapes of the relu layer do not match "
             << i << " th";
+    // 先取输出的指针，数据共享时只在这里拷贝一次，输入和输出可能是同一个张量
+    float *output_ptr = output->raw_ptr();
+    const float *input_ptr = std::as_const(*input).data().memptr();
     for (uint32_t j = 0; j < input->size(); ++j) {
-      float value = input->index(j);
-      output->index(j) = value > 0.f ? value : 0.f;
+      const float value = input_ptr[j];
+      output_ptr[j] = value > 0.f ? value : 0.f;
     }
   }
   return InferStatus::kInferSuccess;
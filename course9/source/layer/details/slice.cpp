@@ -0,0 +1,271 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#include "slice.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "layer/abstract/layer_factory.hpp"
+
+namespace kuiper_infer {
+/// 输出元素数量超过该值时按通道多线程拷贝
+static constexpr uint64_t kSliceParallelElements = 1 << 16;
+
+SliceLayer::SliceLayer(uint32_t axis, int32_t start, int32_t end, int32_t step)
+    : NonParamLayer("Slice"),
+      axis_(axis),
+      start_(start),
+      end_(end),
+      step_(step) {
+  CHECK(axis_ < 3) << "The axis of the slice layer should be less than 3";
+  CHECK(step_ > 0) << "The step of the slice layer should be positive";
+}
+
+bool SliceLayer::output_is_view() const { return axis_ == 0 && step_ == 1; }
+
+std::string SliceLayer::kernel_name() const {
+  if (output_is_view()) {
+    return "channel_view";
+  }
+  return step_ == 1 && axis_ == 2 ? "contiguous_copy" : "strided_copy";
+}
+
+/**
+ * 把切片的起止位置规整到[0, size]之间
+ * @return 切片的元素数量
+ */
+static uint32_t NormalizeSlice(int32_t size, int32_t step, int32_t& start,
+                               int32_t& end) {
+  if (start < 0) {
+    start += size;
+  }
+  if (end < 0) {
+    end += size;
+  }
+  start = std::clamp(start, 0, size);
+  end = std::clamp(end, 0, size);
+  if (start >= end) {
+    return 0;
+  }
+  return uint32_t((end - start + step - 1) / step);
+}
+
+InferStatus SliceLayer::Forward(
+    const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+    std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the slice layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the slice layer "
+                  "do not match";
+    return InferStatus::kInferFailedInputOutSizeMatchError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR) << "The input tensor array in the slice layer has an empty "
+                    "tensor "
+                 << i << " th";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+
+    const uint32_t channels = input->channels();
+    const uint32_t rows = input->rows();
+    const uint32_t cols = input->cols();
+    const uint32_t axis_size =
+        axis_ == 0 ? channels : (axis_ == 1 ? rows : cols);
+    int32_t start = start_;
+    int32_t end = end_;
+    const uint32_t extent =
+        NormalizeSlice(int32_t(axis_size), step_, start, end);
+    if (extent == 0) {
+      LOG(ERROR) << "The slice [" << start_ << ", " << end_
+                 << ") of the slice layer is empty along axis " << axis_;
+      return InferStatus::kInferFailedShapeParameterError;
+    }
+
+    const uint32_t output_channels = axis_ == 0 ? extent : channels;
+    const uint32_t output_rows = axis_ == 1 ? extent : rows;
+    const uint32_t output_cols = axis_ == 2 ? extent : cols;
+    // 输出保持输入的维度数，只替换切片所在的维度
+    std::vector<uint32_t> output_shapes = input->raw_shapes();
+    const int32_t raw_axis = int32_t(output_shapes.size()) - 3 + int32_t(axis_);
+    if (raw_axis >= 0) {
+      output_shapes.at(raw_axis) = extent;
+    }
+
+    const uint32_t plane = rows * cols;
+    const float* input_ptr = std::as_const(*input).data().memptr();
+    sftensor output = outputs.at(i);
+    if (output_is_view()) {
+      // 通道是最外层的维度，连续的通道在内存中也是连续的
+      float* view_ptr = const_cast<float*>(input_ptr) + uint64_t(start) * plane;
+      if (output == nullptr || output->empty() ||
+          std::as_const(*output).data().memptr() != view_ptr ||
+          output->channels() != output_channels) {
+        outputs.at(i) = std::make_shared<Tensor<float>>(view_ptr, output_shapes);
+      }
+      continue;
+    }
+
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(output_shapes);
+      outputs.at(i) = output;
+    }
+    if (output->channels() != output_channels ||
+        output->rows() != output_rows || output->cols() != output_cols) {
+      LOG(ERROR) << "The output tensor shape of the slice layer do not match "
+                 << i << " th";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+
+    float* output_ptr = output->raw_ptr();
+    const uint32_t output_plane = output_rows * output_cols;
+    const uint32_t step = uint32_t(step_);
+    const uint32_t offset = uint32_t(start);
+    // 每个通道是列主序的矩阵，列是最小的连续内存段，按连续的内存段拷贝
+#pragma omp parallel for if (output->size() >= kSliceParallelElements)
+    for (uint32_t c = 0; c < output_channels; ++c) {
+      float* output_channel = output_ptr + uint64_t(c) * output_plane;
+      if (axis_ == 0) {
+        std::memcpy(output_channel,
+                    input_ptr + uint64_t(offset + c * step) * plane,
+                    sizeof(float) * plane);
+        continue;
+      }
+      const float* input_channel = input_ptr + uint64_t(c) * plane;
+      if (axis_ == 2) {
+        if (step == 1) {
+          std::memcpy(output_channel, input_channel + uint64_t(offset) * rows,
+                      sizeof(float) * output_plane);
+        } else {
+          for (uint32_t k = 0; k < output_cols; ++k) {
+            std::memcpy(output_channel + uint64_t(k) * rows,
+                        input_channel + uint64_t(offset + k * step) * rows,
+                        sizeof(float) * rows);
+          }
+        }
+        continue;
+      }
+      for (uint32_t w = 0; w < cols; ++w) {
+        const float* input_col = input_channel + uint64_t(w) * rows + offset;
+        float* output_col = output_channel + uint64_t(w) * output_rows;
+        if (step == 1) {
+          std::memcpy(output_col, input_col, sizeof(float) * output_rows);
+        } else {
+          for (uint32_t k = 0; k < output_rows; ++k) {
+            output_col[k] = input_col[k * step];
+          }
+        }
+      }
+    }
+  }
+  return InferStatus::kInferSuccess;
+}
+
+/**
+ * 读取切片参数，兼容单个的dim/start/end/step和只有一个元素的dims/starts/ends/steps
+ */
+static bool GetSliceParameter(const std::map<std::string,
+                                             std::shared_ptr<RuntimeParameter>>&
+                                  params,
+                              const std::string& name,
+                              const std::string& array_name, int32_t& value) {
+  if (params.find(name) != params.end()) {
+    auto parameter =
+        std::dynamic_pointer_cast<RuntimeParameterInt>(params.at(name));
+    if (parameter == nullptr) {
+      return false;
+    }
+    value = parameter->value;
+    return true;
+  }
+  if (params.find(array_name) != params.end()) {
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterIntArray>(
+        params.at(array_name));
+    if (parameter == nullptr || parameter->value.size() != 1) {
+      return false;
+    }
+    value = parameter->value.front();
+    return true;
+  }
+  return false;
+}
+
+ParseParameterAttrStatus SliceLayer::GetInstance(
+    const std::shared_ptr<RuntimeOperator>& op,
+    std::shared_ptr<Layer>& slice_layer) {
+  CHECK(op != nullptr) << "Slice operator is nullptr";
+  const auto& params = op->params;
+  int32_t dim = 0;
+  if (!GetSliceParameter(params, "dim", "dims", dim)) {
+    LOG(ERROR) << "Can not find the dim parameter of the slice layer";
+    return ParseParameterAttrStatus::kParameterMissingDim;
+  }
+  int32_t start = 0;
+  int32_t end = 0;
+  if (!GetSliceParameter(params, "start", "starts", start) ||
+      !GetSliceParameter(params, "end", "ends", end)) {
+    LOG(ERROR) << "Can not find the start or end parameter of the slice layer";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+  int32_t step = 1;
+  if ((params.find("step") != params.end() ||
+       params.find("steps") != params.end()) &&
+      !GetSliceParameter(params, "step", "steps", step)) {
+    LOG(ERROR) << "The step parameter of the slice layer is wrong";
+    return ParseParameterAttrStatus::kParameterMissingStride;
+  }
+  if (step <= 0) {
+    LOG(ERROR) << "Only positive steps are supported in the slice layer";
+    return ParseParameterAttrStatus::kParameterMissingStride;
+  }
+
+  // pnnx的维度包含批次维度，张量的维度向右对齐到通道、行和列
+  if (op->input_operands_seq.empty()) {
+    LOG(ERROR) << "The input operand of the slice layer is empty";
+    return ParseParameterAttrStatus::kParameterMissingShape;
+  }
+  const int32_t rank = int32_t(op->input_operands_seq.front()->shapes.size());
+  if (dim < 0) {
+    dim += rank;
+  }
+  if (dim <= 0 || dim >= rank || rank - dim > 3) {
+    LOG(ERROR) << "The slice layer do not support the dim " << dim
+               << " of a rank " << rank << " tensor";
+    return ParseParameterAttrStatus::kParameterMissingDim;
+  }
+  const uint32_t axis = uint32_t(3 - (rank - dim));
+  slice_layer = std::make_shared<SliceLayer>(axis, start, end, step);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kSliceGetInstance("Tensor.slice",
+                                         SliceLayer::GetInstance);
+
+}  // namespace kuiper_infer
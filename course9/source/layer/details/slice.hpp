@@ -0,0 +1,63 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-14.
+
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_SLICE_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_SLICE_HPP_
+#include "layer/abstract/non_param_layer.hpp"
+
+namespace kuiper_infer {
+class SliceLayer : public NonParamLayer {
+ public:
+  /**
+   * @param axis 切片所在的张量维度，0为通道，1为行，2为列
+   * @param start 切片的起始位置，负数表示从末尾计数
+   * @param end 切片的结束位置(不包含)，负数表示从末尾计数，超出范围时截断
+   * @param step 切片的步长
+   */
+  explicit SliceLayer(uint32_t axis, int32_t start, int32_t end,
+                      int32_t step = 1);
+
+  /**
+   * 沿通道且步长为1的切片是输入中一段连续的内存，输出直接是输入上的视图，不拷贝数据；
+   * 其他的切片按连续的内存段拷贝到输出中
+   */
+  InferStatus Forward(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  std::string kernel_name() const override;
+
+  bool output_is_view() const override;
+
+  static ParseParameterAttrStatus GetInstance(
+      const std::shared_ptr<RuntimeOperator> &op,
+      std::shared_ptr<Layer> &slice_layer);
+
+ private:
+  uint32_t axis_ = 0;
+  int32_t start_ = 0;
+  int32_t end_ = 0;
+  int32_t step_ = 1;
+};
+}  // namespace kuiper_infer
+#endif  // KUIPER_INFER_SOURCE_LAYER_DETAILS_SLICE_HPP_
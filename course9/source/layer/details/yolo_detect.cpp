@@ -97,12 +97,20 @@ InferStatus YoloDetectLayer::Forward(
     CHECK(stage_output.size() == batch_size)
             << "The number of stage output in the yolo detect layer should be "
                "equal to batch size";
-    stage_outputs.at(stage) = stage_output;
+    stage_outputs.at(stage) = std::move(stage_output);
+  }
+
+  // 各阶段卷积的输出和拼接用的f1都是每次推理临时申请的
+  uint64_t workspace_bytes = 0;
+  for (const std::vector<sftensor>& stage_output : stage_outputs) {
+    for (const sftensor& output : stage_output) {
+      workspace_bytes += uint64_t(output->size()) * sizeof(float);
+    }
   }
 
   uint32_t concat_rows = 0;
   for (uint32_t stage = 0; stage < stages; ++stage) {
-    const std::vector<sftensor> stage_output = stage_outputs.at(stage);
+    const std::vector<sftensor>& stage_output = stage_outputs.at(stage);
     const uint32_t nx = stage_output.front()->rows();
     const uint32_t ny = stage_output.front()->cols();
     for (uint32_t i = 0; i < stage_output.size(); ++i) {
@@ -144,6 +152,7 @@ InferStatus YoloDetectLayer::Forward(
 
   uint32_t current_rows = 0;
   arma::fcube f1(concat_rows, classes_info, batch_size);
+  RecordWorkspace(workspace_bytes + uint64_t(f1.n_elem) * sizeof(float));
   for (std::shared_ptr<ftensor> stages_tensor : this->stages_tensors_) {
     f1.subcube(current_rows, 0, 0, current_rows + stages_tensor->rows() - 1,
                classes_info - 1, batch_size - 1) = stages_tensor->data();
@@ -168,6 +177,80 @@ void YoloDetectLayer::set_stage_tensors(
   this->stages_tensors_ = stage_tensors;
 }
 
+void YoloDetectLayer::Prepare() {
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    conv_layer->Prepare();
+  }
+}
+
+uint64_t YoloDetectLayer::constant_floats() const {
+  uint64_t floats = 0;
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    floats += conv_layer->constant_floats();
+  }
+  for (const auto *matrices : {&this->grids_, &this->anchor_grids_}) {
+    for (const arma::fmat &matrix : *matrices) {
+      floats += AlignConstant(matrix.n_elem);
+    }
+  }
+  return floats;
+}
+
+uint64_t YoloDetectLayer::MoveConstants(float *arena) {
+  // 各阶段的卷积不在计算图的节点中，由检测头移动它们的权重
+  uint64_t offset = 0;
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    offset += conv_layer->MoveConstants(arena + offset);
+  }
+  for (auto *matrices : {&this->grids_, &this->anchor_grids_}) {
+    std::vector<arma::fmat> frozen_matrices;
+    frozen_matrices.reserve(matrices->size());
+    for (const arma::fmat &matrix : *matrices) {
+      float *data = arena + offset;
+      std::copy(matrix.begin(), matrix.end(), data);
+      frozen_matrices.emplace_back(data, matrix.n_rows, matrix.n_cols, false,
+                                   true);
+      offset += AlignConstant(matrix.n_elem);
+    }
+    *matrices = std::move(frozen_matrices);
+  }
+  return offset;
+}
+
+void YoloDetectLayer::set_workspace_limit(uint64_t workspace_limit) {
+  Layer::set_workspace_limit(workspace_limit);
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    conv_layer->set_workspace_limit(workspace_limit);
+  }
+}
+
+uint64_t YoloDetectLayer::workspace_peak() const {
+  uint64_t workspace_peak = Layer::workspace_peak();
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    workspace_peak = std::max(workspace_peak, conv_layer->workspace_peak());
+  }
+  return workspace_peak;
+}
+
+uint64_t YoloDetectLayer::persistent_bytes() const {
+  uint64_t persistent_bytes = 0;
+  for (const sftensor &stages_tensor : this->stages_tensors_) {
+    if (stages_tensor != nullptr) {
+      persistent_bytes += uint64_t(stages_tensor->size()) * sizeof(float);
+    }
+  }
+  for (const auto &conv_layer : this->conv_layers_) {
+    CHECK(conv_layer != nullptr);
+    persistent_bytes += conv_layer->persistent_bytes();
+  }
+  return persistent_bytes;
+}
+
 ParseParameterAttrStatus YoloDetectLayer::GetInstance(
     const std::shared_ptr<RuntimeOperator> &op,
     std::shared_ptr<Layer> &yolo_detect_layer) {
@@ -45,6 +45,18 @@ class YoloDetectLayer : public Layer {
 
   void set_stage_tensors(const std::vector<sftensor>& stage_tensors);
 
+  void set_workspace_limit(uint64_t workspace_limit) override;
+
+  void Prepare() override;
+
+  uint64_t constant_floats() const override;
+
+  uint64_t MoveConstants(float* arena) override;
+
+  uint64_t workspace_peak() const override;
+
+  uint64_t persistent_bytes() const override;
+
  private:
   int32_t stages_ = 0;
   int32_t num_classes_ = 0;
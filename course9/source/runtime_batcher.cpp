@@ -0,0 +1,257 @@
+//
+// Created by fss on 23-9-14.
+//
+#include "runtime/runtime_batcher.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+namespace kuiper_infer {
+
+double BatchingReport::padding_ratio() const {
+  const uint64_t pixels = image_pixels + padding_pixels;
+  return pixels > 0 ? double(padding_pixels) / double(pixels) : 0.;
+}
+
+double BatchingReport::single_bucket_padding_ratio() const {
+  const uint64_t pixels = image_pixels + single_bucket_padding_pixels;
+  return pixels > 0 ? double(single_bucket_padding_pixels) / double(pixels)
+                    : 0.;
+}
+
+uint64_t LetterboxContentPixels(uint32_t height, uint32_t width,
+                                uint32_t bucket_h, uint32_t bucket_w) {
+  if (height == 0 || width == 0) {
+    return 0;
+  }
+  // 和Letterbox保持一致，只缩小不放大
+  const float ratio = std::min({float(bucket_h) / float(height),
+                                float(bucket_w) / float(width), 1.f});
+  const uint64_t content_h =
+      std::min(uint64_t(std::round(float(height) * ratio)), uint64_t(bucket_h));
+  const uint64_t content_w =
+      std::min(uint64_t(std::round(float(width) * ratio)), uint64_t(bucket_w));
+  return content_h * content_w;
+}
+
+RuntimeBatcher::RuntimeBatcher(std::string input_name, std::string output_name)
+    : input_name_(std::move(input_name)), output_name_(std::move(output_name)) {}
+
+RuntimeBatcher::~RuntimeBatcher() = default;
+
+bool RuntimeBatcher::AddBucket(uint32_t height, uint32_t width,
+                               const std::string &param_path,
+                               const std::string &bin_path) {
+  if (height == 0 || width == 0) {
+    LOG(ERROR) << "The size of bucket should be positive";
+    return false;
+  }
+  for (const Bucket &bucket : buckets_) {
+    if (bucket.height == height && bucket.width == width) {
+      LOG(ERROR) << "The bucket " << height << "x" << width
+                 << " has already been added";
+      return false;
+    }
+  }
+  Bucket bucket;
+  bucket.height = height;
+  bucket.width = width;
+  bucket.param_path = param_path;
+  bucket.bin_path = bin_path;
+  buckets_.push_back(std::move(bucket));
+  return true;
+}
+
+void RuntimeBatcher::set_memory_budget(uint64_t memory_budget) {
+  this->memory_budget_ = memory_budget;
+}
+
+int32_t RuntimeBatcher::SelectBucket(uint32_t height, uint32_t width) const {
+  if (buckets_.empty() || height == 0 || width == 0) {
+    return -1;
+  }
+  std::vector<float> ratios;
+  float max_ratio = 0.f;
+  for (const Bucket &bucket : buckets_) {
+    const float ratio = std::min({float(bucket.height) / float(height),
+                                  float(bucket.width) / float(width), 1.f});
+    ratios.push_back(ratio);
+    max_ratio = std::max(max_ratio, ratio);
+  }
+
+  int32_t selected = -1;
+  for (uint32_t i = 0; i < buckets_.size(); ++i) {
+    if (ratios.at(i) < max_ratio * (1.f - 1e-6f)) {
+      continue;
+    }
+    const uint64_t area = uint64_t(buckets_.at(i).height) * buckets_.at(i).width;
+    if (selected < 0 ||
+        area < uint64_t(buckets_.at(selected).height) * buckets_.at(selected).width) {
+      selected = int32_t(i);
+    }
+  }
+  return selected;
+}
+
+RuntimeGraph *RuntimeBatcher::BucketGraph(Bucket &bucket) {
+  if (bucket.graph != nullptr) {
+    return bucket.graph.get();
+  }
+  auto graph =
+      std::make_unique<RuntimeGraph>(bucket.param_path, bucket.bin_path);
+  graph->set_memory_budget(memory_budget_);
+  if (!graph->Build(input_name_, output_name_)) {
+    LOG(ERROR) << "Build the graph of bucket " << bucket.param_path
+               << " failed, the memory budget may be too small";
+    return nullptr;
+  }
+
+  std::shared_ptr<RuntimeOperator> input_op;
+  for (const auto &op : graph->operators()) {
+    if (op->name == input_name_) {
+      input_op = op;
+      break;
+    }
+  }
+  if (input_op == nullptr || input_op->output_operands == nullptr) {
+    LOG(ERROR) << "Can not find the input operator " << input_name_ << " in "
+               << bucket.param_path;
+    return nullptr;
+  }
+  const std::vector<int32_t> &shapes = input_op->output_operands->shapes;
+  if (shapes.size() != 4 || shapes.at(0) <= 0 ||
+      shapes.at(2) != int32_t(bucket.height) ||
+      shapes.at(3) != int32_t(bucket.width)) {
+    LOG(ERROR) << "The input shape of " << bucket.param_path
+               << " does not match the bucket " << bucket.height << "x"
+               << bucket.width;
+    return nullptr;
+  }
+  bucket.batch_size = uint32_t(shapes.front());
+  bucket.graph = std::move(graph);
+  return bucket.graph.get();
+}
+
+std::vector<sftensor> RuntimeBatcher::Forward(
+    const std::vector<BatchRequest> &requests,
+    const BucketPreprocess &preprocess) {
+  report_ = BatchingReport();
+  if (buckets_.empty()) {
+    LOG(ERROR) << "No resolution bucket has been added";
+    return {};
+  }
+  CHECK(preprocess != nullptr) << "The preprocess function is empty";
+
+  const auto start = std::chrono::steady_clock::now();
+  uint32_t largest = 0;
+  for (uint32_t i = 1; i < buckets_.size(); ++i) {
+    if (uint64_t(buckets_.at(i).height) * buckets_.at(i).width >
+        uint64_t(buckets_.at(largest).height) * buckets_.at(largest).width) {
+      largest = i;
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> assignments(buckets_.size());
+  report_.buckets.resize(buckets_.size());
+  for (uint32_t i = 0; i < requests.size(); ++i) {
+    const BatchRequest &request = requests.at(i);
+    const int32_t bucket_index = SelectBucket(request.height, request.width);
+    if (bucket_index < 0) {
+      LOG(ERROR) << "Reject the request " << i << ", no bucket matches its size "
+                 << request.height << "x" << request.width;
+      report_.rejected += 1;
+      continue;
+    }
+    const Bucket &bucket = buckets_.at(bucket_index);
+    assignments.at(bucket_index).push_back(i);
+
+    BucketReport &bucket_report = report_.buckets.at(bucket_index);
+    const uint64_t content = LetterboxContentPixels(
+        request.height, request.width, bucket.height, bucket.width);
+    bucket_report.requests += 1;
+    bucket_report.image_pixels += content;
+    bucket_report.padding_pixels +=
+        uint64_t(bucket.height) * bucket.width - content;
+
+    const Bucket &largest_bucket = buckets_.at(largest);
+    report_.single_bucket_padding_pixels +=
+        uint64_t(largest_bucket.height) * largest_bucket.width -
+        LetterboxContentPixels(request.height, request.width,
+                               largest_bucket.height, largest_bucket.width);
+  }
+
+  std::vector<sftensor> outputs(requests.size());
+  for (uint32_t b = 0; b < buckets_.size(); ++b) {
+    Bucket &bucket = buckets_.at(b);
+    BucketReport &bucket_report = report_.buckets.at(b);
+    bucket_report.height = bucket.height;
+    bucket_report.width = bucket.width;
+    const std::vector<uint32_t> &indices = assignments.at(b);
+    if (indices.empty()) {
+      bucket_report.batch_size = bucket.batch_size;
+      continue;
+    }
+
+    // 构建失败的桶拒绝分到该桶的所有请求，输出为空，其余的桶照常执行
+    RuntimeGraph *graph = BucketGraph(bucket);
+    if (graph == nullptr) {
+      LOG(ERROR) << "Reject " << indices.size() << " requests of the bucket "
+                 << bucket.height << "x" << bucket.width;
+      report_.rejected += indices.size();
+      bucket_report.requests = 0;
+      bucket_report.image_pixels = 0;
+      bucket_report.padding_pixels = 0;
+      continue;
+    }
+    bucket_report.batch_size = bucket.batch_size;
+    for (uint32_t offset = 0; offset < indices.size();
+         offset += bucket.batch_size) {
+      const uint32_t count =
+          std::min(bucket.batch_size, uint32_t(indices.size()) - offset);
+      std::vector<sftensor> inputs;
+      inputs.reserve(bucket.batch_size);
+      for (uint32_t i = 0; i < count; ++i) {
+        inputs.push_back(
+            preprocess(indices.at(offset + i), bucket.height, bucket.width));
+      }
+      // 计算图的批次大小是固定的，最后一个批次不满时重复最后一个输入，结果丢弃
+      while (inputs.size() < bucket.batch_size) {
+        inputs.push_back(inputs.back());
+        bucket_report.empty_slots += 1;
+      }
+
+      const auto forward_start = std::chrono::steady_clock::now();
+      const std::vector<sftensor> &batch_outputs =
+          graph->Forward(inputs, false);
+      bucket_report.forward_ms +=
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - forward_start)
+              .count();
+      bucket_report.batches += 1;
+      CHECK(batch_outputs.size() == bucket.batch_size);
+      // 计算图的输出在下一次Forward时会被覆盖，需要拷贝出来
+      for (uint32_t i = 0; i < count; ++i) {
+        outputs.at(indices.at(offset + i)) = TensorClone(batch_outputs.at(i));
+      }
+    }
+  }
+
+  for (const BucketReport &bucket_report : report_.buckets) {
+    report_.requests += bucket_report.requests;
+    report_.image_pixels += bucket_report.image_pixels;
+    report_.padding_pixels += bucket_report.padding_pixels;
+  }
+  report_.elapsed_ms = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  if (report_.elapsed_ms > 0) {
+    report_.throughput = double(report_.requests) / report_.elapsed_ms * 1e3;
+  }
+  return outputs;
+}
+
+const BatchingReport &RuntimeBatcher::report() const { return report_; }
+
+}  // namespace kuiper_infer
@@ -0,0 +1,736 @@
+//
+// Created by fss on 23-9-13.
+//
+
+#include "runtime/runtime_codegen.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stack>
+#include <utility>
+#include "parser/parse_expression.hpp"
+#include "runtime/codegen_kernels.hpp"
+#include "runtime/runtime_ir.hpp"
+
+namespace kuiper_infer {
+
+/// 权重和中间结果的偏移按16个float(64字节)对齐
+static constexpr uint64_t kCodegenAlignFloats = 16;
+
+static uint64_t AlignSize(uint64_t size) {
+  return (size + kCodegenAlignFloats - 1) / kCodegenAlignFloats *
+         kCodegenAlignFloats;
+}
+
+template <typename P>
+static std::shared_ptr<P> FindParameter(
+    const std::shared_ptr<RuntimeOperator> &op, const std::string &name) {
+  const auto &param = op->params.find(name);
+  if (param == op->params.end()) {
+    LOG(ERROR) << "Can not find the parameter " << name << " in " << op->name;
+    return nullptr;
+  }
+  auto value = std::dynamic_pointer_cast<P>(param->second);
+  if (value == nullptr) {
+    LOG(ERROR) << "The parameter " << name << " in " << op->name
+               << " has a wrong type";
+  }
+  return value;
+}
+
+/**
+ * 读取一对整数参数，例如卷积核的大小和步长
+ */
+static bool FindIntPair(const std::shared_ptr<RuntimeOperator> &op,
+                        const std::string &name, int32_t &first,
+                        int32_t &second) {
+  const auto &param = FindParameter<RuntimeParameterIntArray>(op, name);
+  if (param == nullptr || param->value.size() != 2) {
+    return false;
+  }
+  first = param->value.at(0);
+  second = param->value.at(1);
+  return true;
+}
+
+/**
+ * 返回形状(1, C, H, W)去掉批次后的字符串，例如3x640x640
+ */
+static std::string ShapeString(const std::vector<int32_t> &shapes) {
+  std::ostringstream shape;
+  for (uint32_t i = 1; i < shapes.size(); ++i) {
+    shape << (i == 1 ? "" : "x") << shapes.at(i);
+  }
+  return shape.str();
+}
+
+static uint64_t ShapeSize(const std::vector<int32_t> &shapes) {
+  uint64_t size = 1;
+  for (uint32_t i = 1; i < shapes.size(); ++i) {
+    size *= uint64_t(shapes.at(i));
+  }
+  return size;
+}
+
+static std::string FloatLiteral(float value) {
+  std::ostringstream literal;
+  literal << std::showpoint << std::setprecision(9) << value << "f";
+  return literal.str();
+}
+
+static bool IsIdentifier(const std::string &name) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front()))) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  });
+}
+
+RuntimeCodegen::RuntimeCodegen(std::string param_path, std::string bin_path)
+    : param_path_(std::move(param_path)), bin_path_(std::move(bin_path)) {}
+
+const CodegenReport &RuntimeCodegen::report() const { return this->report_; }
+
+std::string RuntimeCodegen::AppendWeight(
+    const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+    uint64_t expect_size) {
+  const auto &attr = op->attribute.find(name);
+  if (attr == op->attribute.end() || attr->second->weight_data.empty()) {
+    LOG(ERROR) << "Can not find the attribute " << name << " in " << op->name;
+    return "";
+  }
+  const std::vector<float> &weight = attr->second->get<float>();
+  if (weight.size() != expect_size) {
+    LOG(ERROR) << "The attribute " << name << " in " << op->name << " has "
+               << weight.size() << " values, but " << expect_size
+               << " are expected";
+    return "";
+  }
+  const uint64_t offset = weights_.size();
+  weights_.insert(weights_.end(), weight.begin(), weight.end());
+  weights_.resize(AlignSize(weights_.size()), 0.f);
+  return "weights + " + std::to_string(offset);
+}
+
+std::string RuntimeCodegen::DefineValue(const std::string &name, uint64_t size,
+                                        int32_t step) {
+  if (name == output_producer_) {
+    return "output";
+  }
+  CHECK(values_.find(name) == values_.end())
+      << "The value " << name << " has been defined";
+  CodegenValue value;
+  value.size = size;
+  value.first_use = step;
+  value.last_use = step;
+  value.pointer = "arena + kValue" + std::to_string(value_order_.size());
+  values_.insert({name, value});
+  value_order_.push_back(name);
+  report_.unplanned_bytes += size * sizeof(float);
+  return value.pointer;
+}
+
+std::string RuntimeCodegen::UseValue(const std::string &name, int32_t step) {
+  if (name == input_name_) {
+    return "input";
+  }
+  if (name == output_producer_) {
+    return "output";
+  }
+  CodegenValue &value = values_.at(name);
+  value.last_use = std::max(value.last_use, step);
+  return value.pointer;
+}
+
+uint64_t RuntimeCodegen::PlanArena() {
+  // 从大到小依次放置，每个结果放在和它生命周期重叠的结果之间第一个足够大的空隙中
+  std::vector<std::string> names = value_order_;
+  std::stable_sort(names.begin(), names.end(),
+                   [this](const std::string &a, const std::string &b) {
+                     return values_.at(a).size > values_.at(b).size;
+                   });
+  std::vector<const CodegenValue *> placed;
+  uint64_t arena_size = 0;
+  for (const std::string &name : names) {
+    CodegenValue &value = values_.at(name);
+    std::vector<std::pair<uint64_t, uint64_t>> used;
+    for (const CodegenValue *other : placed) {
+      if (other->first_use <= value.last_use &&
+          value.first_use <= other->last_use) {
+        used.emplace_back(other->offset, other->offset + AlignSize(other->size));
+      }
+    }
+    std::sort(used.begin(), used.end());
+    uint64_t offset = 0;
+    for (const auto &[start, end] : used) {
+      if (offset + value.size <= start) {
+        break;
+      }
+      offset = std::max(offset, end);
+    }
+    value.offset = offset;
+    arena_size = std::max(arena_size, offset + AlignSize(value.size));
+    placed.push_back(&value);
+  }
+  return arena_size;
+}
+
+bool RuntimeCodegen::EmitOperator(const std::shared_ptr<RuntimeOperator> &op,
+                                  int32_t step) {
+  const std::string &type = op->type;
+  if (fused_activations_.find(op->name) != fused_activations_.end()) {
+    return true;
+  }
+  for (const auto &operand : op->input_operands_seq) {
+    if (operand->shapes.size() != 4 && type != "models.yolo.Detect") {
+      LOG(ERROR) << "Only the (1, C, H, W) inputs are supported in " << op->name;
+      return false;
+    }
+  }
+  const auto &output_shape = shapes_.find(op->name);
+  if (output_shape == shapes_.end()) {
+    LOG(ERROR) << "Can not find the output shape of " << op->name;
+    return false;
+  }
+  const std::vector<int32_t> &output_shapes = output_shape->second;
+  const uint64_t output_size = ShapeSize(output_shapes);
+
+  std::ostringstream line;
+  line << "  // " << op->name << ": " << type;
+  if (type == "nn.Conv2d") {
+    const std::vector<int32_t> &input_shapes =
+        op->input_operands_seq.front()->shapes;
+    const int32_t in_c = input_shapes.at(1);
+    const int32_t in_h = input_shapes.at(2);
+    const int32_t in_w = input_shapes.at(3);
+    const auto &out_channels =
+        FindParameter<RuntimeParameterInt>(op, "out_channels");
+    const auto &groups = FindParameter<RuntimeParameterInt>(op, "groups");
+    const auto &bias = FindParameter<RuntimeParameterBool>(op, "bias");
+    const auto &padding_mode =
+        FindParameter<RuntimeParameterString>(op, "padding_mode");
+    int32_t kernel_h = 0, kernel_w = 0, stride_h = 0, stride_w = 0;
+    int32_t padding_h = 0, padding_w = 0, dilation_h = 0, dilation_w = 0;
+    if (out_channels == nullptr || groups == nullptr || bias == nullptr ||
+        padding_mode == nullptr ||
+        !FindIntPair(op, "kernel_size", kernel_h, kernel_w) ||
+        !FindIntPair(op, "stride", stride_h, stride_w) ||
+        !FindIntPair(op, "padding", padding_h, padding_w) ||
+        !FindIntPair(op, "dilation", dilation_h, dilation_w)) {
+      return false;
+    }
+    if (dilation_h != 1 || dilation_w != 1 || padding_mode->value != "zeros") {
+      LOG(ERROR) << "Only the zero padded convolution without dilation is "
+                    "supported in "
+                 << op->name;
+      return false;
+    }
+    const int32_t out_c = out_channels->value;
+    const int32_t out_h = (in_h + 2 * padding_h - kernel_h) / stride_h + 1;
+    const int32_t out_w = (in_w + 2 * padding_w - kernel_w) / stride_w + 1;
+    if (output_shapes != std::vector<int32_t>{1, out_c, out_h, out_w} ||
+        in_c % groups->value != 0 || out_c % groups->value != 0) {
+      LOG(ERROR) << "The output shape of " << op->name << " is wrong";
+      return false;
+    }
+
+    const std::string &weight = AppendWeight(
+        op, "weight",
+        uint64_t(out_c) * (in_c / groups->value) * kernel_h * kernel_w);
+    const std::string &bias_weight =
+        bias->value ? AppendWeight(op, "bias", out_c) : "nullptr";
+    if (weight.empty() || bias_weight.empty()) {
+      return false;
+    }
+
+    // 唯一的后继是激活函数时把激活函数融合到卷积中，卷积直接写入激活函数的输出
+    std::string output_name = op->name;
+    std::string activation = "Activation::kNone";
+    if (op->output_names.size() == 1) {
+      const auto &next_op = operators_.at(op->output_names.front());
+      if (next_op->input_operands_seq.size() == 1 &&
+          (next_op->type == "nn.SiLU" || next_op->type == "nn.ReLU")) {
+        output_name = next_op->name;
+        activation = next_op->type == "nn.SiLU" ? "Activation::kSiLU"
+                                                : "Activation::kReLU";
+        fused_activations_.insert(next_op->name);
+        report_.fused_activations += 1;
+        line << " + " << next_op->type;
+      }
+    }
+    workspace_size_ = std::max(
+        workspace_size_,
+        uint64_t(in_c / groups->value) * kernel_h * kernel_w * codegen::kConvTile);
+
+    const std::string &input = UseValue(op->input_operands_seq.front()->name, step);
+    const std::string &output = DefineValue(output_name, output_size, step);
+    line << ", " << ShapeString(input_shapes) << " -> "
+         << ShapeString(output_shapes) << "\n";
+    line << "  Conv2d<" << in_c << ", " << in_h << ", " << in_w << ", " << out_c
+         << ", " << kernel_h << ", " << kernel_w << ", " << stride_h << ", "
+         << stride_w << ", " << padding_h << ", " << padding_w << ", "
+         << groups->value << ", " << activation << ">(" << input << ", "
+         << weight << ", " << bias_weight << ", " << output
+         << ", workspace);";
+  } else if (type == "nn.SiLU" || type == "nn.ReLU") {
+    const std::string &input = UseValue(op->input_operands_seq.front()->name, step);
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << ", " << ShapeString(output_shapes) << "\n";
+    line << "  ActivateTensor<" << output_size << ", "
+         << (type == "nn.SiLU" ? "Activation::kSiLU" : "Activation::kReLU")
+         << ">(" << input << ", " << output << ");";
+  } else if (type == "nn.MaxPool2d") {
+    const std::vector<int32_t> &input_shapes =
+        op->input_operands_seq.front()->shapes;
+    const auto &ceil_mode = FindParameter<RuntimeParameterBool>(op, "ceil_mode");
+    int32_t kernel_h = 0, kernel_w = 0, stride_h = 0, stride_w = 0;
+    int32_t padding_h = 0, padding_w = 0, dilation_h = 0, dilation_w = 0;
+    if (ceil_mode == nullptr ||
+        !FindIntPair(op, "kernel_size", kernel_h, kernel_w) ||
+        !FindIntPair(op, "stride", stride_h, stride_w) ||
+        !FindIntPair(op, "padding", padding_h, padding_w) ||
+        !FindIntPair(op, "dilation", dilation_h, dilation_w)) {
+      return false;
+    }
+    const int32_t out_h =
+        (input_shapes.at(2) + 2 * padding_h - kernel_h) / stride_h + 1;
+    const int32_t out_w =
+        (input_shapes.at(3) + 2 * padding_w - kernel_w) / stride_w + 1;
+    if (ceil_mode->value || dilation_h != 1 || dilation_w != 1 ||
+        output_shapes !=
+            std::vector<int32_t>{1, input_shapes.at(1), out_h, out_w}) {
+      LOG(ERROR) << "Unsupported max pooling in " << op->name;
+      return false;
+    }
+    const std::string &input = UseValue(op->input_operands_seq.front()->name, step);
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << ", " << ShapeString(input_shapes) << " -> "
+         << ShapeString(output_shapes) << "\n";
+    line << "  MaxPool2d<" << input_shapes.at(1) << ", " << input_shapes.at(2)
+         << ", " << input_shapes.at(3) << ", " << kernel_h << ", " << kernel_w
+         << ", " << stride_h << ", " << stride_w << ", " << padding_h << ", "
+         << padding_w << ">(" << input << ", " << output << ");";
+  } else if (type == "nn.Upsample") {
+    const std::vector<int32_t> &input_shapes =
+        op->input_operands_seq.front()->shapes;
+    const auto &mode = FindParameter<RuntimeParameterString>(op, "mode");
+    const auto &scales =
+        FindParameter<RuntimeParameterFloatArray>(op, "scale_factor");
+    if (mode == nullptr || scales == nullptr || scales->value.size() != 2) {
+      return false;
+    }
+    const int32_t scale_h = int32_t(scales->value.at(0));
+    const int32_t scale_w = int32_t(scales->value.at(1));
+    if (mode->value != "nearest" || float(scale_h) != scales->value.at(0) ||
+        float(scale_w) != scales->value.at(1) ||
+        output_shapes != std::vector<int32_t>{1, input_shapes.at(1),
+                                              input_shapes.at(2) * scale_h,
+                                              input_shapes.at(3) * scale_w}) {
+      LOG(ERROR) << "Only the integer scaled nearest upsample is supported in "
+                 << op->name;
+      return false;
+    }
+    const std::string &input = UseValue(op->input_operands_seq.front()->name, step);
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << ", " << ShapeString(input_shapes) << " -> "
+         << ShapeString(output_shapes) << "\n";
+    line << "  UpsampleNearest<" << input_shapes.at(1) << ", "
+         << input_shapes.at(2) << ", " << input_shapes.at(3) << ", " << scale_h
+         << ", " << scale_w << ">(" << input << ", " << output << ");";
+  } else if (type == "torch.cat") {
+    const auto &dim = FindParameter<RuntimeParameterInt>(op, "dim");
+    if (dim == nullptr || (dim->value != 1 && dim->value != -3)) {
+      LOG(ERROR) << "Only the channel concatenation is supported in "
+                 << op->name;
+      return false;
+    }
+    // 按通道拼接时每个输入在输出中是连续的一段
+    std::vector<std::string> inputs;
+    for (const auto &operand : op->input_operands_seq) {
+      inputs.push_back(UseValue(operand->name, step));
+    }
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << ", " << ShapeString(output_shapes);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+      const uint64_t input_size = ShapeSize(op->input_operands_seq.at(i)->shapes);
+      line << "\n  Copy<" << input_size << ">(" << inputs.at(i) << ", "
+           << output << " + " << offset << ");";
+      offset += input_size;
+    }
+    if (offset != output_size) {
+      LOG(ERROR) << "The output shape of " << op->name << " is wrong";
+      return false;
+    }
+  } else if (type == "pnnx.Expression") {
+    const auto &expr = FindParameter<RuntimeParameterString>(op, "expr");
+    if (expr == nullptr) {
+      return false;
+    }
+    // 把逆波兰式展开为一个逐元素的表达式，所有运算在一次遍历中完成
+    ExpressionParser parser(expr->value);
+    std::stack<std::string> operands;
+    for (const auto &token_node : parser.Generate()) {
+      if (token_node->num_index >= 0) {
+        const uint32_t input_index = uint32_t(token_node->num_index);
+        if (input_index >= op->input_operands_seq.size()) {
+          LOG(ERROR) << "The input index " << input_index << " of "
+                     << op->name << " is out of range";
+          return false;
+        }
+        if (ShapeSize(op->input_operands_seq.at(input_index)->shapes) !=
+            output_size) {
+          LOG(ERROR) << "Broadcast is not supported in " << op->name;
+          return false;
+        }
+        operands.push("in" + std::to_string(input_index) + "[i]");
+      } else if (token_node->num_index == int(TokenType::TokenAdd) ||
+                 token_node->num_index == int(TokenType::TokenMul)) {
+        if (operands.size() < 2) {
+          return false;
+        }
+        const std::string right = operands.top();
+        operands.pop();
+        const std::string left = operands.top();
+        operands.pop();
+        const char *op_str =
+            token_node->num_index == int(TokenType::TokenAdd) ? " + " : " * ";
+        operands.push("(" + left + op_str + right + ")");
+      } else {
+        LOG(ERROR) << "Unsupported expression " << expr->value << " in "
+                   << op->name;
+        return false;
+      }
+    }
+    if (operands.size() != 1) {
+      return false;
+    }
+    std::vector<std::string> inputs;
+    for (const auto &operand : op->input_operands_seq) {
+      inputs.push_back(UseValue(operand->name, step));
+    }
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << " " << expr->value << ", " << ShapeString(output_shapes) << "\n  {";
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+      line << "\n    const float* in" << i << " = " << inputs.at(i) << ";";
+    }
+    line << "\n    Elementwise<" << output_size << ">(" << output
+         << ", [=](int i) { return " << operands.top() << "; });\n  }";
+  } else if (type == "models.yolo.Detect") {
+    const auto &strides_attr = op->attribute.find("pnnx_5");
+    if (strides_attr == op->attribute.end() ||
+        op->input_operands_seq.size() != 3 || output_shapes.size() != 3) {
+      LOG(ERROR) << "Only the three stages yolo detect head is supported in "
+                 << op->name;
+      return false;
+    }
+    const std::vector<float> &strides = strides_attr->second->get<float>();
+    const int32_t rows = output_shapes.at(1);
+    const int32_t classes_info = output_shapes.at(2);
+    // 和YoloDetectLayer一致，从小步长到大步长依次读取锚框和网格
+    const std::vector<int32_t> anchor_indexes{4, 2, 0};
+    const std::vector<int32_t> grid_indexes{6, 3, 1};
+    std::vector<std::string> inputs;
+    for (const auto &operand : op->input_operands_seq) {
+      inputs.push_back(UseValue(operand->name, step));
+    }
+    const std::string &output = DefineValue(op->name, output_size, step);
+    line << ", " << output_shapes.at(1) << "x" << output_shapes.at(2);
+
+    int32_t row_offset = 0;
+    for (uint32_t stage = 0; stage < 3; ++stage) {
+      const std::vector<int32_t> &input_shapes =
+          op->input_operands_seq.at(stage)->shapes;
+      const std::string &stage_name = std::to_string(stage);
+      const auto &weight_attr = op->attribute.find("m." + stage_name + ".weight");
+      if (input_shapes.size() != 4 || weight_attr == op->attribute.end() ||
+          weight_attr->second->shape.size() != 4) {
+        LOG(ERROR) << "Can not find the convolution of stage " << stage
+                   << " in " << op->name;
+        return false;
+      }
+      const int32_t in_c = input_shapes.at(1);
+      const int32_t in_h = input_shapes.at(2);
+      const int32_t in_w = input_shapes.at(3);
+      const int32_t out_c = weight_attr->second->shape.at(0);
+      const int32_t num_anchors = out_c / classes_info;
+      if (out_c % classes_info != 0 || weight_attr->second->shape.at(1) != in_c ||
+          weight_attr->second->shape.at(2) != 1 ||
+          weight_attr->second->shape.at(3) != 1) {
+        LOG(ERROR) << "The convolution of stage " << stage << " in " << op->name
+                   << " has a wrong shape";
+        return false;
+      }
+      const uint64_t grid_size = uint64_t(num_anchors) * in_h * in_w * 2;
+      const std::string &weight =
+          AppendWeight(op, "m." + stage_name + ".weight", uint64_t(out_c) * in_c);
+      const std::string &bias =
+          AppendWeight(op, "m." + stage_name + ".bias", out_c);
+      const std::string &grid = AppendWeight(
+          op, "pnnx_" + std::to_string(grid_indexes.at(stage)), grid_size);
+      const std::string &anchor_grid = AppendWeight(
+          op, "pnnx_" + std::to_string(anchor_indexes.at(stage)), grid_size);
+      if (weight.empty() || bias.empty() || grid.empty() ||
+          anchor_grid.empty()) {
+        return false;
+      }
+      workspace_size_ =
+          std::max(workspace_size_, uint64_t(in_c) * codegen::kConvTile);
+
+      const std::string &stage_output =
+          DefineValue(op->name + ".m." + stage_name,
+                      uint64_t(out_c) * in_h * in_w, step);
+      line << "\n  Conv2d<" << in_c << ", " << in_h << ", " << in_w << ", "
+           << out_c << ", 1, 1, 1, 1, 0, 0, 1, Activation::kNone>("
+           << inputs.at(stage) << ", " << weight << ", " << bias << ", "
+           << stage_output << ", workspace);";
+      line << "\n  DetectDecode<" << in_h << ", " << in_w << ", " << num_anchors
+           << ", " << classes_info << ">(" << stage_output << ", " << grid
+           << ", " << anchor_grid << ", " << FloatLiteral(strides.at(stage)) << ", "
+           << output << ", " << row_offset << ", " << rows << ");";
+      row_offset += num_anchors * in_h * in_w;
+    }
+    if (row_offset != rows) {
+      LOG(ERROR) << "The output shape of " << op->name << " is wrong";
+      return false;
+    }
+  } else {
+    LOG(ERROR) << "Unsupported operator " << op->name << " with type " << type;
+    return false;
+  }
+  lines_.push_back(line.str());
+  report_.kernels += 1;
+  return true;
+}
+
+bool RuntimeCodegen::Generate(const std::string &name,
+                              const std::string &source_path,
+                              const std::string &weight_path) {
+  if (!IsIdentifier(name)) {
+    LOG(ERROR) << "The name of generated code is not an identifier: " << name;
+    return false;
+  }
+  report_ = CodegenReport();
+  operators_.clear();
+  shapes_.clear();
+  input_name_.clear();
+  output_producer_.clear();
+  fused_activations_.clear();
+  values_.clear();
+  value_order_.clear();
+  weights_.clear();
+  lines_.clear();
+  workspace_size_ = 0;
+
+  RuntimeGraph graph(param_path_, bin_path_);
+  if (!graph.Init()) {
+    return false;
+  }
+  const auto &operators = graph.operators();
+  for (const auto &op : operators) {
+    operators_.insert({op->name, op});
+    for (const auto &operand : op->input_operands_seq) {
+      shapes_[operand->name] = operand->shapes;
+    }
+  }
+
+  // 按输入操作数确定执行顺序，pnnx中的节点一般已经是拓扑顺序
+  std::vector<std::shared_ptr<RuntimeOperator>> topo_operators;
+  std::map<std::string, uint32_t> in_degrees;
+  std::deque<std::shared_ptr<RuntimeOperator>> ready;
+  for (const auto &op : operators) {
+    in_degrees[op->name] = op->input_operands_seq.size();
+    if (op->input_operands_seq.empty()) {
+      ready.push_back(op);
+    }
+  }
+  while (!ready.empty()) {
+    const auto op = ready.front();
+    ready.pop_front();
+    topo_operators.push_back(op);
+    for (const auto &next_name : op->output_names) {
+      const auto &next_op = operators_.find(next_name);
+      if (next_op == operators_.end()) {
+        continue;
+      }
+      uint32_t &in_degree = in_degrees.at(next_name);
+      // 一个节点可能多次读取同一个输入
+      for (const auto &operand : next_op->second->input_operands_seq) {
+        if (operand->name == op->name && in_degree > 0) {
+          in_degree -= 1;
+        }
+      }
+      if (in_degree == 0) {
+        ready.push_back(next_op->second);
+        in_degree = UINT32_MAX;
+      }
+    }
+  }
+  if (topo_operators.size() != operators.size()) {
+    LOG(ERROR) << "The graph " << param_path_ << " has a cycle";
+    return false;
+  }
+
+  std::vector<int32_t> input_shapes;
+  std::vector<int32_t> output_shapes;
+  for (const auto &op : topo_operators) {
+    if (op->type == "pnnx.Input") {
+      if (!input_name_.empty()) {
+        LOG(ERROR) << "Only the graph with one input is supported";
+        return false;
+      }
+      input_name_ = op->name;
+      input_shapes = shapes_[op->name];
+    } else if (op->type == "pnnx.Output") {
+      if (!output_producer_.empty() || op->input_operands_seq.size() != 1) {
+        LOG(ERROR) << "Only the graph with one output is supported";
+        return false;
+      }
+      output_producer_ = op->input_operands_seq.front()->name;
+      output_shapes = op->input_operands_seq.front()->shapes;
+    }
+  }
+  if (input_shapes.size() != 4 || input_shapes.front() != 1 ||
+      output_shapes.empty() || output_shapes.front() != 1 ||
+      output_producer_ == input_name_) {
+    LOG(ERROR) << "Only the graph with a (1, C, H, W) input and a batch one "
+                  "output is supported";
+    return false;
+  }
+  for (const auto &[operand_name, shapes] : shapes_) {
+    for (const int32_t dim : shapes) {
+      if (dim <= 0) {
+        LOG(ERROR) << "The shape of " << operand_name << " is not static";
+        return false;
+      }
+    }
+  }
+
+  int32_t step = 0;
+  for (const auto &op : topo_operators) {
+    if (op->type == "pnnx.Input" || op->type == "pnnx.Output") {
+      continue;
+    }
+    if (!EmitOperator(op, step)) {
+      return false;
+    }
+    step += 1;
+  }
+
+  const uint64_t arena_size = PlanArena();
+  const uint64_t workspace_size = workspace_size_ * codegen::kMaxThreads;
+  report_.arena_bytes = arena_size * sizeof(float);
+  report_.workspace_bytes = workspace_size * sizeof(float);
+  report_.weight_bytes = weights_.size() * sizeof(float);
+
+  std::ofstream weight_file(weight_path,
+                            std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!weight_file.is_open()) {
+    LOG(ERROR) << "Can not open the weight file " << weight_path;
+    return false;
+  }
+  weight_file.write(reinterpret_cast<const char *>(weights_.data()),
+                    std::streamsize(report_.weight_bytes));
+  if (!weight_file.good()) {
+    LOG(ERROR) << "Write the weight file " << weight_path << " failed";
+    return false;
+  }
+
+  std::ostringstream source;
+  source << "// Generated by kuiper_infer::RuntimeCodegen from " << param_path_
+         << ", do not edit.\n"
+         << "#include <fcntl.h>\n"
+         << "#include <sys/mman.h>\n"
+         << "#include <sys/stat.h>\n"
+         << "#include <unistd.h>\n"
+         << "#include <cstdint>\n"
+         << "#include \"runtime/codegen_kernels.hpp\"\n\n"
+         << "namespace " << name << " {\n"
+         << "using namespace kuiper_infer::codegen;\n\n"
+         << "constexpr int kInputChannels = " << input_shapes.at(1) << ";\n"
+         << "constexpr int kInputRows = " << input_shapes.at(2) << ";\n"
+         << "constexpr int kInputCols = " << input_shapes.at(3) << ";\n"
+         << "constexpr uint64_t kOutputSize = " << ShapeSize(output_shapes)
+         << ";  // " << ShapeString(output_shapes) << "\n"
+         << "constexpr uint64_t kWeightBytes = " << report_.weight_bytes
+         << ";\n"
+         << "constexpr uint64_t kArenaFloats = " << std::max<uint64_t>(arena_size, 1)
+         << ";\n"
+         << "constexpr uint64_t kWorkspaceFloats = "
+         << std::max<uint64_t>(workspace_size, 1) << ";\n\n";
+  for (uint32_t i = 0; i < value_order_.size(); ++i) {
+    const std::string &value_name = value_order_.at(i);
+    source << "constexpr uint64_t kValue" << i << " = "
+           << values_.at(value_name).offset << ";  // " << value_name << "\n";
+  }
+  source << "\nalignas(64) static float arena[kArenaFloats];\n"
+         << "alignas(64) static float workspace[kWorkspaceFloats];\n"
+         << "static const float* weights = nullptr;\n\n"
+         << "void Unload() {\n"
+         << "  if (weights != nullptr) {\n"
+         << "    munmap(const_cast<float*>(weights), kWeightBytes);\n"
+         << "    weights = nullptr;\n"
+         << "  }\n"
+         << "}\n\n"
+         << "bool Load(const char* weight_path) {\n"
+         << "  Unload();\n"
+         << "  const int fd = open(weight_path, O_RDONLY);\n"
+         << "  if (fd < 0) {\n"
+         << "    return false;\n"
+         << "  }\n"
+         << "  struct stat weight_stat {};\n"
+         << "  if (fstat(fd, &weight_stat) != 0 ||\n"
+         << "      uint64_t(weight_stat.st_size) != kWeightBytes) {\n"
+         << "    close(fd);\n"
+         << "    return false;\n"
+         << "  }\n"
+         << "  void* data = mmap(nullptr, kWeightBytes, PROT_READ, MAP_PRIVATE, "
+            "fd, 0);\n"
+         << "  close(fd);\n"
+         << "  if (data == MAP_FAILED) {\n"
+         << "    return false;\n"
+         << "  }\n"
+         << "  weights = static_cast<const float*>(data);\n"
+         << "  return true;\n"
+         << "}\n\n"
+         << "void Forward(const float* input, float* output) {\n";
+  for (const std::string &line : lines_) {
+    source << line << "\n";
+  }
+  source << "}\n\n"
+         << "}  // namespace " << name << "\n\n"
+         << "extern \"C\" bool " << name << "_load(const char* weight_path) {\n"
+         << "  return " << name << "::Load(weight_path);\n"
+         << "}\n\n"
+         << "extern \"C\" void " << name << "_unload() { " << name
+         << "::Unload(); }\n\n"
+         << "extern \"C\" void " << name
+         << "_forward(const float* input, float* output) {\n"
+         << "  " << name << "::Forward(input, output);\n"
+         << "}\n";
+
+  std::ofstream source_file(source_path, std::ios::out | std::ios::trunc);
+  if (!source_file.is_open()) {
+    LOG(ERROR) << "Can not open the source file " << source_path;
+    return false;
+  }
+  source_file << source.str();
+  if (!source_file.good()) {
+    LOG(ERROR) << "Write the source file " << source_path << " failed";
+    return false;
+  }
+
+  LOG(INFO) << "Generate " << source_path << " with " << report_.kernels
+            << " kernels, fused activations: " << report_.fused_activations
+            << ", arena: " << report_.arena_bytes
+            << " bytes, outputs without reuse: " << report_.unplanned_bytes
+            << " bytes, weights: " << report_.weight_bytes << " bytes";
+  return true;
+}
+
+}  // namespace kuiper_infer
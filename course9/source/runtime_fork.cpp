@@ -0,0 +1,151 @@
+//
+// Created by fss on 23-9-14.
+//
+#include "runtime/runtime_fork.hpp"
+#include <glog/logging.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace kuiper_infer {
+
+/**
+ * 解析smaps中的一行，累加到对应的字段中
+ * @return 是否是内存占用的字段
+ */
+static bool ParseMemoryLine(const std::string &line, ProcessMemory &memory) {
+  static const std::map<std::string, uint64_t ProcessMemory::*> fields{
+      {"Rss:", &ProcessMemory::rss},
+      {"Pss:", &ProcessMemory::pss},
+      {"Shared_Clean:", &ProcessMemory::shared_clean},
+      {"Shared_Dirty:", &ProcessMemory::shared_dirty},
+      {"Private_Clean:", &ProcessMemory::private_clean},
+      {"Private_Dirty:", &ProcessMemory::private_dirty},
+  };
+  std::istringstream stream(line);
+  std::string key;
+  uint64_t value = 0;
+  if (!(stream >> key >> value)) {
+    return false;
+  }
+  const auto field = fields.find(key);
+  if (field == fields.end()) {
+    return false;
+  }
+  memory.*(field->second) += value;
+  return true;
+}
+
+bool ReadProcessMemory(int32_t pid, ProcessMemory &memory) {
+  const std::string process =
+      pid == 0 ? std::string("self") : std::to_string(pid);
+  std::ifstream file("/proc/" + process + "/smaps_rollup");
+  if (!file.is_open()) {
+    file.open("/proc/" + process + "/smaps");
+  }
+  if (!file.is_open()) {
+    LOG(ERROR) << "Can not open the smaps of process " << process;
+    return false;
+  }
+
+  memory = ProcessMemory();
+  std::string line;
+  while (std::getline(file, line)) {
+    ParseMemoryLine(line, memory);
+  }
+  return memory.rss > 0;
+}
+
+bool ReadRegionMemory(int32_t pid, uint64_t address, ProcessMemory &memory) {
+  const std::string process =
+      pid == 0 ? std::string("self") : std::to_string(pid);
+  std::ifstream file("/proc/" + process + "/smaps");
+  if (!file.is_open()) {
+    LOG(ERROR) << "Can not open the smaps of process " << process;
+    return false;
+  }
+
+  // 每个映射以"起始地址-结束地址 权限 ..."开头，之后是以冒号结尾的各个字段
+  memory = ProcessMemory();
+  bool found = false;
+  bool in_region = false;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    std::string range;
+    stream >> range;
+    const size_t dash = range.find('-');
+    if (!range.empty() && range.back() != ':' && dash != std::string::npos) {
+      if (found) {
+        break;
+      }
+      const uint64_t start = std::strtoull(range.c_str(), nullptr, 16);
+      const uint64_t end = std::strtoull(range.c_str() + dash + 1, nullptr, 16);
+      in_region = address >= start && address < end;
+      found = in_region;
+      continue;
+    }
+    if (in_region) {
+      ParseMemoryLine(line, memory);
+    }
+  }
+  if (!found) {
+    LOG(ERROR) << "Can not find the mapping of address " << std::hex << address
+               << " in process " << process;
+  }
+  return found;
+}
+
+std::vector<int32_t> ForkWorkers(uint32_t workers,
+                                 const std::function<int(uint32_t)> &worker) {
+  CHECK(worker != nullptr) << "The worker function is empty";
+  std::vector<int32_t> pids;
+  for (uint32_t i = 0; i < workers; ++i) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      LOG(ERROR) << "Fork worker " << i << " failed: " << std::strerror(errno);
+      break;
+    }
+    if (pid == 0) {
+      // 工作进程之间已经按进程并行，各自只用一个线程，
+      // 也避免使用父进程中可能已经创建、但在子进程中并不存在的OpenMP线程
+#ifdef _OPENMP
+      omp_set_num_threads(1);
+#endif
+      // 子进程不回到调用方，避免执行父进程中剩余的逻辑和析构
+      const int exit_code = worker(i);
+      google::FlushLogFiles(google::GLOG_INFO);
+      _exit(exit_code);
+    }
+    pids.push_back(int32_t(pid));
+  }
+  return pids;
+}
+
+bool WaitWorkers(const std::vector<int32_t> &pids) {
+  bool success = true;
+  for (const int32_t pid : pids) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid) {
+      LOG(ERROR) << "Wait worker " << pid << " failed: " << std::strerror(errno);
+      success = false;
+      continue;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      LOG(ERROR) << "Worker " << pid << " exited abnormally, status " << status;
+      success = false;
+    }
+  }
+  return success;
+}
+
+}  // namespace kuiper_infer
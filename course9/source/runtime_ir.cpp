@@ -1,11 +1,24 @@
 #include "runtime/runtime_ir.hpp"
 #include "status_code.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "data/tensor_util.hpp"
+#include "layer/details/identity.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <deque>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <utility>
 #include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace kuiper_infer {
 RuntimeGraph::RuntimeGraph(std::string param_path, std::string bin_path)
@@ -25,6 +38,49 @@ const std::string &RuntimeGraph::param_path() const {
 
 const std::string &RuntimeGraph::bin_path() const { return this->bin_path_; }
 
+void RuntimeGraph::set_memory_budget(uint64_t memory_budget) {
+  LOG_IF(WARNING, graph_state_ == GraphState::Complete)
+      << "The memory budget only takes effect before the graph is built";
+  this->memory_budget_ = memory_budget;
+}
+
+uint64_t RuntimeGraph::memory_budget() const { return this->memory_budget_; }
+
+void RuntimeGraph::set_schedule_beam_width(uint32_t beam_width) {
+  this->schedule_beam_width_ = beam_width;
+}
+
+uint32_t RuntimeGraph::schedule_beam_width() const {
+  return this->schedule_beam_width_;
+}
+
+void RuntimeGraph::set_fuse_activations(bool fuse_activations) {
+  LOG_IF(WARNING, graph_state_ == GraphState::Complete)
+      << "The activation fusion only takes effect before the graph is built";
+  this->fuse_activations_ = fuse_activations;
+}
+
+bool RuntimeGraph::fuse_activations() const { return this->fuse_activations_; }
+
+const RuntimeMemoryReport &RuntimeGraph::memory_report() const {
+  return this->memory_report_;
+}
+
+std::string RuntimeGraph::OperandProducerName(const pnnx::Operand *operand) {
+  CHECK(operand != nullptr && operand->producer != nullptr);
+  const pnnx::Operator *producer = operand->producer;
+  const std::vector<pnnx::Operand *> &outputs = producer->outputs;
+  if (outputs.size() <= 1) {
+    return producer->name;
+  }
+  // 有多个输出的节点被拆分为多个计算节点，每个输出对应一个
+  const auto iter = std::find(outputs.begin(), outputs.end(), operand);
+  CHECK(iter != outputs.end())
+      << "Operand " << operand->name << " is not an output of "
+      << producer->name;
+  return producer->name + "." + std::to_string(iter - outputs.begin());
+}
+
 void RuntimeGraph::InitGraphOperatorsInput(
     const std::vector<pnnx::Operand *> &inputs,
     const std::shared_ptr<RuntimeOperator> &runtime_operator) {
@@ -32,10 +88,10 @@ void RuntimeGraph::InitGraphOperatorsInput(
     if (!input) {
       continue;
     }
-    const pnnx::Operator *producer = input->producer;
+    const std::string &producer_name = OperandProducerName(input);
     std::shared_ptr<RuntimeOperand> runtime_operand =
         std::make_shared<RuntimeOperand>();
-    runtime_operand->name = producer->name;
+    runtime_operand->name = producer_name;
     runtime_operand->shapes = input->shape;
 
     switch (input->type) {
@@ -51,7 +107,7 @@ void RuntimeGraph::InitGraphOperatorsInput(
         LOG(FATAL) << "Unknown input operand type: " << input->type;
       }
     }
-    runtime_operator->input_operands.insert({producer->name, runtime_operand});
+    runtime_operator->input_operands.insert({producer_name, runtime_operand});
     runtime_operator->input_operands_seq.push_back(runtime_operand);
   }
 }
@@ -65,7 +121,15 @@ void RuntimeGraph::InitGraphOperatorsOutput(
     }
     const auto &consumers = output->consumers;
     for (const auto &c : consumers) {
-      runtime_operator->output_names.push_back(c->name);
+      if (c->outputs.size() <= 1) {
+        runtime_operator->output_names.push_back(c->name);
+        continue;
+      }
+      // 后继节点有多个输出时已经被拆分，每个拆分后的节点都是当前节点的后继
+      for (uint32_t i = 0; i < c->outputs.size(); ++i) {
+        runtime_operator->output_names.push_back(c->name + "." +
+                                                 std::to_string(i));
+      }
     }
   }
 }
@@ -137,6 +201,155 @@ void RuntimeGraph::InitGraphParams(
   }
 }
 
+void RuntimeGraph::FuseChannelShuffle() {
+  CHECK(graph_ != nullptr);
+  std::set<pnnx::Operator *> removed_ops;
+  std::set<pnnx::Operand *> removed_operands;
+  for (pnnx::Operator *op : graph_->ops) {
+    // x.view(b, g, c / g, h, w) -> transpose(1, 2) -> view(b, c, h, w)
+    if (op->type != "Tensor.view" || op->inputs.size() != 1 ||
+        op->outputs.size() != 1 || removed_ops.count(op)) {
+      continue;
+    }
+    const pnnx::Operand *input = op->inputs.front();
+    pnnx::Operand *grouped = op->outputs.front();
+    if (input->shape.size() != 4 || grouped->shape.size() != 5 ||
+        grouped->consumers.size() != 1) {
+      continue;
+    }
+    pnnx::Operator *transpose = grouped->consumers.front();
+    if (transpose->type != "torch.transpose" ||
+        transpose->outputs.size() != 1) {
+      continue;
+    }
+    const auto dim0 = transpose->params.find("dim0");
+    const auto dim1 = transpose->params.find("dim1");
+    if (dim0 == transpose->params.end() || dim1 == transpose->params.end() ||
+        std::min(dim0->second.i, dim1->second.i) != 1 ||
+        std::max(dim0->second.i, dim1->second.i) != 2) {
+      continue;
+    }
+    pnnx::Operand *transposed = transpose->outputs.front();
+    if (transposed->consumers.size() != 1) {
+      continue;
+    }
+    pnnx::Operator *restore = transposed->consumers.front();
+    if (restore->type != "Tensor.view" || restore->outputs.size() != 1 ||
+        restore->outputs.front()->shape != input->shape) {
+      continue;
+    }
+    const std::vector<int> &grouped_shape = grouped->shape;
+    if (grouped_shape.at(0) != input->shape.at(0) ||
+        grouped_shape.at(1) * grouped_shape.at(2) != input->shape.at(1) ||
+        grouped_shape.at(3) != input->shape.at(2) ||
+        grouped_shape.at(4) != input->shape.at(3)) {
+      continue;
+    }
+
+    // 第一个view节点改写为nn.ChannelShuffle，直接输出第二个view节点的输出
+    pnnx::Operand *output = restore->outputs.front();
+    op->type = "nn.ChannelShuffle";
+    op->params.clear();
+    op->params["groups"] = grouped_shape.at(1);
+    op->outputs = {output};
+    output->producer = op;
+    removed_ops.insert(transpose);
+    removed_ops.insert(restore);
+    removed_operands.insert(grouped);
+    removed_operands.insert(transposed);
+  }
+  if (removed_ops.empty()) {
+    return;
+  }
+
+  auto &ops = graph_->ops;
+  ops.erase(std::remove_if(ops.begin(), ops.end(),
+                           [&](pnnx::Operator *op) {
+                             return removed_ops.count(op) > 0;
+                           }),
+            ops.end());
+  auto &operands = graph_->operands;
+  operands.erase(std::remove_if(operands.begin(), operands.end(),
+                                [&](pnnx::Operand *operand) {
+                                  return removed_operands.count(operand) > 0;
+                                }),
+                 operands.end());
+  for (pnnx::Operator *op : removed_ops) {
+    delete op;
+  }
+  for (pnnx::Operand *operand : removed_operands) {
+    delete operand;
+  }
+  LOG(INFO) << "Fused " << removed_ops.size() / 2
+            << " view-transpose-view patterns into channel shuffles";
+}
+
+bool RuntimeGraph::InitSplitOperators(const pnnx::Operator *op) {
+  if (op->type != "torch.chunk" && op->type != "torch.split") {
+    LOG(ERROR) << "Unsupported operator with multiple outputs: " << op->type
+               << " " << op->name;
+    return false;
+  }
+  if (op->inputs.size() != 1 || op->inputs.front() == nullptr) {
+    LOG(ERROR) << "The " << op->type << " operator " << op->name
+               << " should have one input";
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = op->inputs.front()->shape;
+  const int32_t rank = int32_t(input_shape.size());
+  const auto dim_param = op->params.find("dim");
+  if (dim_param == op->params.end() || dim_param->second.type != 2) {
+    LOG(ERROR) << "Can not find the dim parameter of " << op->name;
+    return false;
+  }
+  int32_t dim = dim_param->second.i;
+  if (dim < 0) {
+    dim += rank;
+  }
+  if (dim <= 0 || dim >= rank) {
+    LOG(ERROR) << "The " << op->type << " operator " << op->name
+               << " can not split along the batch dim or dim " << dim;
+    return false;
+  }
+
+  // 每个输出拆分为一个Tensor.slice计算节点，区间由各个输出的形状依次累加得到
+  int32_t start = 0;
+  for (uint32_t i = 0; i < op->outputs.size(); ++i) {
+    pnnx::Operand *output = op->outputs.at(i);
+    if (output == nullptr || int32_t(output->shape.size()) != rank) {
+      LOG(ERROR) << "The output " << i << " of " << op->name
+                 << " has a wrong shape";
+      return false;
+    }
+    const int32_t end = start + output->shape.at(dim);
+    std::shared_ptr<RuntimeOperator> runtime_operator =
+        std::make_shared<RuntimeOperator>();
+    runtime_operator->name = op->name + "." + std::to_string(i);
+    runtime_operator->type = "Tensor.slice";
+    InitGraphOperatorsInput(op->inputs, runtime_operator);
+    InitGraphOperatorsOutput({output}, runtime_operator);
+    runtime_operator->params.insert(
+        {"dim", std::make_shared<RuntimeParameterInt>(dim)});
+    runtime_operator->params.insert(
+        {"start", std::make_shared<RuntimeParameterInt>(start)});
+    runtime_operator->params.insert(
+        {"end", std::make_shared<RuntimeParameterInt>(end)});
+    runtime_operator->params.insert(
+        {"step", std::make_shared<RuntimeParameterInt>(1)});
+    this->operators_.push_back(runtime_operator);
+    this->operators_maps_.insert({runtime_operator->name, runtime_operator});
+    this->pnnx_outputs_.push_back(output);
+    start = end;
+  }
+  if (start != input_shape.at(dim)) {
+    LOG(ERROR) << "The outputs of " << op->name << " cover " << start
+               << " of the " << input_shape.at(dim) << " elements in dim "
+               << dim;
+    return false;
+  }
+  return true;
+}
+
 bool RuntimeGraph::Init() {
   if (this->bin_path_.empty() || this->param_path_.empty()) {
     LOG(ERROR) << "The bin path or param path is empty";
@@ -151,6 +364,7 @@ bool RuntimeGraph::Init() {
     return false;
   }
 
+  this->FuseChannelShuffle();
   std::vector<pnnx::Operator *> operators = this->graph_->ops;
   if (operators.empty()) {
     LOG(ERROR) << "Can not read the layers' define";
@@ -159,10 +373,15 @@ bool RuntimeGraph::Init() {
 
   this->operators_.clear();
   this->operators_maps_.clear();
+  this->pnnx_outputs_.clear();
   for (const pnnx::Operator *op : operators) {
     if (!op) {
       LOG(ERROR) << "Meet the empty node";
       continue;
+    } else if (op->outputs.size() > 1) {
+      if (!InitSplitOperators(op)) {
+        return false;
+      }
     } else {
       std::shared_ptr<RuntimeOperator> runtime_operator =
           std::make_shared<RuntimeOperator>();
@@ -195,6 +414,8 @@ bool RuntimeGraph::Init() {
       }
       this->operators_.push_back(runtime_operator);
       this->operators_maps_.insert({runtime_operator->name, runtime_operator});
+      this->pnnx_outputs_.push_back(outputs.empty() ? nullptr
+                                                    : outputs.front());
     }
   }
 
@@ -256,8 +477,41 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(
   for (const auto& op : topo_operators_) {
     op->has_forward = false;
   }
+  executed_ = true;
+
+  const bool record_metrics = !metrics_name_.empty();
+  // 打开追踪时每次推理都计时，结束后再决定是否写入环形缓冲区，慢推理因此不会被漏掉
+  const bool record_trace = trace_enabled_;
+  const bool record_time = record_metrics || record_trace || recorder_ ||
+                           profile_enabled_ || first_forward_pending_;
+  uint64_t allocation_start = 0;
+  if (record_metrics) {
+    if (layer_metrics_.size() != topo_operators_.size()) {
+      this->InitMetrics();
+    }
+    model_metrics_->queue_depth.fetch_add(1, std::memory_order_relaxed);
+    allocation_start = Tensor<float>::allocation_count();
+  }
+  if (record_trace) {
+    if (trace_graph_id_ < 0) {
+      trace_graph_id_ =
+          RuntimeTracer::Instance().RegisterGraph(topo_operators_);
+    }
+    trace_spans_.assign(topo_operators_.size(), TraceSpan{0, -1});
+  }
+  if (profile_enabled_) {
+    if (op_profile_ns_.size() != topo_operators_.size()) {
+      op_profile_ns_.assign(topo_operators_.size(), 0);
+      profile_runs_ = 0;
+    }
+    profile_runs_ += 1;
+  }
+  const auto forward_start = record_time
+                                 ? std::chrono::steady_clock::now()
+                                 : std::chrono::steady_clock::time_point();
 
-  for (const auto& current_op : topo_operators_) {
+  for (uint32_t op_index = 0; op_index < topo_operators_.size(); ++op_index) {
+    const auto& current_op = topo_operators_.at(op_index);
     if (current_op->type == "pnnx.Input") {
       current_op->has_forward = true;
       ProbeNextLayer(current_op, inputs);
@@ -266,10 +520,35 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(
       CHECK(current_op->input_operands_seq.size() == 1);
       current_op->output_operands = current_op->input_operands_seq.front();
     } else {
+      const auto layer_start = record_time
+                                   ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point();
       InferStatus status = current_op->layer->Forward();
       CHECK(status == InferStatus::kInferSuccess)
               << current_op->layer->layer_name()
               << " layer forward failed, error code: " << int(status);
+      if (record_time) {
+        const int64_t layer_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - layer_start)
+                .count();
+        if (record_metrics) {
+          LayerTypeMetrics* layer_metrics = layer_metrics_.at(op_index);
+          layer_metrics->calls.fetch_add(1, std::memory_order_relaxed);
+          layer_metrics->nanoseconds.fetch_add(layer_ns,
+                                               std::memory_order_relaxed);
+        }
+        if (record_trace) {
+          TraceSpan& span = trace_spans_.at(op_index);
+          span.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              layer_start.time_since_epoch())
+                              .count();
+          span.duration_ns = layer_ns;
+        }
+        if (profile_enabled_) {
+          op_profile_ns_.at(op_index) += layer_ns;
+        }
+      }
       current_op->has_forward = true;
       ProbeNextLayer(current_op, current_op->output_operands->datas);
     }
@@ -279,6 +558,65 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(
     LOG_IF(FATAL, !op->has_forward)
             << "The operator: " << op->name << " has not been forward yet!";
   }
+  if (memory_budget_ > 0) {
+    this->UpdateMemoryReport();
+  }
+
+  const auto forward_end = record_time
+                               ? std::chrono::steady_clock::now()
+                               : std::chrono::steady_clock::time_point();
+  if (first_forward_pending_) {
+    first_forward_pending_ = false;
+    first_forward_ms_ = std::chrono::duration<double, std::milli>(
+                            forward_end - forward_start)
+                            .count();
+  }
+  if (recorder_ != nullptr) {
+    recorder_->Record(inputs,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          forward_start.time_since_epoch())
+                          .count(),
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          forward_end - forward_start)
+                          .count());
+  }
+
+  if (record_trace) {
+    const TraceSpan run_span{
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            forward_start.time_since_epoch())
+            .count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(forward_end -
+                                                             forward_start)
+            .count()};
+    const bool sampled =
+        trace_sample_every_ > 0 && trace_runs_ % trace_sample_every_ == 0;
+    const bool slow = trace_slow_threshold_ns_ > 0 &&
+                      run_span.duration_ns >= trace_slow_threshold_ns_;
+    trace_runs_ += 1;
+    if (sampled || slow) {
+      RuntimeTracer &tracer = RuntimeTracer::Instance();
+      tracer.Commit(uint32_t(trace_graph_id_), tracer.NextRunId(), run_span,
+                    trace_spans_, slow);
+    }
+  }
+
+  if (record_metrics) {
+    const uint32_t batch = inputs.size();
+    auto latency_iter = forward_latency_.find(batch);
+    if (latency_iter == forward_latency_.end()) {
+      latency_iter =
+          forward_latency_
+              .insert({batch, RuntimeMetrics::Instance().ForwardLatency(
+                                  metrics_name_, batch)})
+              .first;
+    }
+    latency_iter->second->Observe(
+        std::chrono::duration<double>(forward_end - forward_start).count());
+    model_metrics_->allocations.Observe(
+        double(Tensor<float>::allocation_count() - allocation_start));
+    model_metrics_->queue_depth.fetch_sub(1, std::memory_order_relaxed);
+  }
 
   if (operators_maps_.find(output_name_) != operators_maps_.end()) {
     const auto& output_op = operators_maps_.at(output_name_);
@@ -292,16 +630,502 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(
   }
 }
 
-void RuntimeGraph::Build(const std::string &input_name,
+void RuntimeGraph::BindInputs(
+    const std::vector<std::shared_ptr<Tensor<float>>> &inputs) {
+  CHECK(graph_state_ == GraphState::Complete)
+          << "Graph need be build before binding inputs!";
+  CHECK(operators_maps_.find(input_name_) != operators_maps_.end())
+          << "Can not find the input operator " << input_name_;
+  const auto &input_op = operators_maps_.at(input_name_);
+  CHECK(input_op->output_operands != nullptr);
+  const std::vector<int32_t> &operand_shapes =
+      input_op->output_operands->shapes;
+  CHECK(!operand_shapes.empty() && inputs.size() == operand_shapes.front())
+          << "The number of bound inputs should be equal to batch size";
+
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    const auto &input = inputs.at(i);
+    CHECK(input != nullptr && !input->empty())
+            << "The bound input tensor is empty " << i << " th";
+    CHECK(input->raw_shapes().size() == operand_shapes.size() - 1)
+            << "The bound input tensor has " << input->raw_shapes().size()
+            << " dims, but the input operand has "
+            << operand_shapes.size() - 1 << " dims " << i << " th";
+    for (uint32_t j = 1; j < operand_shapes.size(); ++j) {
+      CHECK(input->raw_shapes().at(j - 1) == operand_shapes.at(j))
+              << "The bound input tensor shape does not match the input "
+                 "operand "
+              << i << " th";
+    }
+  }
+  this->bound_inputs_ = inputs;
+}
+
+void RuntimeGraph::BindOutputs(
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  CHECK(graph_state_ == GraphState::Complete)
+          << "Graph need be build before binding outputs!";
+  CHECK(operators_maps_.find(output_name_) != operators_maps_.end())
+          << "Can not find the output operator " << output_name_;
+  const auto &output_op = operators_maps_.at(output_name_);
+  CHECK(output_op->input_operands_seq.size() == 1);
+
+  // 输出节点的输入来自于唯一的前驱，让前驱直接写入绑定的张量
+  const std::string &producer_name = output_op->input_operands_seq.front()->name;
+  CHECK(operators_maps_.find(producer_name) != operators_maps_.end())
+          << "Can not find the producer of output operator " << producer_name;
+  const auto &producer = operators_maps_.at(producer_name);
+  CHECK(producer->output_operands != nullptr);
+  std::vector<std::shared_ptr<Tensor<float>>> &producer_datas =
+      producer->output_operands->datas;
+  CHECK(outputs.size() == producer_datas.size())
+          << "The number of bound outputs should be equal to batch size";
+
+  for (uint32_t i = 0; i < outputs.size(); ++i) {
+    const auto &output = outputs.at(i);
+    const auto &producer_data = producer_datas.at(i);
+    CHECK(output != nullptr && !output->empty())
+            << "The bound output tensor is empty " << i << " th";
+    CHECK(producer_data != nullptr &&
+          output->shapes() == producer_data->shapes())
+            << "The bound output tensor shape does not match the output "
+               "operand "
+            << i << " th";
+    producer_datas.at(i) = output;
+  }
+  this->bound_outputs_ = outputs;
+}
+
+void RuntimeGraph::Forward(bool debug) {
+  CHECK(!bound_inputs_.empty()) << "Graph inputs need be bound!";
+  const auto &outputs = this->Forward(bound_inputs_, debug);
+  if (bound_outputs_.empty()) {
+    return;
+  }
+
+  // Expression和Flatten直接写入绑定的张量，其余替换了输出张量的Layer(例如输出是输入视图的节点)
+  // 在这里拷贝到绑定的张量中并恢复绑定
+  CHECK(outputs.size() == bound_outputs_.size());
+  const auto &output_op = operators_maps_.at(output_name_);
+  const auto &producer =
+      operators_maps_.at(output_op->input_operands_seq.front()->name);
+  for (uint32_t i = 0; i < outputs.size(); ++i) {
+    const auto &output = outputs.at(i);
+    const auto &bound_output = bound_outputs_.at(i);
+    if (output == bound_output) {
+      continue;
+    }
+    CHECK(output != nullptr && output->size() == bound_output->size());
+    std::copy(output->raw_ptr(), output->raw_ptr() + output->size(),
+              bound_output->raw_ptr());
+    producer->output_operands->datas.at(i) = bound_output;
+  }
+}
+
+WarmupReport RuntimeGraph::Warmup(uint32_t runs, bool lock_memory) {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  CHECK(runs > 0) << "Warmup needs at least one run";
+  WarmupReport report;
+  report.runs = runs;
+
+  const auto &input_op = operators_maps_.at(input_name_);
+  CHECK(input_op->output_operands != nullptr)
+          << "The input operator " << input_name_ << " has no output operand";
+  const std::vector<int32_t> &shapes = input_op->output_operands->shapes;
+  CHECK(shapes.size() >= 2 && shapes.size() <= 4)
+          << "Unsupported input shape sizes: " << shapes.size();
+  std::vector<uint32_t> input_shapes;
+  for (uint32_t i = 1; i < shapes.size(); ++i) {
+    input_shapes.push_back(uint32_t(shapes.at(i)));
+  }
+  std::vector<sftensor> inputs;
+  for (int32_t b = 0; b < shapes.front(); ++b) {
+    sftensor input = TensorCreate(input_shapes);
+    input->Fill(0.5f);
+    inputs.push_back(input);
+  }
+
+  // 绑定的输出属于调用方，预热时输出节点的前驱写入临时的张量，预热之后恢复绑定
+  std::shared_ptr<RuntimeOperator> output_producer;
+  if (!bound_outputs_.empty()) {
+    const auto &output_op = operators_maps_.at(output_name_);
+    output_producer =
+        operators_maps_.at(output_op->input_operands_seq.front()->name);
+    for (auto &output_data : output_producer->output_operands->datas) {
+      output_data = TensorCreate(output_data->shapes());
+    }
+  }
+
+  // 预热时的推理不计入指标、追踪、录制和逐节点计时，
+  // 第一次推理写入所有节点的输出，内存页的缺页中断在这里发生
+  std::string metrics_name;
+  std::swap(metrics_name, metrics_name_);
+  std::unique_ptr<ForwardRecorder> recorder = std::move(recorder_);
+  const bool trace_enabled = trace_enabled_;
+  const bool profile_enabled = profile_enabled_;
+  trace_enabled_ = false;
+  profile_enabled_ = false;
+  for (uint32_t i = 0; i < runs; ++i) {
+    first_forward_pending_ = true;
+    this->Forward(inputs, false);
+    if (i == 0) {
+      report.cold_forward_ms = first_forward_ms_;
+    }
+    report.warm_forward_ms = first_forward_ms_;
+  }
+  std::swap(metrics_name, metrics_name_);
+  recorder_ = std::move(recorder);
+  trace_enabled_ = trace_enabled;
+  profile_enabled_ = profile_enabled;
+
+  if (output_producer != nullptr) {
+    output_producer->output_operands->datas = bound_outputs_;
+  }
+
+  // 锁定计算图自己的节点输出，原地计算和内存复用的节点共享同一个张量，只锁定一次，
+  // 绑定的输出不锁定，重复预热时先解锁之前锁定的区域
+  locked_memory_.Unlock();
+  if (lock_memory) {
+    const auto lock_start = std::chrono::steady_clock::now();
+    std::set<const Tensor<float> *> locked;
+    for (const auto &bound_output : bound_outputs_) {
+      locked.insert(bound_output.get());
+    }
+    for (const auto &op : topo_operators_) {
+      if (op->output_operands == nullptr) {
+        continue;
+      }
+      for (const auto &output_data : op->output_operands->datas) {
+        if (output_data == nullptr || output_data->empty() ||
+            !locked.insert(output_data.get()).second) {
+          continue;
+        }
+        report.locked_bytes += locked_memory_.Lock(output_data);
+      }
+    }
+    report.lock_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - lock_start)
+                         .count();
+  }
+
+  first_forward_pending_ = true;
+  first_forward_ms_ = 0.;
+  return report;
+}
+
+double RuntimeGraph::first_forward_ms() const { return first_forward_ms_; }
+
+ForkReport RuntimeGraph::PrepareFork() {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  LOG_IF(WARNING, executed_)
+      << "The graph has been executed before fork, the OpenMP threads of the "
+         "parent do not exist in the children, run the children with one "
+         "OpenMP thread or use ForkWorkers";
+  if (recorder_ != nullptr) {
+    LOG(WARNING) << "Stop recording before fork";
+    this->StopRecording();
+  }
+  // 子进程中只有调用fork的线程，后台线程持有的锁和状态在子进程中不再有效
+  CHECK(MetricsExporter::running_exporters() == 0)
+      << "Stop the metrics exporter before fork, its background thread does "
+         "not exist in the children";
+  CHECK(!RuntimeTracer::Instance().signal_handler_installed())
+      << "Install the trace signal handler after fork, its background thread "
+         "does not exist in the children";
+
+  ForkReport report;
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t total_floats = 0;
+  for (const auto &op : topo_operators_) {
+    if (op->layer == nullptr) {
+      continue;
+    }
+    op->layer->Prepare();
+    report.prepared_layers += 1;
+    total_floats += op->layer->constant_floats();
+  }
+
+  // 各Layer的权重、偏移和展开之后的权重复制到按页对齐的内存中，复制之后去掉写权限
+  if (weight_arena_ == nullptr && total_floats > 0) {
+    const uint64_t page_size = uint64_t(sysconf(_SC_PAGESIZE));
+    const uint64_t bytes = (total_floats * sizeof(float) + page_size - 1) /
+                           page_size * page_size;
+    void *arena = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(arena != MAP_FAILED) << "Allocate " << bytes
+                               << " bytes for the weights failed";
+    float *arena_ptr = static_cast<float *>(arena);
+    uint64_t offset = 0;
+    for (const auto &op : topo_operators_) {
+      if (op->layer != nullptr) {
+        offset += op->layer->MoveConstants(arena_ptr + offset);
+        CHECK(offset <= total_floats)
+            << "The constants of " << op->name << " exceed the arena";
+      }
+    }
+    CHECK(mprotect(arena, bytes, PROT_READ) == 0)
+        << "Protect the weights failed";
+    weight_arena_ =
+        std::shared_ptr<void>(arena, [bytes](void *ptr) { munmap(ptr, bytes); });
+    report.frozen_bytes = offset * sizeof(float);
+    report.arena_address = reinterpret_cast<uint64_t>(arena);
+    report.arena_bytes = bytes;
+  }
+  report.prepare_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  return report;
+}
+
+void RuntimeGraph::EnableMetrics(const std::string &model_name) {
+  CHECK(!model_name.empty()) << "The model name of metrics is empty";
+  this->metrics_name_ = model_name;
+  this->model_metrics_ = nullptr;
+  this->layer_metrics_.clear();
+  this->forward_latency_.clear();
+}
+
+void RuntimeGraph::EnableTracing(uint32_t sample_every,
+                                 double slow_threshold_ms) {
+  CHECK(sample_every > 0 || slow_threshold_ms > 0)
+          << "Either the sample interval or the slow threshold should be set";
+  this->trace_enabled_ = true;
+  this->trace_sample_every_ = sample_every;
+  this->trace_slow_threshold_ns_ = int64_t(slow_threshold_ms * 1e6);
+  this->trace_runs_ = 0;
+}
+
+bool RuntimeGraph::StartRecording(const std::string &path) {
+  auto recorder = std::make_unique<ForwardRecorder>(path);
+  if (!recorder->is_open()) {
+    return false;
+  }
+  this->recorder_ = std::move(recorder);
+  return true;
+}
+
+void RuntimeGraph::StopRecording() {
+  if (recorder_ != nullptr) {
+    recorder_->Flush();
+    LOG(INFO) << "Stop recording after " << recorder_->records()
+              << " forward calls, dropped " << recorder_->dropped();
+    recorder_.reset();
+  }
+}
+
+void RuntimeGraph::EnableProfiling() {
+  this->profile_enabled_ = true;
+  this->profile_runs_ = 0;
+  this->op_profile_ns_.clear();
+}
+
+/// 转义DOT双引号字符串中的双引号和反斜杠
+static std::string EscapeDot(const std::string &text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+std::string RuntimeGraph::ExportDot() const {
+  CHECK(graph_state_ == GraphState::Complete)
+          << "Graph need be build before exporting!";
+  // 各输出张量的数据地址，被多个节点持有的地址说明内存被规划器复用
+  std::map<const float *, uint32_t> output_owners;
+  for (const auto &op : topo_operators_) {
+    if (op->type == "pnnx.Output" || op->output_operands == nullptr) {
+      continue;
+    }
+    for (const auto &data : op->output_operands->datas) {
+      if (data != nullptr && !data->empty()) {
+        output_owners[std::as_const(*data).data().memptr()] += 1;
+      }
+    }
+  }
+
+  int64_t max_ns = 0;
+  for (const int64_t op_ns : op_profile_ns_) {
+    max_ns = std::max(max_ns, op_ns);
+  }
+
+  std::ostringstream dot;
+  dot << "digraph kuiper_infer {\n"
+      << "  rankdir=TB;\n"
+      << "  node [shape=box, style=\"rounded,filled\", fontname=\"monospace\"];\n";
+  for (uint32_t op_index = 0; op_index < topo_operators_.size(); ++op_index) {
+    const auto &op = topo_operators_.at(op_index);
+    std::ostringstream label;
+    label << EscapeDot(op->name) << "\\n" << EscapeDot(op->type);
+    if (op->layer != nullptr) {
+      label << "\\nkernel: " << EscapeDot(op->layer->kernel_name());
+    }
+
+    bool inplace = false;
+    bool shared = false;
+    if (op->type != "pnnx.Output" && op->output_operands != nullptr) {
+      std::ostringstream shape;
+      for (uint32_t i = 0; i < op->output_operands->shapes.size(); ++i) {
+        shape << (i == 0 ? "" : "x") << op->output_operands->shapes.at(i);
+      }
+      uint64_t output_bytes = 0;
+      for (const auto &data : op->output_operands->datas) {
+        if (data == nullptr || data->empty()) {
+          continue;
+        }
+        output_bytes += uint64_t(data->size()) * sizeof(float);
+        const float *output_ptr = std::as_const(*data).data().memptr();
+        for (const auto &input_operand : op->input_operands_seq) {
+          for (const auto &input : input_operand->datas) {
+            if (input != nullptr && !input->empty() &&
+                std::as_const(*input).data().memptr() == output_ptr) {
+              inplace = true;
+            }
+          }
+        }
+        if (output_owners.at(output_ptr) > 1) {
+          shared = true;
+        }
+      }
+      label << "\\noutput: " << shape.str() << ", " << output_bytes
+            << " bytes";
+    }
+
+    double color_ratio = 0.;
+    if (op_index < op_profile_ns_.size() && profile_runs_ > 0) {
+      const int64_t op_ns = op_profile_ns_.at(op_index);
+      label << "\\ntime: "
+            << double(op_ns) / double(profile_runs_) / 1e6 << " ms";
+      if (max_ns > 0) {
+        color_ratio = double(op_ns) / double(max_ns);
+      }
+    }
+    if (inplace) {
+      label << "\\ninplace";
+    } else if (shared) {
+      label << "\\nshared buffer";
+    }
+
+    // 色相从绿色(0.33)过渡到红色(0)
+    dot << "  \"" << EscapeDot(op->name) << "\" [label=\"" << label.str()
+        << "\", fillcolor=\"" << (1. - color_ratio) * 0.33 << " 0.45 1.0\"";
+    if (inplace || shared) {
+      dot << ", peripheries=2";
+    }
+    dot << "];\n";
+  }
+
+  for (const auto &op : topo_operators_) {
+    for (const auto &[_, next_op] : op->output_operators) {
+      if (next_op != nullptr) {
+        dot << "  \"" << EscapeDot(op->name) << "\" -> \""
+            << EscapeDot(next_op->name) << "\";\n";
+      }
+    }
+  }
+  dot << "}\n";
+  return dot.str();
+}
+
+bool RuntimeGraph::ExportGraph(const std::string &path) const {
+  const std::string svg_suffix = ".svg";
+  const bool export_svg =
+      path.size() > svg_suffix.size() &&
+      path.compare(path.size() - svg_suffix.size(), svg_suffix.size(),
+                   svg_suffix) == 0;
+  const std::string dot_path = export_svg ? path + ".dot" : path;
+  {
+    std::ofstream dot_file(dot_path, std::ios::out | std::ios::trunc);
+    if (!dot_file.is_open()) {
+      LOG(ERROR) << "Can not open the graph file " << dot_path;
+      return false;
+    }
+    dot_file << this->ExportDot();
+    if (!dot_file.good()) {
+      LOG(ERROR) << "Write the graph file " << dot_path << " failed";
+      return false;
+    }
+  }
+  if (!export_svg) {
+    return true;
+  }
+
+  // 参数直接传给graphviz，不经过shell解释，路径中的引号和分号不会被执行
+  std::vector<std::string> arguments{"dot", "-Tsvg", dot_path, "-o", path};
+  std::vector<char *> argv;
+  for (std::string &argument : arguments) {
+    argv.push_back(argument.data());
+  }
+  argv.push_back(nullptr);
+
+  int status = -1;
+  const pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv.front(), argv.data());
+    _exit(127);
+  } else if (pid > 0) {
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+  }
+  std::remove(dot_path.c_str());
+  if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    LOG(ERROR) << "Convert the graph " << dot_path
+               << " to svg failed, graphviz may be missing";
+    return false;
+  }
+  return true;
+}
+
+void RuntimeGraph::InitMetrics() {
+  CHECK(graph_state_ == GraphState::Complete)
+          << "Graph need be build before recording metrics!";
+  RuntimeMetrics &metrics = RuntimeMetrics::Instance();
+  model_metrics_ = metrics.Model(metrics_name_);
+
+  // 内存规划之后按复用后的大小统计，否则统计各节点输出的大小
+  uint64_t pool_memory_bytes = memory_report_.planned_bytes;
+  if (memory_budget_ == 0) {
+    for (const auto &op : topo_operators_) {
+      if (op->output_operands == nullptr) {
+        continue;
+      }
+      for (const auto &data : op->output_operands->datas) {
+        if (data != nullptr && !data->empty()) {
+          pool_memory_bytes += uint64_t(data->size()) * sizeof(float);
+        }
+      }
+    }
+  }
+  model_metrics_->pool_memory_bytes.store(pool_memory_bytes,
+                                          std::memory_order_relaxed);
+
+  layer_metrics_.clear();
+  for (const auto &op : topo_operators_) {
+    if (op->type == "pnnx.Input" || op->type == "pnnx.Output") {
+      layer_metrics_.push_back(nullptr);
+    } else {
+      layer_metrics_.push_back(metrics.LayerType(metrics_name_, op->type));
+    }
+  }
+}
+
+bool RuntimeGraph::Build(const std::string &input_name,
                          const std::string &output_name) {
   if (graph_state_ == GraphState::Complete) {
     LOG(INFO) << "Model has been built already!";
-    return;
+    return true;
   }
 
   if (graph_state_ == GraphState::NeedInit) {
     bool init_graph = Init();
-    LOG_IF(FATAL, !init_graph) << "Init graph failed!";
+    if (!init_graph) {
+      LOG(ERROR) << "Init graph failed!";
+      return false;
+    }
   }
 
   CHECK(graph_state_ >= GraphState::NeedBuild)
@@ -334,9 +1158,13 @@ void RuntimeGraph::Build(const std::string &input_name,
     }
   }
 
+  if (this->fuse_activations_) {
+    this->FuseActivations();
+  }
+
   // 初始化节点的输入和输出空间
   RuntimeOperatorUtils::InitOperatorInput(operators_);
-  RuntimeOperatorUtils::InitOperatorOutput(graph_->ops, operators_);
+  RuntimeOperatorUtils::InitOperatorOutput(pnnx_outputs_, operators_);
 
   // 构建拓扑顺序
   topo_operators_.clear();
@@ -351,6 +1179,44 @@ void RuntimeGraph::Build(const std::string &input_name,
           << "Build wrong topo queue";
   std::reverse(topo_operators_.begin(), topo_operators_.end());
 
+  // 在内存预算下调整执行顺序，降低同时存活的节点输出，再复用节点的输出空间
+  if (memory_budget_ > 0) {
+    const uint64_t topo_peak_bytes =
+        RuntimeMemoryPlanner::PeakLiveBytes(topo_operators_);
+    const uint64_t topo_planned_bytes =
+        RuntimeMemoryPlanner::PlannedBytes(topo_operators_);
+    if (schedule_beam_width_ > 0) {
+      topo_operators_ = RuntimeMemoryPlanner::Schedule(topo_operators_,
+                                                       schedule_beam_width_);
+    }
+    if (!memory_planner_.Plan(topo_operators_, memory_budget_,
+                              memory_report_)) {
+      // 节点和Layer已经按本次构建修改过，下次构建时从模型文件重新初始化
+      LOG(ERROR) << "Plan the memory of graph failed!";
+      topo_operators_.clear();
+      graph_state_ = GraphState::NeedInit;
+      return false;
+    }
+    memory_report_.topo_peak_bytes = topo_peak_bytes;
+    memory_report_.topo_planned_bytes = topo_planned_bytes;
+    memory_report_.scheduled_peak_bytes =
+        RuntimeMemoryPlanner::PeakLiveBytes(topo_operators_);
+    LOG(INFO) << "Memory budget: " << memory_report_.memory_budget
+              << " bytes, outputs without reuse: "
+              << memory_report_.unplanned_bytes
+              << " bytes, outputs with reuse: " << memory_report_.planned_bytes
+              << " bytes in " << memory_report_.memory_blocks
+              << " blocks (" << memory_report_.topo_planned_bytes
+              << " bytes in topo order), inplace operators: "
+              << memory_report_.inplace_operators
+              << ", view operators: " << memory_report_.view_operators
+              << ", layer buffers: " << memory_report_.layer_buffer_bytes
+              << " bytes, workspace limit: " << memory_report_.workspace_limit
+              << " bytes, peak live outputs: "
+              << memory_report_.topo_peak_bytes << " bytes in topo order, "
+              << memory_report_.scheduled_peak_bytes << " bytes scheduled";
+  }
+
   graph_state_ = GraphState::Complete;
   input_name_ = input_name;
   output_name_ = output_name;
@@ -358,6 +1224,44 @@ void RuntimeGraph::Build(const std::string &input_name,
     graph_.reset();
     graph_ = nullptr;
   }
+  pnnx_outputs_.clear();
+  return true;
+}
+
+void RuntimeGraph::UpdateMemoryReport() {
+  uint64_t layer_buffer_bytes = 0;
+  uint64_t workspace_peak_bytes = 0;
+  for (const auto &op : topo_operators_) {
+    if (op->layer != nullptr) {
+      layer_buffer_bytes += op->layer->persistent_bytes();
+      workspace_peak_bytes =
+          std::max(workspace_peak_bytes, op->layer->workspace_peak());
+    }
+  }
+  memory_report_.layer_buffer_bytes = layer_buffer_bytes;
+  memory_report_.workspace_peak_bytes = workspace_peak_bytes;
+}
+
+void RuntimeGraph::FuseActivations() {
+  for (const auto &op : this->operators_) {
+    if (op->layer == nullptr || op->output_operators.size() != 1) {
+      continue;
+    }
+    const auto &next_op = op->output_operators.begin()->second;
+    if ((next_op->type != "nn.ReLU" && next_op->type != "nn.SiLU") ||
+        next_op->input_operands_seq.size() > 1) {
+      continue;
+    }
+    bool feeds_output = false;
+    for (const auto &[_, after_op] : next_op->output_operators) {
+      feeds_output = feeds_output || after_op->type == "pnnx.Output";
+    }
+    if (feeds_output || !op->layer->FuseActivation(next_op->type)) {
+      continue;
+    }
+    next_op->layer = std::make_shared<IdentityLayer>();
+    next_op->layer->set_runtime_operator(next_op);
+  }
 }
 
 void RuntimeGraph::ReverseTopo(
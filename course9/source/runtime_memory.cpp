@@ -0,0 +1,687 @@
+//
+// Created by fss on 23-9-2.
+//
+
+#include "runtime/runtime_memory.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <sys/mman.h>
+#include "layer/abstract/layer.hpp"
+
+namespace kuiper_infer {
+
+LockedMemory::~LockedMemory() { this->Unlock(); }
+
+uint64_t LockedMemory::Lock(const std::shared_ptr<Tensor<float>>& tensor) {
+  if (tensor == nullptr || tensor->empty()) {
+    return 0;
+  }
+  void* data = tensor->raw_ptr();
+  const uint64_t bytes = tensor->size() * sizeof(float);
+  if (mlock(data, bytes) != 0) {
+    LOG(WARNING) << "Lock " << bytes
+                 << " bytes failed, the RLIMIT_MEMLOCK may be too small";
+    return 0;
+  }
+  ranges_.emplace_back(data, bytes);
+  return bytes;
+}
+
+void LockedMemory::Unlock() {
+  for (const auto& [data, bytes] : ranges_) {
+    if (munlock(data, bytes) != 0) {
+      LOG(WARNING) << "Unlock " << bytes << " bytes failed";
+    }
+  }
+  ranges_.clear();
+}
+
+uint64_t LockedMemory::locked_bytes() const {
+  uint64_t bytes = 0;
+  for (const auto& range : ranges_) {
+    bytes += range.second;
+  }
+  return bytes;
+}
+
+bool RuntimeMemoryPlanner::IsInplaceOperator(
+    const std::shared_ptr<RuntimeOperator>& op) {
+  CHECK(op != nullptr);
+  if (op->type != "nn.ReLU" && op->type != "nn.SiLU" &&
+      op->type != "nn.BatchNorm2d" && op->type != "nn.LayerNorm" &&
+      op->type != "nn.GELU" && op->type != "F.gelu") {
+    return false;
+  }
+  return op->input_operands_seq.size() == 1;
+}
+
+/// 节点输出和Layer缓冲区在内存块上的分配结果
+struct MemoryLayout {
+  std::vector<uint64_t> block_sizes;  /// 每个内存块的大小，单位是float
+  std::vector<int32_t> op_blocks;     /// 节点输出所在的内存块
+  std::vector<int32_t> scratch_blocks;     /// Layer执行期间使用的缓冲区所在的内存块
+  std::vector<int32_t> inplace_producers;  /// 原地计算的节点所使用的前驱节点
+  std::vector<int32_t> view_roots;  /// 视图节点的输出所在的、真正持有内存的节点
+};
+
+MemoryLayout RuntimeMemoryPlanner::AssignBlocks(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+    RuntimeMemoryReport& report) {
+  const uint32_t op_size = topo_operators.size();
+  CHECK(op_size > 0) << "Operators for memory planning is empty!";
+
+  std::map<std::string, uint32_t> op_indexes;
+  for (uint32_t i = 0; i < op_size; ++i) {
+    op_indexes.insert({topo_operators.at(i)->name, i});
+  }
+
+  // 节点输出最后一次被后继节点使用的位置，图的输出需要一直保留
+  std::vector<uint32_t> last_uses(op_size, 0);
+  for (uint32_t i = 0; i < op_size; ++i) {
+    const auto& op = topo_operators.at(i);
+    uint32_t last_use = op->output_operators.empty() ? op_size : i;
+    for (const auto& [next_name, next_op] : op->output_operators) {
+      if (next_op->type == "pnnx.Output") {
+        last_use = op_size;
+      } else {
+        last_use = std::max(last_use, op_indexes.at(next_name));
+      }
+    }
+    last_uses.at(i) = last_use;
+  }
+
+  MemoryLayout layout;
+  std::vector<uint64_t>& block_sizes = layout.block_sizes;
+  std::vector<uint32_t> block_last_uses;  // 每个内存块被占用到的位置
+  // 在位置i之前空闲的内存块中选择能放下elements的最小块，都放不下时扩大最大的空闲块
+  auto allocate_block = [&](uint64_t elements, uint32_t i) {
+    int32_t best_block = -1;
+    int32_t largest_block = -1;
+    for (uint32_t b = 0; b < block_sizes.size(); ++b) {
+      if (block_last_uses.at(b) >= i) {
+        continue;
+      }
+      if (block_sizes.at(b) >= elements &&
+          (best_block < 0 || block_sizes.at(b) < block_sizes.at(best_block))) {
+        best_block = int32_t(b);
+      }
+      if (largest_block < 0 ||
+          block_sizes.at(b) > block_sizes.at(largest_block)) {
+        largest_block = int32_t(b);
+      }
+    }
+    if (best_block < 0 && largest_block >= 0) {
+      best_block = largest_block;
+      block_sizes.at(best_block) = elements;
+    }
+    if (best_block < 0) {
+      best_block = int32_t(block_sizes.size());
+      block_sizes.push_back(elements);
+      block_last_uses.push_back(0);
+    }
+    return best_block;
+  };
+
+  std::vector<int32_t>& op_blocks = layout.op_blocks;
+  std::vector<int32_t>& scratch_blocks = layout.scratch_blocks;
+  std::vector<int32_t>& inplace_producers = layout.inplace_producers;
+  std::vector<int32_t>& view_roots = layout.view_roots;
+  op_blocks.assign(op_size, -1);
+  scratch_blocks.assign(op_size, -1);
+  inplace_producers.assign(op_size, -1);
+  view_roots.assign(op_size, -1);
+  for (uint32_t i = 0; i < op_size; ++i) {
+    const auto& op = topo_operators.at(i);
+    // 缓冲区只占用当前位置，先于输出分配，避免和输入、输出落在同一块内存上
+    if (op->layer != nullptr) {
+      const std::vector<uint32_t>& scratch_shapes =
+          op->layer->scratch_shapes();
+      if (!scratch_shapes.empty()) {
+        uint64_t scratch_elements = 1;
+        for (const uint32_t dim : scratch_shapes) {
+          scratch_elements *= dim;
+        }
+        const int32_t scratch_block = allocate_block(scratch_elements, i);
+        block_last_uses.at(scratch_block) = i;
+        scratch_blocks.at(i) = scratch_block;
+        report.scratch_operators += 1;
+      }
+    }
+
+    const auto& output_operand = op->output_operands;
+    if (output_operand == nullptr || output_operand->datas.empty()) {
+      continue;
+    }
+
+    uint64_t op_elements = 0;
+    for (const auto& output_data : output_operand->datas) {
+      CHECK(output_data != nullptr && !output_data->empty())
+          << "The output of " << op->name << " is not initialized";
+      op_elements += output_data->size();
+    }
+    report.unplanned_bytes += op_elements * sizeof(float);
+
+    // 输入节点的输出空间不会被使用，图的输入直接传递给后继节点
+    if (op->type == "pnnx.Input") {
+      continue;
+    }
+
+    // 视图节点不分配内存，把持有内存的节点的内存块保留到视图最后一次被使用
+    if (op->layer != nullptr && op->layer->output_is_view() &&
+        op->input_operands_seq.size() == 1) {
+      const std::string& producer_name = op->input_operands_seq.front()->name;
+      const uint32_t producer_index = op_indexes.at(producer_name);
+      const int32_t root = view_roots.at(producer_index) >= 0
+                               ? view_roots.at(producer_index)
+                               : int32_t(producer_index);
+      view_roots.at(i) = root;
+      const int32_t root_block = op_blocks.at(root);
+      if (root_block >= 0) {
+        block_last_uses.at(root_block) =
+            std::max(block_last_uses.at(root_block), last_uses.at(i));
+      }
+      report.view_operators += 1;
+      continue;
+    }
+
+    // 逐元素计算的节点在唯一前驱的输出上原地计算
+    if (IsInplaceOperator(op)) {
+      const std::string& producer_name = op->input_operands_seq.front()->name;
+      const uint32_t producer_index = op_indexes.at(producer_name);
+      const auto& producer = topo_operators.at(producer_index);
+      const int32_t producer_block = op_blocks.at(producer_index);
+      if (producer_block >= 0 && producer->output_operators.size() == 1 &&
+          producer->output_operands->datas.size() ==
+              output_operand->datas.size() &&
+          block_sizes.at(producer_block) >= op_elements) {
+        op_blocks.at(i) = producer_block;
+        block_last_uses.at(producer_block) = last_uses.at(i);
+        inplace_producers.at(i) = int32_t(producer_index);
+        report.inplace_operators += 1;
+        continue;
+      }
+    }
+
+    const int32_t best_block = allocate_block(op_elements, i);
+    op_blocks.at(i) = best_block;
+    block_last_uses.at(best_block) = last_uses.at(i);
+  }
+
+  for (const uint64_t block_size : block_sizes) {
+    report.planned_bytes += block_size * sizeof(float);
+  }
+  report.memory_blocks = block_sizes.size();
+  return layout;
+}
+
+uint64_t RuntimeMemoryPlanner::PlannedBytes(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators) {
+  RuntimeMemoryReport report;
+  AssignBlocks(topo_operators, report);
+  return report.planned_bytes;
+}
+
+bool RuntimeMemoryPlanner::Plan(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+    uint64_t memory_budget, RuntimeMemoryReport& report) {
+  report = RuntimeMemoryReport();
+  report.memory_budget = memory_budget;
+  const uint32_t op_size = topo_operators.size();
+  const MemoryLayout& layout = AssignBlocks(topo_operators, report);
+  const std::vector<uint64_t>& block_sizes = layout.block_sizes;
+  const std::vector<int32_t>& op_blocks = layout.op_blocks;
+  const std::vector<int32_t>& scratch_blocks = layout.scratch_blocks;
+  const std::vector<int32_t>& inplace_producers = layout.inplace_producers;
+  const std::vector<int32_t>& view_roots = layout.view_roots;
+  for (const auto& op : topo_operators) {
+    if (op->layer != nullptr) {
+      report.layer_buffer_bytes += op->layer->persistent_bytes();
+    }
+  }
+
+  if (memory_budget > 0) {
+    const uint64_t required_bytes =
+        report.planned_bytes + report.layer_buffer_bytes;
+    if (required_bytes >= memory_budget) {
+      LOG(ERROR) << "The memory budget " << memory_budget
+                 << " bytes is too small, the outputs and layer buffers of "
+                    "graph need at least "
+                 << required_bytes << " bytes";
+      return false;
+    }
+    report.workspace_limit = memory_budget - required_bytes;
+  }
+
+  // 申请内存块，并把节点的输出张量替换为内存块上的张量
+  memory_blocks_.clear();
+  for (const uint64_t block_size : block_sizes) {
+    memory_blocks_.emplace_back(block_size);
+  }
+
+  for (uint32_t i = 0; i < op_size; ++i) {
+    const auto& op = topo_operators.at(i);
+    const int32_t scratch_block = scratch_blocks.at(i);
+    if (scratch_block >= 0) {
+      op->layer->set_scratch(std::make_shared<Tensor<float>>(
+          memory_blocks_.at(scratch_block).data(),
+          op->layer->scratch_shapes()));
+    }
+
+    if (op->type == "pnnx.Input" && op->output_operands != nullptr) {
+      for (auto& output_data : op->output_operands->datas) {
+        output_data = std::make_shared<Tensor<float>>();
+      }
+      continue;
+    }
+
+    // 视图节点的输出在推理时指向输入的内存，释放初始化时申请的空间
+    if (view_roots.at(i) >= 0) {
+      for (auto& output_data : op->output_operands->datas) {
+        output_data = std::make_shared<Tensor<float>>();
+      }
+      continue;
+    }
+
+    const int32_t block = op_blocks.at(i);
+    if (block < 0) {
+      continue;
+    }
+    std::vector<sftensor>& output_datas = op->output_operands->datas;
+    const int32_t producer_index = inplace_producers.at(i);
+    if (producer_index >= 0) {
+      const auto& producer = topo_operators.at(producer_index);
+      for (uint32_t b = 0; b < output_datas.size(); ++b) {
+        output_datas.at(b) = producer->output_operands->datas.at(b);
+      }
+      continue;
+    }
+
+    float* block_ptr = memory_blocks_.at(block).data();
+    uint64_t offset = 0;
+    for (auto& output_data : output_datas) {
+      const std::vector<uint32_t> raw_shapes = output_data->raw_shapes();
+      const uint64_t elements = output_data->size();
+      output_data =
+          std::make_shared<Tensor<float>>(block_ptr + offset, raw_shapes);
+      offset += elements;
+    }
+  }
+
+  if (report.workspace_limit > 0) {
+    for (const auto& op : topo_operators) {
+      if (op->layer != nullptr) {
+        op->layer->set_workspace_limit(report.workspace_limit);
+      }
+    }
+  }
+  return true;
+}
+
+/// 以节点在执行顺序中的位置为索引的依赖和内存信息
+struct LivenessGraph {
+  std::vector<uint64_t> bytes;  /// 节点输出新占用的字节数
+  std::vector<int32_t> roots;   /// 视图和原地节点的输出所在的节点，其余为-1
+  std::vector<bool> keeps;      /// 输出是否保留到推理结束
+  std::vector<std::vector<uint32_t>> successors;    /// 后继节点
+  std::vector<std::vector<uint32_t>> predecessors;  /// 前驱节点
+};
+
+/// 执行到一半的部分顺序
+struct ScheduleState {
+  std::vector<uint32_t> ready;    /// 前驱都已执行、可以执行的节点，按原顺序中的位置排列
+  std::vector<uint32_t> waiting;  /// 每个节点还没有执行的前驱数量
+  std::vector<uint32_t> pending;  /// 每块内存还没有执行的使用者数量
+  uint64_t live_bytes = 0;        /// 当前存活的字节数
+  uint64_t peak_bytes = 0;        /// 到目前为止的峰值
+};
+
+/// 搜索树上的节点，只记录相对父节点多执行的一个节点，部分顺序由到根节点的路径给出
+struct ScheduleNode {
+  int32_t parent = -1;      /// 父节点，根节点为-1
+  uint32_t op_index = 0;    /// 相对父节点多执行的节点
+  uint32_t depth = 0;       /// 已经执行的节点数量
+  uint64_t live_bytes = 0;  /// 执行之后存活的字节数
+  uint64_t peak_bytes = 0;  /// 执行之后的峰值
+  uint64_t hash = 0;        /// 已执行节点集合的哈希值，用于去掉重复的状态
+};
+
+/// 返回节点的输出所在内存的持有节点
+static uint32_t MemoryRoot(const LivenessGraph& graph, uint32_t op_index) {
+  const int32_t root = graph.roots.at(op_index);
+  return root >= 0 ? uint32_t(root) : op_index;
+}
+
+LivenessGraph RuntimeMemoryPlanner::BuildLivenessGraph(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators) {
+  const uint32_t op_size = topo_operators.size();
+  std::map<std::string, uint32_t> op_indexes;
+  for (uint32_t i = 0; i < op_size; ++i) {
+    op_indexes.insert({topo_operators.at(i)->name, i});
+  }
+
+  LivenessGraph graph;
+  graph.bytes.assign(op_size, 0);
+  graph.roots.assign(op_size, -1);
+  graph.keeps.assign(op_size, false);
+  graph.successors.resize(op_size);
+  graph.predecessors.resize(op_size);
+  for (uint32_t i = 0; i < op_size; ++i) {
+    const auto& op = topo_operators.at(i);
+    for (const auto& [next_name, next_op] : op->output_operators) {
+      const uint32_t next_index = op_indexes.at(next_name);
+      CHECK(next_index > i) << "The operators are not in topological order";
+      graph.successors.at(i).push_back(next_index);
+      graph.predecessors.at(next_index).push_back(i);
+      if (next_op->type == "pnnx.Output") {
+        graph.keeps.at(i) = true;
+      }
+    }
+    if (op->output_operators.empty()) {
+      graph.keeps.at(i) = true;
+    }
+  }
+
+  // 和Plan中的规则一致，视图节点和原地计算的节点使用已有的内存
+  std::vector<bool> views(op_size, false);
+  for (uint32_t i = 0; i < op_size; ++i) {
+    const auto& op = topo_operators.at(i);
+    const auto& output_operand = op->output_operands;
+    if (op->type == "pnnx.Input" || output_operand == nullptr) {
+      continue;
+    }
+    uint64_t op_bytes = 0;
+    for (const auto& output_data : output_operand->datas) {
+      op_bytes += output_data->size() * sizeof(float);
+    }
+
+    if (op->input_operands_seq.size() == 1) {
+      const uint32_t producer_index =
+          op_indexes.at(op->input_operands_seq.front()->name);
+      const auto& producer = topo_operators.at(producer_index);
+      const uint32_t root = MemoryRoot(graph, producer_index);
+      const bool view = op->layer != nullptr && op->layer->output_is_view();
+      // 输入节点和视图节点没有自己的内存，后继节点不能在上面原地计算
+      const bool inplace =
+          IsInplaceOperator(op) && producer->type != "pnnx.Input" &&
+          !views.at(producer_index) &&
+          producer->output_operators.size() == 1 &&
+          producer->output_operands->datas.size() ==
+              output_operand->datas.size() &&
+          graph.bytes.at(root) >= op_bytes;
+      if (view || inplace) {
+        views.at(i) = view;
+        graph.roots.at(i) = int32_t(root);
+        if (graph.keeps.at(i)) {
+          graph.keeps.at(root) = true;
+        }
+        continue;
+      }
+    }
+    graph.bytes.at(i) = op_bytes;
+  }
+  return graph;
+}
+
+/**
+ * 在部分顺序上执行一个节点，更新存活的字节数和峰值
+ * @param graph 节点的依赖和内存信息
+ * @param op_index 执行的节点
+ * @param state 部分顺序
+ */
+static void ExecuteOperator(const LivenessGraph& graph, uint32_t op_index,
+                            ScheduleState& state) {
+  state.live_bytes += graph.bytes.at(op_index);
+  state.peak_bytes = std::max(state.peak_bytes, state.live_bytes);
+  const int32_t op_root = graph.roots.at(op_index);
+  if (op_root >= 0) {
+    state.pending.at(op_root) += graph.successors.at(op_index).size();
+  }
+  for (const uint32_t producer : graph.predecessors.at(op_index)) {
+    const uint32_t root = MemoryRoot(graph, producer);
+    state.pending.at(root) -= 1;
+    if (state.pending.at(root) == 0 && !graph.keeps.at(root)) {
+      state.live_bytes -= graph.bytes.at(root);
+    }
+  }
+
+  state.ready.erase(
+      std::find(state.ready.begin(), state.ready.end(), op_index));
+  for (const uint32_t next : graph.successors.at(op_index)) {
+    state.waiting.at(next) -= 1;
+    if (state.waiting.at(next) == 0) {
+      state.ready.insert(
+          std::lower_bound(state.ready.begin(), state.ready.end(), next),
+          next);
+    }
+  }
+}
+
+/**
+ * 撤销部分顺序上最后执行的一个节点，是ExecuteOperator的逆操作
+ * @param graph 节点的依赖和内存信息
+ * @param op_index 撤销的节点
+ * @param parent 撤销之后的搜索树节点，用于恢复存活的字节数和峰值
+ * @param state 部分顺序
+ */
+static void UndoOperator(const LivenessGraph& graph, uint32_t op_index,
+                         const ScheduleNode& parent, ScheduleState& state) {
+  for (const uint32_t next : graph.successors.at(op_index)) {
+    if (state.waiting.at(next) == 0) {
+      state.ready.erase(
+          std::find(state.ready.begin(), state.ready.end(), next));
+    }
+    state.waiting.at(next) += 1;
+  }
+  state.ready.insert(
+      std::lower_bound(state.ready.begin(), state.ready.end(), op_index),
+      op_index);
+
+  for (const uint32_t producer : graph.predecessors.at(op_index)) {
+    state.pending.at(MemoryRoot(graph, producer)) += 1;
+  }
+  const int32_t op_root = graph.roots.at(op_index);
+  if (op_root >= 0) {
+    state.pending.at(op_root) -= graph.successors.at(op_index).size();
+  }
+  state.live_bytes = parent.live_bytes;
+  state.peak_bytes = parent.peak_bytes;
+}
+
+/**
+ * 把部分顺序从搜索树的一个节点移动到另一个节点，先撤销到公共祖先，再执行到目标节点，
+ * 束中的节点按搜索树的深度优先顺序排列时，相邻节点之间只需要少量的撤销和执行
+ * @param graph 节点的依赖和内存信息
+ * @param nodes 搜索树的所有节点
+ * @param from 部分顺序当前所在的节点
+ * @param to 目标节点
+ * @param state 部分顺序
+ */
+static void MoveState(const LivenessGraph& graph,
+                      const std::vector<ScheduleNode>& nodes, int32_t from,
+                      int32_t to, ScheduleState& state) {
+  std::vector<int32_t> forward;
+  while (from != to) {
+    if (nodes.at(from).depth >= nodes.at(to).depth) {
+      const ScheduleNode& node = nodes.at(from);
+      UndoOperator(graph, node.op_index, nodes.at(node.parent), state);
+      from = node.parent;
+    } else {
+      forward.push_back(to);
+      to = nodes.at(to).parent;
+    }
+  }
+  for (auto iter = forward.rbegin(); iter != forward.rend(); ++iter) {
+    ExecuteOperator(graph, nodes.at(*iter).op_index, state);
+  }
+}
+
+/**
+ * 计算执行一个节点之后存活的字节数，不修改部分顺序
+ * @param graph 节点的依赖和内存信息
+ * @param op_index 执行的节点
+ * @param state 部分顺序，计算过程中临时修改使用者数量，返回前恢复
+ * @return 执行之后存活的字节数
+ */
+static uint64_t LiveBytesAfter(const LivenessGraph& graph, uint32_t op_index,
+                               ScheduleState& state) {
+  uint64_t live_bytes = state.live_bytes + graph.bytes.at(op_index);
+  const int32_t op_root = graph.roots.at(op_index);
+  const uint32_t extra_uses = graph.successors.at(op_index).size();
+  if (op_root >= 0) {
+    state.pending.at(op_root) += extra_uses;
+  }
+  const std::vector<uint32_t>& producers = graph.predecessors.at(op_index);
+  for (const uint32_t producer : producers) {
+    const uint32_t root = MemoryRoot(graph, producer);
+    state.pending.at(root) -= 1;
+    if (state.pending.at(root) == 0 && !graph.keeps.at(root)) {
+      live_bytes -= graph.bytes.at(root);
+    }
+  }
+  for (const uint32_t producer : producers) {
+    const uint32_t root = MemoryRoot(graph, producer);
+    state.pending.at(root) += 1;
+  }
+  if (op_root >= 0) {
+    state.pending.at(op_root) -= extra_uses;
+  }
+  return live_bytes;
+}
+
+/// 所有节点都没有执行时的状态
+static ScheduleState InitialState(const LivenessGraph& graph) {
+  const uint32_t op_size = graph.bytes.size();
+  ScheduleState state;
+  state.waiting.resize(op_size);
+  state.pending.resize(op_size);
+  for (uint32_t i = 0; i < op_size; ++i) {
+    state.waiting.at(i) = graph.predecessors.at(i).size();
+    state.pending.at(i) = graph.successors.at(i).size();
+    if (state.waiting.at(i) == 0) {
+      state.ready.push_back(i);
+    }
+  }
+  return state;
+}
+
+uint64_t RuntimeMemoryPlanner::PeakLiveBytes(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators) {
+  const LivenessGraph& graph = BuildLivenessGraph(topo_operators);
+  ScheduleState state = InitialState(graph);
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    ExecuteOperator(graph, i, state);
+  }
+  return state.peak_bytes;
+}
+
+std::vector<std::shared_ptr<RuntimeOperator>> RuntimeMemoryPlanner::Schedule(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators,
+    uint32_t beam_width) {
+  CHECK(beam_width > 0) << "The beam width of scheduling should be positive";
+  const uint32_t op_size = topo_operators.size();
+  if (op_size <= 2) {
+    return topo_operators;
+  }
+  const LivenessGraph& graph = BuildLivenessGraph(topo_operators);
+  std::mt19937_64 generator(op_size);
+  std::vector<uint64_t> op_hashes(op_size);
+  for (uint64_t& op_hash : op_hashes) {
+    op_hash = generator();
+  }
+
+  // 候选的下一步: 父节点在束中的位置、执行的节点和执行之后的峰值、存活字节数
+  struct Candidate {
+    uint64_t peak_bytes;
+    uint64_t live_bytes;
+    uint32_t op_index;
+    uint32_t parent;
+    uint64_t hash;
+  };
+  // 所有部分顺序共用一个状态，切换时沿搜索树撤销和执行节点，不复制整个状态
+  ScheduleState state = InitialState(graph);
+  std::vector<ScheduleNode> nodes(1);
+  nodes.reserve(uint64_t(op_size) * beam_width + 1);
+  std::vector<int32_t> beam{0};
+  int32_t current = 0;
+  std::vector<Candidate> candidates;
+  std::set<uint64_t> visited;
+  for (uint32_t step = 0; step < op_size; ++step) {
+    candidates.clear();
+    for (uint32_t s = 0; s < beam.size(); ++s) {
+      MoveState(graph, nodes, current, beam.at(s), state);
+      current = beam.at(s);
+      const uint64_t hash = nodes.at(current).hash;
+      for (const uint32_t op_index : state.ready) {
+        const uint64_t live_bytes = LiveBytesAfter(graph, op_index, state);
+        const uint64_t peak_bytes = std::max(
+            state.peak_bytes, state.live_bytes + graph.bytes.at(op_index));
+        candidates.push_back({peak_bytes, live_bytes, op_index, s,
+                              hash ^ op_hashes.at(op_index)});
+      }
+    }
+    CHECK(!candidates.empty()) << "The operators have a cycle";
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) {
+                if (a.peak_bytes != b.peak_bytes) {
+                  return a.peak_bytes < b.peak_bytes;
+                }
+                if (a.live_bytes != b.live_bytes) {
+                  return a.live_bytes < b.live_bytes;
+                }
+                return a.op_index < b.op_index;
+              });
+
+    // 执行过的节点集合相同的部分顺序只保留最好的一个
+    std::vector<Candidate> selected;
+    visited.clear();
+    for (const Candidate& candidate : candidates) {
+      if (selected.size() >= beam_width) {
+        break;
+      }
+      if (visited.insert(candidate.hash).second) {
+        selected.push_back(candidate);
+      }
+    }
+    // 按父节点在束中的位置排列，束始终保持搜索树的深度优先顺序
+    std::stable_sort(selected.begin(), selected.end(),
+                     [](const Candidate& a, const Candidate& b) {
+                       return a.parent < b.parent;
+                     });
+    std::vector<int32_t> next_beam;
+    for (const Candidate& candidate : selected) {
+      ScheduleNode node;
+      node.parent = beam.at(candidate.parent);
+      node.op_index = candidate.op_index;
+      node.depth = step + 1;
+      node.live_bytes = candidate.live_bytes;
+      node.peak_bytes = candidate.peak_bytes;
+      node.hash = candidate.hash;
+      next_beam.push_back(int32_t(nodes.size()));
+      nodes.push_back(node);
+    }
+    beam = std::move(next_beam);
+  }
+
+  // 存活峰值只是估计，用Plan的分配规则计算每个完整顺序实际规划的字节数，选择最小的
+  std::vector<std::shared_ptr<RuntimeOperator>> best_operators = topo_operators;
+  uint64_t best_planned_bytes = PlannedBytes(topo_operators);
+  std::vector<std::shared_ptr<RuntimeOperator>> scheduled_operators(op_size);
+  for (const int32_t leaf : beam) {
+    for (int32_t n = leaf; nodes.at(n).parent >= 0; n = nodes.at(n).parent) {
+      const ScheduleNode& node = nodes.at(n);
+      scheduled_operators.at(node.depth - 1) =
+          topo_operators.at(node.op_index);
+    }
+    const uint64_t planned_bytes = PlannedBytes(scheduled_operators);
+    if (planned_bytes < best_planned_bytes) {
+      best_planned_bytes = planned_bytes;
+      best_operators = scheduled_operators;
+    }
+  }
+  return best_operators;
+}
+
+}  // namespace kuiper_infer
@@ -0,0 +1,358 @@
+//
+// Created by fss on 23-9-9.
+//
+
+#include "runtime/runtime_metrics.hpp"
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+
+MetricsHistogram::MetricsHistogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+  CHECK(std::is_sorted(bounds_.begin(), bounds_.end()));
+  for (uint32_t i = 0; i <= bounds_.size(); ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void MetricsHistogram::Observe(double value) {
+  const uint32_t index =
+      std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+      bounds_.begin();
+  buckets_[index].fetch_add(1, std::memory_order_relaxed);
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(sum, sum + value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+const std::vector<double>& MetricsHistogram::bounds() const {
+  return this->bounds_;
+}
+
+uint64_t MetricsHistogram::cumulative_count(uint32_t index) const {
+  CHECK_LE(index, bounds_.size());
+  uint64_t count = 0;
+  for (uint32_t i = 0; i <= index; ++i) {
+    count += buckets_[i].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+double MetricsHistogram::sum() const {
+  return sum_.load(std::memory_order_relaxed);
+}
+
+ModelMetrics::ModelMetrics()
+    : allocations({0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024}) {}
+
+RuntimeMetrics& RuntimeMetrics::Instance() {
+  static RuntimeMetrics metrics;
+  return metrics;
+}
+
+MetricsHistogram* RuntimeMetrics::ForwardLatency(const std::string& model,
+                                                 uint32_t batch) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& histogram = forward_latency_[{model, batch}];
+  if (histogram == nullptr) {
+    histogram = std::make_unique<MetricsHistogram>(std::vector<double>{
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5,
+        10});
+  }
+  return histogram.get();
+}
+
+LayerTypeMetrics* RuntimeMetrics::LayerType(const std::string& model,
+                                            const std::string& layer_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& layer_metrics = layer_types_[{model, layer_type}];
+  if (layer_metrics == nullptr) {
+    layer_metrics = std::make_unique<LayerTypeMetrics>();
+  }
+  return layer_metrics.get();
+}
+
+ModelMetrics* RuntimeMetrics::Model(const std::string& model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& model_metrics = models_[model];
+  if (model_metrics == nullptr) {
+    model_metrics = std::make_unique<ModelMetrics>();
+  }
+  return model_metrics.get();
+}
+
+/// 按照文本格式的要求转义标签的值
+static std::string EscapeLabel(const std::string& value) {
+  std::string escaped;
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+static void WriteHistogram(std::ostringstream& stream, const std::string& name,
+                           const std::string& labels,
+                           const MetricsHistogram& histogram) {
+  const std::vector<double>& bounds = histogram.bounds();
+  for (uint32_t i = 0; i < bounds.size(); ++i) {
+    stream << name << "_bucket{" << labels << ",le=\"" << bounds.at(i)
+           << "\"} " << histogram.cumulative_count(i) << "\n";
+  }
+  const uint64_t count = histogram.cumulative_count(bounds.size());
+  stream << name << "_bucket{" << labels << ",le=\"+Inf\"} " << count << "\n";
+  stream << name << "_sum{" << labels << "} " << histogram.sum() << "\n";
+  stream << name << "_count{" << labels << "} " << count << "\n";
+}
+
+std::string RuntimeMetrics::Exposition() const {
+  std::ostringstream stream;
+  stream.precision(10);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  stream << "# HELP kuiper_forward_latency_seconds Latency of Forward calls.\n"
+         << "# TYPE kuiper_forward_latency_seconds histogram\n";
+  for (const auto& [key, histogram] : forward_latency_) {
+    const auto& [model, batch] = key;
+    WriteHistogram(stream, "kuiper_forward_latency_seconds",
+                   "model=\"" + EscapeLabel(model) + "\",batch=\"" +
+                       std::to_string(batch) + "\"",
+                   *histogram);
+  }
+
+  stream << "# HELP kuiper_layer_seconds_total Time spent in layers by type.\n"
+         << "# TYPE kuiper_layer_seconds_total counter\n";
+  for (const auto& [key, layer_metrics] : layer_types_) {
+    const auto& [model, layer_type] = key;
+    stream << "kuiper_layer_seconds_total{model=\"" << EscapeLabel(model)
+           << "\",layer_type=\"" << EscapeLabel(layer_type) << "\"} "
+           << double(layer_metrics->nanoseconds.load(
+                  std::memory_order_relaxed)) /
+                  1e9
+           << "\n";
+  }
+
+  stream << "# HELP kuiper_layer_calls_total Number of layer executions by "
+            "type.\n"
+         << "# TYPE kuiper_layer_calls_total counter\n";
+  for (const auto& [key, layer_metrics] : layer_types_) {
+    const auto& [model, layer_type] = key;
+    stream << "kuiper_layer_calls_total{model=\"" << EscapeLabel(model)
+           << "\",layer_type=\"" << EscapeLabel(layer_type) << "\"} "
+           << layer_metrics->calls.load(std::memory_order_relaxed) << "\n";
+  }
+
+  stream << "# HELP kuiper_queue_depth Forward calls currently in flight.\n"
+         << "# TYPE kuiper_queue_depth gauge\n";
+  for (const auto& [model, model_metrics] : models_) {
+    stream << "kuiper_queue_depth{model=\"" << EscapeLabel(model) << "\"} "
+           << model_metrics->queue_depth.load(std::memory_order_relaxed)
+           << "\n";
+  }
+
+  stream << "# HELP kuiper_pool_memory_bytes Memory held by operator "
+            "outputs.\n"
+         << "# TYPE kuiper_pool_memory_bytes gauge\n";
+  for (const auto& [model, model_metrics] : models_) {
+    stream << "kuiper_pool_memory_bytes{model=\"" << EscapeLabel(model)
+           << "\"} "
+           << model_metrics->pool_memory_bytes.load(std::memory_order_relaxed)
+           << "\n";
+  }
+
+  stream << "# HELP kuiper_forward_allocations Tensor allocations per Forward "
+            "call.\n"
+         << "# TYPE kuiper_forward_allocations histogram\n";
+  for (const auto& [model, model_metrics] : models_) {
+    WriteHistogram(stream, "kuiper_forward_allocations",
+                   "model=\"" + EscapeLabel(model) + "\"",
+                   model_metrics->allocations);
+  }
+
+  stream << "# HELP kuiper_tensor_allocations_total Tensor allocations since "
+            "process start.\n"
+         << "# TYPE kuiper_tensor_allocations_total counter\n"
+         << "kuiper_tensor_allocations_total "
+         << Tensor<float>::allocation_count() << "\n";
+  return stream.str();
+}
+
+bool RuntimeMetrics::WriteTo(const std::string& path) const {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Can not open the metrics file " << tmp_path;
+      return false;
+    }
+    file << this->Exposition();
+    if (!file.good()) {
+      LOG(ERROR) << "Write the metrics file " << tmp_path << " failed";
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "Rename the metrics file to " << path << " failed";
+    return false;
+  }
+  return true;
+}
+
+/// 正在运行后台线程的导出器数量
+static std::atomic<uint32_t> kRunningExporters{0};
+
+MetricsExporter::~MetricsExporter() { this->Stop(); }
+
+bool MetricsExporter::StartHttp(uint16_t port) {
+  CHECK(!running_) << "The metrics exporter is already running";
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    LOG(ERROR) << "Create the metrics socket failed";
+    return false;
+  }
+  const int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  socklen_t address_len = sizeof(address);
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), address_len) !=
+          0 ||
+      listen(listen_fd_, 16) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                  &address_len) != 0) {
+    LOG(ERROR) << "Listen on the metrics port " << port << " failed";
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  port_ = ntohs(address.sin_port);
+  running_ = true;
+  kRunningExporters.fetch_add(1);
+  worker_ = std::thread(&MetricsExporter::ServeHttp, this);
+  return true;
+}
+
+bool MetricsExporter::StartFile(const std::string& path,
+                                uint32_t interval_ms) {
+  CHECK(!running_) << "The metrics exporter is already running";
+  CHECK_GT(interval_ms, 0);
+  if (!RuntimeMetrics::Instance().WriteTo(path)) {
+    return false;
+  }
+  running_ = true;
+  kRunningExporters.fetch_add(1);
+  worker_ = std::thread(&MetricsExporter::WriteFile, this, path, interval_ms);
+  return true;
+}
+
+void MetricsExporter::Stop() {
+  running_ = false;
+  if (worker_.joinable()) {
+    worker_.join();
+    kRunningExporters.fetch_sub(1);
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+  port_ = 0;
+}
+
+uint16_t MetricsExporter::port() const { return this->port_; }
+
+uint32_t MetricsExporter::running_exporters() {
+  return kRunningExporters.load();
+}
+
+void MetricsExporter::ServeHttp() {
+  // 使用poll等待连接，保证Stop之后能在一个超时周期内退出
+  const int timeout_ms = 100;
+  while (running_) {
+    pollfd listen_poll{listen_fd_, POLLIN, 0};
+    if (poll(&listen_poll, 1, timeout_ms) <= 0) {
+      continue;
+    }
+    const int client_fd = accept(listen_fd_, nullptr, nullptr);
+    if (client_fd < 0) {
+      continue;
+    }
+
+    // 只读取请求行和请求头，请求体不会被用到
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < 8192) {
+      pollfd client_poll{client_fd, POLLIN, 0};
+      if (poll(&client_poll, 1, timeout_ms) <= 0) {
+        break;
+      }
+      const ssize_t read_size = recv(client_fd, buffer, sizeof(buffer), 0);
+      if (read_size <= 0) {
+        break;
+      }
+      request.append(buffer, read_size);
+    }
+
+    std::string status = "404 Not Found";
+    std::string body = "Not Found\n";
+    if (request.rfind("GET /metrics ", 0) == 0 ||
+        request.rfind("GET / ", 0) == 0) {
+      status = "200 OK";
+      body = RuntimeMetrics::Instance().Exposition();
+    }
+    const std::string response =
+        "HTTP/1.1 " + status +
+        "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+      const ssize_t sent_size = send(client_fd, response.data() + sent,
+                                     response.size() - sent, MSG_NOSIGNAL);
+      if (sent_size <= 0) {
+        break;
+      }
+      sent += sent_size;
+    }
+    close(client_fd);
+  }
+}
+
+void MetricsExporter::WriteFile(const std::string& path,
+                                uint32_t interval_ms) {
+  // 分段等待，保证Stop之后能尽快退出
+  const uint32_t slice_ms = std::min<uint32_t>(interval_ms, 100);
+  uint32_t waited_ms = 0;
+  while (running_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(slice_ms));
+    waited_ms += slice_ms;
+    if (waited_ms >= interval_ms) {
+      waited_ms = 0;
+      RuntimeMetrics::Instance().WriteTo(path);
+    }
+  }
+  RuntimeMetrics::Instance().WriteTo(path);
+}
+
+}  // namespace kuiper_infer
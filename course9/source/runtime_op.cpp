@@ -65,22 +65,18 @@ void RuntimeOperatorUtils::InitOperatorInput(
 }
 
 void RuntimeOperatorUtils::InitOperatorOutput(
-    const std::vector<pnnx::Operator*>& pnnx_operators,
+    const std::vector<pnnx::Operand*>& pnnx_outputs,
     const std::vector<std::shared_ptr<RuntimeOperator>>& operators) {
-  CHECK(!pnnx_operators.empty() && !operators.empty());
-  CHECK(pnnx_operators.size() == operators.size());
-  for (uint32_t i = 0; i < pnnx_operators.size(); ++i) {
-    // 得到pnnx原有的输出空间
-    const std::vector<pnnx::Operand*> operands = pnnx_operators.at(i)->outputs;
-    CHECK(operands.size() <= 1) << "Only support one node one output yet!";
-    if (operands.empty()) {
+  CHECK(!pnnx_outputs.empty() && !operators.empty());
+  CHECK(pnnx_outputs.size() == operators.size());
+  for (uint32_t i = 0; i < pnnx_outputs.size(); ++i) {
+    // 得到pnnx原有的输出空间，一个计算节点只有一个输出，
+    // pnnx中有多个输出的节点在初始化计算图时已经拆分为多个计算节点
+    pnnx::Operand* operand = pnnx_outputs.at(i);
+    if (operand == nullptr) {
       continue;
     }
-    CHECK(operands.size() == 1) << "Only support one output in the KuiperInfer";
-    // 一个节点仅支持一个输出，实际上在pnnx中一个节点拥有两个不同输出的情况也是不存在的
-    pnnx::Operand* operand = operands.front();
     const auto& runtime_op = operators.at(i);
-    CHECK(operand != nullptr) << "Operand output is null";
     const std::vector<int32_t>& operand_shapes = operand->shape;
     // 得到需要初始化的输出空间
     const auto& output_tensors = runtime_op->output_operands;
@@ -0,0 +1,272 @@
+//
+// Created by fss on 23-9-11.
+//
+
+#include "runtime/runtime_record.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+namespace kuiper_infer {
+
+/// 日志文件头，依次为魔数和版本号
+static constexpr char kRecordMagic[4] = {'K', 'I', 'R', 'L'};
+static constexpr uint32_t kRecordVersion = 1;
+
+template <typename T>
+static void WriteValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool ReadValue(std::ifstream& file, T& value) {
+  file.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return file.good();
+}
+
+ForwardRecorder::ForwardRecorder(const std::string& path,
+                                 uint32_t queue_capacity)
+    : queue_capacity_(queue_capacity),
+      file_(path, std::ios::out | std::ios::binary | std::ios::trunc) {
+  CHECK(queue_capacity > 0) << "The record queue capacity should be positive";
+  if (!file_.is_open()) {
+    LOG(ERROR) << "Can not open the record file " << path;
+    return;
+  }
+  file_.write(kRecordMagic, sizeof(kRecordMagic));
+  WriteValue(file_, kRecordVersion);
+  writer_ = std::thread(&ForwardRecorder::WriteLoop, this);
+}
+
+ForwardRecorder::~ForwardRecorder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_one();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  if (dropped_ > 0) {
+    LOG(WARNING) << "Dropped " << dropped_
+                 << " records because the record queue was full";
+  }
+}
+
+bool ForwardRecorder::is_open() const { return file_.is_open(); }
+
+void ForwardRecorder::Record(const std::vector<sftensor>& inputs,
+                             int64_t start_ns, int64_t latency_ns) {
+  if (!file_.is_open()) {
+    return;
+  }
+  // 调用方在推理之后可能改写输入，先在锁外拷贝一份
+  ForwardRecord record;
+  record.latency_ns = latency_ns;
+  record.inputs.reserve(inputs.size());
+  for (const sftensor& input : inputs) {
+    CHECK(input != nullptr && !input->empty());
+    record.inputs.push_back(TensorClone(input));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= queue_capacity_) {
+      dropped_ += 1;
+      return;
+    }
+    if (first_start_ns_ < 0) {
+      first_start_ns_ = start_ns;
+    }
+    record.offset_ns = start_ns - first_start_ns_;
+    queue_.push_back(std::move(record));
+  }
+  queue_cv_.notify_one();
+}
+
+void ForwardRecorder::WriteLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      break;
+    }
+    ForwardRecord record = std::move(queue_.front());
+    queue_.pop_front();
+    writing_ = true;
+    lock.unlock();
+
+    // 每条记录依次为相对时间、耗时、张量数量，以及每个张量的维度和数据
+    WriteValue(file_, record.offset_ns);
+    WriteValue(file_, record.latency_ns);
+    WriteValue(file_, uint32_t(record.inputs.size()));
+    for (const sftensor& input : record.inputs) {
+      const std::vector<uint32_t>& shapes = input->raw_shapes();
+      WriteValue(file_, uint32_t(shapes.size()));
+      file_.write(reinterpret_cast<const char*>(shapes.data()),
+                  shapes.size() * sizeof(uint32_t));
+      file_.write(reinterpret_cast<const char*>(
+                      std::as_const(*input).data().memptr()),
+                  input->size() * sizeof(float));
+    }
+    file_.flush();
+
+    lock.lock();
+    writing_ = false;
+    records_ += 1;
+    if (queue_.empty()) {
+      drained_cv_.notify_all();
+    }
+  }
+  drained_cv_.notify_all();
+}
+
+void ForwardRecorder::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  drained_cv_.wait(lock, [this] {
+    return (queue_.empty() && !writing_) || !writer_.joinable();
+  });
+}
+
+uint64_t ForwardRecorder::records() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_;
+}
+
+uint64_t ForwardRecorder::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+bool LoadForwardRecords(const std::string& path,
+                        std::vector<ForwardRecord>& records) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Can not open the record file " << path;
+    return false;
+  }
+  char magic[4];
+  uint32_t version = 0;
+  file.read(magic, sizeof(magic));
+  if (!file.good() || std::memcmp(magic, kRecordMagic, sizeof(magic)) != 0 ||
+      !ReadValue(file, version) || version != kRecordVersion) {
+    LOG(ERROR) << "The record file " << path << " has an unknown format";
+    return false;
+  }
+
+  file.seekg(0, std::ios::end);
+  const uint64_t file_size = uint64_t(file.tellg());
+  file.seekg(sizeof(kRecordMagic) + sizeof(kRecordVersion), std::ios::beg);
+
+  records.clear();
+  while (true) {
+    ForwardRecord record;
+    uint32_t input_size = 0;
+    if (!ReadValue(file, record.offset_ns) ||
+        !ReadValue(file, record.latency_ns) || !ReadValue(file, input_size)) {
+      break;
+    }
+    bool complete = true;
+    for (uint32_t i = 0; i < input_size && complete; ++i) {
+      uint32_t dims = 0;
+      if (!ReadValue(file, dims) || dims == 0 || dims > 3) {
+        complete = false;
+        break;
+      }
+      std::vector<uint32_t> shapes(dims);
+      file.read(reinterpret_cast<char*>(shapes.data()),
+                dims * sizeof(uint32_t));
+      if (!file.good()) {
+        complete = false;
+        break;
+      }
+      // 分配之前检查维度，损坏的维度不会导致申请超出文件剩余大小的内存
+      const uint64_t remaining_bytes = file_size - uint64_t(file.tellg());
+      uint64_t elements = 1;
+      for (const uint32_t dim : shapes) {
+        if (dim == 0 || elements > remaining_bytes / sizeof(float) / dim) {
+          elements = 0;
+          break;
+        }
+        elements *= dim;
+      }
+      if (elements == 0 || elements * sizeof(float) > remaining_bytes) {
+        complete = false;
+        break;
+      }
+      sftensor input = std::make_shared<ftensor>(shapes);
+      file.read(reinterpret_cast<char*>(input->raw_ptr()),
+                input->size() * sizeof(float));
+      if (!file.good()) {
+        complete = false;
+        break;
+      }
+      record.inputs.push_back(input);
+    }
+    if (!complete) {
+      LOG(WARNING) << "Ignore the incomplete record at the end of " << path;
+      break;
+    }
+    records.push_back(std::move(record));
+  }
+  return true;
+}
+
+LatencyReport LatencyReport::FromSamples(std::vector<double> latencies,
+                                         double elapsed_ms) {
+  LatencyReport report;
+  if (latencies.empty()) {
+    return report;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  const auto percentile = [&latencies](double ratio) {
+    const size_t index = std::min(
+        latencies.size() - 1, size_t(ratio * double(latencies.size() - 1) + 0.5));
+    return latencies.at(index);
+  };
+  report.samples = latencies.size();
+  double sum = 0.;
+  for (const double latency : latencies) {
+    sum += latency;
+  }
+  report.mean = sum / double(latencies.size());
+  report.p50 = percentile(0.5);
+  report.p90 = percentile(0.9);
+  report.p99 = percentile(0.99);
+  report.max = latencies.back();
+  if (elapsed_ms > 0) {
+    report.throughput = double(latencies.size()) / elapsed_ms * 1e3;
+  }
+  return report;
+}
+
+LatencyReport ReplayForwardRecords(RuntimeGraph& graph,
+                                   const std::vector<ForwardRecord>& records,
+                                   bool recorded_rate) {
+  std::vector<double> latencies;
+  latencies.reserve(records.size());
+  const auto replay_start = std::chrono::steady_clock::now();
+  for (const ForwardRecord& record : records) {
+    if (recorded_rate) {
+      // 按录制时的相对时间到达，前一次推理超时则立即执行
+      std::this_thread::sleep_until(replay_start +
+                                    std::chrono::nanoseconds(record.offset_ns));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    graph.Forward(record.inputs, false);
+    latencies.push_back(std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+  }
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - replay_start)
+                                .count();
+  return LatencyReport::FromSamples(std::move(latencies), elapsed_ms);
+}
+
+}  // namespace kuiper_infer
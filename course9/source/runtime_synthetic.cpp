@@ -0,0 +1,257 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#include "runtime/runtime_synthetic.hpp"
+#include <glog/logging.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "runtime/ir.h"
+
+namespace kuiper_infer {
+
+/// 逐个添加节点和张量，同时统计计算图的信息
+class SyntheticGraphBuilder {
+ public:
+  SyntheticGraphBuilder(pnnx::Graph &graph, uint32_t seed, uint32_t batch,
+                        SyntheticGraphReport &report)
+      : graph_(graph), generator_(seed), batch_(batch), report_(report) {}
+
+  /**
+   * 添加一个节点，输入和输出节点使用固定的名称，其余节点的名称由类型和序号组成
+   * @param type 节点的类型
+   * @param inputs 节点的输入张量
+   * @return 添加的节点
+   */
+  pnnx::Operator *NewOperator(const std::string &type,
+                              const std::vector<pnnx::Operand *> &inputs) {
+    std::string name;
+    if (type == "pnnx.Input") {
+      name = "pnnx_input_0";
+    } else if (type == "pnnx.Output") {
+      name = "pnnx_output_0";
+    } else {
+      name = type.substr(type.find('.') + 1) + "_" +
+             std::to_string(graph_.ops.size());
+    }
+    pnnx::Operator *op = graph_.new_operator(type, name);
+    for (pnnx::Operand *input : inputs) {
+      op->inputs.push_back(input);
+      input->consumers.push_back(op);
+    }
+    report_.operators += 1;
+    return op;
+  }
+
+  /**
+   * 为节点添加一个形状为(batch, channels, rows, cols)的输出张量
+   */
+  pnnx::Operand *NewOutput(pnnx::Operator *op, uint32_t channels,
+                           uint32_t rows, uint32_t cols) {
+    pnnx::Operand *operand =
+        graph_.new_operand(std::to_string(graph_.operands.size()));
+    operand->producer = op;
+    operand->type = 1;
+    operand->shape = {int(batch_), int(channels), int(rows), int(cols)};
+    op->outputs.push_back(operand);
+    report_.operands += 1;
+    report_.activation_bytes +=
+        uint64_t(batch_) * channels * rows * cols * sizeof(float);
+    return operand;
+  }
+
+  /**
+   * 添加卷积和紧随其后的ReLU，权重按输入的扇入随机初始化，保持各层输出的幅值稳定
+   * @param input 输入张量
+   * @param out_channels 输出的通道数
+   * @param kernel_size 卷积核的大小，只能是1或者3，输出和输入的尺寸相同
+   * @return ReLU的输出张量
+   */
+  pnnx::Operand *ConvRelu(pnnx::Operand *input, uint32_t out_channels,
+                          uint32_t kernel_size) {
+    const uint32_t in_channels = input->shape.at(1);
+    const uint32_t rows = input->shape.at(2);
+    const uint32_t cols = input->shape.at(3);
+    const int kernel = int(kernel_size);
+    const int padding = int(kernel_size / 2);
+
+    pnnx::Operator *conv = NewOperator("nn.Conv2d", {input});
+    conv->params["in_channels"] = int(in_channels);
+    conv->params["out_channels"] = int(out_channels);
+    conv->params["kernel_size"] = {kernel, kernel};
+    conv->params["stride"] = {1, 1};
+    conv->params["padding"] = {padding, padding};
+    conv->params["dilation"] = {1, 1};
+    conv->params["groups"] = 1;
+    conv->params["bias"] = true;
+    conv->params["padding_mode"] = "zeros";
+
+    const uint32_t fan_in = in_channels * kernel_size * kernel_size;
+    const float bound = std::sqrt(3.f / float(fan_in));
+    std::uniform_real_distribution<float> weight_dist(-bound, bound);
+    std::vector<float> weights(uint64_t(out_channels) * fan_in);
+    for (float &weight : weights) {
+      weight = weight_dist(generator_);
+    }
+    std::uniform_real_distribution<float> bias_dist(-0.1f, 0.1f);
+    std::vector<float> bias(out_channels);
+    for (float &value : bias) {
+      value = bias_dist(generator_);
+    }
+    conv->attrs["weight"] = FloatAttribute(
+        {int(out_channels), int(in_channels), kernel, kernel}, weights);
+    conv->attrs["bias"] = FloatAttribute({int(out_channels)}, bias);
+    report_.convolutions += 1;
+    report_.weight_bytes += (weights.size() + bias.size()) * sizeof(float);
+    pnnx::Operand *conv_output = NewOutput(conv, out_channels, rows, cols);
+
+    pnnx::Operator *relu = NewOperator("nn.ReLU", {conv_output});
+    report_.activations += 1;
+    return NewOutput(relu, out_channels, rows, cols);
+  }
+
+  /// 沿通道拼接多个形状相同的张量
+  pnnx::Operand *Cat(const std::vector<pnnx::Operand *> &inputs) {
+    pnnx::Operator *cat = NewOperator("torch.cat", inputs);
+    cat->params["dim"] = 1;
+    uint32_t channels = 0;
+    for (const pnnx::Operand *input : inputs) {
+      channels += input->shape.at(1);
+    }
+    report_.concats += 1;
+    return NewOutput(cat, channels, inputs.front()->shape.at(2),
+                     inputs.front()->shape.at(3));
+  }
+
+  /// 两个形状相同的张量相加
+  pnnx::Operand *Add(pnnx::Operand *input1, pnnx::Operand *input2) {
+    pnnx::Operator *add = NewOperator("pnnx.Expression", {input1, input2});
+    add->params["expr"] = "add(@0,@1)";
+    report_.residuals += 1;
+    return NewOutput(add, input1->shape.at(1), input1->shape.at(2),
+                     input1->shape.at(3));
+  }
+
+  /// 核大小和步长都为2的最大池化，奇数的尺寸向下取整
+  pnnx::Operand *MaxPool(pnnx::Operand *input) {
+    pnnx::Operator *pool = NewOperator("nn.MaxPool2d", {input});
+    pool->params["kernel_size"] = {2, 2};
+    pool->params["stride"] = {2, 2};
+    pool->params["padding"] = {0, 0};
+    pool->params["dilation"] = {1, 1};
+    pool->params["ceil_mode"] = false;
+    pool->params["return_indices"] = false;
+    report_.pools += 1;
+    return NewOutput(pool, input->shape.at(1), input->shape.at(2) / 2,
+                     input->shape.at(3) / 2);
+  }
+
+  /// 返回[low, high]之间均匀分布的随机整数
+  uint32_t RandomInt(uint32_t low, uint32_t high) {
+    return std::uniform_int_distribution<uint32_t>(low, high)(generator_);
+  }
+
+  /// 按概率返回true
+  bool RandomBool(float probability) {
+    return std::uniform_real_distribution<float>(0.f, 1.f)(generator_) <
+           probability;
+  }
+
+ private:
+  static pnnx::Attribute FloatAttribute(const std::vector<int> &shape,
+                                        const std::vector<float> &values) {
+    pnnx::Attribute attribute;
+    attribute.type = 1;
+    attribute.shape = shape;
+    attribute.data.resize(values.size() * sizeof(float));
+    std::memcpy(attribute.data.data(), values.data(), attribute.data.size());
+    return attribute;
+  }
+
+ private:
+  pnnx::Graph &graph_;
+  std::mt19937 generator_;
+  uint32_t batch_ = 1;
+  SyntheticGraphReport &report_;
+};
+
+bool GenerateSyntheticGraph(const SyntheticGraphOptions &options,
+                            const std::string &param_path,
+                            const std::string &bin_path,
+                            SyntheticGraphReport *report) {
+  if (options.branches == 0 || options.branch_length == 0 ||
+      options.input_channels == 0 || options.channels == 0 ||
+      options.input_h == 0 || options.input_w == 0 || options.batch == 0) {
+    LOG(ERROR) << "The branches, branch length, channels, input size and "
+                  "batch of the synthetic graph should be greater than zero";
+    return false;
+  }
+  if (options.residual_density < 0.f || options.residual_density > 1.f) {
+    LOG(ERROR) << "The residual density of the synthetic graph should be in "
+                  "[0, 1]";
+    return false;
+  }
+
+  pnnx::Graph graph;
+  SyntheticGraphReport graph_report;
+  SyntheticGraphBuilder builder(graph, options.seed, options.batch,
+                                graph_report);
+
+  pnnx::Operator *input_op = builder.NewOperator("pnnx.Input", {});
+  pnnx::Operand *input = builder.NewOutput(
+      input_op, options.input_channels, options.input_h, options.input_w);
+  pnnx::Operand *x = builder.ConvRelu(input, options.channels, 3);
+
+  // 和当前阶段输入形状相同、可以作为残差来源的张量，池化之后清空
+  std::vector<pnnx::Operand *> residual_sources{x};
+  for (uint32_t stage = 0; stage < options.depth; ++stage) {
+    const uint32_t branches = builder.RandomInt(1, options.branches);
+    std::vector<pnnx::Operand *> branch_outputs;
+    for (uint32_t b = 0; b < branches; ++b) {
+      pnnx::Operand *y = x;
+      const uint32_t length = builder.RandomInt(1, options.branch_length);
+      for (uint32_t i = 0; i < length; ++i) {
+        const uint32_t kernel_size = builder.RandomBool(0.25f) ? 1 : 3;
+        y = builder.ConvRelu(y, options.channels, kernel_size);
+      }
+      branch_outputs.push_back(y);
+    }
+
+    pnnx::Operand *stage_output = branch_outputs.front();
+    if (branches > 1) {
+      stage_output =
+          builder.ConvRelu(builder.Cat(branch_outputs), options.channels, 1);
+    }
+    if (builder.RandomBool(options.residual_density)) {
+      const uint32_t source =
+          builder.RandomInt(0, uint32_t(residual_sources.size()) - 1);
+      stage_output = builder.Add(stage_output, residual_sources.at(source));
+    }
+    x = stage_output;
+    residual_sources.push_back(x);
+
+    if (options.pool_every > 0 && (stage + 1) % options.pool_every == 0 &&
+        x->shape.at(2) >= 2 && x->shape.at(3) >= 2) {
+      x = builder.MaxPool(x);
+      residual_sources = {x};
+    }
+  }
+  builder.NewOperator("pnnx.Output", {x});
+
+  graph_report.output_channels = x->shape.at(1);
+  graph_report.output_h = x->shape.at(2);
+  graph_report.output_w = x->shape.at(3);
+  if (graph.save(param_path, bin_path) != 0) {
+    LOG(ERROR) << "Save the synthetic graph to " << param_path << " and "
+               << bin_path << " failed";
+    return false;
+  }
+  if (report != nullptr) {
+    *report = graph_report;
+  }
+  return true;
+}
+
+}  // namespace kuiper_infer
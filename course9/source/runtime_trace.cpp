@@ -0,0 +1,235 @@
+//
+// Created by fss on 23-9-10.
+//
+
+#include "runtime/runtime_trace.hpp"
+#include <glog/logging.h>
+#include <unistd.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace kuiper_infer {
+
+/// 环形缓冲区默认保存的事件数量，每个事件约五十字节
+static constexpr uint32_t kTraceCapacity = 16384;
+
+/// 信号处理函数和写文件线程之间的管道，信号处理函数中只允许调用write
+static int kTraceSignalPipe[2] = {-1, -1};
+
+static void TraceSignalHandler(int) {
+  const char signal_byte = 1;
+  const ssize_t write_size = write(kTraceSignalPipe[1], &signal_byte, 1);
+  (void)write_size;
+}
+
+RuntimeTracer::RuntimeTracer()
+    : slots_(new TraceSlot[kTraceCapacity]), capacity_(kTraceCapacity) {}
+
+RuntimeTracer& RuntimeTracer::Instance() {
+  static RuntimeTracer tracer;
+  return tracer;
+}
+
+uint32_t RuntimeTracer::RegisterGraph(
+    const std::vector<std::shared_ptr<RuntimeOperator>>& topo_operators) {
+  std::vector<std::pair<std::string, std::string>> operators;
+  for (const auto& op : topo_operators) {
+    CHECK(op != nullptr);
+    operators.emplace_back(op->name, op->type);
+  }
+  std::lock_guard<std::mutex> lock(graphs_mutex_);
+  graphs_.push_back(std::move(operators));
+  return graphs_.size() - 1;
+}
+
+uint64_t RuntimeTracer::NextRunId() {
+  return run_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RuntimeTracer::Write(const TraceEvent& event) {
+  const uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot& slot = slots_[index % capacity_];
+  // 写入前后各更新一次序号，读取方据此判断槽位是否被完整写入
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.run_id.store(event.run_id, std::memory_order_relaxed);
+  slot.graph_id.store(event.graph_id, std::memory_order_relaxed);
+  slot.op_index.store(event.op_index, std::memory_order_relaxed);
+  slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(event.duration_ns, std::memory_order_relaxed);
+  slot.slow.store(event.slow, std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void RuntimeTracer::Commit(uint32_t graph_id, uint64_t run_id,
+                           const TraceSpan& run_span,
+                           const std::vector<TraceSpan>& spans, bool slow) {
+  TraceEvent event;
+  event.run_id = run_id;
+  event.graph_id = graph_id;
+  event.slow = slow;
+  event.start_ns = run_span.start_ns;
+  event.duration_ns = run_span.duration_ns;
+  this->Write(event);
+  for (uint32_t i = 0; i < spans.size(); ++i) {
+    // 输入和输出节点没有计算，不记录
+    if (spans.at(i).duration_ns < 0) {
+      continue;
+    }
+    event.op_index = int32_t(i);
+    event.start_ns = spans.at(i).start_ns;
+    event.duration_ns = spans.at(i).duration_ns;
+    this->Write(event);
+  }
+}
+
+std::vector<TraceEvent> RuntimeTracer::Snapshot() const {
+  std::vector<TraceEvent> events;
+  for (uint32_t i = 0; i < capacity_; ++i) {
+    const TraceSlot& slot = slots_[i];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || sequence % 2 == 1) {
+      continue;
+    }
+    TraceEvent event;
+    event.run_id = slot.run_id.load(std::memory_order_relaxed);
+    event.graph_id = slot.graph_id.load(std::memory_order_relaxed);
+    event.op_index = slot.op_index.load(std::memory_order_relaxed);
+    event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+    event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+    event.slow = slot.slow.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    events.push_back(event);
+  }
+  std::sort(events.begin(), events.end(),
+            [](const TraceEvent& a, const TraceEvent& b) {
+              return a.run_id != b.run_id ? a.run_id < b.run_id
+                                          : a.start_ns < b.start_ns;
+            });
+  return events;
+}
+
+static std::string EscapeJson(const std::string& value) {
+  std::string escaped;
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+std::string RuntimeTracer::DumpJson() const {
+  const std::vector<TraceEvent>& events = this->Snapshot();
+  std::ostringstream stream;
+  stream.precision(15);
+  stream << "{\"traceEvents\":[";
+  std::lock_guard<std::mutex> lock(graphs_mutex_);
+  bool first = true;
+  for (const TraceEvent& event : events) {
+    std::string name = "Forward";
+    std::string type = "graph";
+    if (event.graph_id < graphs_.size() && event.op_index >= 0 &&
+        event.op_index < graphs_.at(event.graph_id).size()) {
+      const auto& op = graphs_.at(event.graph_id).at(event.op_index);
+      name = op.first;
+      type = op.second;
+    }
+    if (!first) {
+      stream << ",";
+    }
+    first = false;
+    // 每次推理对应一个tid，时间单位为微秒
+    stream << "\n{\"name\":\"" << EscapeJson(name) << "\",\"cat\":\""
+           << EscapeJson(type) << "\",\"ph\":\"X\",\"pid\":" << event.graph_id
+           << ",\"tid\":" << event.run_id
+           << ",\"ts\":" << double(event.start_ns) / 1e3
+           << ",\"dur\":" << double(event.duration_ns) / 1e3
+           << ",\"args\":{\"slow\":" << (event.slow ? "true" : "false") << "}}";
+  }
+  stream << "\n]}\n";
+  return stream.str();
+}
+
+bool RuntimeTracer::DumpToFile(const std::string& path) const {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Can not open the trace file " << tmp_path;
+      return false;
+    }
+    file << this->DumpJson();
+    if (!file.good()) {
+      LOG(ERROR) << "Write the trace file " << tmp_path << " failed";
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "Rename the trace file to " << path << " failed";
+    return false;
+  }
+  return true;
+}
+
+bool RuntimeTracer::InstallSignalHandler(const std::string& path) {
+  CHECK(!path.empty());
+  {
+    std::lock_guard<std::mutex> lock(graphs_mutex_);
+    if (kTraceSignalPipe[0] >= 0) {
+      signal_path_ = path;
+      return true;
+    }
+    if (pipe(kTraceSignalPipe) != 0) {
+      LOG(ERROR) << "Create the trace signal pipe failed";
+      return false;
+    }
+    signal_path_ = path;
+  }
+
+  // 写文件需要分配内存和加锁，不能在信号处理函数中完成，交给后台线程
+  std::thread([this]() {
+    char signal_byte = 0;
+    while (read(kTraceSignalPipe[0], &signal_byte, 1) > 0) {
+      std::string path;
+      {
+        std::lock_guard<std::mutex> lock(graphs_mutex_);
+        path = signal_path_;
+      }
+      if (this->DumpToFile(path)) {
+        LOG(INFO) << "Dump the runtime trace to " << path;
+      }
+    }
+  }).detach();
+
+  struct sigaction action {};
+  action.sa_handler = TraceSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(SIGUSR1, &action, nullptr) != 0) {
+    LOG(ERROR) << "Install the SIGUSR1 handler failed";
+    return false;
+  }
+  return true;
+}
+
+bool RuntimeTracer::signal_handler_installed() const {
+  std::lock_guard<std::mutex> lock(graphs_mutex_);
+  return kTraceSignalPipe[0] >= 0;
+}
+
+uint32_t RuntimeTracer::capacity() const { return this->capacity_; }
+
+}  // namespace kuiper_infer
@@ -4,12 +4,25 @@
 
 #include "data/tensor.hpp"
 #include <glog/logging.h>
+#include <atomic>
 #include <memory>
 #include <numeric>
+#include "utils/math/transpose.hpp"
 
 namespace kuiper_infer {
+static std::atomic<uint64_t> kTensorAllocations{0};
+
+/// 分配张量的数据内存并计数，不包括空张量和外部内存
+template <typename... Args>
+static std::shared_ptr<arma::fcube> AllocateCube(Args &&...args) {
+  kTensorAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::make_shared<arma::fcube>(std::forward<Args>(args)...);
+}
+
+Tensor<float>::Tensor() : data_(std::make_shared<arma::fcube>()) {}
+
 Tensor<float>::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
-  data_ = arma::fcube(rows, cols, channels);
+  data_ = AllocateCube(rows, cols, channels);
   if (channels == 1 && rows == 1) {
     this->raw_shapes_ = std::vector<uint32_t>{cols};
   } else if (channels == 1) {
@@ -20,12 +33,12 @@ Tensor<float>::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
 }
 
 Tensor<float>::Tensor(uint32_t size) {
-  data_ = arma::fcube(1, size, 1);
+  data_ = AllocateCube(1, size, 1);
   this->raw_shapes_ = std::vector<uint32_t>{size};
 }
 
 Tensor<float>::Tensor(uint32_t rows, uint32_t cols) {
-  data_ = arma::fcube(rows, cols, 1);
+  data_ = AllocateCube(rows, cols, 1);
   this->raw_shapes_ = std::vector<uint32_t>{rows, cols};
 }
 
@@ -40,7 +53,22 @@ Tensor<float>::Tensor(const std::vector<uint32_t> &shapes) {
   uint32_t rows = shapes_.at(1);
   uint32_t cols = shapes_.at(2);
 
-  data_ = arma::fcube(rows, cols, channels);
+  data_ = AllocateCube(rows, cols, channels);
+  if (channels == 1 && rows == 1) {
+    this->raw_shapes_ = std::vector<uint32_t>{cols};
+  } else if (channels == 1) {
+    this->raw_shapes_ = std::vector<uint32_t>{rows, cols};
+  } else {
+    this->raw_shapes_ = std::vector<uint32_t>{channels, rows, cols};
+  }
+}
+
+Tensor<float>::Tensor(float *raw_ptr, uint32_t channels, uint32_t rows,
+                      uint32_t cols)
+    : data_(std::make_shared<arma::fcube>(raw_ptr, rows, cols, channels, false,
+                                          true)),
+      external_memory_(true) {
+  CHECK(raw_ptr != nullptr);
   if (channels == 1 && rows == 1) {
     this->raw_shapes_ = std::vector<uint32_t>{cols};
   } else if (channels == 1) {
@@ -50,9 +78,22 @@ Tensor<float>::Tensor(const std::vector<uint32_t> &shapes) {
   }
 }
 
+Tensor<float>::Tensor(float *raw_ptr, const std::vector<uint32_t> &shapes)
+    : Tensor(raw_ptr, shapes.size() >= 3 ? shapes.at(shapes.size() - 3) : 1,
+             shapes.size() >= 2 ? shapes.at(shapes.size() - 2) : 1,
+             shapes.empty() ? 0 : shapes.back()) {
+  CHECK(!shapes.empty() && shapes.size() <= 3);
+  this->raw_shapes_ = shapes;
+}
+
 Tensor<float>::Tensor(const Tensor &tensor) {
   if (this != &tensor) {
-    this->data_ = tensor.data_;
+    // 外部内存的生命周期不由张量管理，不能共享
+    if (tensor.external_memory_) {
+      this->data_ = AllocateCube(*tensor.data_);
+    } else {
+      this->data_ = tensor.data_;
+    }
     this->raw_shapes_ = tensor.raw_shapes_;
   }
 }
@@ -61,6 +102,7 @@ Tensor<float>::Tensor(Tensor<float> &&tensor) noexcept {
   if (this != &tensor) {
     this->data_ = std::move(tensor.data_);
     this->raw_shapes_ = tensor.raw_shapes_;
+    this->external_memory_ = tensor.external_memory_;
   }
 }
 
@@ -68,96 +110,140 @@ Tensor<float> &Tensor<float>::operator=(Tensor<float> &&tensor) noexcept {
   if (this != &tensor) {
     this->data_ = std::move(tensor.data_);
     this->raw_shapes_ = tensor.raw_shapes_;
+    this->external_memory_ = tensor.external_memory_;
   }
   return *this;
 }
 
 Tensor<float> &Tensor<float>::operator=(const Tensor &tensor) {
   if (this != &tensor) {
-    this->data_ = tensor.data_;
+    if (tensor.external_memory_) {
+      this->data_ = AllocateCube(*tensor.data_);
+    } else {
+      this->data_ = tensor.data_;
+    }
     this->raw_shapes_ = tensor.raw_shapes_;
+    this->external_memory_ = false;
   }
   return *this;
 }
 
+Tensor<float> Tensor<float>::Clone() const {
+  Tensor<float> tensor;
+  if (this->data_ != nullptr) {
+    tensor.data_ = AllocateCube(*this->data_);
+  }
+  tensor.raw_shapes_ = this->raw_shapes_;
+  return tensor;
+}
+
+uint64_t Tensor<float>::allocation_count() {
+  return kTensorAllocations.load(std::memory_order_relaxed);
+}
+
+bool Tensor<float>::is_shared() const {
+  return this->data_ != nullptr && this->data_.use_count() > 1;
+}
+
+void Tensor<float>::Detach() {
+  if (this->data_ == nullptr) {
+    this->data_ = std::make_shared<arma::fcube>();
+  } else if (this->data_.use_count() > 1) {
+    CHECK(!this->external_memory_);
+    this->data_ = AllocateCube(*this->data_);
+  }
+}
+
 uint32_t Tensor<float>::rows() const {
-  CHECK(!this->data_.empty());
-  return this->data_.n_rows;
+  CHECK(!this->empty());
+  return this->data_->n_rows;
 }
 
 uint32_t Tensor<float>::cols() const {
-  CHECK(!this->data_.empty());
-  return this->data_.n_cols;
+  CHECK(!this->empty());
+  return this->data_->n_cols;
 }
 
 uint32_t Tensor<float>::channels() const {
-  CHECK(!this->data_.empty());
-  return this->data_.n_slices;
+  CHECK(!this->empty());
+  return this->data_->n_slices;
 }
 
 uint32_t Tensor<float>::size() const {
-  CHECK(!this->data_.empty());
-  return this->data_.size();
+  CHECK(!this->empty());
+  return this->data_->size();
 }
 
 void Tensor<float>::set_data(const arma::fcube &data) {
-  CHECK(data.n_rows == this->data_.n_rows)
-          << data.n_rows << " != " << this->data_.n_rows;
-  CHECK(data.n_cols == this->data_.n_cols)
-          << data.n_cols << " != " << this->data_.n_cols;
-  CHECK(data.n_slices == this->data_.n_slices)
-          << data.n_slices << " != " << this->data_.n_slices;
-  this->data_ = data;
+  this->Detach();
+  CHECK(data.n_rows == this->data_->n_rows)
+          << data.n_rows << " != " << this->data_->n_rows;
+  CHECK(data.n_cols == this->data_->n_cols)
+          << data.n_cols << " != " << this->data_->n_cols;
+  CHECK(data.n_slices == this->data_->n_slices)
+          << data.n_slices << " != " << this->data_->n_slices;
+  *this->data_ = data;
 }
 
-bool Tensor<float>::empty() const { return this->data_.empty(); }
+bool Tensor<float>::empty() const {
+  return this->data_ == nullptr || this->data_->empty();
+}
 
 float Tensor<float>::index(uint32_t offset) const {
-  CHECK(offset < this->data_.size()) << "Tensor index out of bound!";
-  return this->data_.at(offset);
+  CHECK(offset < this->size()) << "Tensor index out of bound!";
+  return this->data_->at(offset);
 }
 
 float &Tensor<float>::index(uint32_t offset) {
-  CHECK(offset < this->data_.size()) << "Tensor index out of bound!";
-  return this->data_.at(offset);
+  CHECK(offset < this->size()) << "Tensor index out of bound!";
+  this->Detach();
+  return this->data_->at(offset);
 }
 
 std::vector<uint32_t> Tensor<float>::shapes() const {
-  CHECK(!this->data_.empty());
+  CHECK(!this->empty());
   return {this->channels(), this->rows(), this->cols()};
 }
 
-arma::fcube &Tensor<float>::data() { return this->data_; }
+arma::fcube &Tensor<float>::data() {
+  this->Detach();
+  return *this->data_;
+}
 
-const arma::fcube &Tensor<float>::data() const { return this->data_; }
+const arma::fcube &Tensor<float>::data() const {
+  CHECK(this->data_ != nullptr);
+  return *this->data_;
+}
 
 arma::fmat &Tensor<float>::slice(uint32_t channel) {
   CHECK_LT(channel, this->channels());
-  return this->data_.slice(channel);
+  this->Detach();
+  return this->data_->slice(channel);
 }
 
 const arma::fmat &Tensor<float>::slice(uint32_t channel) const {
   CHECK_LT(channel, this->channels());
-  return this->data_.slice(channel);
+  return this->data_->slice(channel);
 }
 
 float Tensor<float>::at(uint32_t channel, uint32_t row, uint32_t col) const {
   CHECK_LT(row, this->rows());
   CHECK_LT(col, this->cols());
   CHECK_LT(channel, this->channels());
-  return this->data_.at(row, col, channel);
+  return this->data_->at(row, col, channel);
 }
 
 float &Tensor<float>::at(uint32_t channel, uint32_t row, uint32_t col) {
   CHECK_LT(row, this->rows());
   CHECK_LT(col, this->cols());
   CHECK_LT(channel, this->channels());
-  return this->data_.at(row, col, channel);
+  this->Detach();
+  return this->data_->at(row, col, channel);
 }
 
 void Tensor<float>::Padding(const std::vector<uint32_t> &pads,
                             float padding_value) {
-  CHECK(!this->data_.empty());
+  CHECK(!this->empty());
   CHECK_EQ(pads.size(), 4);
   // 四周填充的维度
   uint32_t pad_rows1 = pads.at(0);  // up
@@ -165,61 +251,72 @@ void Tensor<float>::Padding(const std::vector<uint32_t> &pads,
   uint32_t pad_cols1 = pads.at(2);  // left
   uint32_t pad_cols2 = pads.at(3);  // right
 
-  // 请补充代码
+  const uint32_t rows = this->rows();
+  const uint32_t cols = this->cols();
+  const uint32_t channels = this->channels();
+  auto padded = AllocateCube(
+      rows + pad_rows1 + pad_rows2, cols + pad_cols1 + pad_cols2, channels);
+  padded->fill(padding_value);
+  padded->subcube(pad_rows1, pad_cols1, 0, pad_rows1 + rows - 1,
+                  pad_cols1 + cols - 1, channels - 1) = *this->data_;
+
+  // 填充后的张量总是使用自己分配的内存
+  this->data_ = std::move(padded);
+  this->external_memory_ = false;
+  if (this->raw_shapes_.size() == 3) {
+    this->raw_shapes_ = {channels, this->rows(), this->cols()};
+  } else {
+    this->raw_shapes_ = {this->rows(), this->cols()};
+  }
 }
 
 void Tensor<float>::Fill(float value) {
-  CHECK(!this->data_.empty());
-  this->data_.fill(value);
+  CHECK(!this->empty());
+  this->Detach();
+  this->data_->fill(value);
 }
 
 void Tensor<float>::Fill(const std::vector<float> &values, bool row_major) {
-  CHECK(!this->data_.empty());
-  const uint32_t total_elems = this->data_.size();
+  CHECK(!this->empty());
+  this->Detach();
+  const uint32_t total_elems = this->data_->size();
   CHECK_EQ(values.size(), total_elems);
   if (row_major) {
-    const uint32_t rows = this->rows();
-    const uint32_t cols = this->cols();
-    const uint32_t planes = rows * cols;
-    const uint32_t channels = this->data_.n_slices;
-
-    for (uint32_t i = 0; i < channels; ++i) {
-      auto &channel_data = this->data_.slice(i);
-      const arma::fmat &channel_data_t =
-          arma::fmat((float *) values.data() + i * planes, this->cols(),
-                     this->rows(), false, true);
-      channel_data = channel_data_t.t();
-    }
+    // 行主序的rows x cols矩阵即列主序的cols x rows矩阵，逐通道转置即可
+    TransposePlanes(values.data(), this->data_->memptr(), this->cols(),
+                    this->rows(), this->channels());
   } else {
-    std::copy(values.begin(), values.end(), this->data_.memptr());
+    std::copy(values.begin(), values.end(), this->data_->memptr());
   }
 }
 
 void Tensor<float>::Show() {
   for (uint32_t i = 0; i < this->channels(); ++i) {
     LOG(INFO) << "Channel: " << i;
-    LOG(INFO) << "\n" << this->data_.slice(i);
+    LOG(INFO) << "\n" << this->data_->slice(i);
   }
 }
 
 void Tensor<float>::Flatten(bool row_major) {
-  CHECK(!this->data_.empty());
+  CHECK(!this->empty());
   // 请补充代码
 }
 
 void Tensor<float>::Rand() {
-  CHECK(!this->data_.empty());
-  this->data_.randn();
+  CHECK(!this->empty());
+  this->Detach();
+  this->data_->randn();
 }
 
 void Tensor<float>::Ones() {
-  CHECK(!this->data_.empty());
+  CHECK(!this->empty());
   this->Fill(1.f);
 }
 
 void Tensor<float>::Transform(const std::function<float(float)> &filter) {
-  CHECK(!this->data_.empty());
-  this->data_.transform(filter);
+  CHECK(!this->empty());
+  this->Detach();
+  this->data_->transform(filter);
 }
 
 const std::vector<uint32_t> &Tensor<float>::raw_shapes() const {
@@ -231,7 +328,7 @@ const std::vector<uint32_t> &Tensor<float>::raw_shapes() const {
 
 void Tensor<float>::Reshape(const std::vector<uint32_t> &shapes,
                             bool row_major) {
-  CHECK(!this->data_.empty());
+  CHECK(!this->empty());
   CHECK(!shapes.empty());
   const uint32_t origin_size = this->size();
   const uint32_t current_size =
@@ -243,14 +340,15 @@ void Tensor<float>::Reshape(const std::vector<uint32_t> &shapes,
   if (row_major) {
     values = this->values(true);
   }
+  this->Detach();
   if (shapes.size() == 3) {
-    this->data_.reshape(shapes.at(1), shapes.at(2), shapes.at(0));
+    this->data_->reshape(shapes.at(1), shapes.at(2), shapes.at(0));
     this->raw_shapes_ = {shapes.at(0), shapes.at(1), shapes.at(2)};
   } else if (shapes.size() == 2) {
-    this->data_.reshape(shapes.at(0), shapes.at(1), 1);
+    this->data_->reshape(shapes.at(0), shapes.at(1), 1);
     this->raw_shapes_ = {shapes.at(0), shapes.at(1)};
   } else {
-    this->data_.reshape(1, shapes.at(0), 1);
+    this->data_->reshape(1, shapes.at(0), 1);
     this->raw_shapes_ = {shapes.at(0)};
   }
 
@@ -260,32 +358,28 @@ void Tensor<float>::Reshape(const std::vector<uint32_t> &shapes,
 }
 
 float *Tensor<float>::raw_ptr() {
-  CHECK(!this->data_.empty());
-  return this->data_.memptr();
+  CHECK(!this->empty());
+  this->Detach();
+  return this->data_->memptr();
 }
 
 float *Tensor<float>::raw_ptr(uint32_t offset) {
   const uint32_t size = this->size();
-  CHECK(!this->data_.empty());
   CHECK_LT(offset, size);
-  return this->data_.memptr() + offset;
+  this->Detach();
+  return this->data_->memptr() + offset;
 }
 
 std::vector<float> Tensor<float>::values(bool row_major) {
-  CHECK_EQ(this->data_.empty(), false);
-  std::vector<float> values(this->data_.size());
+  CHECK_EQ(this->empty(), false);
+  const arma::fcube &data = *this->data_;
+  std::vector<float> values(data.size());
 
   if (!row_major) {
-    std::copy(this->data_.mem, this->data_.mem + this->data_.size(),
-              values.begin());
+    std::copy(data.mem, data.mem + data.size(), values.begin());
   } else {
-    uint32_t index = 0;
-    for (uint32_t c = 0; c < this->data_.n_slices; ++c) {
-      const arma::fmat &channel = this->data_.slice(c).t();
-      std::copy(channel.begin(), channel.end(), values.begin() + index);
-      index += channel.size();
-    }
-    CHECK_EQ(index, values.size());
+    TransposePlanes(data.memptr(), values.data(), data.n_rows, data.n_cols,
+                    data.n_slices);
   }
   return values;
 }
@@ -298,6 +392,14 @@ float *Tensor<float>::matrix_raw_ptr(uint32_t index) {
   return mem_ptr;
 }
 
+const float *Tensor<float>::matrix_raw_ptr(uint32_t index) const {
+  CHECK_LT(index, this->channels());
+  uint32_t offset = index * this->rows() * this->cols();
+  CHECK_LE(offset, this->size());
+  const float *mem_ptr = this->data_->memptr() + offset;
+  return mem_ptr;
+}
+
 sftensor operator-=(sftensor tensor, const float value) {
   CHECK(tensor != nullptr);
   tensor->data() -= value;
@@ -21,6 +21,9 @@
 
 // Created by fss on 2023/3/20.
 #include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
 #include "data/tensor.hpp"
 #include "data/tensor_util.hpp"
 
@@ -199,6 +202,51 @@ std::shared_ptr<Tensor<float>> TensorPadding(
   return output;
 }
 
+void TensorPaddingInto(const std::shared_ptr<Tensor<float>>& tensor,
+                       const std::vector<uint32_t>& pads, float padding_value,
+                       std::shared_ptr<Tensor<float>>& padded) {
+  CHECK(tensor != nullptr && !tensor->empty());
+  CHECK(pads.size() == 4);
+  const uint32_t pad_rows1 = pads.at(0);  // up
+  const uint32_t pad_rows2 = pads.at(1);  // bottom
+  const uint32_t pad_cols1 = pads.at(2);  // left
+  const uint32_t pad_cols2 = pads.at(3);  // right
+
+  const uint32_t channels = tensor->channels();
+  const uint32_t rows = tensor->rows();
+  const uint32_t cols = tensor->cols();
+  const uint32_t padded_rows = rows + pad_rows1 + pad_rows2;
+  const uint32_t padded_cols = cols + pad_cols1 + pad_cols2;
+  if (padded == nullptr || padded->empty() ||
+      padded->channels() != channels || padded->rows() != padded_rows ||
+      padded->cols() != padded_cols) {
+    padded = std::make_shared<ftensor>(channels, padded_rows, padded_cols);
+  }
+
+  const float* input_ptr = std::as_const(*tensor).data().memptr();
+  float* padded_ptr = padded->raw_ptr();
+  const uint64_t input_plane = uint64_t(rows) * cols;
+  const uint64_t padded_plane = uint64_t(padded_rows) * padded_cols;
+#pragma omp parallel for if (channels * input_plane >= 65536)
+  for (uint32_t c = 0; c < channels; ++c) {
+    // 缓冲区可能和其他张量共享内存，边框每次都重新写入，只占整个平面的一小部分
+    float* padded_channel = padded_ptr + c * padded_plane;
+    std::fill(padded_channel, padded_channel + uint64_t(pad_cols1) * padded_rows,
+              padding_value);
+    std::fill(padded_channel + uint64_t(pad_cols1 + cols) * padded_rows,
+              padded_channel + padded_plane, padding_value);
+    for (uint32_t w = 0; w < cols; ++w) {
+      float* padded_col = padded_channel + uint64_t(w + pad_cols1) * padded_rows;
+      std::fill(padded_col, padded_col + pad_rows1, padding_value);
+      std::memcpy(padded_col + pad_rows1,
+                  input_ptr + c * input_plane + uint64_t(w) * rows,
+                  rows * sizeof(float));
+      std::fill(padded_col + pad_rows1 + rows, padded_col + padded_rows,
+                padding_value);
+    }
+  }
+}
+
 std::tuple<sftensor, sftensor> TensorBroadcast(const sftensor& tensor1,
                                                const sftensor& tensor2) {
   CHECK(tensor1 != nullptr && tensor2 != nullptr);
@@ -231,6 +279,7 @@ std::tuple<sftensor, sftensor> TensorBroadcast(const sftensor& tensor1,
 
 std::shared_ptr<Tensor<float>> TensorClone(
     std::shared_ptr<Tensor<float>> tensor) {
-  return std::make_shared<Tensor<float>>(*tensor);
+  CHECK(tensor != nullptr);
+  return std::make_shared<Tensor<float>>(tensor->Clone());
 }
 }  // namespace kuiper_infer
\ No newline at end of file
@@ -0,0 +1,131 @@
+// MIT License
+// Copyright (c) 2022 - 傅莘莘
+// Source URL: https://github.com/zjhellofss/KuiperInfer
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Created by fss on 23-9-7.
+
+#include "utils/math/transpose.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace kuiper_infer {
+/// 外层分块的大小，16x16的块在源矩阵和目标矩阵中各占16条缓存行
+static constexpr uint32_t kTransposeBlock = 16;
+/// 元素数量超过该值时，使用多线程转置
+static constexpr uint64_t kTransposeParallelElements = 1 << 16;
+/// 内层小块的大小
+static constexpr uint32_t kTransposeKernel = 4;
+
+#if defined(__SSE2__)
+/**
+ * 转置源矩阵中从src开始的4x4小块，x86-64上SSE2总是可用
+ * @param src 小块在源矩阵中的起始地址
+ * @param src_stride 源矩阵一列的长度
+ * @param dst 小块在目标矩阵中的起始地址
+ * @param dst_stride 目标矩阵一列的长度
+ */
+static inline void TransposeKernel(const float* src, uint64_t src_stride,
+                                   float* dst, uint64_t dst_stride) {
+  __m128 r0 = _mm_loadu_ps(src + 0 * src_stride);
+  __m128 r1 = _mm_loadu_ps(src + 1 * src_stride);
+  __m128 r2 = _mm_loadu_ps(src + 2 * src_stride);
+  __m128 r3 = _mm_loadu_ps(src + 3 * src_stride);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(dst + 0 * dst_stride, r0);
+  _mm_storeu_ps(dst + 1 * dst_stride, r1);
+  _mm_storeu_ps(dst + 2 * dst_stride, r2);
+  _mm_storeu_ps(dst + 3 * dst_stride, r3);
+}
+#else
+static inline void TransposeKernel(const float* src, uint64_t src_stride,
+                                   float* dst, uint64_t dst_stride) {
+  for (uint32_t c = 0; c < kTransposeKernel; ++c) {
+    for (uint32_t r = 0; r < kTransposeKernel; ++r) {
+      dst[r * dst_stride + c] = src[c * src_stride + r];
+    }
+  }
+}
+#endif
+
+/**
+ * 转置源矩阵中行区间[row_start, row_end)、列区间[col_start, col_end)的块
+ */
+static inline void TransposeBlock(const float* src, uint64_t src_stride,
+                                  float* dst, uint64_t dst_stride,
+                                  uint32_t row_start, uint32_t row_end,
+                                  uint32_t col_start, uint32_t col_end) {
+  // 源矩阵中(r, c)位于src[r + c * src_stride]，目标矩阵中(c, r)位于dst[c + r * dst_stride]
+  uint32_t c = col_start;
+  for (; c + kTransposeKernel <= col_end; c += kTransposeKernel) {
+    uint32_t r = row_start;
+    for (; r + kTransposeKernel <= row_end; r += kTransposeKernel) {
+      TransposeKernel(src + c * src_stride + r, src_stride,
+                      dst + r * dst_stride + c, dst_stride);
+    }
+    for (; r < row_end; ++r) {
+      for (uint32_t k = c; k < c + kTransposeKernel; ++k) {
+        dst[r * dst_stride + k] = src[k * src_stride + r];
+      }
+    }
+  }
+  for (; c < col_end; ++c) {
+    for (uint32_t r = row_start; r < row_end; ++r) {
+      dst[r * dst_stride + c] = src[c * src_stride + r];
+    }
+  }
+}
+
+void Transpose(const float* src, float* dst, uint32_t rows, uint32_t cols) {
+  TransposeStrided(src, rows, dst, cols, rows, cols);
+}
+
+void TransposeStrided(const float* src, uint64_t src_stride, float* dst,
+                      uint64_t dst_stride, uint32_t rows, uint32_t cols) {
+  CHECK(src != nullptr && dst != nullptr);
+  CHECK(src != dst) << "Transpose do not support in-place";
+  CHECK(src_stride >= rows && dst_stride >= cols);
+  const uint32_t col_blocks = (cols + kTransposeBlock - 1) / kTransposeBlock;
+  const uint32_t row_blocks = (rows + kTransposeBlock - 1) / kTransposeBlock;
+  const bool parallel = uint64_t(rows) * cols >= kTransposeParallelElements;
+
+#pragma omp parallel for collapse(2) if (parallel)
+  for (uint32_t cb = 0; cb < col_blocks; ++cb) {
+    for (uint32_t rb = 0; rb < row_blocks; ++rb) {
+      const uint32_t col_start = cb * kTransposeBlock;
+      const uint32_t row_start = rb * kTransposeBlock;
+      TransposeBlock(src, src_stride, dst, dst_stride, row_start,
+                     std::min(rows, row_start + kTransposeBlock), col_start,
+                     std::min(cols, col_start + kTransposeBlock));
+    }
+  }
+}
+
+void TransposePlanes(const float* src, float* dst, uint32_t rows,
+                     uint32_t cols, uint32_t planes) {
+  CHECK(src != nullptr && dst != nullptr);
+  const uint64_t plane_size = uint64_t(rows) * cols;
+  for (uint32_t p = 0; p < planes; ++p) {
+    Transpose(src + p * plane_size, dst + p * plane_size, rows, cols);
+  }
+}
+}  // namespace kuiper_infer
@@ -0,0 +1,267 @@
+//
+// Created by fss on 23-9-14.
+//
+#include "data/yuv_input.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "utils/math/transpose.hpp"
+
+namespace kuiper_infer {
+/// 每次处理的输出行数，各通道的行先写入行主序的小块，再整块转置到列主序的张量中
+static constexpr uint32_t kYuvRowBlock = 16;
+/// 输出像素数量超过该值时多线程处理
+static constexpr uint64_t kYuvParallelPixels = 1 << 16;
+
+// BT.601 limited range，和OpenCV的COLOR_YUV2RGB_NV12一致
+static constexpr float kYuvLumaScale = 1.164f;
+static constexpr float kYuvRedV = 1.596f;
+static constexpr float kYuvGreenU = -0.391f;
+static constexpr float kYuvGreenV = -0.813f;
+static constexpr float kYuvBlueU = 2.018f;
+
+/// 双线性插值在某一个方向上的两个采样点和权重
+struct YuvSample {
+  uint32_t index0 = 0;
+  uint32_t index1 = 0;
+  float weight = 0.f;  /// index1的权重
+};
+
+/**
+ * 计算输出的每个位置在源图像中的采样点，坐标对齐方式和cv::resize的INTER_LINEAR一致
+ * @param output_size 输出的长度
+ * @param source_size 源图像亮度平面的长度
+ * @param luma 亮度平面的采样点
+ * @param chroma 色度平面的采样点，色度平面的长度为亮度的一半
+ */
+static void ComputeSamples(uint32_t output_size, uint32_t source_size,
+                           std::vector<YuvSample> &luma,
+                           std::vector<YuvSample> &chroma) {
+  const uint32_t chroma_size = (source_size + 1) / 2;
+  const float inv_scale = float(source_size) / float(output_size);
+  luma.resize(output_size);
+  chroma.resize(output_size);
+  auto sample = [](float position, uint32_t size) {
+    position = std::clamp(position, 0.f, float(size - 1));
+    YuvSample result;
+    result.index0 = uint32_t(position);
+    result.index1 = std::min(result.index0 + 1, size - 1);
+    result.weight = position - float(result.index0);
+    return result;
+  };
+  for (uint32_t i = 0; i < output_size; ++i) {
+    const float position = (float(i) + 0.5f) * inv_scale - 0.5f;
+    luma.at(i) = sample(position, source_size);
+    chroma.at(i) = sample((position + 0.5f) * 0.5f - 0.5f, chroma_size);
+  }
+}
+
+static inline float Lerp(float a, float b, float weight) {
+  return a + (b - a) * weight;
+}
+
+bool YuvToTensor(const YuvFrame &frame, const YuvPreprocessOptions &options,
+                 std::shared_ptr<Tensor<float>> &output,
+                 YuvPreprocessInfo *info) {
+  const uint32_t width = frame.width;
+  const uint32_t height = frame.height;
+  const uint32_t chroma_w = (width + 1) / 2;
+  if (width == 0 || height == 0 || frame.y == nullptr ||
+      frame.y_stride < width || frame.u == nullptr) {
+    LOG(ERROR) << "The yuv frame is empty or its luma plane is wrong";
+    return false;
+  }
+  const bool nv12 = frame.format == YuvFormat::kNV12;
+  if (nv12 ? frame.u_stride < chroma_w * 2
+           : (frame.v == nullptr || frame.u_stride < chroma_w ||
+              frame.v_stride < chroma_w)) {
+    LOG(ERROR) << "The chroma planes of the yuv frame are wrong";
+    return false;
+  }
+
+  const uint32_t output_h = options.output_h;
+  const uint32_t output_w = options.output_w;
+  if (output_h == 0 || output_w == 0) {
+    LOG(ERROR) << "The output size of the yuv preprocessing is empty";
+    return false;
+  }
+  for (uint32_t c = 0; c < 3; ++c) {
+    if (options.std[c] == 0.f) {
+      LOG(ERROR) << "The std of channel " << c << " is zero";
+      return false;
+    }
+  }
+  if (output == nullptr || output->empty()) {
+    output = std::make_shared<Tensor<float>>(3, output_h, output_w);
+  } else if (output->channels() != 3 || output->rows() != output_h ||
+             output->cols() != output_w) {
+    LOG(ERROR) << "The output tensor of the yuv preprocessing should be 3 x "
+               << output_h << " x " << output_w;
+    return false;
+  }
+
+  // 和Letterbox保持一致的缩放比例和填充位置
+  uint32_t content_h = output_h;
+  uint32_t content_w = output_w;
+  uint32_t top = 0;
+  uint32_t left = 0;
+  float scale = 1.f;
+  if (options.letterbox) {
+    scale = std::min(float(output_h) / float(height),
+                     float(output_w) / float(width));
+    if (!options.scale_up) {
+      scale = std::min(scale, 1.f);
+    }
+    content_w = uint32_t(std::round(float(width) * scale));
+    content_h = uint32_t(std::round(float(height) * scale));
+    if (content_w == 0 || content_h == 0) {
+      LOG(ERROR) << "The yuv frame is too small for the letterbox";
+      return false;
+    }
+    const float dw = float(output_w - content_w) / 2.f;
+    const float dh = float(output_h - content_h) / 2.f;
+    top = uint32_t(std::round(dh - 0.1f));
+    left = uint32_t(std::round(dw - 0.1f));
+  }
+  if (info != nullptr) {
+    info->scale = options.letterbox ? scale : float(output_w) / float(width);
+    info->top = top;
+    info->left = left;
+    info->content_h = content_h;
+    info->content_w = content_w;
+  }
+
+  std::vector<YuvSample> luma_cols;
+  std::vector<YuvSample> chroma_cols;
+  std::vector<YuvSample> luma_rows;
+  std::vector<YuvSample> chroma_rows;
+  ComputeSamples(content_w, width, luma_cols, chroma_cols);
+  ComputeSamples(content_h, height, luma_rows, chroma_rows);
+
+  // 归一化折算为乘加，按输出的通道顺序
+  float channel_scale[3];
+  float channel_bias[3];
+  float pad_values[3];
+  for (uint32_t c = 0; c < 3; ++c) {
+    channel_scale[c] = 1.f / options.std[c];
+    channel_bias[c] = -options.mean[c] / options.std[c];
+    pad_values[c] = options.pad_value * channel_scale[c] + channel_bias[c];
+  }
+  const uint32_t red = options.bgr ? 2 : 0;
+  const uint32_t blue = options.bgr ? 0 : 2;
+
+  float *output_ptr = output->raw_ptr();
+  const uint64_t plane = uint64_t(output_h) * output_w;
+  const uint32_t blocks = (output_h + kYuvRowBlock - 1) / kYuvRowBlock;
+  const uint64_t tile_size = uint64_t(kYuvRowBlock) * output_w;
+
+#pragma omp parallel if (plane >= kYuvParallelPixels)
+  {
+    std::vector<float> tile(3 * tile_size);
+    std::vector<float> y_values(content_w);
+    std::vector<float> u_values(content_w);
+    std::vector<float> v_values(content_w);
+#pragma omp for schedule(static)
+    for (uint32_t block = 0; block < blocks; ++block) {
+      const uint32_t row_begin = block * kYuvRowBlock;
+      const uint32_t block_rows = std::min(kYuvRowBlock, output_h - row_begin);
+      for (uint32_t i = 0; i < block_rows; ++i) {
+        const uint32_t row = row_begin + i;
+        float *tile_rows[3];
+        for (uint32_t c = 0; c < 3; ++c) {
+          tile_rows[c] = tile.data() + c * tile_size + uint64_t(i) * output_w;
+        }
+        if (row < top || row >= top + content_h) {
+          for (uint32_t c = 0; c < 3; ++c) {
+            std::fill(tile_rows[c], tile_rows[c] + output_w, pad_values[c]);
+          }
+          continue;
+        }
+        for (uint32_t c = 0; c < 3; ++c) {
+          std::fill(tile_rows[c], tile_rows[c] + left, pad_values[c]);
+          std::fill(tile_rows[c] + left + content_w, tile_rows[c] + output_w,
+                    pad_values[c]);
+        }
+
+        // 在亮度和色度平面上分别双线性插值
+        const YuvSample &luma_row = luma_rows.at(row - top);
+        const YuvSample &chroma_row = chroma_rows.at(row - top);
+        const uint8_t *y0 = frame.y + uint64_t(luma_row.index0) * frame.y_stride;
+        const uint8_t *y1 = frame.y + uint64_t(luma_row.index1) * frame.y_stride;
+        const uint8_t *u0 = frame.u + uint64_t(chroma_row.index0) * frame.u_stride;
+        const uint8_t *u1 = frame.u + uint64_t(chroma_row.index1) * frame.u_stride;
+        for (uint32_t x = 0; x < content_w; ++x) {
+          const YuvSample &col = luma_cols[x];
+          y_values[x] = Lerp(Lerp(y0[col.index0], y0[col.index1], col.weight),
+                             Lerp(y1[col.index0], y1[col.index1], col.weight),
+                             luma_row.weight);
+        }
+        if (nv12) {
+          for (uint32_t x = 0; x < content_w; ++x) {
+            const YuvSample &col = chroma_cols[x];
+            const uint32_t i0 = col.index0 * 2;
+            const uint32_t i1 = col.index1 * 2;
+            u_values[x] = Lerp(Lerp(u0[i0], u0[i1], col.weight),
+                               Lerp(u1[i0], u1[i1], col.weight),
+                               chroma_row.weight);
+            v_values[x] = Lerp(Lerp(u0[i0 + 1], u0[i1 + 1], col.weight),
+                               Lerp(u1[i0 + 1], u1[i1 + 1], col.weight),
+                               chroma_row.weight);
+          }
+        } else {
+          const uint8_t *v0 =
+              frame.v + uint64_t(chroma_row.index0) * frame.v_stride;
+          const uint8_t *v1 =
+              frame.v + uint64_t(chroma_row.index1) * frame.v_stride;
+          for (uint32_t x = 0; x < content_w; ++x) {
+            const YuvSample &col = chroma_cols[x];
+            u_values[x] = Lerp(Lerp(u0[col.index0], u0[col.index1], col.weight),
+                               Lerp(u1[col.index0], u1[col.index1], col.weight),
+                               chroma_row.weight);
+            v_values[x] = Lerp(Lerp(v0[col.index0], v0[col.index1], col.weight),
+                               Lerp(v1[col.index0], v1[col.index1], col.weight),
+                               chroma_row.weight);
+          }
+        }
+
+        // 颜色转换和归一化
+        float *red_row = tile_rows[red] + left;
+        float *green_row = tile_rows[1] + left;
+        float *blue_row = tile_rows[blue] + left;
+        const float *y_ptr = y_values.data();
+        const float *u_ptr = u_values.data();
+        const float *v_ptr = v_values.data();
+        const float red_scale = channel_scale[red];
+        const float red_bias = channel_bias[red];
+        const float green_scale = channel_scale[1];
+        const float green_bias = channel_bias[1];
+        const float blue_scale = channel_scale[blue];
+        const float blue_bias = channel_bias[blue];
+#pragma omp simd
+        for (uint32_t x = 0; x < content_w; ++x) {
+          const float luma = kYuvLumaScale * (y_ptr[x] - 16.f);
+          const float u = u_ptr[x] - 128.f;
+          const float v = v_ptr[x] - 128.f;
+          const float r = std::min(std::max(luma + kYuvRedV * v, 0.f), 255.f);
+          const float g = std::min(
+              std::max(luma + kYuvGreenU * u + kYuvGreenV * v, 0.f), 255.f);
+          const float b = std::min(std::max(luma + kYuvBlueU * u, 0.f), 255.f);
+          red_row[x] = r * red_scale + red_bias;
+          green_row[x] = g * green_scale + green_bias;
+          blue_row[x] = b * blue_scale + blue_bias;
+        }
+      }
+
+      // 行主序的小块转置到列主序的各个通道
+      for (uint32_t c = 0; c < 3; ++c) {
+        TransposeStrided(tile.data() + c * tile_size, output_w,
+                         output_ptr + c * plane + row_begin, output_h,
+                         output_w, block_rows);
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace kuiper_infer
@@ -22,6 +22,10 @@
 // Created by fss on 23-1-5.
 
 #include "image_util.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
 
 float Letterbox(const cv::Mat &image,
                 cv::Mat &out_image,
@@ -90,3 +94,148 @@ void ScaleCoords(const cv::Size &img_shape, cv::Rect &coords, const cv::Size &im
   coords.height = clip(coords.height, 0, img_origin_shape.height);
 }
 
+/**
+ * 从APP1段中读取EXIF的方向，APP1段以"Exif\0\0"开头，之后是TIFF格式的数据
+ * @param segment APP1段的数据，不包括标记和长度
+ * @return 方向，1~8，没有方向信息时返回1
+ */
+static int ReadExifOrientation(const std::vector<unsigned char> &segment) {
+  static const char kExifHeader[6] = {'E', 'x', 'i', 'f', 0, 0};
+  if (segment.size() < 14 ||
+      !std::equal(kExifHeader, kExifHeader + 6, segment.begin())) {
+    return 1;
+  }
+  const unsigned char *tiff = segment.data() + 6;
+  const size_t tiff_size = segment.size() - 6;
+  bool little_endian = false;
+  if (tiff[0] == 'I' && tiff[1] == 'I') {
+    little_endian = true;
+  } else if (tiff[0] != 'M' || tiff[1] != 'M') {
+    return 1;
+  }
+  auto read_u16 = [&](size_t offset) -> uint32_t {
+    return little_endian ? (tiff[offset] | (tiff[offset + 1] << 8))
+                         : ((tiff[offset] << 8) | tiff[offset + 1]);
+  };
+  auto read_u32 = [&](size_t offset) -> uint32_t {
+    return little_endian ? (read_u16(offset) | (read_u16(offset + 2) << 16))
+                         : ((read_u16(offset) << 16) | read_u16(offset + 2));
+  };
+
+  // 第一个IFD中每个条目12字节: 标签、类型、数量和值，方向的标签为0x0112
+  const size_t ifd = read_u32(4);
+  if (ifd + 2 > tiff_size) {
+    return 1;
+  }
+  const uint32_t entries = read_u16(ifd);
+  for (uint32_t i = 0; i < entries; ++i) {
+    const size_t entry = ifd + 2 + size_t(i) * 12;
+    if (entry + 12 > tiff_size) {
+      break;
+    }
+    if (read_u16(entry) == 0x0112) {
+      const int orientation = int(read_u16(entry + 8));
+      return orientation >= 1 && orientation <= 8 ? orientation : 1;
+    }
+  }
+  return 1;
+}
+
+bool ReadJpegSize(const std::string &path, cv::Size &size) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open() || file.get() != 0xFF || file.get() != 0xD8) {
+    return false;
+  }
+  // 大端的16位整数，两次读取的顺序需要确定
+  auto read_u16 = [&file]() {
+    const int high = file.get();
+    const int low = file.get();
+    return (high << 8) | low;
+  };
+  int orientation = 1;
+  while (file.good()) {
+    int marker = file.get();
+    if (marker != 0xFF) {
+      return false;
+    }
+    // 标记之前可以有多个填充的0xFF
+    while (marker == 0xFF) {
+      marker = file.get();
+    }
+    if (marker == EOF || marker == 0xD9 || marker == 0xDA) {
+      return false;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      continue;
+    }
+    const int length = read_u16();
+    if (length < 2) {
+      return false;
+    }
+    // SOF0~SOF15，排除DHT(0xC4)、JPG(0xC8)和DAC(0xCC)
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+        marker != 0xCC) {
+      file.get();
+      const int height = read_u16();
+      const int width = read_u16();
+      if (!file.good() || height <= 0 || width <= 0) {
+        return false;
+      }
+      // imread默认按EXIF的方向旋转图片，方向为5~8时宽高互换
+      size = orientation >= 5 ? cv::Size(height, width)
+                              : cv::Size(width, height);
+      return true;
+    }
+    if (marker == 0xE1) {
+      std::vector<unsigned char> segment(length - 2);
+      file.read(reinterpret_cast<char *>(segment.data()), segment.size());
+      if (!file.good()) {
+        return false;
+      }
+      orientation = ReadExifOrientation(segment);
+      continue;
+    }
+    file.seekg(length - 2, std::ios::cur);
+  }
+  return false;
+}
+
+int ReducedDecodeFactor(const cv::Size &image_size, const cv::Size &input_size) {
+  // Letterbox的缩放比例，缩小解码之后的比例变为scale * factor，不能超过1
+  const float scale = std::min((float) input_size.height / (float) image_size.height,
+                               (float) input_size.width / (float) image_size.width);
+  for (const int factor : {8, 4, 2}) {
+    if (scale * (float) factor <= 1.f) {
+      return factor;
+    }
+  }
+  return 1;
+}
+
+bool DecodeImage(const std::string &path, const cv::Size &input_size, DecodedImage &decoded) {
+  const auto start = std::chrono::steady_clock::now();
+  cv::Size origin_size;
+  int flags = cv::IMREAD_COLOR;
+  int factor = 1;
+  if (ReadJpegSize(path, origin_size)) {
+    factor = ReducedDecodeFactor(origin_size, input_size);
+    switch (factor) {
+      case 2: flags = cv::IMREAD_REDUCED_COLOR_2;
+        break;
+      case 4: flags = cv::IMREAD_REDUCED_COLOR_4;
+        break;
+      case 8: flags = cv::IMREAD_REDUCED_COLOR_8;
+        break;
+      default: break;
+    }
+  }
+  decoded.image = cv::imread(path, flags);
+  decoded.decode_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  if (decoded.image.empty()) {
+    return false;
+  }
+  decoded.reduce_factor = factor;
+  decoded.origin_size = factor == 1 ? decoded.image.size() : origin_size;
+  return true;
+}
@@ -42,4 +42,39 @@ float Letterbox(
 
 void ScaleCoords(const cv::Size &img_shape, cv::Rect &coords, const cv::Size &img_origin_shape);
 
+/// 解码后的图片，可能是按整数倍缩小解码的结果
+struct DecodedImage {
+  cv::Mat image;            /// 解码得到的图片
+  cv::Size origin_size;     /// 原图的尺寸
+  int reduce_factor = 1;    /// 解码时缩小的倍数，1、2、4或8
+  double decode_ms = 0.;    /// 读取文件和解码的耗时
+};
+
+/**
+ * 只读取JPEG文件头中的帧信息，得到图片的尺寸而不解码
+ * 和imread的默认行为一致，EXIF方向为旋转90度(5~8)时返回宽高互换之后的尺寸
+ * @param path 图片的路径
+ * @param size 按EXIF方向旋转之后的图片尺寸
+ * @return 是否是可以读出尺寸的JPEG文件
+ */
+bool ReadJpegSize(const std::string &path, cv::Size &size);
+
+/**
+ * 选择缩小解码的倍数，缩小后的图片仍然不小于Letterbox之后的内容，不需要放大
+ * @param image_size 原图的尺寸
+ * @param input_size 模型输入的尺寸
+ * @return 缩小的倍数，1、2、4或8
+ */
+int ReducedDecodeFactor(const cv::Size &image_size, const cv::Size &input_size);
+
+/**
+ * 按模型输入的尺寸解码图片，JPEG图片在DCT域中按IMREAD_REDUCED_COLOR_*缩小解码，
+ * 其他格式按原尺寸解码，每张图片只解码一次
+ * @param path 图片的路径
+ * @param input_size 模型输入的尺寸
+ * @param decoded 解码的结果
+ * @return 是否解码成功
+ */
+bool DecodeImage(const std::string &path, const cv::Size &input_size, DecodedImage &decoded);
+
 #endif //KUIPER_INFER_DEMOS_IMAGE_UTIL_HPP_
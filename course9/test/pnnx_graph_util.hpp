@@ -0,0 +1,39 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#ifndef KUIPER_INFER_TEST_PNNX_GRAPH_UTIL_HPP_
+#define KUIPER_INFER_TEST_PNNX_GRAPH_UTIL_HPP_
+#include <string>
+#include <vector>
+#include "runtime/ir.h"
+
+/**
+ * 为节点添加一个float32的输出张量，张量的名称为它在计算图中的序号
+ * @param graph 计算图
+ * @param producer 产生该张量的节点
+ * @param shape 张量的形状
+ * @return 添加的张量
+ */
+inline pnnx::Operand *NewOperand(pnnx::Graph &graph, pnnx::Operator *producer,
+                                 const std::vector<int> &shape) {
+  pnnx::Operand *operand =
+      graph.new_operand(std::to_string(graph.operands.size()));
+  operand->producer = producer;
+  operand->type = 1;
+  operand->shape = shape;
+  producer->outputs.push_back(operand);
+  return operand;
+}
+
+/**
+ * 把张量作为节点的下一个输入
+ * @param consumer 使用该张量的节点
+ * @param operand 张量
+ */
+inline void Consume(pnnx::Operator *consumer, pnnx::Operand *operand) {
+  consumer->inputs.push_back(operand);
+  operand->consumers.push_back(consumer);
+}
+
+#endif  // KUIPER_INFER_TEST_PNNX_GRAPH_UTIL_HPP_
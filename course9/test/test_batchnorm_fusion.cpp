@@ -0,0 +1,146 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <map>
+#include <random>
+#include "data/tensor_util.hpp"
+#include "layer/abstract/layer.hpp"
+#include "runtime/ir.h"
+#include "runtime/runtime_ir.hpp"
+#include "pnnx_graph_util.hpp"
+
+using namespace kuiper_infer;
+
+static std::vector<float> RandomValues(std::mt19937 &generator, uint32_t size,
+                                       float low, float high) {
+  std::uniform_real_distribution<float> distribution(low, high);
+  std::vector<float> values(size);
+  for (float &value : values) {
+    value = distribution(generator);
+  }
+  return values;
+}
+
+static pnnx::Operand *AddConv(pnnx::Graph &graph, std::mt19937 &generator,
+                              const std::string &name, pnnx::Operand *input,
+                              int out_channels, int kernel_size) {
+  const int in_channels = input->shape.at(1);
+  const int padding = kernel_size / 2;
+  pnnx::Operator *conv = graph.new_operator("nn.Conv2d", name);
+  conv->params["in_channels"] = in_channels;
+  conv->params["out_channels"] = out_channels;
+  conv->params["kernel_size"] = {kernel_size, kernel_size};
+  conv->params["stride"] = {1, 1};
+  conv->params["padding"] = {padding, padding};
+  conv->params["dilation"] = {1, 1};
+  conv->params["groups"] = 1;
+  conv->params["bias"] = true;
+  conv->params["padding_mode"] = "zeros";
+  conv->attrs["weight"] = pnnx::Attribute(
+      {out_channels, in_channels, kernel_size, kernel_size},
+      RandomValues(generator,
+                   out_channels * in_channels * kernel_size * kernel_size,
+                   -0.5f, 0.5f));
+  conv->attrs["bias"] = pnnx::Attribute(
+      {out_channels}, RandomValues(generator, out_channels, -0.1f, 0.1f));
+  Consume(conv, input);
+  return NewOperand(graph, conv,
+                    {input->shape.at(0), out_channels, input->shape.at(2),
+                     input->shape.at(3)});
+}
+
+static pnnx::Operand *AddBatchNorm(pnnx::Graph &graph, std::mt19937 &generator,
+                                   const std::string &name,
+                                   pnnx::Operand *input, bool affine) {
+  const int channels = input->shape.at(1);
+  pnnx::Operator *bn = graph.new_operator("nn.BatchNorm2d", name);
+  bn->params["num_features"] = channels;
+  bn->params["eps"] = 1e-5f;
+  bn->params["affine"] = affine;
+  bn->attrs["running_mean"] = pnnx::Attribute(
+      {channels}, RandomValues(generator, channels, -0.5f, 0.5f));
+  bn->attrs["running_var"] = pnnx::Attribute(
+      {channels}, RandomValues(generator, channels, 0.5f, 2.f));
+  if (affine) {
+    bn->attrs["weight"] = pnnx::Attribute(
+        {channels}, RandomValues(generator, channels, 0.5f, 1.5f));
+    bn->attrs["bias"] = pnnx::Attribute(
+        {channels}, RandomValues(generator, channels, -0.5f, 0.5f));
+  }
+  Consume(bn, input);
+  return NewOperand(graph, bn, input->shape);
+}
+
+static pnnx::Operand *AddActivation(pnnx::Graph &graph, const std::string &type,
+                                    const std::string &name,
+                                    pnnx::Operand *input) {
+  pnnx::Operator *activation = graph.new_operator(type, name);
+  Consume(activation, input);
+  return NewOperand(graph, activation, input->shape);
+}
+
+TEST(test_batchnorm_fusion, fused_graph) {
+  const std::string &param_path = "batchnorm_fusion.pnnx.param";
+  const std::string &bin_path = "batchnorm_fusion.pnnx.bin";
+  {
+    // conv -> bn(affine) -> relu -> conv -> bn -> silu -> maxpool
+    std::mt19937 generator(91);
+    pnnx::Graph graph;
+    pnnx::Operator *input = graph.new_operator("pnnx.Input", "pnnx_input_0");
+    pnnx::Operand *x = NewOperand(graph, input, {1, 4, 12, 10});
+    x = AddConv(graph, generator, "conv_0", x, 6, 3);
+    x = AddBatchNorm(graph, generator, "bn_0", x, true);
+    x = AddActivation(graph, "nn.ReLU", "relu_0", x);
+    x = AddConv(graph, generator, "conv_1", x, 6, 1);
+    x = AddBatchNorm(graph, generator, "bn_1", x, false);
+    x = AddActivation(graph, "nn.SiLU", "silu_0", x);
+    pnnx::Operator *pool = graph.new_operator("nn.MaxPool2d", "pool_0");
+    pool->params["kernel_size"] = {2, 2};
+    pool->params["stride"] = {2, 2};
+    pool->params["padding"] = {0, 0};
+    pool->params["dilation"] = {1, 1};
+    pool->params["ceil_mode"] = false;
+    pool->params["return_indices"] = false;
+    Consume(pool, x);
+    x = NewOperand(graph, pool, {1, 6, 6, 5});
+    pnnx::Operator *output =
+        graph.new_operator("pnnx.Output", "pnnx_output_0");
+    Consume(output, x);
+    ASSERT_EQ(graph.save(param_path, bin_path), 0);
+  }
+
+  sftensor input = TensorCreate(4, 12, 10);
+  input->Rand();
+  for (const uint64_t memory_budget : {uint64_t(0), uint64_t(1 << 24)}) {
+    std::vector<sftensor> outputs;
+    for (const bool fuse : {false, true}) {
+      RuntimeGraph graph(param_path, bin_path);
+      graph.set_memory_budget(memory_budget);
+      graph.set_fuse_activations(fuse);
+      ASSERT_TRUE(graph.Build("pnnx_input_0", "pnnx_output_0"));
+
+      std::map<std::string, std::shared_ptr<RuntimeOperator>> ops;
+      for (const auto &op : graph.operators()) {
+        ops.insert({op->name, op});
+      }
+      // 融合后激活函数节点替换为IdentityLayer，BatchNorm2d执行带激活函数的内核
+      ASSERT_EQ(ops.at("relu_0")->layer->layer_name() == "Identity", fuse);
+      ASSERT_EQ(ops.at("silu_0")->layer->layer_name() == "Identity", fuse);
+      ASSERT_EQ(ops.at("bn_0")->layer->kernel_name(),
+                fuse ? "scale_shift_relu" : "scale_shift");
+      ASSERT_EQ(ops.at("bn_1")->layer->kernel_name(),
+                fuse ? "scale_shift_silu" : "scale_shift");
+
+      const std::vector<sftensor> &result = graph.Forward({input}, false);
+      ASSERT_EQ(result.size(), 1);
+      ASSERT_EQ(result.front()->shapes(), std::vector<uint32_t>({6, 6, 5}));
+      outputs.push_back(TensorClone(result.front()));
+    }
+    ASSERT_TRUE(TensorIsSame(outputs.at(0), outputs.at(1), 1e-5f));
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
@@ -0,0 +1,103 @@
+//
+// Created by fss on 23-9-6.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include "../source/layer/details/convolution.hpp"
+#include "data/tensor_util.hpp"
+
+using namespace kuiper_infer;
+
+static sftensor ConvReference(const sftensor& input,
+                              const std::vector<sftensor>& weights,
+                              uint32_t padding, uint32_t stride,
+                              uint32_t dilation) {
+  const uint32_t kernel_h = weights.front()->rows();
+  const uint32_t kernel_w = weights.front()->cols();
+  const uint32_t output_h =
+      (input->rows() + 2 * padding - dilation * (kernel_h - 1) - 1) / stride +
+      1;
+  const uint32_t output_w =
+      (input->cols() + 2 * padding - dilation * (kernel_w - 1) - 1) / stride +
+      1;
+  sftensor output = TensorCreate(weights.size(), output_h, output_w);
+  for (uint32_t oc = 0; oc < weights.size(); ++oc) {
+    for (uint32_t oh = 0; oh < output_h; ++oh) {
+      for (uint32_t ow = 0; ow < output_w; ++ow) {
+        float sum = 0.f;
+        for (uint32_t ic = 0; ic < input->channels(); ++ic) {
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+              const int32_t ih =
+                  int32_t(oh * stride + kh * dilation) - int32_t(padding);
+              const int32_t iw =
+                  int32_t(ow * stride + kw * dilation) - int32_t(padding);
+              if (ih < 0 || iw < 0 || ih >= int32_t(input->rows()) ||
+                  iw >= int32_t(input->cols())) {
+                continue;
+              }
+              sum += weights.at(oc)->at(ic, kh, kw) * input->at(ic, ih, iw);
+            }
+          }
+        }
+        output->at(oc, oh, ow) = sum;
+      }
+    }
+  }
+  return output;
+}
+
+TEST(test_conv_dilation, reference) {
+  const uint32_t in_channel = 5;
+  const uint32_t out_channel = 7;
+  for (const uint32_t dilation : {1, 2, 4}) {
+    for (const uint32_t stride : {1, 2}) {
+      const uint32_t padding = dilation;
+      ConvolutionLayer conv_layer(out_channel, in_channel, 3, 3, padding,
+                                  padding, stride, stride, 1, false, dilation,
+                                  dilation);
+      for (const auto& weight : conv_layer.weights()) {
+        weight->Rand();
+      }
+      sftensor input = TensorCreate(in_channel, 23, 19);
+      input->Rand();
+      std::vector<sftensor> inputs{input};
+      std::vector<sftensor> outputs(1);
+      ASSERT_EQ(conv_layer.Forward(inputs, outputs),
+                InferStatus::kInferSuccess);
+
+      const sftensor& reference = ConvReference(input, conv_layer.weights(),
+                                                padding, stride, dilation);
+      ASSERT_EQ(outputs.front()->shapes(), reference->shapes());
+      ASSERT_TRUE(TensorIsSame(outputs.front(), reference, 1e-3f));
+    }
+  }
+}
+
+TEST(test_conv_dilation, throughput) {
+  const uint32_t channels = 64;
+  const uint32_t runs = 10;
+  sftensor input = TensorCreate(channels, 128, 128);
+  input->Rand();
+  std::vector<sftensor> inputs{input};
+
+  // padding和dilation相同时输出尺寸不变，两者的计算量相同
+  for (const uint32_t dilation : {1, 2, 4}) {
+    ConvolutionLayer conv_layer(channels, channels, 3, 3, dilation, dilation,
+                                1, 1, 1, false, dilation, dilation);
+    std::vector<sftensor> outputs(1);
+    conv_layer.Forward(inputs, outputs);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; ++i) {
+      ASSERT_EQ(conv_layer.Forward(inputs, outputs),
+                InferStatus::kInferSuccess);
+    }
+    const double cost = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count() /
+                        runs;
+    LOG(INFO) << "3x3 convolution 64x128x128, dilation " << dilation << ": "
+              << cost << " ms";
+  }
+}
@@ -0,0 +1,146 @@
+//
+// Created by fss on 23-9-5.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include "../source/layer/details/convolution.hpp"
+#include "../source/layer/details/deconvolution.hpp"
+#include "../source/layer/details/upsample.hpp"
+#include "data/tensor_util.hpp"
+
+using namespace kuiper_infer;
+
+static sftensor DeconvReference(const sftensor& input,
+                                const std::vector<sftensor>& weights,
+                                const std::vector<sftensor>& bias,
+                                uint32_t output_channel, uint32_t stride,
+                                uint32_t padding, uint32_t output_padding,
+                                uint32_t dilation, uint32_t groups) {
+  const uint32_t in_channel = input->channels();
+  const uint32_t kernel_h = weights.front()->rows();
+  const uint32_t kernel_w = weights.front()->cols();
+  const uint32_t output_h = (input->rows() - 1) * stride - 2 * padding +
+                            dilation * (kernel_h - 1) + output_padding + 1;
+  const uint32_t output_w = (input->cols() - 1) * stride - 2 * padding +
+                            dilation * (kernel_w - 1) + output_padding + 1;
+  sftensor output = TensorCreate(output_channel, output_h, output_w);
+  output->Fill(0.f);
+
+  const uint32_t in_c_group = in_channel / groups;
+  const uint32_t out_c_group = output_channel / groups;
+  for (uint32_t ic = 0; ic < in_channel; ++ic) {
+    const uint32_t g = ic / in_c_group;
+    for (uint32_t oc = 0; oc < out_c_group; ++oc) {
+      for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          const float w = weights.at(ic)->at(oc, kh, kw);
+          for (uint32_t ih = 0; ih < input->rows(); ++ih) {
+            for (uint32_t iw = 0; iw < input->cols(); ++iw) {
+              const int32_t oh =
+                  int32_t(ih * stride + kh * dilation) - int32_t(padding);
+              const int32_t ow =
+                  int32_t(iw * stride + kw * dilation) - int32_t(padding);
+              if (oh < 0 || ow < 0 || oh >= int32_t(output_h) ||
+                  ow >= int32_t(output_w)) {
+                continue;
+              }
+              output->at(g * out_c_group + oc, oh, ow) +=
+                  w * input->at(ic, ih, iw);
+            }
+          }
+        }
+      }
+    }
+  }
+  for (uint32_t oc = 0; oc < output_channel; ++oc) {
+    output->slice(oc) += bias.at(oc)->index(0);
+  }
+  return output;
+}
+
+static void DeconvCheck(uint32_t in_channel, uint32_t output_channel,
+                        uint32_t kernel, uint32_t stride, uint32_t padding,
+                        uint32_t output_padding, uint32_t dilation,
+                        uint32_t groups) {
+  DeconvolutionLayer deconv_layer(output_channel, in_channel, kernel, kernel,
+                                  padding, padding, stride, stride,
+                                  output_padding, output_padding, dilation,
+                                  dilation, groups, true);
+  for (const auto& weight : deconv_layer.weights()) {
+    weight->Rand();
+  }
+  for (const auto& bias : deconv_layer.bias()) {
+    bias->Rand();
+  }
+
+  sftensor input = TensorCreate(in_channel, 13, 11);
+  input->Rand();
+  std::vector<sftensor> inputs{input};
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(deconv_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+  const sftensor& reference =
+      DeconvReference(input, deconv_layer.weights(), deconv_layer.bias(),
+                      output_channel, stride, padding, output_padding,
+                      dilation, groups);
+  ASSERT_EQ(outputs.front()->shapes(), reference->shapes());
+  ASSERT_TRUE(TensorIsSame(outputs.front(), reference, 1e-3f));
+}
+
+TEST(test_deconvolution, direct) {
+  DeconvCheck(4, 6, 3, 2, 1, 1, 1, 1);
+  DeconvCheck(4, 4, 2, 2, 0, 0, 1, 1);
+  DeconvCheck(8, 8, 3, 1, 1, 0, 2, 4);
+}
+
+TEST(test_deconvolution, gemm) {
+  DeconvCheck(32, 16, 3, 2, 1, 1, 1, 1);
+  DeconvCheck(32, 16, 4, 2, 1, 0, 1, 1);
+  DeconvCheck(32, 32, 3, 3, 2, 0, 2, 2);
+}
+
+TEST(test_deconvolution, upsample_conv_cost) {
+  const uint32_t channels = 64;
+  const uint32_t runs = 10;
+  sftensor input = TensorCreate(channels, 80, 80);
+  input->Rand();
+  std::vector<sftensor> inputs{input};
+
+  // 4x4步长2的转置卷积和2倍上采样加3x3卷积输出相同的尺寸
+  DeconvolutionLayer deconv_layer(channels, channels, 4, 4, 1, 1, 2, 2, 0, 0,
+                                  1, 1, 1, true);
+  std::vector<sftensor> deconv_outputs(1);
+  deconv_layer.Forward(inputs, deconv_outputs);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(deconv_layer.Forward(inputs, deconv_outputs),
+              InferStatus::kInferSuccess);
+  }
+  const double deconv_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             runs;
+
+  UpSampleLayer upsample_layer(2.f, 2.f);
+  ConvolutionLayer conv_layer(channels, channels, 3, 3, 1, 1, 1, 1, 1, true);
+  std::vector<sftensor> upsample_outputs(1);
+  std::vector<sftensor> conv_outputs(1);
+  upsample_layer.Forward(inputs, upsample_outputs);
+  conv_layer.Forward(upsample_outputs, conv_outputs);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(upsample_layer.Forward(inputs, upsample_outputs),
+              InferStatus::kInferSuccess);
+    ASSERT_EQ(conv_layer.Forward(upsample_outputs, conv_outputs),
+              InferStatus::kInferSuccess);
+  }
+  const double upsample_conv_cost = std::chrono::duration<double, std::milli>(
+                                        std::chrono::steady_clock::now() - start)
+                                        .count() /
+                                    runs;
+
+  ASSERT_EQ(deconv_outputs.front()->shapes(), conv_outputs.front()->shapes());
+  LOG(INFO) << "64x80x80 -> 64x160x160, deconvolution: " << deconv_cost
+            << " ms, upsample + convolution: " << upsample_conv_cost << " ms";
+}
@@ -0,0 +1,91 @@
+//
+// Created by fss on 23-9-12.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+TEST(test_graph_dot, resnet18_annotations) {
+  const std::string &param_path =
+      "course9/model_file/resnet18_batch1.pnnx.param";
+  const std::string &bin_path = "course9/model_file/resnet18_batch1.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  // 设置内存预算后逐元素节点原地计算，节点的输出复用前面节点的内存
+  graph.set_memory_budget(64 * 1024 * 1024);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  graph.EnableProfiling();
+
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  for (uint32_t i = 0; i < 3; ++i) {
+    graph.Forward({input}, false);
+  }
+
+  const std::string &dot = graph.ExportDot();
+  ASSERT_EQ(dot.rfind("digraph kuiper_infer {", 0), 0);
+  ASSERT_NE(dot.find("nn.Conv2d"), std::string::npos);
+  ASSERT_NE(dot.find("kernel: im2col_gemm_halo"), std::string::npos);
+  ASSERT_NE(dot.find("output: 1x64x112x112"), std::string::npos);
+  ASSERT_NE(dot.find(" ms"), std::string::npos);
+  ASSERT_NE(dot.find("inplace"), std::string::npos);
+  for (const auto &op : graph.get_topo_queues()) {
+    ASSERT_NE(dot.find("\"" + op->name + "\" ["), std::string::npos);
+    for (const auto &[next_name, _] : op->output_operators) {
+      ASSERT_NE(dot.find("\"" + op->name + "\" -> \"" + next_name + "\""),
+                std::string::npos);
+    }
+  }
+
+  const std::string path = "./resnet18_graph.dot";
+  ASSERT_TRUE(graph.ExportGraph(path));
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  ASSERT_EQ(content.str(), dot);
+  std::remove(path.c_str());
+}
+
+TEST(test_graph_dot, yolov5_svg) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  graph.EnableProfiling();
+  sftensor input = TensorCreate(3, 640, 640);
+  input->Rand();
+  graph.Forward({input}, false);
+
+  const std::string &dot = graph.ExportDot();
+  ASSERT_NE(dot.find("nn.SiLU"), std::string::npos);
+  // 没有安装graphviz时只检查DOT文本
+  if (std::system("dot -V > /dev/null 2>&1") != 0) {
+    LOG(WARNING) << "Graphviz is not installed, skip the svg export";
+    return;
+  }
+  const std::string path = "./yolov5s_graph.svg";
+  ASSERT_TRUE(graph.ExportGraph(path));
+  std::ifstream file(path);
+  ASSERT_TRUE(file.is_open());
+  std::remove(path.c_str());
+}
+
+TEST(test_graph_dot, svg_path_not_interpreted) {
+  const std::string &param_path = "course9/model_file/simple_ops.pnnx.param";
+  const std::string &bin_path = "course9/model_file/simple_ops.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 路径中的引号和分号只是文件名的一部分，不会被shell当作命令执行
+  const std::string marker = "./graph_dot_injected";
+  std::remove(marker.c_str());
+  const std::string path = "./graph\"; touch " + marker + "; \".svg";
+  graph.ExportGraph(path);
+  ASSERT_FALSE(std::ifstream(marker).is_open());
+  std::remove(path.c_str());
+  std::remove((path + ".dot").c_str());
+}
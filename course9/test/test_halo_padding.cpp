@@ -0,0 +1,175 @@
+//
+// Created by fss on 23-9-8.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <limits>
+#include "../source/layer/details/convolution.hpp"
+#include "../source/layer/details/maxpooling.hpp"
+#include "data/tensor_util.hpp"
+
+using namespace kuiper_infer;
+
+static sftensor MaxPoolReference(const sftensor& input, uint32_t kernel,
+                                 uint32_t padding, uint32_t stride) {
+  const uint32_t output_h = (input->rows() + 2 * padding - kernel) / stride + 1;
+  const uint32_t output_w = (input->cols() + 2 * padding - kernel) / stride + 1;
+  sftensor output = TensorCreate(input->channels(), output_h, output_w);
+  for (uint32_t c = 0; c < input->channels(); ++c) {
+    for (uint32_t oh = 0; oh < output_h; ++oh) {
+      for (uint32_t ow = 0; ow < output_w; ++ow) {
+        float max_value = std::numeric_limits<float>::lowest();
+        for (uint32_t kh = 0; kh < kernel; ++kh) {
+          for (uint32_t kw = 0; kw < kernel; ++kw) {
+            const int32_t ih = int32_t(oh * stride + kh) - int32_t(padding);
+            const int32_t iw = int32_t(ow * stride + kw) - int32_t(padding);
+            if (ih < 0 || iw < 0 || ih >= int32_t(input->rows()) ||
+                iw >= int32_t(input->cols())) {
+              continue;
+            }
+            max_value = std::max(max_value, input->at(c, ih, iw));
+          }
+        }
+        output->at(c, oh, ow) = max_value;
+      }
+    }
+  }
+  return output;
+}
+
+TEST(test_halo_padding, tensor_padding) {
+  sftensor input = TensorCreate(3, 5, 7);
+  input->Rand();
+  const std::vector<uint32_t> pads{1, 2, 3, 4};
+  const sftensor& reference = TensorPadding(input, pads, -1.f);
+
+  Tensor<float> padded = input->Clone();
+  padded.Padding(pads, -1.f);
+  ASSERT_EQ(padded.raw_shapes(), reference->raw_shapes());
+  ASSERT_TRUE(arma::approx_equal(padded.data(), reference->data(), "absdiff",
+                                 0.f));
+
+  // 复用缓冲区时不重新分配，边框被其他张量改写之后也会重新写入
+  sftensor buffer;
+  TensorPaddingInto(input, pads, -1.f, buffer);
+  const float* buffer_ptr = buffer->raw_ptr();
+  input->Rand();
+  buffer->Fill(7.f);
+  TensorPaddingInto(input, pads, -1.f, buffer);
+  ASSERT_EQ(buffer->raw_ptr(), buffer_ptr);
+  ASSERT_TRUE(TensorIsSame(buffer, TensorPadding(input, pads, -1.f), 0.f));
+}
+
+TEST(test_halo_padding, max_pooling) {
+  for (const uint32_t padding : {0, 1, 2}) {
+    for (const uint32_t stride : {1, 2}) {
+      const uint32_t kernel = 2 * padding + 1;
+      MaxPoolingLayer max_layer(padding, padding, kernel, kernel, stride,
+                                stride);
+      // 输入中包含负数，边框必须取最小值而不是零
+      sftensor input = TensorCreate(4, 17, 13);
+      input->Rand();
+      input->Transform([](float value) { return value - 0.5f; });
+      std::vector<sftensor> inputs{input};
+      std::vector<sftensor> outputs(1);
+      for (int run = 0; run < 2; ++run) {
+        ASSERT_EQ(max_layer.Forward(inputs, outputs),
+                  InferStatus::kInferSuccess);
+        ASSERT_TRUE(TensorIsSame(
+            outputs.front(), MaxPoolReference(input, kernel, padding, stride),
+            0.f));
+        input->Rand();
+      }
+    }
+  }
+}
+
+TEST(test_halo_padding, convolution_reuse) {
+  ConvolutionLayer conv_layer(6, 4, 3, 3, 1, 1, 1, 1, 1, false);
+  ConvolutionLayer unpadded_layer(6, 4, 3, 3, 0, 0, 1, 1, 1, false);
+  for (uint32_t k = 0; k < conv_layer.weights().size(); ++k) {
+    conv_layer.weights().at(k)->Rand();
+    *unpadded_layer.weights().at(k) = *conv_layer.weights().at(k);
+  }
+
+  // 两次推理之间输入尺寸改变，缓冲区需要重新分配
+  for (const uint32_t size : {9, 9, 12}) {
+    sftensor input = TensorCreate(4, size, size);
+    input->Rand();
+    std::vector<sftensor> inputs{input};
+    std::vector<sftensor> outputs(1);
+    ASSERT_EQ(conv_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+    // 与手动填充后不带padding的卷积结果一致
+    std::vector<sftensor> padded_inputs{TensorPadding(input, {1, 1, 1, 1}, 0.f)};
+    std::vector<sftensor> reference(1);
+    ASSERT_EQ(unpadded_layer.Forward(padded_inputs, reference),
+              InferStatus::kInferSuccess);
+    ASSERT_TRUE(TensorIsSame(outputs.front(), reference.front(), 1e-4f));
+  }
+}
+
+TEST(test_halo_padding, planner_scratch) {
+  ConvolutionLayer conv_layer(6, 4, 3, 3, 1, 1, 1, 1, 1, false);
+  ConvolutionLayer unpadded_layer(6, 4, 3, 3, 0, 0, 1, 1, 1, false);
+  for (uint32_t k = 0; k < conv_layer.weights().size(); ++k) {
+    conv_layer.weights().at(k)->Rand();
+    *unpadded_layer.weights().at(k) = *conv_layer.weights().at(k);
+  }
+
+  // 内存规划分配的缓冲区在两次推理之间会被其他节点改写，边框需要每次重新写入
+  sftensor scratch = TensorCreate(4, 11, 11);
+  conv_layer.set_scratch(scratch);
+  for (int run = 0; run < 2; ++run) {
+    sftensor input = TensorCreate(4, 9, 9);
+    input->Rand();
+    scratch->Fill(7.f);
+    std::vector<sftensor> inputs{input};
+    std::vector<sftensor> outputs(1);
+    ASSERT_EQ(conv_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+    std::vector<sftensor> padded_inputs{TensorPadding(input, {1, 1, 1, 1}, 0.f)};
+    std::vector<sftensor> reference(1);
+    ASSERT_EQ(unpadded_layer.Forward(padded_inputs, reference),
+              InferStatus::kInferSuccess);
+    ASSERT_TRUE(TensorIsSame(outputs.front(), reference.front(), 1e-4f));
+    ASSERT_EQ(conv_layer.persistent_bytes(), 0);
+  }
+}
+
+TEST(test_halo_padding, throughput) {
+  const uint32_t runs = 10;
+  sftensor input = TensorCreate(64, 160, 160);
+  input->Rand();
+  std::vector<sftensor> inputs{input};
+
+  ConvolutionLayer conv_layer(64, 64, 3, 3, 1, 1, 1, 1, 1, false);
+  MaxPoolingLayer max_layer(2, 2, 5, 5, 1, 1);
+  std::vector<sftensor> conv_outputs(1);
+  std::vector<sftensor> max_outputs(1);
+  conv_layer.Forward(inputs, conv_outputs);
+  max_layer.Forward(inputs, max_outputs);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(conv_layer.Forward(inputs, conv_outputs),
+              InferStatus::kInferSuccess);
+  }
+  const double conv_cost = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count() /
+                           runs;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(max_layer.Forward(inputs, max_outputs),
+              InferStatus::kInferSuccess);
+  }
+  const double max_cost = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          runs;
+  LOG(INFO) << "64x160x160, 3x3 convolution with padding: " << conv_cost
+            << " ms, 5x5 max pooling with padding: " << max_cost << " ms";
+}
@@ -0,0 +1,69 @@
+//
+// Created by fss on 23-9-3.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+TEST(test_io_binding, resnet18) {
+  const std::string &param_path =
+      "course9/model_file/resnet18_batch1.pnnx.param";
+  const std::string &bin_path = "course9/model_file/resnet18_batch1.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  std::vector<sftensor> outputs = graph.Forward({input}, false);
+  ASSERT_EQ(outputs.size(), 1);
+  const sftensor output = TensorClone(outputs.front());
+
+  // 调用方持有输入和输出的内存，计算图直接在上面读写
+  std::vector<float> input_buffer(input->size());
+  std::copy(input->raw_ptr(), input->raw_ptr() + input->size(),
+            input_buffer.begin());
+  std::vector<float> output_buffer(output->size());
+  sftensor bound_input =
+      std::make_shared<ftensor>(input_buffer.data(), input->raw_shapes());
+  sftensor bound_output =
+      std::make_shared<ftensor>(output_buffer.data(), output->raw_shapes());
+
+  graph.BindInputs({bound_input});
+  graph.BindOutputs({bound_output});
+  for (int run = 0; run < 2; ++run) {
+    graph.Forward(false);
+    ASSERT_EQ(bound_output->raw_ptr(), output_buffer.data());
+    ASSERT_TRUE(TensorIsSame(output, bound_output, 1e-4f));
+  }
+}
+
+TEST(test_io_binding, expression_output) {
+  // 输出节点的前驱是Expression，结果直接写入绑定的张量
+  const std::string &param_path = "course9/model_file/simple_ops.pnnx.param";
+  const std::string &bin_path = "course9/model_file/simple_ops.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  sftensor input = TensorCreate(3, 16, 16);
+  input->Rand();
+  const sftensor output = TensorClone(graph.Forward({input}, false).front());
+
+  std::vector<float> output_buffer(output->size());
+  sftensor bound_output =
+      std::make_shared<ftensor>(output_buffer.data(), output->raw_shapes());
+  graph.BindInputs({input});
+  graph.BindOutputs({bound_output});
+  for (int run = 0; run < 2; ++run) {
+    graph.Forward(false);
+    for (const auto &op : graph.get_topo_queues()) {
+      if (op->type == "pnnx.Expression") {
+        ASSERT_EQ(op->output_operands->datas.front(), bound_output);
+      }
+    }
+    ASSERT_EQ(bound_output->raw_ptr(), output_buffer.data());
+    ASSERT_TRUE(TensorIsSame(output, bound_output, 1e-5f));
+  }
+}
@@ -0,0 +1,1007 @@
+//
+// Created by fss on 23-9-12.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include "../source/layer/details/adaptive_avgpooling.hpp"
+#include "../source/layer/details/attention.hpp"
+#include "../source/layer/details/batchnorm2d.hpp"
+#include "../source/layer/details/convolution.hpp"
+#include "../source/layer/details/deconvolution.hpp"
+#include "../source/layer/details/gelu.hpp"
+#include "../source/layer/details/layernorm.hpp"
+#include "../source/layer/details/linear.hpp"
+#include "../source/layer/details/matmul.hpp"
+#include "../source/layer/details/maxpooling.hpp"
+#include "../source/layer/details/permute.hpp"
+#include "../source/layer/details/relu.hpp"
+#include "../source/layer/details/silu.hpp"
+#include "../source/layer/details/slice.hpp"
+#include "../source/layer/details/softmax.hpp"
+#include "../source/layer/details/upsample.hpp"
+#include "data/tensor_util.hpp"
+
+using namespace kuiper_infer;
+
+using ReferenceFunction = std::function<sftensor(const sftensor&)>;
+using OperandsReferenceFunction =
+    std::function<sftensor(const std::vector<sftensor>&)>;
+
+/// 对照结果中的一行
+struct ReferenceRow {
+  std::string layer;
+  std::string config;
+  float max_abs = 0.f;  /// 最大绝对误差
+  float max_rel = 0.f;  /// 最大绝对误差除以参考结果的最大绝对值
+  double reference_ms = 0.;
+  double optimized_ms = 0.;
+};
+
+static std::vector<ReferenceRow>& ReferenceRows() {
+  static std::vector<ReferenceRow> rows;
+  return rows;
+}
+
+static constexpr uint32_t kReferenceSeed = 20230912;
+
+static std::mt19937& Generator() {
+  static std::mt19937 generator(kReferenceSeed);
+  return generator;
+}
+
+static uint32_t RandomInt(uint32_t low, uint32_t high) {
+  return std::uniform_int_distribution<uint32_t>(low, high)(Generator());
+}
+
+static std::vector<sftensor> RandomInputs(uint32_t batch, uint32_t channels,
+                                          uint32_t rows, uint32_t cols) {
+  std::vector<sftensor> inputs;
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  for (uint32_t b = 0; b < batch; ++b) {
+    sftensor input = TensorCreate(channels, rows, cols);
+    float* input_ptr = input->raw_ptr();
+    for (uint32_t i = 0; i < input->size(); ++i) {
+      input_ptr[i] = distribution(Generator());
+    }
+    inputs.push_back(input);
+  }
+  return inputs;
+}
+
+static void RandomParams(Layer& layer) {
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  for (const auto& params : {layer.weights(), layer.bias()}) {
+    for (const sftensor& param : params) {
+      param->Transform([&distribution](float) {
+        return distribution(Generator());
+      });
+    }
+  }
+}
+
+/**
+ * 分别运行参考实现和优化实现，比较每个输出并记录误差和耗时，
+ * 多个输入的层按操作数排列输入，第i个操作数的批次位于[i * batch, (i + 1) * batch)
+ * @param layer_name 层的名称
+ * @param config 当前的配置
+ * @param layer 优化实现
+ * @param reference 逐个批次计算的参考实现，参数是该批次的各个操作数
+ * @param inputs 输入张量
+ * @param operands 每个批次的操作数数量
+ * @param tolerance 允许的相对误差
+ */
+static void CompareOperands(const std::string& layer_name,
+                            const std::string& config, Layer& layer,
+                            const OperandsReferenceFunction& reference,
+                            const std::vector<sftensor>& inputs,
+                            uint32_t operands, float tolerance) {
+  ASSERT_EQ(inputs.size() % operands, 0);
+  const uint32_t batch = inputs.size() / operands;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<sftensor> expected;
+  for (uint32_t b = 0; b < batch; ++b) {
+    std::vector<sftensor> batch_operands;
+    for (uint32_t i = 0; i < operands; ++i) {
+      batch_operands.push_back(inputs.at(i * batch + b));
+    }
+    expected.push_back(reference(batch_operands));
+  }
+  const double reference_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+
+  std::vector<sftensor> outputs(batch);
+  ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess)
+      << layer_name << " " << config;
+  const uint32_t runs = 3;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+  }
+  const double optimized_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count() /
+                              runs;
+
+  ReferenceRow row{layer_name, config, 0.f, 0.f, reference_ms, optimized_ms};
+  float reference_max = 0.f;
+  for (uint32_t b = 0; b < batch; ++b) {
+    const sftensor& output = outputs.at(b);
+    const sftensor& target = expected.at(b);
+    ASSERT_EQ(output->shapes(), target->shapes())
+        << layer_name << " " << config;
+    const float* output_ptr = std::as_const(*output).data().memptr();
+    const float* target_ptr = std::as_const(*target).data().memptr();
+    for (uint32_t i = 0; i < target->size(); ++i) {
+      row.max_abs =
+          std::max(row.max_abs, std::fabs(output_ptr[i] - target_ptr[i]));
+      reference_max = std::max(reference_max, std::fabs(target_ptr[i]));
+    }
+  }
+  row.max_rel = row.max_abs / std::max(reference_max, 1e-6f);
+  EXPECT_LE(row.max_rel, tolerance) << layer_name << " " << config;
+  ReferenceRows().push_back(row);
+}
+
+/**
+ * 单个输入的层的对照，参数的含义同CompareOperands
+ */
+static void Compare(const std::string& layer_name, const std::string& config,
+                    Layer& layer, const ReferenceFunction& reference,
+                    const std::vector<sftensor>& inputs, float tolerance) {
+  CompareOperands(
+      layer_name, config, layer,
+      [&reference](const std::vector<sftensor>& batch_operands) {
+        return reference(batch_operands.front());
+      },
+      inputs, 1, tolerance);
+}
+
+static sftensor ConvReference(const sftensor& input, const Layer& layer,
+                              uint32_t padding, uint32_t stride,
+                              uint32_t dilation, uint32_t groups) {
+  const auto& weights = layer.weights();
+  const auto& bias = layer.bias();
+  const uint32_t out_channel = weights.size();
+  const uint32_t kernel_h = weights.front()->rows();
+  const uint32_t kernel_w = weights.front()->cols();
+  const uint32_t in_c_group = input->channels() / groups;
+  const uint32_t out_c_group = out_channel / groups;
+  const uint32_t output_h =
+      (input->rows() + 2 * padding - dilation * (kernel_h - 1) - 1) / stride +
+      1;
+  const uint32_t output_w =
+      (input->cols() + 2 * padding - dilation * (kernel_w - 1) - 1) / stride +
+      1;
+  sftensor output = TensorCreate(out_channel, output_h, output_w);
+  for (uint32_t oc = 0; oc < out_channel; ++oc) {
+    const uint32_t g = oc / out_c_group;
+    for (uint32_t oh = 0; oh < output_h; ++oh) {
+      for (uint32_t ow = 0; ow < output_w; ++ow) {
+        float sum = bias.empty() ? 0.f : bias.at(oc)->index(0);
+        for (uint32_t ic = 0; ic < in_c_group; ++ic) {
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+              const int32_t ih =
+                  int32_t(oh * stride + kh * dilation) - int32_t(padding);
+              const int32_t iw =
+                  int32_t(ow * stride + kw * dilation) - int32_t(padding);
+              if (ih < 0 || iw < 0 || ih >= int32_t(input->rows()) ||
+                  iw >= int32_t(input->cols())) {
+                continue;
+              }
+              sum += weights.at(oc)->at(ic, kh, kw) *
+                     input->at(g * in_c_group + ic, ih, iw);
+            }
+          }
+        }
+        output->at(oc, oh, ow) = sum;
+      }
+    }
+  }
+  return output;
+}
+
+static sftensor DeconvReference(const sftensor& input, const Layer& layer,
+                                uint32_t out_channel, uint32_t padding,
+                                uint32_t stride, uint32_t output_padding,
+                                uint32_t dilation, uint32_t groups) {
+  const auto& weights = layer.weights();
+  const auto& bias = layer.bias();
+  const uint32_t kernel_h = weights.front()->rows();
+  const uint32_t kernel_w = weights.front()->cols();
+  const uint32_t in_c_group = input->channels() / groups;
+  const uint32_t out_c_group = out_channel / groups;
+  const uint32_t output_h = (input->rows() - 1) * stride - 2 * padding +
+                            dilation * (kernel_h - 1) + output_padding + 1;
+  const uint32_t output_w = (input->cols() - 1) * stride - 2 * padding +
+                            dilation * (kernel_w - 1) + output_padding + 1;
+  sftensor output = TensorCreate(out_channel, output_h, output_w);
+  output->Fill(0.f);
+  for (uint32_t ic = 0; ic < input->channels(); ++ic) {
+    const uint32_t g = ic / in_c_group;
+    for (uint32_t oc = 0; oc < out_c_group; ++oc) {
+      for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          for (uint32_t ih = 0; ih < input->rows(); ++ih) {
+            for (uint32_t iw = 0; iw < input->cols(); ++iw) {
+              const int32_t oh =
+                  int32_t(ih * stride + kh * dilation) - int32_t(padding);
+              const int32_t ow =
+                  int32_t(iw * stride + kw * dilation) - int32_t(padding);
+              if (oh < 0 || ow < 0 || oh >= int32_t(output_h) ||
+                  ow >= int32_t(output_w)) {
+                continue;
+              }
+              output->at(g * out_c_group + oc, oh, ow) +=
+                  weights.at(ic)->at(oc, kh, kw) * input->at(ic, ih, iw);
+            }
+          }
+        }
+      }
+    }
+  }
+  for (uint32_t oc = 0; oc < out_channel && !bias.empty(); ++oc) {
+    output->slice(oc) += bias.at(oc)->index(0);
+  }
+  return output;
+}
+
+/// 每个测试使用相同的随机种子，互不依赖执行顺序，所有测试结束后输出对照结果
+/// Cat、Flatten、Expression、Identity和YoloDetect只组合其他层或者不做计算，不在对照表中
+class test_kernel_reference : public ::testing::Test {
+ protected:
+  void SetUp() override { Generator().seed(kReferenceSeed); }
+
+  static void SetUpTestSuite() { ReferenceRows().clear(); }
+
+  static void TearDownTestSuite() {
+    std::ostringstream table;
+    table << "\n"
+          << std::left << std::setw(20) << "layer" << std::setw(52) << "config"
+          << std::right << std::setw(12) << "max_abs" << std::setw(12)
+          << "max_rel" << std::setw(12) << "ref_ms" << std::setw(12)
+          << "opt_ms" << std::setw(10) << "speedup" << "\n";
+    for (const ReferenceRow& row : ReferenceRows()) {
+      table << std::left << std::setw(20) << row.layer << std::setw(52)
+            << row.config << std::right << std::scientific
+            << std::setprecision(2) << std::setw(12) << row.max_abs
+            << std::setw(12) << row.max_rel << std::fixed << std::setw(12)
+            << std::setprecision(3) << row.reference_ms << std::setw(12)
+            << row.optimized_ms << std::setw(9) << std::setprecision(1)
+            << row.reference_ms / std::max(row.optimized_ms, 1e-6) << "x\n";
+    }
+    LOG(INFO) << table.str();
+    ReferenceRows().clear();
+  }
+};
+
+TEST_F(test_kernel_reference, convolution) {
+  for (uint32_t trial = 0; trial < 12; ++trial) {
+    const uint32_t groups = RandomInt(0, 2) == 0 ? RandomInt(2, 4) : 1;
+    const uint32_t in_channel = groups * RandomInt(1, 8);
+    const uint32_t out_channel = groups * RandomInt(1, 8);
+    const uint32_t kernel = RandomInt(1, 5);
+    const uint32_t stride = RandomInt(1, 3);
+    const uint32_t padding = RandomInt(0, kernel / 2);
+    const uint32_t dilation = kernel > 1 ? RandomInt(1, 2) : 1;
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t size = RandomInt(dilation * (kernel - 1) + 1, 33);
+    const bool workspace = RandomInt(0, 1) == 1;
+
+    ConvolutionLayer layer(out_channel, in_channel, kernel, kernel, padding,
+                           padding, stride, stride, groups, true, dilation,
+                           dilation);
+    RandomParams(layer);
+    // 限制临时空间时im2col按列分块展开
+    if (workspace) {
+      layer.set_workspace_limit(4096);
+    }
+    std::ostringstream config;
+    config << "b" << batch << " " << in_channel << "x" << size << "x" << size
+           << " oc" << out_channel << " k" << kernel << " s" << stride << " p"
+           << padding << " d" << dilation << " g" << groups
+           << (workspace ? " tiled" : "");
+    Compare("Convolution", config.str(), layer,
+            [&](const sftensor& input) {
+              return ConvReference(input, layer, padding, stride, dilation,
+                                   groups);
+            },
+            RandomInputs(batch, in_channel, size, size), 1e-4f);
+  }
+}
+
+TEST_F(test_kernel_reference, convolution_specialized) {
+  struct SpecializedConfig {
+    uint32_t kernel;
+    uint32_t stride;
+    uint32_t padding;
+    uint32_t groups;
+    bool workspace;
+    std::string kernel_name;  /// Forward之后分派到的实现
+  };
+  // 分派表中的常见配置，以及一个走通用实现的配置
+  const std::vector<SpecializedConfig> configs{
+      {1, 1, 0, 1, false, "pointwise_gemm"},
+      {1, 1, 0, 2, false, "pointwise_gemm"},
+      {1, 1, 1, 1, false, "im2col_gemm_k1x1s1_halo"},
+      {3, 1, 1, 1, false, "im2col_gemm_k3x3s1_halo"},
+      {3, 1, 1, 2, true, "im2col_gemm_k3x3s1_halo_tiled"},
+      {3, 2, 1, 1, false, "im2col_gemm_k3x3s2_halo"},
+      {6, 2, 2, 1, false, "im2col_gemm_k6x6s2_halo"},
+      {5, 1, 2, 1, false, "im2col_gemm_halo"},
+  };
+  for (const SpecializedConfig& spec : configs) {
+    const uint32_t in_channel = spec.groups * RandomInt(2, 8);
+    const uint32_t out_channel = spec.groups * RandomInt(2, 8);
+    const uint32_t size = RandomInt(spec.kernel + 6, 40);
+    ConvolutionLayer layer(out_channel, in_channel, spec.kernel, spec.kernel,
+                           spec.padding, spec.padding, spec.stride, spec.stride,
+                           spec.groups);
+    RandomParams(layer);
+    if (spec.workspace) {
+      layer.set_workspace_limit(4096);
+    }
+    std::ostringstream config;
+    config << in_channel << "x" << size << "x" << size << " oc" << out_channel
+           << " k" << spec.kernel << " s" << spec.stride << " p"
+           << spec.padding << " g" << spec.groups
+           << (spec.workspace ? " tiled" : "");
+    Compare("Convolution", config.str(), layer,
+            [&](const sftensor& input) {
+              return ConvReference(input, layer, spec.padding, spec.stride, 1,
+                                   spec.groups);
+            },
+            RandomInputs(2, in_channel, size, size), 1e-4f);
+    EXPECT_EQ(layer.kernel_name(), spec.kernel_name) << config.str();
+  }
+}
+
+TEST_F(test_kernel_reference, deconvolution) {
+  for (uint32_t trial = 0; trial < 10; ++trial) {
+    const uint32_t groups = RandomInt(0, 2) == 0 ? 2 : 1;
+    // 每组的输入通道较少时走直接计算，较多时走gemm加col2im
+    const uint32_t in_channel = groups * (RandomInt(0, 1) ? RandomInt(1, 8)
+                                                          : RandomInt(9, 24));
+    const uint32_t out_channel = groups * RandomInt(1, 8);
+    const uint32_t kernel = RandomInt(1, 4);
+    const uint32_t stride = RandomInt(1, 3);
+    const uint32_t dilation = RandomInt(1, 2);
+    const uint32_t padding = RandomInt(0, (dilation * (kernel - 1)) / 2);
+    const uint32_t output_padding =
+        RandomInt(0, std::max(stride, dilation) - 1);
+    const uint32_t batch = RandomInt(1, 2);
+    const uint32_t size = RandomInt(2, 17);
+
+    DeconvolutionLayer layer(out_channel, in_channel, kernel, kernel, padding,
+                             padding, stride, stride, output_padding,
+                             output_padding, dilation, dilation, groups, true);
+    RandomParams(layer);
+    std::ostringstream config;
+    config << "b" << batch << " " << in_channel << "x" << size << "x" << size
+           << " oc" << out_channel << " k" << kernel << " s" << stride << " p"
+           << padding << " op" << output_padding << " d" << dilation << " g"
+           << groups;
+    Compare("Deconvolution", config.str(), layer,
+            [&](const sftensor& input) {
+              return DeconvReference(input, layer, out_channel, padding,
+                                     stride, output_padding, dilation, groups);
+            },
+            RandomInputs(batch, in_channel, size, size), 1e-4f);
+  }
+}
+
+TEST_F(test_kernel_reference, max_pooling) {
+  for (uint32_t trial = 0; trial < 10; ++trial) {
+    const uint32_t kernel = RandomInt(1, 5);
+    const uint32_t stride = RandomInt(1, 3);
+    const uint32_t padding = RandomInt(0, kernel / 2);
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 16);
+    const uint32_t rows = RandomInt(kernel, 40);
+    const uint32_t cols = RandomInt(kernel, 40);
+
+    MaxPoolingLayer layer(padding, padding, kernel, kernel, stride, stride);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " k" << kernel << " s" << stride << " p" << padding;
+    Compare("MaxPooling", config.str(), layer,
+            [&](const sftensor& input) {
+              const uint32_t output_h =
+                  (input->rows() + 2 * padding - kernel) / stride + 1;
+              const uint32_t output_w =
+                  (input->cols() + 2 * padding - kernel) / stride + 1;
+              sftensor output =
+                  TensorCreate(input->channels(), output_h, output_w);
+              for (uint32_t c = 0; c < input->channels(); ++c) {
+                for (uint32_t oh = 0; oh < output_h; ++oh) {
+                  for (uint32_t ow = 0; ow < output_w; ++ow) {
+                    float max_value = std::numeric_limits<float>::lowest();
+                    for (uint32_t kh = 0; kh < kernel; ++kh) {
+                      for (uint32_t kw = 0; kw < kernel; ++kw) {
+                        const int32_t ih =
+                            int32_t(oh * stride + kh) - int32_t(padding);
+                        const int32_t iw =
+                            int32_t(ow * stride + kw) - int32_t(padding);
+                        if (ih >= 0 && iw >= 0 && ih < int32_t(input->rows()) &&
+                            iw < int32_t(input->cols())) {
+                          max_value =
+                              std::max(max_value, input->at(c, ih, iw));
+                        }
+                      }
+                    }
+                    output->at(c, oh, ow) = max_value;
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 0.f);
+  }
+}
+
+TEST_F(test_kernel_reference, adaptive_avg_pooling) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    // 输入尺寸是输出尺寸的整数倍时，每个输出对应的窗口互不重叠
+    const uint32_t output_h = RandomInt(1, 7);
+    const uint32_t output_w = RandomInt(1, 7);
+    const uint32_t rows = output_h * RandomInt(1, 5);
+    const uint32_t cols = output_w * RandomInt(1, 5);
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 16);
+
+    AdaptiveAveragePoolingLayer layer(output_h, output_w);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " o" << output_h << "x" << output_w;
+    Compare("AdaptiveAvgPooling", config.str(), layer,
+            [&](const sftensor& input) {
+              sftensor output =
+                  TensorCreate(input->channels(), output_h, output_w);
+              for (uint32_t c = 0; c < input->channels(); ++c) {
+                for (uint32_t oh = 0; oh < output_h; ++oh) {
+                  for (uint32_t ow = 0; ow < output_w; ++ow) {
+                    const uint32_t h_start = oh * rows / output_h;
+                    const uint32_t h_end = (oh + 1) * rows / output_h;
+                    const uint32_t w_start = ow * cols / output_w;
+                    const uint32_t w_end = (ow + 1) * cols / output_w;
+                    float sum = 0.f;
+                    for (uint32_t h = h_start; h < h_end; ++h) {
+                      for (uint32_t w = w_start; w < w_end; ++w) {
+                        sum += input->at(c, h, w);
+                      }
+                    }
+                    output->at(c, oh, ow) =
+                        sum / float((h_end - h_start) * (w_end - w_start));
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, linear) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const uint32_t in_features = RandomInt(1, 300);
+    const uint32_t out_features = RandomInt(1, 300);
+    const uint32_t feature_dims = RandomInt(1, 8);
+    const uint32_t batch = RandomInt(1, 3);
+    const bool use_bias = RandomInt(0, 1) == 1;
+
+    LinearLayer layer(in_features, out_features, use_bias);
+    RandomParams(layer);
+    std::ostringstream config;
+    config << "b" << batch << " " << feature_dims << "x" << in_features
+           << " -> " << out_features << (use_bias ? " bias" : "");
+    Compare("Linear", config.str(), layer,
+            [&](const sftensor& input) {
+              const sftensor& weight = layer.weights().front();
+              sftensor output = TensorCreate(1, feature_dims, out_features);
+              for (uint32_t r = 0; r < feature_dims; ++r) {
+                for (uint32_t o = 0; o < out_features; ++o) {
+                  float sum =
+                      use_bias ? layer.bias().front()->at(0, 0, o) : 0.f;
+                  for (uint32_t i = 0; i < in_features; ++i) {
+                    sum += input->at(0, r, i) * weight->at(0, o, i);
+                  }
+                  output->at(0, r, o) = sum;
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, 1, feature_dims, in_features), 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, elementwise) {
+  for (uint32_t trial = 0; trial < 4; ++trial) {
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 32);
+    const uint32_t rows = RandomInt(1, 64);
+    const uint32_t cols = RandomInt(1, 64);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols;
+
+    ReluLayer relu_layer;
+    Compare("ReLU", config.str(), relu_layer,
+            [](const sftensor& input) {
+              sftensor output = TensorClone(input);
+              output->Transform([](float x) { return std::max(x, 0.f); });
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 0.f);
+
+    SiLULayer silu_layer;
+    Compare("SiLU", config.str(), silu_layer,
+            [](const sftensor& input) {
+              sftensor output = TensorClone(input);
+              output->Transform(
+                  [](float x) { return x / (1.f + std::exp(-x)); });
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, upsample) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    // 上采样的倍数为整数，最近邻的位置没有舍入误差
+    const uint32_t scale_h = RandomInt(1, 4);
+    const uint32_t scale_w = RandomInt(1, 4);
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 16);
+    const uint32_t rows = RandomInt(1, 40);
+    const uint32_t cols = RandomInt(1, 40);
+
+    UpSampleLayer layer(static_cast<float>(scale_h),
+                        static_cast<float>(scale_w));
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " x" << scale_h << "x" << scale_w;
+    Compare("UpSample", config.str(), layer,
+            [&](const sftensor& input) {
+              sftensor output =
+                  TensorCreate(input->channels(), input->rows() * scale_h,
+                               input->cols() * scale_w);
+              for (uint32_t c = 0; c < output->channels(); ++c) {
+                for (uint32_t h = 0; h < output->rows(); ++h) {
+                  for (uint32_t w = 0; w < output->cols(); ++w) {
+                    output->at(c, h, w) =
+                        input->at(c, h / scale_h, w / scale_w);
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 0.f);
+  }
+}
+
+TEST_F(test_kernel_reference, batchnorm) {
+  const std::vector<std::string> activations{"", "nn.ReLU", "nn.SiLU"};
+  const float eps = 1e-5f;
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 32);
+    const uint32_t rows = RandomInt(1, 64);
+    const uint32_t cols = RandomInt(1, 64);
+    const bool affine = trial % 2 == 0;
+    const std::string& activation = activations.at(trial % activations.size());
+
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::uniform_real_distribution<float> var_distribution(0.1f, 2.f);
+    std::vector<float> mean(channels);
+    std::vector<float> var(channels);
+    std::vector<float> gamma;
+    std::vector<float> beta;
+    for (uint32_t c = 0; c < channels; ++c) {
+      mean.at(c) = distribution(Generator());
+      var.at(c) = var_distribution(Generator());
+      if (affine) {
+        gamma.push_back(distribution(Generator()));
+        beta.push_back(distribution(Generator()));
+      }
+    }
+
+    BatchNorm2dLayer layer(channels, eps, mean, var, gamma, beta);
+    if (!activation.empty()) {
+      ASSERT_TRUE(layer.FuseActivation(activation));
+      // 只能融合一个激活函数
+      ASSERT_FALSE(layer.FuseActivation("nn.ReLU"));
+    }
+
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << (affine ? " affine" : "") << " " << layer.kernel_name();
+    const auto reference = [&](const sftensor& input) {
+      sftensor output = TensorClone(input);
+      for (uint32_t c = 0; c < channels; ++c) {
+        const float g = affine ? gamma.at(c) : 1.f;
+        const float b = affine ? beta.at(c) : 0.f;
+        output->slice(c).transform([&](float x) {
+          float y = (x - mean.at(c)) / std::sqrt(var.at(c) + eps) * g + b;
+          if (activation == "nn.ReLU") {
+            y = std::max(y, 0.f);
+          } else if (activation == "nn.SiLU") {
+            y = y / (1.f + std::exp(-y));
+          }
+          return y;
+        });
+      }
+      return output;
+    };
+    Compare("BatchNorm2d", config.str(), layer, reference,
+            RandomInputs(batch, channels, rows, cols), 1e-5f);
+
+    // 输出和输入是同一个张量时原地计算
+    const sftensor input = RandomInputs(1, channels, rows, cols).front();
+    const sftensor expected = reference(input);
+    std::vector<sftensor> outputs{input};
+    ASSERT_EQ(layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+    ASSERT_EQ(outputs.front(), input);
+    ASSERT_TRUE(TensorIsSame(input, expected, 1e-5f));
+  }
+}
+
+TEST_F(test_kernel_reference, softmax) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const int dim = int(RandomInt(0, 2));
+    const uint32_t batch = RandomInt(1, 2);
+    const uint32_t channels = RandomInt(2, 16);
+    const uint32_t rows = RandomInt(1, 32);
+    const uint32_t cols = RandomInt(1, 32);
+
+    SoftmaxLayer layer(dim);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " dim" << dim;
+    Compare("Softmax", config.str(), layer,
+            [dim](const sftensor& input) {
+              sftensor output = TensorClone(input);
+              const std::vector<uint32_t> shapes = input->shapes();
+              for (uint32_t c = 0; c < shapes.at(0); ++c) {
+                for (uint32_t r = 0; r < shapes.at(1); ++r) {
+                  for (uint32_t w = 0; w < shapes.at(2); ++w) {
+                    // 只在dim轴上的第一个位置计算整条轴
+                    const uint32_t index[3] = {c, r, w};
+                    if (index[dim] != 0) {
+                      continue;
+                    }
+                    double sum = 0.;
+                    for (uint32_t k = 0; k < shapes.at(dim); ++k) {
+                      uint32_t pos[3] = {c, r, w};
+                      pos[dim] = k;
+                      sum += std::exp(double(input->at(pos[0], pos[1], pos[2])));
+                    }
+                    for (uint32_t k = 0; k < shapes.at(dim); ++k) {
+                      uint32_t pos[3] = {c, r, w};
+                      pos[dim] = k;
+                      output->at(pos[0], pos[1], pos[2]) = float(
+                          std::exp(double(input->at(pos[0], pos[1], pos[2]))) /
+                          sum);
+                    }
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, layernorm) {
+  const float eps = 1e-5f;
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const uint32_t batch = RandomInt(1, 2);
+    const uint32_t channels = RandomInt(1, 4);
+    const uint32_t tokens = RandomInt(1, 64);
+    const uint32_t features = RandomInt(1, 96);
+    const bool affine = trial % 2 == 0;
+
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> gamma;
+    std::vector<float> beta;
+    for (uint32_t f = 0; f < features && affine; ++f) {
+      gamma.push_back(distribution(Generator()));
+      beta.push_back(distribution(Generator()));
+    }
+
+    LayerNormLayer layer(features, eps, gamma, beta);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << tokens << "x"
+           << features << (affine ? " affine" : "");
+    Compare("LayerNorm", config.str(), layer,
+            [&](const sftensor& input) {
+              sftensor output = TensorClone(input);
+              for (uint32_t c = 0; c < channels; ++c) {
+                for (uint32_t t = 0; t < tokens; ++t) {
+                  double mean = 0.;
+                  for (uint32_t f = 0; f < features; ++f) {
+                    mean += input->at(c, t, f);
+                  }
+                  mean /= features;
+                  double var = 0.;
+                  for (uint32_t f = 0; f < features; ++f) {
+                    const double diff = input->at(c, t, f) - mean;
+                    var += diff * diff;
+                  }
+                  var /= features;
+                  for (uint32_t f = 0; f < features; ++f) {
+                    float y = float((input->at(c, t, f) - mean) /
+                                    std::sqrt(var + eps));
+                    output->at(c, t, f) =
+                        affine ? y * gamma.at(f) + beta.at(f) : y;
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, tokens, features), 1e-4f);
+  }
+}
+
+TEST_F(test_kernel_reference, gelu) {
+  for (uint32_t trial = 0; trial < 4; ++trial) {
+    const uint32_t batch = RandomInt(1, 3);
+    const uint32_t channels = RandomInt(1, 8);
+    const uint32_t rows = RandomInt(1, 64);
+    const uint32_t cols = RandomInt(1, 128);
+    const bool tanh_approximate = trial % 2 == 1;
+
+    GeluLayer layer(tanh_approximate);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " " << layer.kernel_name();
+    Compare("GELU", config.str(), layer,
+            [tanh_approximate](const sftensor& input) {
+              sftensor output = TensorClone(input);
+              output->Transform([tanh_approximate](float x) {
+                if (tanh_approximate) {
+                  const double u = std::sqrt(2. / M_PI) *
+                                   (x + 0.044715 * double(x) * x * x);
+                  return float(0.5 * x * (1. + std::tanh(u)));
+                }
+                return float(0.5 * x * (1. + std::erf(x / std::sqrt(2.))));
+              });
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, matmul) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const uint32_t batch = RandomInt(1, 2);
+    const uint32_t channels = RandomInt(1, 4);
+    // 一方的通道数为1时在通道上广播
+    const uint32_t broadcast = RandomInt(0, 2);
+    const uint32_t left_channels = broadcast == 1 ? 1 : channels;
+    const uint32_t right_channels = broadcast == 2 ? 1 : channels;
+    const uint32_t m = RandomInt(1, 64);
+    const uint32_t k = RandomInt(1, 64);
+    const uint32_t n = RandomInt(1, 64);
+
+    MatMulLayer layer;
+    std::ostringstream config;
+    config << "b" << batch << " " << left_channels << "x" << m << "x" << k
+           << " * " << right_channels << "x" << k << "x" << n;
+    std::vector<sftensor> inputs = RandomInputs(batch, left_channels, m, k);
+    for (const sftensor& right : RandomInputs(batch, right_channels, k, n)) {
+      inputs.push_back(right);
+    }
+    CompareOperands(
+        "MatMul", config.str(), layer,
+        [&](const std::vector<sftensor>& operands) {
+          const sftensor& left = operands.at(0);
+          const sftensor& right = operands.at(1);
+          sftensor output = TensorCreate(channels, m, n);
+          for (uint32_t c = 0; c < channels; ++c) {
+            const uint32_t lc = left_channels == 1 ? 0 : c;
+            const uint32_t rc = right_channels == 1 ? 0 : c;
+            for (uint32_t r = 0; r < m; ++r) {
+              for (uint32_t col = 0; col < n; ++col) {
+                float sum = 0.f;
+                for (uint32_t i = 0; i < k; ++i) {
+                  sum += left->at(lc, r, i) * right->at(rc, i, col);
+                }
+                output->at(c, r, col) = sum;
+              }
+            }
+          }
+          return output;
+        },
+        inputs, 2, 1e-5f);
+  }
+}
+
+TEST_F(test_kernel_reference, attention) {
+  for (uint32_t trial = 0; trial < 6; ++trial) {
+    const uint32_t batch = RandomInt(1, 2);
+    // key和value的头数可以少于query，多个query头共享一组key和value
+    const uint32_t kv_heads = RandomInt(1, 3);
+    const uint32_t heads = kv_heads * RandomInt(1, 2);
+    const uint32_t query_size = RandomInt(1, 80);
+    const uint32_t key_size = RandomInt(1, 80);
+    const uint32_t head_dim = RandomInt(1, 32);
+    const uint32_t value_dim = RandomInt(1, 32);
+    const bool is_causal = trial % 2 == 1;
+
+    ScaledDotProductAttentionLayer layer(is_causal);
+    std::ostringstream config;
+    config << "b" << batch << " q" << heads << "x" << query_size << "x"
+           << head_dim << " kv" << kv_heads << "x" << key_size << "x"
+           << value_dim << " " << layer.kernel_name();
+    std::vector<sftensor> inputs =
+        RandomInputs(batch, heads, query_size, head_dim);
+    for (const sftensor& key :
+         RandomInputs(batch, kv_heads, key_size, head_dim)) {
+      inputs.push_back(key);
+    }
+    for (const sftensor& value :
+         RandomInputs(batch, kv_heads, key_size, value_dim)) {
+      inputs.push_back(value);
+    }
+    CompareOperands(
+        "Attention", config.str(), layer,
+        [&](const std::vector<sftensor>& operands) {
+          const sftensor& query = operands.at(0);
+          const sftensor& key = operands.at(1);
+          const sftensor& value = operands.at(2);
+          const double scale = 1. / std::sqrt(double(head_dim));
+          sftensor output = TensorCreate(heads, query_size, value_dim);
+          output->Fill(0.f);
+          std::vector<double> scores(key_size);
+          for (uint32_t h = 0; h < heads; ++h) {
+            const uint32_t kv_h = h / (heads / kv_heads);
+            for (uint32_t q = 0; q < query_size; ++q) {
+              // 因果注意力中第q个query只关注前q + 1个key
+              const uint32_t keys =
+                  is_causal ? std::min(key_size, q + 1) : key_size;
+              double max_score = -std::numeric_limits<double>::infinity();
+              for (uint32_t j = 0; j < keys; ++j) {
+                double score = 0.;
+                for (uint32_t d = 0; d < head_dim; ++d) {
+                  score += double(query->at(h, q, d)) * key->at(kv_h, j, d);
+                }
+                scores.at(j) = score * scale;
+                max_score = std::max(max_score, scores.at(j));
+              }
+              double sum = 0.;
+              for (uint32_t j = 0; j < keys; ++j) {
+                scores.at(j) = std::exp(scores.at(j) - max_score);
+                sum += scores.at(j);
+              }
+              for (uint32_t d = 0; d < value_dim; ++d) {
+                double value_sum = 0.;
+                for (uint32_t j = 0; j < keys; ++j) {
+                  value_sum += scores.at(j) * value->at(kv_h, j, d);
+                }
+                output->at(h, q, d) = float(value_sum / sum);
+              }
+            }
+          }
+          return output;
+        },
+        inputs, 3, 1e-4f);
+  }
+}
+
+TEST_F(test_kernel_reference, slice) {
+  for (uint32_t trial = 0; trial < 8; ++trial) {
+    const uint32_t axis = trial % 3;
+    const uint32_t batch = RandomInt(1, 2);
+    const uint32_t channels = RandomInt(2, 16);
+    const uint32_t rows = RandomInt(2, 40);
+    const uint32_t cols = RandomInt(2, 40);
+    const int32_t size =
+        int32_t(axis == 0 ? channels : (axis == 1 ? rows : cols));
+    // 起始位置可以从末尾计数，结束位置可以从末尾计数或者超出范围
+    const int32_t first = int32_t(RandomInt(0, uint32_t(size) - 1));
+    const int32_t start = RandomInt(0, 1) == 1 ? first - size : first;
+    const int32_t end =
+        first + 1 < size && RandomInt(0, 1) == 1 ? -1 : INT32_MAX;
+    const int32_t step = int32_t(RandomInt(1, 3));
+
+    SliceLayer layer(axis, start, end, step);
+    std::ostringstream config;
+    config << "b" << batch << " " << channels << "x" << rows << "x" << cols
+           << " axis" << axis << " [" << start << ", " << end << ", " << step
+           << "] " << layer.kernel_name();
+    Compare("Slice", config.str(), layer,
+            [&](const sftensor& input) {
+              const int32_t last = end < 0 ? end + size : std::min(end, size);
+              std::vector<uint32_t> indexes;
+              for (int32_t i = first; i < last; i += step) {
+                indexes.push_back(uint32_t(i));
+              }
+              std::vector<uint32_t> shapes{channels, rows, cols};
+              shapes.at(axis) = indexes.size();
+              sftensor output =
+                  TensorCreate(shapes.at(0), shapes.at(1), shapes.at(2));
+              for (uint32_t c = 0; c < shapes.at(0); ++c) {
+                for (uint32_t r = 0; r < shapes.at(1); ++r) {
+                  for (uint32_t w = 0; w < shapes.at(2); ++w) {
+                    uint32_t pos[3] = {c, r, w};
+                    pos[axis] = indexes.at(pos[axis]);
+                    output->at(c, r, w) = input->at(pos[0], pos[1], pos[2]);
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, channels, rows, cols), 0.f);
+  }
+}
+
+TEST_F(test_kernel_reference, permute) {
+  const std::vector<std::vector<uint32_t>> all_axes{
+      {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+  for (const std::vector<uint32_t>& axes : all_axes) {
+    const uint32_t batch = RandomInt(1, 2);
+    const std::vector<uint32_t> input_shapes{
+        RandomInt(2, 16), RandomInt(2, 48), RandomInt(2, 48)};
+
+    PermuteLayer layer(axes);
+    std::ostringstream config;
+    config << "b" << batch << " " << input_shapes.at(0) << "x"
+           << input_shapes.at(1) << "x" << input_shapes.at(2) << " axes"
+           << axes.at(0) << axes.at(1) << axes.at(2) << " "
+           << layer.kernel_name();
+    Compare("Permute", config.str(), layer,
+            [&](const sftensor& input) {
+              sftensor output = TensorCreate(input_shapes.at(axes.at(0)),
+                                             input_shapes.at(axes.at(1)),
+                                             input_shapes.at(axes.at(2)));
+              for (uint32_t c = 0; c < output->channels(); ++c) {
+                for (uint32_t r = 0; r < output->rows(); ++r) {
+                  for (uint32_t w = 0; w < output->cols(); ++w) {
+                    // 输出的第i个维度来自输入的第axes[i]个维度
+                    uint32_t pos[3];
+                    pos[axes.at(0)] = c;
+                    pos[axes.at(1)] = r;
+                    pos[axes.at(2)] = w;
+                    output->at(c, r, w) = input->at(pos[0], pos[1], pos[2]);
+                  }
+                }
+              }
+              return output;
+            },
+            RandomInputs(batch, input_shapes.at(0), input_shapes.at(1),
+                         input_shapes.at(2)),
+            0.f);
+  }
+
+  for (uint32_t trial = 0; trial < 4; ++trial) {
+    const uint32_t groups = RandomInt(2, 4);
+    const uint32_t channels = groups * RandomInt(1, 6);
+    const uint32_t rows = RandomInt(1, 32);
+    const uint32_t cols = RandomInt(1, 32);
+
+    ChannelShuffleLayer layer(groups);
+    std::ostringstream config;
+    config << channels << "x" << rows << "x" << cols << " g" << groups;
+    Compare("ChannelShuffle", config.str(), layer,
+            [&](const sftensor& input) {
+              sftensor output = TensorCreate(channels, rows, cols);
+              const uint32_t channels_per_group = channels / groups;
+              for (uint32_t p = 0; p < channels_per_group; ++p) {
+                for (uint32_t q = 0; q < groups; ++q) {
+                  output->slice(p * groups + q) =
+                      std::as_const(*input).slice(q * channels_per_group + p);
+                }
+              }
+              return output;
+            },
+            RandomInputs(RandomInt(1, 2), channels, rows, cols), 0.f);
+  }
+}
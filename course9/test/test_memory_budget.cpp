@@ -0,0 +1,154 @@
+//
+// Created by fss on 23-9-2.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <map>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+static double ForwardCost(RuntimeGraph &graph,
+                          const std::vector<sftensor> &inputs,
+                          std::vector<sftensor> &outputs) {
+  const auto start = std::chrono::steady_clock::now();
+  outputs = graph.Forward(inputs, false);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+TEST(test_memory_budget, yolov5s) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+
+  const uint32_t batch_size = 1;
+  std::vector<sftensor> inputs;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    sftensor input = TensorCreate(3, 640, 640);
+    input->Rand();
+    inputs.push_back(input);
+  }
+
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  std::vector<sftensor> outputs;
+  ForwardCost(graph, inputs, outputs);
+  const double cost = ForwardCost(graph, inputs, outputs);
+
+  const uint64_t memory_budget = 64ull << 20;
+  RuntimeGraph budget_graph(param_path, bin_path);
+  budget_graph.set_memory_budget(memory_budget);
+  ASSERT_TRUE(budget_graph.Build("pnnx_input_0", "pnnx_output_0"));
+  std::vector<sftensor> budget_outputs;
+  ForwardCost(budget_graph, inputs, budget_outputs);
+  const double budget_cost = ForwardCost(budget_graph, inputs, budget_outputs);
+
+  // 峰值是推理之后实际测得的，包括卷积的边框缓冲区、im2col分块和yolo各阶段的张量
+  const RuntimeMemoryReport &report = budget_graph.memory_report();
+  ASSERT_LT(report.planned_bytes, report.unplanned_bytes);
+  ASSERT_GT(report.scratch_operators, 0);
+  ASSERT_GT(report.layer_buffer_bytes, 0);
+  ASSERT_GT(report.workspace_peak_bytes, 0);
+  ASSERT_GT(report.peak_bytes(), report.planned_bytes);
+  ASSERT_LE(report.peak_bytes(), memory_budget);
+
+  ASSERT_EQ(outputs.size(), budget_outputs.size());
+  for (uint32_t i = 0; i < outputs.size(); ++i) {
+    ASSERT_TRUE(TensorIsSame(outputs.at(i), budget_outputs.at(i), 1e-3f));
+  }
+
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  LOG(INFO) << "Outputs without reuse: " << report.unplanned_bytes / 1024
+            << " KB, peak under budget: " << report.peak_bytes() / 1024
+            << " KB, max resident set of process: " << usage.ru_maxrss << " KB";
+  LOG(INFO) << "Forward cost: " << cost << " ms, under budget: " << budget_cost
+            << " ms, throughput cost: " << (budget_cost / cost - 1.) * 100.
+            << "%";
+}
+
+TEST(test_memory_budget, yolov5s_reject_budget) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+
+  // 1MB放不下yolov5s的节点输出，构建失败而不是终止进程
+  RuntimeGraph graph(param_path, bin_path);
+  graph.set_memory_budget(1ull << 20);
+  ASSERT_FALSE(graph.Build("pnnx_input_0", "pnnx_output_0"));
+
+  // 调大预算之后可以重新构建并推理
+  graph.set_memory_budget(64ull << 20);
+  ASSERT_TRUE(graph.Build("pnnx_input_0", "pnnx_output_0"));
+  sftensor input = TensorCreate(3, 640, 640);
+  input->Rand();
+  const std::vector<sftensor> &outputs = graph.Forward({input}, false);
+  ASSERT_EQ(outputs.size(), 1);
+  ASSERT_LE(graph.memory_report().peak_bytes(), 64ull << 20);
+}
+
+TEST(test_memory_budget, yolov5s_schedule) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  sftensor input = TensorCreate(3, 640, 640);
+  input->Rand();
+
+  const uint64_t memory_budget = 64ull << 20;
+  std::vector<std::vector<sftensor>> outputs;
+  uint64_t topo_planned_bytes = 0;
+  for (const uint32_t beam_width : {0u, 1u, 8u}) {
+    RuntimeGraph graph(param_path, bin_path);
+    graph.set_memory_budget(memory_budget);
+    graph.set_schedule_beam_width(beam_width);
+    const auto start = std::chrono::steady_clock::now();
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    const double build_cost = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+
+    // 调整之后仍然是合法的拓扑顺序
+    const auto &topo_operators = graph.get_topo_queues();
+    std::map<std::string, uint32_t> positions;
+    for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+      positions.insert({topo_operators.at(i)->name, i});
+    }
+    for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+      const auto &next_operators = topo_operators.at(i)->output_operators;
+      for (const auto &[next_name, _] : next_operators) {
+        ASSERT_GT(positions.at(next_name), i);
+      }
+    }
+
+    // PlannedBytes和实际规划的结果一致，调整顺序之后yolov5s实际规划的字节数下降
+    const RuntimeMemoryReport &report = graph.memory_report();
+    if (beam_width == 0) {
+      ASSERT_EQ(report.planned_bytes, report.topo_planned_bytes);
+      ASSERT_EQ(report.scheduled_peak_bytes, report.topo_peak_bytes);
+      topo_planned_bytes = report.planned_bytes;
+    } else {
+      ASSERT_EQ(report.topo_planned_bytes, topo_planned_bytes);
+      ASSERT_LT(report.planned_bytes, topo_planned_bytes);
+    }
+    // 输出在计算图的内存块上，计算图析构前拷贝出来
+    std::vector<sftensor> graph_outputs;
+    for (const sftensor &output : graph.Forward({input}, false)) {
+      graph_outputs.push_back(TensorClone(output));
+    }
+    outputs.push_back(graph_outputs);
+    LOG(INFO) << "Beam width " << beam_width << ", peak live outputs: "
+              << report.topo_peak_bytes / 1024 << " KB in topo order, "
+              << report.scheduled_peak_bytes / 1024
+              << " KB scheduled, planned: " << report.topo_planned_bytes / 1024
+              << " KB in topo order, " << report.planned_bytes / 1024
+              << " KB scheduled, build: " << build_cost << " ms";
+  }
+  for (uint32_t i = 1; i < outputs.size(); ++i) {
+    ASSERT_EQ(outputs.at(i).size(), outputs.front().size());
+    for (uint32_t j = 0; j < outputs.front().size(); ++j) {
+      ASSERT_TRUE(TensorIsSame(outputs.at(i).at(j), outputs.front().at(j),
+                               1e-3f));
+    }
+  }
+}
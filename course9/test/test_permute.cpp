@@ -0,0 +1,241 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include "../source/layer/details/permute.hpp"
+#include "data/tensor_util.hpp"
+#include "runtime/ir.h"
+#include "runtime/runtime_ir.hpp"
+#include "pnnx_graph_util.hpp"
+
+using namespace kuiper_infer;
+
+/// 逐个元素计算置换的参考结果，输出的第k维来自输入的第axes[k]维
+static sftensor ReferencePermute(const sftensor &input,
+                                 const std::vector<uint32_t> &axes) {
+  const std::vector<uint32_t> &shapes = input->shapes();
+  sftensor output = TensorCreate(shapes.at(axes.at(0)), shapes.at(axes.at(1)),
+                                 shapes.at(axes.at(2)));
+  for (uint32_t c = 0; c < output->channels(); ++c) {
+    for (uint32_t r = 0; r < output->rows(); ++r) {
+      for (uint32_t w = 0; w < output->cols(); ++w) {
+        uint32_t index[3];
+        index[axes.at(0)] = c;
+        index[axes.at(1)] = r;
+        index[axes.at(2)] = w;
+        output->at(c, r, w) =
+            std::as_const(*input).at(index[0], index[1], index[2]);
+      }
+    }
+  }
+  return output;
+}
+
+static const std::vector<std::vector<uint32_t>> kPermutations{
+    {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+
+TEST(test_permute, all_axes) {
+  for (const auto &shapes : std::vector<std::vector<uint32_t>>{
+           {5, 17, 13}, {3, 40, 36}, {16, 9, 8}, {1, 33, 7}}) {
+    sftensor input = TensorCreate(shapes);
+    input->Rand();
+    for (const auto &axes : kPermutations) {
+      PermuteLayer permute_layer(axes);
+      std::vector<sftensor> outputs(1);
+      ASSERT_EQ(permute_layer.Forward({input}, outputs),
+                InferStatus::kInferSuccess);
+      ASSERT_TRUE(
+          TensorIsSame(outputs.front(), ReferencePermute(input, axes), 0.f))
+          << "axes " << axes.at(0) << axes.at(1) << axes.at(2) << ", shape "
+          << shapes.at(0) << "x" << shapes.at(1) << "x" << shapes.at(2);
+    }
+  }
+}
+
+TEST(test_permute, view) {
+  // 行数为1时交换行和列、通道数为1时交换通道和列都不改变内存中的顺序
+  ASSERT_TRUE(PermuteLayer::KeepsMemoryOrder({0, 2, 1}, {4, 1, 9}));
+  ASSERT_TRUE(PermuteLayer::KeepsMemoryOrder({2, 1, 0}, {1, 5, 9}));
+  ASSERT_FALSE(PermuteLayer::KeepsMemoryOrder({1, 0, 2}, {1, 5, 9}));
+  ASSERT_FALSE(PermuteLayer::KeepsMemoryOrder({0, 2, 1}, {4, 3, 9}));
+  ASSERT_FALSE(PermuteLayer::KeepsMemoryOrder({1, 0, 2}, {2, 5, 9}));
+
+  sftensor input = TensorCreate(4, 1, 9);
+  input->Rand();
+  PermuteLayer permute_layer({0, 2, 1}, true);
+  ASSERT_TRUE(permute_layer.output_is_view());
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(permute_layer.Forward({input}, outputs),
+            InferStatus::kInferSuccess);
+  ASSERT_EQ(std::as_const(*outputs.front()).data().memptr(),
+            std::as_const(*input).data().memptr());
+  ASSERT_TRUE(TensorIsSame(outputs.front(),
+                           ReferencePermute(input, {0, 2, 1}), 0.f));
+
+  // 形状不满足条件时退回到拷贝
+  sftensor other = TensorCreate(4, 3, 9);
+  other->Rand();
+  std::vector<sftensor> other_outputs(1);
+  ASSERT_EQ(permute_layer.Forward({other}, other_outputs),
+            InferStatus::kInferSuccess);
+  ASSERT_NE(std::as_const(*other_outputs.front()).data().memptr(),
+            std::as_const(*other).data().memptr());
+  ASSERT_TRUE(TensorIsSame(other_outputs.front(),
+                           ReferencePermute(other, {0, 2, 1}), 0.f));
+}
+
+TEST(test_permute, channel_shuffle) {
+  sftensor input = TensorCreate(12, 7, 5);
+  input->Rand();
+  ChannelShuffleLayer shuffle_layer(3);
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(shuffle_layer.Forward({input}, outputs),
+            InferStatus::kInferSuccess);
+  // view(4, 3, 4) -> transpose(0, 1): 输出的第p * 3 + q个通道来自输入的第q * 4 + p个通道
+  for (uint32_t p = 0; p < 4; ++p) {
+    for (uint32_t q = 0; q < 3; ++q) {
+      ASSERT_TRUE(arma::approx_equal(outputs.front()->slice(p * 3 + q),
+                                     input->slice(q * 4 + p), "absdiff", 0.f));
+    }
+  }
+
+  ChannelShuffleLayer identity_layer(1, true);
+  std::vector<sftensor> identity_outputs(1);
+  ASSERT_EQ(identity_layer.Forward({input}, identity_outputs),
+            InferStatus::kInferSuccess);
+  ASSERT_EQ(std::as_const(*identity_outputs.front()).data().memptr(),
+            std::as_const(*input).data().memptr());
+
+  ChannelShuffleLayer wrong_layer(5);
+  ASSERT_EQ(wrong_layer.Forward({input}, outputs),
+            InferStatus::kInferFailedChannelParameterError);
+}
+
+TEST(test_permute, bandwidth) {
+  const uint32_t runs = 10;
+  sftensor input = TensorCreate(64, 80, 80);
+  input->Rand();
+  const double gigabytes = 2. * input->size() * sizeof(float) / 1e9;
+  std::vector<float> copy(input->size());
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    std::memcpy(copy.data(), std::as_const(*input).data().memptr(),
+                input->size() * sizeof(float));
+  }
+  const double memcpy_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             runs;
+  LOG(INFO) << "memcpy 64x80x80: " << memcpy_cost << " ms ("
+            << gigabytes / memcpy_cost * 1e3 << " GB/s)";
+
+  for (const auto &axes : kPermutations) {
+    PermuteLayer permute_layer(axes);
+    std::vector<sftensor> outputs(1);
+    ASSERT_EQ(permute_layer.Forward({input}, outputs),
+              InferStatus::kInferSuccess);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; ++i) {
+      permute_layer.Forward({input}, outputs);
+    }
+    const double permute_cost = std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count() /
+                                runs;
+
+    // 按输出的顺序逐个元素读取输入的朴素实现
+    start = std::chrono::steady_clock::now();
+    const sftensor &naive = ReferencePermute(input, axes);
+    const double naive_cost = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+    ASSERT_TRUE(TensorIsSame(outputs.front(), naive, 0.f));
+    LOG(INFO) << "Permute (" << axes.at(0) << ", " << axes.at(1) << ", "
+              << axes.at(2) << ") " << permute_layer.kernel_name() << ": "
+              << permute_cost << " ms ("
+              << gigabytes / permute_cost * 1e3 << " GB/s, "
+              << memcpy_cost / permute_cost * 100.
+              << "% of memcpy), element-wise: " << naive_cost << " ms";
+  }
+
+  ChannelShuffleLayer shuffle_layer(4);
+  std::vector<sftensor> outputs(1);
+  shuffle_layer.Forward({input}, outputs);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    shuffle_layer.Forward({input}, outputs);
+  }
+  const double shuffle_cost = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count() /
+                              runs;
+  LOG(INFO) << "Channel shuffle groups 4: " << shuffle_cost << " ms ("
+            << gigabytes / shuffle_cost * 1e3 << " GB/s, "
+            << memcpy_cost / shuffle_cost * 100. << "% of memcpy)";
+}
+
+TEST(test_permute, shuffle_permute_graph) {
+  const std::string &param_path = "permute_graph.pnnx.param";
+  const std::string &bin_path = "permute_graph.pnnx.bin";
+  {
+    // view(1, 2, 4, 6, 5) -> transpose(1, 2) -> view(1, 8, 6, 5) -> permute(0, 2, 3, 1)
+    pnnx::Graph graph;
+    pnnx::Operator *input = graph.new_operator("pnnx.Input", "pnnx_input_0");
+    pnnx::Operand *x = NewOperand(graph, input, {1, 8, 6, 5});
+    pnnx::Operator *view = graph.new_operator("Tensor.view", "view_0");
+    view->params["shape"] = {1, 2, 4, 6, 5};
+    Consume(view, x);
+    pnnx::Operand *grouped = NewOperand(graph, view, {1, 2, 4, 6, 5});
+    pnnx::Operator *transpose =
+        graph.new_operator("torch.transpose", "transpose_0");
+    transpose->params["dim0"] = 1;
+    transpose->params["dim1"] = 2;
+    Consume(transpose, grouped);
+    pnnx::Operand *transposed = NewOperand(graph, transpose, {1, 4, 2, 6, 5});
+    pnnx::Operator *restore = graph.new_operator("Tensor.view", "view_1");
+    restore->params["shape"] = {1, 8, 6, 5};
+    Consume(restore, transposed);
+    pnnx::Operand *shuffled = NewOperand(graph, restore, {1, 8, 6, 5});
+    pnnx::Operator *permute = graph.new_operator("torch.permute", "permute");
+    permute->params["dims"] = {0, 2, 3, 1};
+    Consume(permute, shuffled);
+    pnnx::Operand *permuted = NewOperand(graph, permute, {1, 6, 5, 8});
+    pnnx::Operator *output =
+        graph.new_operator("pnnx.Output", "pnnx_output_0");
+    Consume(output, permuted);
+    ASSERT_EQ(graph.save(param_path, bin_path), 0);
+  }
+
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  std::vector<std::string> types;
+  for (const auto &op : graph.get_topo_queues()) {
+    types.push_back(op->type);
+  }
+  ASSERT_EQ(types, std::vector<std::string>({"pnnx.Input", "nn.ChannelShuffle",
+                                             "torch.permute", "pnnx.Output"}));
+
+  sftensor input = TensorCreate(8, 6, 5);
+  input->Rand();
+  sftensor target = TensorCreate(6, 5, 8);
+  for (uint32_t c = 0; c < 6; ++c) {
+    for (uint32_t r = 0; r < 5; ++r) {
+      for (uint32_t w = 0; w < 8; ++w) {
+        // 置换后的(c, r, w)来自重排后的第w个通道，重排后的第p * 2 + q个通道来自第q * 4 + p个通道
+        const uint32_t source_channel = (w % 2) * 4 + w / 2;
+        target->at(c, r, w) = std::as_const(*input).at(source_channel, c, r);
+      }
+    }
+  }
+  const std::vector<sftensor> &outputs = graph.Forward({input}, false);
+  ASSERT_EQ(outputs.size(), 1);
+  ASSERT_TRUE(TensorIsSame(outputs.front(), target, 0.f));
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
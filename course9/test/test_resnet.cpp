@@ -6,6 +6,7 @@
 #include <opencv2/opencv.hpp>
 #include "../source/layer/details/expression.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "utils/math/transpose.hpp"
 #include "../source/layer/details/softmax.hpp"
 
 using namespace kuiper_infer;
@@ -31,9 +32,10 @@ kuiper_infer::sftensor PreProcessImage(const cv::Mat &image) {
   uint32_t index = 0;
   for (const auto &split_image : split_images) {
     assert(split_image.total() == input_w * input_h);
-    const cv::Mat &split_image_t = split_image.t();
-    memcpy(input->slice(index).memptr(), split_image_t.data,
-           sizeof(float) * split_image.total());
+    // OpenCV的行主序图像即列主序的input_w x input_h矩阵
+    assert(split_image.isContinuous());
+    TransposePlanes(split_image.ptr<float>(), input->slice(index).memptr(),
+                    input_w, input_h, 1);
     index += 1;
   }
 
@@ -0,0 +1,251 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_batcher.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/runtime_synthetic.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+static void LogReport(const BatchingReport &report) {
+  for (const BucketReport &bucket : report.buckets) {
+    LOG(INFO) << "Bucket " << bucket.height << "x" << bucket.width << ": "
+              << bucket.requests << " requests, " << bucket.batches
+              << " batches, " << bucket.empty_slots << " empty slots, "
+              << bucket.forward_ms << " ms";
+  }
+  LOG(INFO) << "Padding " << report.padding_ratio() * 100.
+            << "%, single bucket padding "
+            << report.single_bucket_padding_ratio() * 100. << "%, "
+            << report.throughput << " requests/s";
+}
+
+TEST(test_runtime_batcher, select_bucket) {
+  // 计算图在第一次Forward时才构建，只选择桶不需要模型文件
+  RuntimeBatcher batcher("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(batcher.SelectBucket(720, 1280), -1);
+  ASSERT_TRUE(batcher.AddBucket(384, 640, "bucket_384.param", "bucket_384.bin"));
+  ASSERT_TRUE(batcher.AddBucket(480, 640, "bucket_480.param", "bucket_480.bin"));
+  ASSERT_TRUE(batcher.AddBucket(640, 640, "bucket_640.param", "bucket_640.bin"));
+  ASSERT_FALSE(batcher.AddBucket(640, 640, "other.param", "other.bin"));
+  ASSERT_FALSE(batcher.AddBucket(0, 640, "other.param", "other.bin"));
+
+  ASSERT_EQ(batcher.SelectBucket(720, 1280), 0);   // 16:9
+  ASSERT_EQ(batcher.SelectBucket(1080, 1440), 1);  // 4:3
+  ASSERT_EQ(batcher.SelectBucket(1280, 720), 2);   // 竖屏
+  ASSERT_EQ(batcher.SelectBucket(640, 640), 2);
+  ASSERT_EQ(batcher.SelectBucket(200, 300), 0);    // 小图不放大
+  ASSERT_EQ(batcher.SelectBucket(0, 300), -1);
+
+  ASSERT_EQ(LetterboxContentPixels(720, 1280, 384, 640), 360 * 640);
+  ASSERT_EQ(LetterboxContentPixels(720, 1280, 640, 640), 360 * 640);
+  ASSERT_EQ(LetterboxContentPixels(200, 300, 640, 640), 200 * 300);
+}
+
+TEST(test_runtime_batcher, yolov5_bucket) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  std::vector<cv::Mat> images;
+  for (const std::string &path :
+       {"./course9/model_file/car.jpg", "./course9/model_file/bus.jpg",
+        "./course9/model_file/31.jpg"}) {
+    images.push_back(cv::imread(path));
+    ASSERT_FALSE(images.back().empty());
+  }
+
+  std::vector<BatchRequest> requests;
+  for (uint32_t round = 0; round < 2; ++round) {
+    for (const cv::Mat &image : images) {
+      requests.push_back({uint32_t(image.rows), uint32_t(image.cols)});
+    }
+  }
+  const BucketPreprocess preprocess = [&images](uint32_t index,
+                                                uint32_t bucket_h,
+                                                uint32_t bucket_w) {
+    return PreProcessImage(images.at(index % images.size()), bucket_h,
+                           bucket_w);
+  };
+
+  RuntimeBatcher batcher("pnnx_input_0", "pnnx_output_0");
+  ASSERT_TRUE(batcher.AddBucket(640, 640, param_path, bin_path));
+  const std::vector<sftensor> &outputs = batcher.Forward(requests, preprocess);
+  ASSERT_EQ(outputs.size(), requests.size());
+  const BatchingReport &report = batcher.report();
+  ASSERT_EQ(report.requests, requests.size());
+  ASSERT_EQ(report.buckets.size(), 1);
+  ASSERT_EQ(report.buckets.front().batches,
+            requests.size() / report.buckets.front().batch_size);
+  ASSERT_GT(report.padding_pixels, 0);
+  LogReport(report);
+
+  // 分桶的结果和直接推理相同，各请求的输出互不覆盖
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  for (uint32_t i = 0; i < requests.size(); ++i) {
+    const sftensor &expect =
+        graph.Forward({preprocess(i, 640, 640)}, false).front();
+    ASSERT_TRUE(TensorIsSame(outputs.at(i), expect, 1e-5f));
+  }
+
+  // 缓存的计算图在第二次Forward时不再构建
+  const auto start = std::chrono::steady_clock::now();
+  batcher.Forward(requests, preprocess);
+  LOG(INFO) << "Cached bucket forward: "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms";
+  LogReport(batcher.report());
+}
+
+TEST(test_runtime_batcher, synthetic_buckets) {
+  // 同一个种子在不同的输入大小和批次下生成相同的权重，
+  // 批次为2的计算图作为桶，批次为1的计算图作为逐个请求推理的参照
+  const std::vector<std::pair<uint32_t, uint32_t>> sizes{{24, 40}, {32, 32}};
+  SyntheticGraphOptions options;
+  options.depth = 4;
+  options.branches = 2;
+  options.pool_every = 2;
+  options.channels = 8;
+  options.seed = 11;
+
+  RuntimeBatcher batcher("pnnx_input_0", "pnnx_output_0");
+  std::vector<std::string> files;
+  std::vector<std::unique_ptr<RuntimeGraph>> references;
+  for (const auto &[height, width] : sizes) {
+    options.input_h = height;
+    options.input_w = width;
+    for (const uint32_t batch : {2, 1}) {
+      options.batch = batch;
+      const std::string &prefix = "synthetic_bucket_" + std::to_string(height) +
+                                  "x" + std::to_string(width) + "_batch" +
+                                  std::to_string(batch);
+      const std::string &param_path = prefix + ".pnnx.param";
+      const std::string &bin_path = prefix + ".pnnx.bin";
+      ASSERT_TRUE(GenerateSyntheticGraph(options, param_path, bin_path));
+      files.push_back(param_path);
+      files.push_back(bin_path);
+      if (batch == 2) {
+        ASSERT_TRUE(batcher.AddBucket(height, width, param_path, bin_path));
+      } else {
+        references.push_back(
+            std::make_unique<RuntimeGraph>(param_path, bin_path));
+        ASSERT_TRUE(
+            references.back()->Build("pnnx_input_0", "pnnx_output_0"));
+      }
+    }
+  }
+
+  // 横屏、方形、小图、竖屏交错到达，其中一个大小为0的请求无法分桶
+  const std::vector<BatchRequest> requests{
+      {48, 80}, {64, 64}, {20, 30}, {40, 30}, {0, 16},
+      {96, 160}, {64, 64}, {30, 50}};
+  const std::vector<int32_t> expect_buckets{0, 1, 0, 1, -1, 0, 1, 0};
+  for (uint32_t i = 0; i < requests.size(); ++i) {
+    ASSERT_EQ(batcher.SelectBucket(requests.at(i).height, requests.at(i).width),
+              expect_buckets.at(i));
+  }
+
+  // 每个请求的输入由序号决定，不同请求的输入互不相同
+  const BucketPreprocess preprocess = [](uint32_t index, uint32_t bucket_h,
+                                         uint32_t bucket_w) {
+    sftensor input = TensorCreate(3, bucket_h, bucket_w);
+    float *data = input->raw_ptr();
+    for (uint32_t j = 0; j < input->size(); ++j) {
+      data[j] = float((index * 131 + j * 7) % 97) / 97.f;
+    }
+    return input;
+  };
+
+  const std::vector<sftensor> &outputs = batcher.Forward(requests, preprocess);
+  ASSERT_EQ(outputs.size(), requests.size());
+  const BatchingReport &report = batcher.report();
+  ASSERT_EQ(report.rejected, 1);
+  ASSERT_EQ(report.requests, requests.size() - 1);
+  ASSERT_EQ(report.buckets.size(), 2);
+  ASSERT_EQ(report.buckets.at(0).requests, 4);
+  ASSERT_EQ(report.buckets.at(0).batches, 2);
+  ASSERT_EQ(report.buckets.at(0).empty_slots, 0);
+  ASSERT_EQ(report.buckets.at(1).requests, 3);
+  ASSERT_EQ(report.buckets.at(1).batches, 2);
+  ASSERT_EQ(report.buckets.at(1).empty_slots, 1);
+  LogReport(report);
+
+  // 合并执行的输出和逐个请求推理的输出相同
+  for (uint32_t i = 0; i < requests.size(); ++i) {
+    const int32_t bucket = expect_buckets.at(i);
+    if (bucket < 0) {
+      ASSERT_EQ(outputs.at(i), nullptr);
+      continue;
+    }
+    ASSERT_NE(outputs.at(i), nullptr);
+    const auto &[height, width] = sizes.at(bucket);
+    const sftensor &expect =
+        references.at(bucket)->Forward({preprocess(i, height, width)}, false)
+            .front();
+    ASSERT_EQ(outputs.at(i)->shapes(), expect->shapes());
+    ASSERT_TRUE(TensorIsSame(outputs.at(i), expect, 1e-4f));
+  }
+
+  for (const std::string &file : files) {
+    std::remove(file.c_str());
+  }
+}
+
+TEST(test_runtime_batcher, failed_bucket) {
+  SyntheticGraphOptions options;
+  options.depth = 2;
+  options.channels = 8;
+  options.input_h = 24;
+  options.input_w = 40;
+  options.batch = 2;
+  const std::string &param_path = "synthetic_failed_bucket.pnnx.param";
+  const std::string &bin_path = "synthetic_failed_bucket.pnnx.bin";
+  ASSERT_TRUE(GenerateSyntheticGraph(options, param_path, bin_path));
+
+  const BucketPreprocess preprocess = [](uint32_t index, uint32_t bucket_h,
+                                         uint32_t bucket_w) {
+    sftensor input = TensorCreate(3, bucket_h, bucket_w);
+    input->Fill(float(index));
+    return input;
+  };
+  const std::vector<BatchRequest> requests{{48, 80}, {64, 64}, {96, 160}};
+
+  // 32x32的桶使用了24x40的模型文件，输入的形状不一致，只拒绝该桶的请求
+  RuntimeBatcher batcher("pnnx_input_0", "pnnx_output_0");
+  ASSERT_TRUE(batcher.AddBucket(24, 40, param_path, bin_path));
+  ASSERT_TRUE(batcher.AddBucket(32, 32, param_path, bin_path));
+  std::vector<sftensor> outputs = batcher.Forward(requests, preprocess);
+  ASSERT_EQ(outputs.size(), requests.size());
+  ASSERT_NE(outputs.at(0), nullptr);
+  ASSERT_EQ(outputs.at(1), nullptr);
+  ASSERT_NE(outputs.at(2), nullptr);
+  ASSERT_EQ(batcher.report().rejected, 1);
+  ASSERT_EQ(batcher.report().requests, 2);
+  ASSERT_EQ(batcher.report().buckets.at(1).requests, 0);
+  ASSERT_EQ(batcher.report().buckets.at(1).batches, 0);
+
+  // 内存预算放不下计算图时拒绝所有请求，不终止进程
+  RuntimeBatcher small_batcher("pnnx_input_0", "pnnx_output_0");
+  ASSERT_TRUE(small_batcher.AddBucket(24, 40, param_path, bin_path));
+  small_batcher.set_memory_budget(1024);
+  outputs = small_batcher.Forward(requests, preprocess);
+  ASSERT_EQ(outputs.size(), requests.size());
+  for (const sftensor &output : outputs) {
+    ASSERT_EQ(output, nullptr);
+  }
+  ASSERT_EQ(small_batcher.report().rejected, requests.size());
+  ASSERT_EQ(small_batcher.report().requests, 0);
+
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
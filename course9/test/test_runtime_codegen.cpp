@@ -0,0 +1,110 @@
+//
+// Created by fss on 23-9-13.
+//
+#include <dlfcn.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_codegen.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+TEST(test_runtime_codegen, unsupported_operator) {
+  // resnet18中的AdaptiveAvgPool2d和Linear没有对应的生成内核
+  RuntimeCodegen codegen("course9/model_file/resnet18_batch1.pnnx.param",
+                         "course9/model_file/resnet18_batch1.pnnx.bin");
+  ASSERT_FALSE(codegen.Generate("resnet18", "./resnet18_aot.cpp",
+                                "./resnet18_aot.weights"));
+  ASSERT_FALSE(codegen.Generate("0resnet18", "./resnet18_aot.cpp",
+                                "./resnet18_aot.weights"));
+  std::remove("./resnet18_aot.cpp");
+  std::remove("./resnet18_aot.weights");
+}
+
+TEST(test_runtime_codegen, yolov5_aot) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  const std::string source_path = "./yolov5s_aot.cpp";
+  const std::string weight_path = "./yolov5s_aot.weights";
+  const std::string library_path = "./yolov5s_aot.so";
+
+  RuntimeCodegen codegen(param_path, bin_path);
+  ASSERT_TRUE(codegen.Generate("yolov5s_aot", source_path, weight_path));
+  const CodegenReport &report = codegen.report();
+  ASSERT_EQ(report.fused_activations, 57);
+  ASSERT_LT(report.arena_bytes, report.unplanned_bytes);
+  LOG(INFO) << "Generated " << report.kernels << " kernels, arena "
+            << report.arena_bytes << " bytes, outputs without reuse "
+            << report.unplanned_bytes << " bytes, workspace "
+            << report.workspace_bytes << " bytes";
+
+  // 没有编译器时只检查生成的结果
+  if (std::system("c++ --version > /dev/null 2>&1") != 0) {
+    LOG(WARNING) << "No compiler found, skip compiling the generated code";
+    return;
+  }
+  const std::string command = "c++ -std=c++17 -O3 -march=native -fopenmp "
+                              "-fPIC -shared -Icourse9/include " +
+                              source_path + " -o " + library_path;
+  ASSERT_EQ(std::system(command.c_str()), 0) << command;
+
+  void *library = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  ASSERT_NE(library, nullptr) << dlerror();
+  auto load = reinterpret_cast<bool (*)(const char *)>(
+      dlsym(library, "yolov5s_aot_load"));
+  auto unload = reinterpret_cast<void (*)()>(dlsym(library, "yolov5s_aot_unload"));
+  auto forward = reinterpret_cast<void (*)(const float *, float *)>(
+      dlsym(library, "yolov5s_aot_forward"));
+  ASSERT_TRUE(load != nullptr && unload != nullptr && forward != nullptr);
+  ASSERT_TRUE(load(weight_path.c_str()));
+
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  sftensor input = PreProcessImage(image, 640, 640);
+
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  const sftensor &expect = graph.Forward({input}, false).front();
+  sftensor output = TensorCreate(expect->shapes());
+  forward(input->raw_ptr(), output->raw_ptr());
+
+  float max_error = 0.f;
+  for (uint32_t i = 0; i < expect->size(); ++i) {
+    const float expect_value = expect->index(i);
+    max_error = std::max(max_error, std::fabs(output->index(i) - expect_value) /
+                                        (1.f + std::fabs(expect_value)));
+  }
+  ASSERT_LT(max_error, 1e-3f);
+
+  const uint32_t runs = 5;
+  double costs[2] = {0., 0.};
+  for (uint32_t i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    graph.Forward({input}, false);
+    costs[0] += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    start = std::chrono::steady_clock::now();
+    forward(input->raw_ptr(), output->raw_ptr());
+    costs[1] += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  }
+  LOG(INFO) << "Yolov5s 640x640 RuntimeGraph: " << costs[0] / runs
+            << " ms, generated code: " << costs[1] / runs
+            << " ms, max relative error: " << max_error;
+
+  unload();
+  dlclose(library);
+  std::remove(source_path.c_str());
+  std::remove(weight_path.c_str());
+  std::remove(library_path.c_str());
+}
@@ -0,0 +1,118 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <array>
+#include <utility>
+#include <opencv2/opencv.hpp>
+#include "runtime/runtime_fork.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+/// 工作进程通过管道返回的结果
+struct WorkerResult {
+  double checksum = 0.;
+  double forward_ms = 0.;
+  ProcessMemory memory;
+  ProcessMemory weight_region;  /// 只读权重所在映射的内存占用
+};
+
+static double Checksum(const sftensor &output) {
+  const float *data = std::as_const(*output).data().memptr();
+  double checksum = 0.;
+  for (uint32_t i = 0; i < output->size(); ++i) {
+    checksum += data[i];
+  }
+  return checksum;
+}
+
+static void LogMemory(const std::string &name, const ProcessMemory &memory) {
+  LOG(INFO) << name << ": rss " << memory.rss << " KB, pss " << memory.pss
+            << " KB, shared " << memory.shared_clean + memory.shared_dirty
+            << " KB, private dirty " << memory.private_dirty << " KB";
+}
+
+TEST(test_runtime_fork, yolov5_workers) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  const uint32_t workers = 3;
+
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  const ForkReport &report = graph.PrepareFork();
+  ASSERT_GT(report.prepared_layers, 0);
+  ASSERT_GT(report.frozen_bytes, 0);
+  ASSERT_NE(report.arena_address, 0);
+  ASSERT_GE(report.arena_bytes, report.frozen_bytes);
+  LOG(INFO) << "Prepare fork: " << report.prepared_layers << " layers, "
+            << report.frozen_bytes << " bytes of weights frozen in "
+            << report.prepare_ms << " ms";
+  ProcessMemory parent_memory;
+  ASSERT_TRUE(ReadProcessMemory(0, parent_memory));
+  LogMemory("Parent after build", parent_memory);
+
+  std::vector<std::array<int, 2>> pipes(workers);
+  for (auto &pipe_fds : pipes) {
+    ASSERT_EQ(pipe(pipe_fds.data()), 0);
+  }
+  // 图片的读取和预处理也放在子进程中，父进程在fork之前不启动任何线程池
+  const std::vector<int32_t> &pids =
+      ForkWorkers(workers, [&](uint32_t index) {
+        const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+        if (image.empty()) {
+          return 1;
+        }
+        const sftensor input = PreProcessImage(image, 640, 640);
+        WorkerResult result;
+        const auto start = std::chrono::steady_clock::now();
+        result.checksum = Checksum(graph.Forward({input}, false).front());
+        result.forward_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+        if (!ReadProcessMemory(0, result.memory) ||
+            !ReadRegionMemory(0, report.arena_address, result.weight_region)) {
+          return 2;
+        }
+        const int fd = pipes.at(index)[1];
+        return write(fd, &result, sizeof(result)) == sizeof(result) ? 0 : 3;
+      });
+  ASSERT_EQ(pids.size(), workers);
+
+  std::vector<WorkerResult> results(workers);
+  for (uint32_t i = 0; i < workers; ++i) {
+    close(pipes.at(i)[1]);
+    ASSERT_EQ(read(pipes.at(i)[0], &results.at(i), sizeof(WorkerResult)),
+              sizeof(WorkerResult));
+    close(pipes.at(i)[0]);
+  }
+  ASSERT_TRUE(WaitWorkers(pids));
+
+  // 父进程在子进程退出后推理，结果应和子进程一致
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  const double checksum =
+      Checksum(graph.Forward({PreProcessImage(image, 640, 640)}, false).front());
+  for (uint32_t i = 0; i < workers; ++i) {
+    const WorkerResult &result = results.at(i);
+    ASSERT_NEAR(result.checksum, checksum, std::fabs(checksum) * 1e-5 + 1e-3);
+    // 冻结的权重和父进程共享，均摊之后的占用小于驻留的大小
+    ASSERT_LT(result.memory.pss, result.memory.rss);
+    ASSERT_GE((result.memory.shared_clean + result.memory.shared_dirty) * 1024,
+              report.frozen_bytes / 2);
+    // 子进程的推理没有写入权重所在的内存页，包括检测头内部卷积展开之后的权重，
+    // 这些内存页全部和父进程共享，没有写时复制产生的私有副本
+    const ProcessMemory &region = result.weight_region;
+    ASSERT_EQ(region.private_dirty, 0);
+    ASSERT_GE((region.shared_clean + region.shared_dirty) * 1024,
+              report.frozen_bytes / 2);
+    LOG(INFO) << "Worker " << i << " forward " << result.forward_ms << " ms";
+    LogMemory("Worker " + std::to_string(i), result.memory);
+    LogMemory("Worker " + std::to_string(i) + " weights", region);
+  }
+}
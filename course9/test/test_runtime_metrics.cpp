@@ -0,0 +1,124 @@
+//
+// Created by fss on 23-9-9.
+//
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/runtime_metrics.hpp"
+
+using namespace kuiper_infer;
+
+static std::string Scrape(uint16_t port, const std::string& path) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  CHECK(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+        0);
+  const std::string request =
+      "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  CHECK(send(fd, request.data(), request.size(), 0) == request.size());
+
+  std::string response;
+  char buffer[4096];
+  ssize_t read_size = 0;
+  while ((read_size = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, read_size);
+  }
+  close(fd);
+  return response;
+}
+
+TEST(test_runtime_metrics, http_scrape) {
+  const std::string& param_path =
+      "course9/model_file/resnet18_batch1.pnnx.param";
+  const std::string& bin_path = "course9/model_file/resnet18_batch1.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  graph.EnableMetrics("resnet18");
+
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  const uint32_t runs = 3;
+  for (uint32_t i = 0; i < runs; ++i) {
+    graph.Forward({input}, false);
+  }
+
+  MetricsExporter exporter;
+  ASSERT_TRUE(exporter.StartHttp(0));
+  ASSERT_NE(exporter.port(), 0);
+  const std::string& response = Scrape(exporter.port(), "/metrics");
+  ASSERT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0);
+  ASSERT_NE(response.find("kuiper_forward_latency_seconds_count{model="
+                          "\"resnet18\",batch=\"1\"} 3\n"),
+            std::string::npos);
+  ASSERT_NE(response.find("kuiper_layer_calls_total{model=\"resnet18\","
+                          "layer_type=\"nn.Conv2d\"} "),
+            std::string::npos);
+  ASSERT_NE(response.find("kuiper_queue_depth{model=\"resnet18\"} 0\n"),
+            std::string::npos);
+  ASSERT_NE(response.find("kuiper_forward_allocations_count{model="
+                          "\"resnet18\"} 3\n"),
+            std::string::npos);
+  ASSERT_EQ(Scrape(exporter.port(), "/other").rfind("HTTP/1.1 404", 0), 0);
+  exporter.Stop();
+  ASSERT_EQ(exporter.port(), 0);
+}
+
+TEST(test_runtime_metrics, file_export) {
+  RuntimeMetrics::Instance().ForwardLatency("file_model", 4)->Observe(0.002);
+  const std::string path = "./metrics_test.prom";
+  MetricsExporter exporter;
+  ASSERT_TRUE(exporter.StartFile(path, 20));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  exporter.Stop();
+
+  std::ifstream file(path);
+  ASSERT_TRUE(file.is_open());
+  std::stringstream content;
+  content << file.rdbuf();
+  ASSERT_NE(content.str().find("kuiper_forward_latency_seconds_bucket{model="
+                               "\"file_model\",batch=\"4\",le=\"0.0025\"} 1\n"),
+            std::string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(test_runtime_metrics, overhead) {
+  const std::string& param_path =
+      "course9/model_file/resnet18_batch1.pnnx.param";
+  const std::string& bin_path = "course9/model_file/resnet18_batch1.pnnx.bin";
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  const uint32_t runs = 10;
+
+  double costs[2] = {0., 0.};
+  for (const bool metrics : {false, true}) {
+    RuntimeGraph graph(param_path, bin_path);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    if (metrics) {
+      graph.EnableMetrics("resnet18_overhead");
+    }
+    graph.Forward({input}, false);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; ++i) {
+      graph.Forward({input}, false);
+    }
+    costs[metrics] = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() /
+                     runs;
+  }
+  LOG(INFO) << "Resnet18 forward without metrics: " << costs[0]
+            << " ms, with metrics: " << costs[1] << " ms";
+}
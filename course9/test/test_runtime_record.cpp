@@ -0,0 +1,168 @@
+//
+// Created by fss on 23-9-11.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/runtime_record.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+static void LogReport(const std::string &name, const LatencyReport &report) {
+  LOG(INFO) << name << ": " << report.samples << " runs, mean " << report.mean
+            << " ms, p50 " << report.p50 << " ms, p90 " << report.p90
+            << " ms, p99 " << report.p99 << " ms, max " << report.max
+            << " ms, " << report.throughput << " runs/s";
+}
+
+TEST(test_runtime_record, round_trip) {
+  const std::string &param_path =
+      "course9/model_file/resnet18_batch1.pnnx.param";
+  const std::string &bin_path = "course9/model_file/resnet18_batch1.pnnx.bin";
+  const std::string record_path = "./resnet18_record.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  std::vector<sftensor> inputs;
+  std::vector<sftensor> outputs;
+  ASSERT_TRUE(graph.StartRecording(record_path));
+  for (uint32_t i = 0; i < 3; ++i) {
+    sftensor input = TensorCreate(3, 224, 224);
+    input->Rand();
+    inputs.push_back(input);
+    outputs.push_back(TensorClone(graph.Forward({input}, false).front()));
+  }
+  graph.StopRecording();
+  // 停止录制后的推理不再写入日志
+  graph.Forward({inputs.front()}, false);
+
+  std::vector<ForwardRecord> records;
+  ASSERT_TRUE(LoadForwardRecords(record_path, records));
+  ASSERT_EQ(records.size(), inputs.size());
+  for (uint32_t i = 0; i < records.size(); ++i) {
+    const ForwardRecord &record = records.at(i);
+    ASSERT_EQ(record.inputs.size(), 1);
+    ASSERT_GT(record.latency_ns, 0);
+    ASSERT_TRUE(TensorIsSame(record.inputs.front(), inputs.at(i), 0.f));
+    if (i > 0) {
+      ASSERT_GE(record.offset_ns,
+                records.at(i - 1).offset_ns + records.at(i - 1).latency_ns);
+    }
+    // 回放录制的输入得到相同的结果
+    ASSERT_TRUE(TensorIsSame(graph.Forward(record.inputs, false).front(),
+                             outputs.at(i), 1e-5f));
+  }
+  std::remove(record_path.c_str());
+}
+
+TEST(test_runtime_record, truncated_log) {
+  const std::string record_path = "./truncated_record.bin";
+  {
+    ForwardRecorder recorder(record_path);
+    ASSERT_TRUE(recorder.is_open());
+    sftensor input = TensorCreate(2, 3, 4);
+    input->Rand();
+    recorder.Record({input}, 100, 10);
+    recorder.Record({input}, 200, 10);
+  }
+  // 截断最后一条记录的一部分数据，模拟进程在写入时退出
+  std::ifstream file(record_path, std::ios::binary | std::ios::ate);
+  const auto size = file.tellg();
+  file.close();
+  std::vector<char> content(size);
+  std::ifstream(record_path, std::ios::binary).read(content.data(), size);
+  std::ofstream(record_path, std::ios::binary | std::ios::trunc)
+      .write(content.data(), size - std::streamoff(8));
+
+  std::vector<ForwardRecord> records;
+  ASSERT_TRUE(LoadForwardRecords(record_path, records));
+  ASSERT_EQ(records.size(), 1);
+  ASSERT_EQ(records.front().offset_ns, 0);
+  ASSERT_EQ(records.front().inputs.front()->shapes(),
+            std::vector<uint32_t>({2, 3, 4}));
+  std::remove(record_path.c_str());
+}
+
+TEST(test_runtime_record, corrupted_shape) {
+  const std::string record_path = "./corrupted_record.bin";
+  {
+    ForwardRecorder recorder(record_path);
+    ASSERT_TRUE(recorder.is_open());
+    sftensor input = TensorCreate(2, 3, 4);
+    input->Rand();
+    recorder.Record({input}, 100, 10);
+    recorder.Record({input}, 200, 10);
+    recorder.Flush();
+    ASSERT_EQ(recorder.records(), 2);
+    ASSERT_EQ(recorder.dropped(), 0);
+  }
+
+  // 把第二条记录的维度改成远大于文件的值，读取时不能按这个维度申请内存
+  std::fstream file(record_path,
+                    std::ios::in | std::ios::out | std::ios::binary);
+  const std::streamoff record_bytes = 8 + 8 + 4 + 4 + 3 * 4 + 2 * 3 * 4 * 4;
+  file.seekp(8 + record_bytes + 8 + 8 + 4 + 4);
+  const uint32_t huge_shapes[3] = {1u << 30, 1u << 30, 4};
+  file.write(reinterpret_cast<const char *>(huge_shapes), sizeof(huge_shapes));
+  file.close();
+
+  std::vector<ForwardRecord> records;
+  ASSERT_TRUE(LoadForwardRecords(record_path, records));
+  ASSERT_EQ(records.size(), 1);
+  std::remove(record_path.c_str());
+}
+
+TEST(test_runtime_record, yolov5_replay) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  const std::string record_path = "./yolov5s_record.bin";
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+
+  // 用翻转和缩放后的图片模拟不同的线上输入，候选框的数量各不相同
+  std::vector<cv::Mat> images{image};
+  cv::Mat flipped;
+  cv::flip(image, flipped, 1);
+  images.push_back(flipped);
+  cv::Mat small;
+  cv::resize(image, small, cv::Size(image.cols / 3, image.rows / 3));
+  images.push_back(small);
+
+  std::vector<double> recorded_latencies;
+  {
+    RuntimeGraph graph(param_path, bin_path);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(graph.StartRecording(record_path));
+    for (uint32_t round = 0; round < 2; ++round) {
+      for (const cv::Mat &input_image : images) {
+        graph.Forward({PreProcessImage(input_image, 640, 640)}, false);
+      }
+    }
+    graph.StopRecording();
+  }
+
+  std::vector<ForwardRecord> records;
+  ASSERT_TRUE(LoadForwardRecords(record_path, records));
+  ASSERT_EQ(records.size(), 2 * images.size());
+  for (const ForwardRecord &record : records) {
+    recorded_latencies.push_back(double(record.latency_ns) / 1e6);
+  }
+  const double recorded_elapsed_ms =
+      double(records.back().offset_ns + records.back().latency_ns) / 1e6;
+
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  LogReport("Recorded",
+            LatencyReport::FromSamples(recorded_latencies, recorded_elapsed_ms));
+  LogReport("Replay at recorded rate",
+            ReplayForwardRecords(graph, records, true));
+  LogReport("Replay at maximum rate",
+            ReplayForwardRecords(graph, records, false));
+  std::remove(record_path.c_str());
+}
@@ -0,0 +1,145 @@
+//
+// Created by fss on 23-9-10.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/runtime_trace.hpp"
+
+using namespace kuiper_infer;
+
+static const std::string kParamPath =
+    "course9/model_file/resnet18_batch1.pnnx.param";
+static const std::string kBinPath =
+    "course9/model_file/resnet18_batch1.pnnx.bin";
+
+/// 统计first_run_id之后被记录的推理，返回推理编号和是否为慢推理
+static std::map<uint64_t, bool> TracedRuns(uint64_t first_run_id,
+                                           uint32_t* op_events) {
+  std::map<uint64_t, bool> runs;
+  *op_events = 0;
+  for (const TraceEvent& event : RuntimeTracer::Instance().Snapshot()) {
+    if (event.run_id <= first_run_id) {
+      continue;
+    }
+    if (event.op_index < 0) {
+      runs.insert({event.run_id, event.slow});
+    } else {
+      *op_events += 1;
+    }
+  }
+  return runs;
+}
+
+TEST(test_runtime_trace, sampling) {
+  RuntimeGraph graph(kParamPath, kBinPath);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  graph.EnableTracing(4, 0);
+
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  const uint64_t first_run_id = RuntimeTracer::Instance().NextRunId();
+  for (uint32_t i = 0; i < 8; ++i) {
+    graph.Forward({input}, false);
+  }
+
+  // 8次推理中第0次和第4次被采样
+  uint32_t op_events = 0;
+  const auto& runs = TracedRuns(first_run_id, &op_events);
+  ASSERT_EQ(runs.size(), 2);
+  for (const auto& [_, slow] : runs) {
+    ASSERT_FALSE(slow);
+  }
+  ASSERT_EQ(op_events % 2, 0);
+  ASSERT_GT(op_events, 0);
+
+  const std::string& json = RuntimeTracer::Instance().DumpJson();
+  ASSERT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  ASSERT_NE(json.find("\"cat\":\"nn.Conv2d\""), std::string::npos);
+}
+
+TEST(test_runtime_trace, slow_capture) {
+  RuntimeGraph graph(kParamPath, kBinPath);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  // 不采样，阈值足够小时每次推理都超过阈值
+  graph.EnableTracing(0, 1e-3);
+
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  const uint64_t first_run_id = RuntimeTracer::Instance().NextRunId();
+  for (uint32_t i = 0; i < 3; ++i) {
+    graph.Forward({input}, false);
+  }
+  uint32_t op_events = 0;
+  const auto& runs = TracedRuns(first_run_id, &op_events);
+  ASSERT_EQ(runs.size(), 3);
+  for (const auto& [_, slow] : runs) {
+    ASSERT_TRUE(slow);
+  }
+
+  // 阈值很大且不采样时不记录任何推理
+  RuntimeGraph quiet_graph(kParamPath, kBinPath);
+  quiet_graph.Build("pnnx_input_0", "pnnx_output_0");
+  quiet_graph.EnableTracing(0, 1e6);
+  const uint64_t quiet_run_id = RuntimeTracer::Instance().NextRunId();
+  quiet_graph.Forward({input}, false);
+  ASSERT_TRUE(TracedRuns(quiet_run_id, &op_events).empty());
+}
+
+TEST(test_runtime_trace, signal_dump) {
+  RuntimeGraph graph(kParamPath, kBinPath);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  graph.EnableTracing(1, 0);
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  graph.Forward({input}, false);
+
+  const std::string path = "./trace_signal_test.json";
+  std::remove(path.c_str());
+  ASSERT_TRUE(RuntimeTracer::Instance().InstallSignalHandler(path));
+  ASSERT_EQ(raise(SIGUSR1), 0);
+
+  std::ifstream file;
+  for (uint32_t i = 0; i < 50 && !file.is_open(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    file.open(path);
+  }
+  ASSERT_TRUE(file.is_open());
+  std::stringstream content;
+  content << file.rdbuf();
+  ASSERT_NE(content.str().find("\"name\":\"Forward\""), std::string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(test_runtime_trace, overhead) {
+  sftensor input = TensorCreate(3, 224, 224);
+  input->Rand();
+  const uint32_t runs = 10;
+
+  double costs[2] = {0., 0.};
+  for (const bool trace : {false, true}) {
+    RuntimeGraph graph(kParamPath, kBinPath);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    if (trace) {
+      graph.EnableTracing(100, 500);
+    }
+    graph.Forward({input}, false);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; ++i) {
+      graph.Forward({input}, false);
+    }
+    costs[trace] = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count() /
+                   runs;
+  }
+  LOG(INFO) << "Resnet18 forward without tracing: " << costs[0]
+            << " ms, with 1/100 sampled tracing: " << costs[1] << " ms";
+}
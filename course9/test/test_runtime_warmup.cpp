@@ -0,0 +1,118 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <limits>
+#include <opencv2/opencv.hpp>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+/// 读取/proc/self/status中当前进程锁定的内存，单位为KB
+static uint64_t LockedKilobytes() {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "VmLck:") {
+      uint64_t kilobytes = 0;
+      status >> kilobytes;
+      return kilobytes;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+static double SteadyForwardMs(RuntimeGraph &graph, const sftensor &input) {
+  const uint32_t runs = 3;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    graph.Forward({input}, false);
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         runs;
+}
+
+TEST(test_runtime_warmup, yolov5_first_request) {
+  const std::string &param_path = "course9/model_file/yolov5s.pnnx.param";
+  const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  const sftensor input = PreProcessImage(image, 640, 640);
+
+  RuntimeGraph cold_graph(param_path, bin_path);
+  cold_graph.Build("pnnx_input_0", "pnnx_output_0");
+  const sftensor cold_output =
+      TensorClone(cold_graph.Forward({input}, false).front());
+  const double cold_ms = cold_graph.first_forward_ms();
+  ASSERT_GT(cold_ms, 0.);
+
+  const uint64_t locked_before = LockedKilobytes();
+  for (const bool lock_memory : {false, true}) {
+    RuntimeGraph graph(param_path, bin_path);
+    graph.set_memory_budget(lock_memory ? 512ull * 1024 * 1024 : 0);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    const WarmupReport &report = graph.Warmup(2, lock_memory);
+    ASSERT_EQ(report.runs, 2);
+    ASSERT_GT(report.cold_forward_ms, 0.);
+    ASSERT_GT(report.warm_forward_ms, 0.);
+    if (!lock_memory) {
+      ASSERT_EQ(report.locked_bytes, 0);
+    } else if (report.locked_bytes > 0) {
+      ASSERT_GT(LockedKilobytes(), locked_before);
+    }
+    // 预热的推理不计入第一次推理的耗时
+    ASSERT_EQ(graph.first_forward_ms(), 0.);
+
+    // 预热不影响推理的结果
+    ASSERT_TRUE(TensorIsSame(graph.Forward({input}, false).front(),
+                             cold_output, 1e-5f));
+    const double first_ms = graph.first_forward_ms();
+    ASSERT_GT(first_ms, 0.);
+    const double steady_ms = SteadyForwardMs(graph, input);
+    LOG(INFO) << (lock_memory ? "Warmup with mlock: " : "Warmup: ")
+              << report.locked_bytes << " bytes locked in " << report.lock_ms
+              << " ms, warmup runs " << report.cold_forward_ms << " ms -> "
+              << report.warm_forward_ms << " ms";
+    LOG(INFO) << "First request without warmup: " << cold_ms
+              << " ms, with warmup: " << first_ms
+              << " ms, steady state: " << steady_ms
+              << " ms, first / steady: " << first_ms / steady_ms;
+  }
+  // 锁定的内存在计算图析构时解锁
+  ASSERT_EQ(LockedKilobytes(), locked_before);
+}
+
+TEST(test_runtime_warmup, bound_output) {
+  const std::string &param_path = "course9/model_file/simple_ops.pnnx.param";
+  const std::string &bin_path = "course9/model_file/simple_ops.pnnx.bin";
+  RuntimeGraph graph(param_path, bin_path);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  sftensor input = TensorCreate(3, 16, 16);
+  input->Rand();
+  const sftensor output = TensorClone(graph.Forward({input}, false).front());
+
+  // 预热不写入调用方绑定的输出，预热之后绑定仍然有效
+  std::vector<float> output_buffer(output->size(), -7.f);
+  sftensor bound_output =
+      std::make_shared<ftensor>(output_buffer.data(), output->raw_shapes());
+  graph.BindInputs({input});
+  graph.BindOutputs({bound_output});
+  graph.Warmup(2, true);
+  for (const float value : output_buffer) {
+    ASSERT_EQ(value, -7.f);
+  }
+
+  graph.Forward(false);
+  ASSERT_EQ(bound_output->raw_ptr(), output_buffer.data());
+  ASSERT_TRUE(TensorIsSame(output, bound_output, 1e-5f));
+}
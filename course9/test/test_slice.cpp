@@ -0,0 +1,206 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include "../source/layer/details/slice.hpp"
+#include "data/tensor_util.hpp"
+#include "runtime/ir.h"
+#include "runtime/runtime_ir.hpp"
+#include "pnnx_graph_util.hpp"
+
+using namespace kuiper_infer;
+
+static sftensor RandomSliceInput(uint32_t channels, uint32_t rows,
+                                 uint32_t cols) {
+  static std::mt19937 generator(20230914);
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  sftensor tensor = TensorCreate(channels, rows, cols);
+  tensor->Transform([&distribution](float) { return distribution(generator); });
+  return tensor;
+}
+
+/// 逐个元素计算切片的参考结果，start和end已经规整为非负数
+static sftensor ReferenceSlice(const sftensor &input, uint32_t axis,
+                               uint32_t start, uint32_t end, uint32_t step) {
+  const uint32_t extent = (end - start + step - 1) / step;
+  const uint32_t channels = axis == 0 ? extent : input->channels();
+  const uint32_t rows = axis == 1 ? extent : input->rows();
+  const uint32_t cols = axis == 2 ? extent : input->cols();
+  sftensor output = TensorCreate(channels, rows, cols);
+  for (uint32_t c = 0; c < channels; ++c) {
+    for (uint32_t r = 0; r < rows; ++r) {
+      for (uint32_t w = 0; w < cols; ++w) {
+        output->at(c, r, w) = std::as_const(*input).at(
+            axis == 0 ? start + c * step : c, axis == 1 ? start + r * step : r,
+            axis == 2 ? start + w * step : w);
+      }
+    }
+  }
+  return output;
+}
+
+TEST(test_slice, channel_view) {
+  const sftensor input = RandomSliceInput(6, 7, 5);
+  SliceLayer slice_layer(0, 2, 5, 1);
+  ASSERT_TRUE(slice_layer.output_is_view());
+  ASSERT_EQ(slice_layer.kernel_name(), "channel_view");
+
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(slice_layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+  const sftensor view = outputs.front();
+  ASSERT_EQ(view->shapes(), std::vector<uint32_t>({3, 7, 5}));
+  // 输出直接指向输入的第2个通道，不拷贝数据
+  const float *input_ptr = std::as_const(*input).data().memptr();
+  ASSERT_EQ(std::as_const(*view).data().memptr(), input_ptr + 2 * 7 * 5);
+  ASSERT_TRUE(TensorIsSame(view, ReferenceSlice(input, 0, 2, 5, 1), 0.f));
+
+  // 同一个输入再次推理时沿用上一次的视图，不申请新的内存
+  const uint64_t allocations = Tensor<float>::allocation_count();
+  ASSERT_EQ(slice_layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+  ASSERT_EQ(Tensor<float>::allocation_count(), allocations);
+  ASSERT_EQ(outputs.front(), view);
+
+  // 输入修改之后，视图看到的是修改后的数据
+  input->at(3, 1, 1) = 42.f;
+  ASSERT_EQ(std::as_const(*view).at(1, 1, 1), 42.f);
+}
+
+TEST(test_slice, strided_copy) {
+  const sftensor input = RandomSliceInput(6, 9, 8);
+  struct SliceCase {
+    uint32_t axis;
+    int32_t start;
+    int32_t end;
+    int32_t step;
+    uint32_t expect_start;
+    uint32_t expect_end;
+  };
+  const std::vector<SliceCase> cases{
+      {0, 0, 6, 2, 0, 6},   {1, 2, 7, 1, 2, 7},  {1, 1, 9, 3, 1, 9},
+      {2, 3, 8, 1, 3, 8},   {2, 0, 8, 3, 0, 8},  {2, -3, -1, 1, 5, 7},
+      {1, -4, 2147483647, 1, 5, 9},
+  };
+  for (const SliceCase &slice_case : cases) {
+    SliceLayer slice_layer(slice_case.axis, slice_case.start, slice_case.end,
+                           slice_case.step);
+    ASSERT_FALSE(slice_layer.output_is_view());
+    std::vector<sftensor> outputs(1);
+    ASSERT_EQ(slice_layer.Forward({input}, outputs),
+              InferStatus::kInferSuccess);
+    const sftensor &target =
+        ReferenceSlice(input, slice_case.axis, slice_case.expect_start,
+                       slice_case.expect_end, uint32_t(slice_case.step));
+    ASSERT_TRUE(TensorIsSame(outputs.front(), target, 0.f))
+        << "axis " << slice_case.axis << " start " << slice_case.start
+        << " end " << slice_case.end << " step " << slice_case.step;
+  }
+
+  // 切片为空时报错
+  SliceLayer empty_layer(2, 5, 5, 1);
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(empty_layer.Forward({input}, outputs),
+            InferStatus::kInferFailedShapeParameterError);
+}
+
+/**
+ * 生成计算图: relu -> chunk或split(dim=1) -> cat([后一段, 前一段]) ->
+ * 沿宽度切片[1:-1]
+ */
+static void SaveSplitGraph(bool use_chunk, const std::string &param_path,
+                           const std::string &bin_path) {
+  pnnx::Graph graph;
+  pnnx::Operator *input = graph.new_operator("pnnx.Input", "pnnx_input_0");
+  pnnx::Operand *x = NewOperand(graph, input, {1, 4, 6, 5});
+
+  pnnx::Operator *relu = graph.new_operator("nn.ReLU", "relu");
+  Consume(relu, x);
+  pnnx::Operand *relu_out = NewOperand(graph, relu, {1, 4, 6, 5});
+
+  pnnx::Operator *split = use_chunk
+                              ? graph.new_operator("torch.chunk", "chunk")
+                              : graph.new_operator("torch.split", "split");
+  if (use_chunk) {
+    split->params["chunks"] = 2;
+  } else {
+    split->params["split_size_or_sections"] = {1, 3};
+  }
+  split->params["dim"] = 1;
+  Consume(split, relu_out);
+  const int first_channels = use_chunk ? 2 : 1;
+  pnnx::Operand *first = NewOperand(graph, split, {1, first_channels, 6, 5});
+  pnnx::Operand *second =
+      NewOperand(graph, split, {1, 4 - first_channels, 6, 5});
+
+  pnnx::Operator *cat = graph.new_operator("torch.cat", "cat");
+  cat->params["dim"] = 1;
+  Consume(cat, second);
+  Consume(cat, first);
+  pnnx::Operand *cat_out = NewOperand(graph, cat, {1, 4, 6, 5});
+
+  pnnx::Operator *slice = graph.new_operator("Tensor.slice", "slice");
+  slice->params["dim"] = 3;
+  slice->params["start"] = 1;
+  slice->params["end"] = -1;
+  slice->params["step"] = 1;
+  Consume(slice, cat_out);
+  pnnx::Operand *slice_out = NewOperand(graph, slice, {1, 4, 6, 3});
+
+  pnnx::Operator *output = graph.new_operator("pnnx.Output", "pnnx_output_0");
+  Consume(output, slice_out);
+  ASSERT_EQ(graph.save(param_path, bin_path), 0);
+}
+
+TEST(test_slice, chunk_split_graph) {
+  const std::string &param_path = "slice_graph.pnnx.param";
+  const std::string &bin_path = "slice_graph.pnnx.bin";
+  const sftensor input = RandomSliceInput(4, 6, 5);
+  for (const bool use_chunk : {true, false}) {
+    SaveSplitGraph(use_chunk, param_path, bin_path);
+    const uint32_t first_channels = use_chunk ? 2 : 1;
+
+    // 参考结果: 通道按拆分的两段交换顺序，宽度去掉首尾各一列
+    sftensor target = TensorCreate(4, 6, 3);
+    for (uint32_t c = 0; c < 4; ++c) {
+      const uint32_t source_channel =
+          c < 4 - first_channels ? c + first_channels : c - (4 - first_channels);
+      for (uint32_t r = 0; r < 6; ++r) {
+        for (uint32_t w = 0; w < 3; ++w) {
+          target->at(c, r, w) =
+              std::max(std::as_const(*input).at(source_channel, r, w + 1), 0.f);
+        }
+      }
+    }
+
+    for (const uint64_t memory_budget : {uint64_t(0), uint64_t(1 << 20)}) {
+      RuntimeGraph graph(param_path, bin_path);
+      graph.set_memory_budget(memory_budget);
+      graph.Build("pnnx_input_0", "pnnx_output_0");
+
+      uint32_t views = 0;
+      for (const auto &op : graph.get_topo_queues()) {
+        if (op->layer != nullptr && op->layer->output_is_view()) {
+          ASSERT_EQ(op->type, "Tensor.slice");
+          views += 1;
+        }
+      }
+      ASSERT_EQ(views, 2);
+      if (memory_budget > 0) {
+        ASSERT_EQ(graph.memory_report().view_operators, 2);
+      }
+
+      for (uint32_t run = 0; run < 2; ++run) {
+        const std::vector<sftensor> &outputs = graph.Forward({input}, false);
+        ASSERT_EQ(outputs.size(), 1);
+        ASSERT_TRUE(TensorIsSame(outputs.front(), target, 1e-6f))
+            << (use_chunk ? "torch.chunk" : "torch.split") << ", budget "
+            << memory_budget;
+      }
+    }
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
@@ -0,0 +1,133 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include "data/tensor_util.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/runtime_synthetic.hpp"
+
+using namespace kuiper_infer;
+
+static std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(test_synthetic_graph, generate) {
+  const std::string &param_path = "synthetic_graph.pnnx.param";
+  const std::string &bin_path = "synthetic_graph.pnnx.bin";
+  SyntheticGraphOptions options;
+  options.depth = 12;
+  options.branches = 3;
+  options.branch_length = 2;
+  options.residual_density = 0.7f;
+  options.pool_every = 4;
+  options.channels = 8;
+  options.input_h = 24;
+  options.input_w = 20;
+  options.seed = 7;
+  SyntheticGraphReport report;
+  ASSERT_TRUE(GenerateSyntheticGraph(options, param_path, bin_path, &report));
+  ASSERT_EQ(report.pools, 3);
+  ASSERT_EQ(report.convolutions, report.activations);
+  ASSERT_GT(report.concats, 0);
+  ASSERT_GT(report.residuals, 0);
+  ASSERT_EQ(report.output_channels, 8);
+  ASSERT_EQ(report.output_h, 3);
+  ASSERT_EQ(report.output_w, 2);
+
+  // 相同的参数和种子生成完全相同的文件
+  const std::string &param = ReadFile(param_path);
+  const std::string &bin = ReadFile(bin_path);
+  ASSERT_TRUE(GenerateSyntheticGraph(options, param_path, bin_path));
+  ASSERT_EQ(ReadFile(param_path), param);
+  ASSERT_EQ(ReadFile(bin_path), bin);
+
+  // 不做内存规划和在预算下复用内存的结果一致
+  sftensor input = TensorCreate(3, 24, 20);
+  input->Rand();
+  std::vector<sftensor> targets;
+  for (const uint64_t memory_budget : {uint64_t(0), uint64_t(1 << 24)}) {
+    RuntimeGraph graph(param_path, bin_path);
+    graph.set_memory_budget(memory_budget);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+    const std::vector<sftensor> &outputs = graph.Forward({input}, false);
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs.front()->shapes(), std::vector<uint32_t>({8, 3, 2}));
+    if (targets.empty()) {
+      targets = outputs;
+    } else {
+      ASSERT_LT(graph.memory_report().planned_bytes,
+                graph.memory_report().unplanned_bytes);
+      ASSERT_TRUE(TensorIsSame(outputs.front(), targets.front(), 1e-4f));
+    }
+  }
+
+  SyntheticGraphOptions wrong_options;
+  wrong_options.branches = 0;
+  ASSERT_FALSE(GenerateSyntheticGraph(wrong_options, param_path, bin_path));
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
+
+TEST(test_synthetic_graph, scaling_benchmark) {
+  const std::string &param_path = "synthetic_bench.pnnx.param";
+  const std::string &bin_path = "synthetic_bench.pnnx.bin";
+  const uint32_t runs = 3;
+  sftensor input = TensorCreate(3, 32, 32);
+  input->Rand();
+  for (const uint32_t depth : {8, 32, 128}) {
+    SyntheticGraphOptions options;
+    options.depth = depth;
+    options.branches = 3;
+    options.residual_density = 0.5f;
+    options.seed = depth;
+    SyntheticGraphReport report;
+    ASSERT_TRUE(
+        GenerateSyntheticGraph(options, param_path, bin_path, &report));
+
+    for (const uint64_t memory_budget : {uint64_t(0), uint64_t(1 << 26)}) {
+      RuntimeGraph graph(param_path, bin_path);
+      graph.set_memory_budget(memory_budget);
+      auto start = std::chrono::steady_clock::now();
+      graph.Build("pnnx_input_0", "pnnx_output_0");
+      const double build_cost = std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+
+      graph.Forward({input}, false);
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < runs; ++i) {
+        graph.Forward({input}, false);
+      }
+      const double forward_cost = std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count() /
+                                  runs;
+      LOG(INFO) << "Synthetic graph depth " << depth << ", operators "
+                << report.operators << ", budget " << memory_budget
+                << ", build: " << build_cost << " ms, forward: "
+                << forward_cost << " ms, activation bytes: "
+                << (memory_budget > 0 ? graph.memory_report().planned_bytes
+                                      : report.activation_bytes);
+      if (memory_budget > 0) {
+        const RuntimeMemoryReport &memory_report = graph.memory_report();
+        ASSERT_LE(memory_report.planned_bytes,
+                  memory_report.topo_planned_bytes);
+        LOG(INFO) << "Planned outputs: " << memory_report.topo_planned_bytes
+                  << " bytes in topo order, " << memory_report.planned_bytes
+                  << " bytes scheduled, peak live outputs: "
+                  << memory_report.topo_peak_bytes << " bytes in topo order, "
+                  << memory_report.scheduled_peak_bytes << " bytes scheduled";
+      }
+    }
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
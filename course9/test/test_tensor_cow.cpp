@@ -0,0 +1,115 @@
+//
+// Created by fss on 23-9-4.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <utility>
+#include "../source/layer/details/linear.hpp"
+#include "data/tensor.hpp"
+
+using namespace kuiper_infer;
+
+TEST(test_tensor_cow, copy_on_write) {
+  Tensor<float> f1(3, 32, 32);
+  f1.Fill(1.f);
+  Tensor<float> f2 = f1;
+  ASSERT_TRUE(f1.is_shared());
+  ASSERT_EQ(std::as_const(f1).data().memptr(),
+            std::as_const(f2).data().memptr());
+
+  // 写入时拷贝，原张量中的数据保持不变
+  f2.at(0, 0, 0) = 2.f;
+  ASSERT_FALSE(f1.is_shared());
+  ASSERT_NE(std::as_const(f1).data().memptr(),
+            std::as_const(f2).data().memptr());
+  ASSERT_EQ(f1.at(0, 0, 0), 1.f);
+  ASSERT_EQ(f2.at(0, 0, 0), 2.f);
+
+  Tensor<float> f3 = f1.Clone();
+  ASSERT_FALSE(f1.is_shared());
+  f3.Fill(3.f);
+  ASSERT_EQ(f1.at(1, 1, 1), 1.f);
+
+  // 只读的矩阵指针不拷贝共享的数据，可写的矩阵指针拷贝
+  Tensor<float> f4 = f1;
+  ASSERT_EQ(std::as_const(f4).matrix_raw_ptr(1),
+            std::as_const(f1).matrix_raw_ptr(1));
+  ASSERT_TRUE(f1.is_shared());
+  ASSERT_NE(f4.matrix_raw_ptr(1), std::as_const(f1).matrix_raw_ptr(1));
+  ASSERT_FALSE(f1.is_shared());
+}
+
+TEST(test_tensor_cow, external_memory) {
+  std::vector<float> buffer(2 * 4 * 4, 1.f);
+  Tensor<float> f1(buffer.data(), 2, 4, 4);
+  Tensor<float> f2 = f1;
+  ASSERT_FALSE(f1.is_shared());
+  f2.Fill(2.f);
+  ASSERT_EQ(buffer.front(), 1.f);
+  f1.Fill(3.f);
+  ASSERT_EQ(f1.raw_ptr(), buffer.data());
+  ASSERT_EQ(buffer.back(), 3.f);
+}
+
+TEST(test_tensor_cow, hot_path_cost) {
+  const uint32_t runs = 100;
+  Tensor<float> f1(3, 640, 640);
+  f1.Rand();
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    Tensor<float> f2 = f1;
+    ASSERT_FALSE(f2.empty());
+  }
+  const double shared_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    Tensor<float> f2 = f1.Clone();
+    ASSERT_FALSE(f2.empty());
+  }
+  const double clone_cost = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+  LOG(INFO) << "Copy 3x640x640 tensor " << runs << " times, shared: "
+            << shared_cost << " ms, deep copy: " << clone_cost << " ms";
+
+  // Linear层不再逐次拷贝出转置的权重矩阵，对比原来的做法
+  const uint32_t in_features = 512;
+  const uint32_t out_features = 1000;
+  LinearLayer linear_layer(in_features, out_features, false);
+  linear_layer.weights().front()->Rand();
+  sftensor input = std::make_shared<ftensor>(1, 1, in_features);
+  input->Rand();
+  std::vector<sftensor> inputs{input};
+  std::vector<sftensor> outputs{std::make_shared<ftensor>(1, 1, out_features)};
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_EQ(linear_layer.Forward(inputs, outputs),
+              InferStatus::kInferSuccess);
+  }
+  const double linear_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+  arma::fmat weight_data(linear_layer.weights().front()->raw_ptr(),
+                         out_features, in_features, false, true);
+  arma::fmat input_vec(input->raw_ptr(), 1, in_features, false, true);
+  arma::fmat result;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    const arma::fmat weight_data_t = weight_data.t();
+    result = input_vec * weight_data_t;
+  }
+  const double transposed_cost = std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+  ASSERT_TRUE(arma::approx_equal(result, outputs.front()->slice(0), "absdiff",
+                                 1e-3f));
+  LOG(INFO) << "Linear 512x1000 " << runs << " times: " << linear_cost
+            << " ms, with transposed weight copy: " << transposed_cost << " ms";
+}
@@ -0,0 +1,555 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+#include "../source/layer/details/attention.hpp"
+#include "../source/layer/details/gelu.hpp"
+#include "../source/layer/details/layernorm.hpp"
+#include "../source/layer/details/linear.hpp"
+#include "../source/layer/details/matmul.hpp"
+#include "../source/layer/details/softmax.hpp"
+#include "data/tensor_util.hpp"
+#include "layer/abstract/layer_factory.hpp"
+
+using namespace kuiper_infer;
+
+static std::mt19937& TransformerGenerator() {
+  static std::mt19937 generator(20230914);
+  return generator;
+}
+
+static sftensor RandomTensor(uint32_t channels, uint32_t rows, uint32_t cols,
+                             float range = 1.f) {
+  std::uniform_real_distribution<float> distribution(-range, range);
+  sftensor tensor = TensorCreate(channels, rows, cols);
+  tensor->Transform(
+      [&distribution](float) { return distribution(TransformerGenerator()); });
+  return tensor;
+}
+
+static std::vector<float> RandomVector(uint32_t size) {
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  std::vector<float> values(size);
+  for (float& value : values) {
+    value = distribution(TransformerGenerator());
+  }
+  return values;
+}
+
+/// 最大绝对误差除以参考结果的最大绝对值
+static float MaxRelativeError(const sftensor& output, const sftensor& target) {
+  EXPECT_EQ(output->shapes(), target->shapes());
+  const float* output_ptr = std::as_const(*output).data().memptr();
+  const float* target_ptr = std::as_const(*target).data().memptr();
+  float max_abs = 0.f;
+  float target_max = 0.f;
+  for (uint32_t i = 0; i < target->size(); ++i) {
+    max_abs = std::max(max_abs, std::fabs(output_ptr[i] - target_ptr[i]));
+    target_max = std::max(target_max, std::fabs(target_ptr[i]));
+  }
+  return max_abs / std::max(target_max, 1e-6f);
+}
+
+static double ElapsedMs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static sftensor AttentionReference(const sftensor& query, const sftensor& key,
+                                   const sftensor& value, bool is_causal) {
+  const uint32_t heads = query->channels();
+  const uint32_t group = heads / key->channels();
+  const float scale = 1.f / std::sqrt(float(query->cols()));
+  sftensor output = TensorCreate(heads, query->rows(), value->cols());
+  for (uint32_t h = 0; h < heads; ++h) {
+    const uint32_t kv_h = h / group;
+    for (uint32_t l = 0; l < query->rows(); ++l) {
+      std::vector<double> weights(key->rows(), 0.);
+      double max_score = -1e30;
+      const uint32_t visible = is_causal ? l + 1 : key->rows();
+      for (uint32_t s = 0; s < visible && s < key->rows(); ++s) {
+        double score = 0.;
+        for (uint32_t d = 0; d < query->cols(); ++d) {
+          score += double(query->at(h, l, d)) * key->at(kv_h, s, d);
+        }
+        weights.at(s) = score * scale;
+        max_score = std::max(max_score, weights.at(s));
+      }
+      double sum = 0.;
+      for (uint32_t s = 0; s < visible && s < key->rows(); ++s) {
+        weights.at(s) = std::exp(weights.at(s) - max_score);
+        sum += weights.at(s);
+      }
+      for (uint32_t d = 0; d < value->cols(); ++d) {
+        double result = 0.;
+        for (uint32_t s = 0; s < visible && s < key->rows(); ++s) {
+          result += weights.at(s) * value->at(kv_h, s, d);
+        }
+        output->at(h, l, d) = float(result / sum);
+      }
+    }
+  }
+  return output;
+}
+
+TEST(test_transformer, layernorm) {
+  const float eps = 1e-6f;
+  for (const auto& shape : std::vector<std::vector<uint32_t>>{
+           {1, 197, 192}, {3, 50, 64}, {1, 1, 7}, {2, 130, 33}}) {
+    for (const bool affine : {false, true}) {
+      const uint32_t features = shape.at(2);
+      const std::vector<float> gamma =
+          affine ? RandomVector(features) : std::vector<float>{};
+      const std::vector<float> beta =
+          affine ? RandomVector(features) : std::vector<float>{};
+      LayerNormLayer layer(features, eps, gamma, beta);
+      // 输入带有较大的偏移，检查方差计算中的相消误差
+      const sftensor input = RandomTensor(shape.at(0), shape.at(1), features);
+      input->Transform([](float x) { return x * 3.f + 100.f; });
+
+      sftensor expected = TensorClone(input);
+      for (uint32_t c = 0; c < shape.at(0); ++c) {
+        for (uint32_t t = 0; t < shape.at(1); ++t) {
+          double mean = 0.;
+          double var = 0.;
+          for (uint32_t f = 0; f < features; ++f) {
+            mean += input->at(c, t, f);
+          }
+          mean /= features;
+          for (uint32_t f = 0; f < features; ++f) {
+            var += (input->at(c, t, f) - mean) * (input->at(c, t, f) - mean);
+          }
+          var /= features;
+          for (uint32_t f = 0; f < features; ++f) {
+            const double y =
+                (input->at(c, t, f) - mean) / std::sqrt(var + eps) *
+                    (affine ? gamma.at(f) : 1.f) +
+                (affine ? beta.at(f) : 0.f);
+            expected->at(c, t, f) = float(y);
+          }
+        }
+      }
+
+      std::vector<sftensor> outputs(1);
+      ASSERT_EQ(layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+      ASSERT_LE(MaxRelativeError(outputs.front(), expected), 1e-4f);
+
+      // 输出和输入是同一个张量时原地计算
+      outputs = {input};
+      ASSERT_EQ(layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+      ASSERT_EQ(outputs.front(), input);
+      ASSERT_LE(MaxRelativeError(input, expected), 1e-4f);
+    }
+  }
+
+  LayerNormLayer layer(16, eps, {}, {});
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(layer.Forward({RandomTensor(1, 4, 8)}, outputs),
+            InferStatus::kInferFailedShapeParameterError);
+}
+
+TEST(test_transformer, gelu) {
+  for (const bool tanh_approximate : {false, true}) {
+    GeluLayer layer(tanh_approximate);
+    // 包含各种SIMD宽度的尾部
+    for (const uint32_t cols : {1u, 7u, 64u, 771u}) {
+      const sftensor input = RandomTensor(2, 3, cols, 8.f);
+      sftensor expected = TensorClone(input);
+      expected->Transform([tanh_approximate](float x) {
+        if (tanh_approximate) {
+          const double u = 0.7978845608 * (x + 0.044715 * x * x * x);
+          return float(0.5 * x * (1. + std::tanh(u)));
+        }
+        return float(0.5 * x * (1. + std::erf(x / std::sqrt(2.))));
+      });
+      std::vector<sftensor> outputs(1);
+      ASSERT_EQ(layer.Forward({input}, outputs), InferStatus::kInferSuccess);
+      ASSERT_LE(MaxRelativeError(outputs.front(), expected), 1e-5f)
+          << layer.kernel_name() << " " << cols;
+    }
+  }
+}
+
+TEST(test_transformer, matmul) {
+  MatMulLayer layer;
+  // 左右两边的channels分别为1时在channels上广播
+  for (const auto& shape : std::vector<std::vector<uint32_t>>{
+           {3, 3, 197, 64, 197}, {1, 4, 17, 9, 5}, {4, 1, 17, 9, 5},
+           {1, 1, 1, 300, 1}}) {
+    const uint32_t left_channels = shape.at(0);
+    const uint32_t right_channels = shape.at(1);
+    const uint32_t m = shape.at(2);
+    const uint32_t k = shape.at(3);
+    const uint32_t n = shape.at(4);
+    const uint32_t channels = std::max(left_channels, right_channels);
+    const uint32_t batch = 2;
+    std::vector<sftensor> inputs(batch * 2);
+    for (uint32_t b = 0; b < batch; ++b) {
+      inputs.at(b) = RandomTensor(left_channels, m, k);
+      inputs.at(b + batch) = RandomTensor(right_channels, k, n);
+    }
+    std::vector<sftensor> outputs(batch);
+    ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+    for (uint32_t b = 0; b < batch; ++b) {
+      const sftensor& left = inputs.at(b);
+      const sftensor& right = inputs.at(b + batch);
+      sftensor expected = TensorCreate(channels, m, n);
+      for (uint32_t c = 0; c < channels; ++c) {
+        const uint32_t lc = left_channels == 1 ? 0 : c;
+        const uint32_t rc = right_channels == 1 ? 0 : c;
+        for (uint32_t i = 0; i < m; ++i) {
+          for (uint32_t j = 0; j < n; ++j) {
+            double sum = 0.;
+            for (uint32_t p = 0; p < k; ++p) {
+              sum += double(left->at(lc, i, p)) * right->at(rc, p, j);
+            }
+            expected->at(c, i, j) = float(sum);
+          }
+        }
+      }
+      ASSERT_LE(MaxRelativeError(outputs.at(b), expected), 1e-5f);
+    }
+  }
+
+  std::vector<sftensor> outputs(1);
+  ASSERT_EQ(layer.Forward({RandomTensor(1, 4, 8), RandomTensor(1, 7, 3)},
+                          outputs),
+            InferStatus::kInferFailedShapeParameterError);
+  ASSERT_EQ(layer.Forward({RandomTensor(2, 4, 8), RandomTensor(3, 8, 3)},
+                          outputs),
+            InferStatus::kInferFailedChannelParameterError);
+}
+
+TEST(test_transformer, attention) {
+  // heads, kv_heads, L, S, D，长度跨越多个query块和key块
+  for (const auto& shape : std::vector<std::vector<uint32_t>>{
+           {3, 3, 197, 197, 64}, {4, 1, 70, 300, 16}, {4, 2, 1, 5, 8},
+           {2, 2, 129, 129, 32}}) {
+    for (const bool is_causal : {false, true}) {
+      ScaledDotProductAttentionLayer layer(is_causal);
+      const sftensor query = RandomTensor(shape.at(0), shape.at(2), shape.at(4),
+                                          2.f);
+      const sftensor key = RandomTensor(shape.at(1), shape.at(3), shape.at(4),
+                                        2.f);
+      const sftensor value = RandomTensor(shape.at(1), shape.at(3), 24);
+      std::vector<sftensor> outputs(1);
+      ASSERT_EQ(layer.Forward({query, key, value}, outputs),
+                InferStatus::kInferSuccess);
+      ASSERT_LE(MaxRelativeError(outputs.front(),
+                                 AttentionReference(query, key, value,
+                                                    is_causal)),
+                1e-4f)
+          << layer.kernel_name() << " " << shape.at(2) << "x" << shape.at(3);
+    }
+  }
+}
+
+/// 按pnnx导出的格式创建float32的权重属性
+static std::shared_ptr<RuntimeAttribute> FloatAttribute(
+    const std::vector<float>& values) {
+  auto attribute = std::make_shared<RuntimeAttribute>();
+  attribute->type = RuntimeDataType::kTypeFloat32;
+  attribute->shape = {int(values.size())};
+  attribute->weight_data.resize(values.size() * sizeof(float));
+  std::memcpy(attribute->weight_data.data(), values.data(),
+              attribute->weight_data.size());
+  return attribute;
+}
+
+/// 创建有inputs个输入操作数的节点
+static std::shared_ptr<RuntimeOperator> NewOperator(const std::string& type,
+                                                    uint32_t inputs) {
+  auto op = std::make_shared<RuntimeOperator>();
+  op->type = type;
+  op->name = type + "_0";
+  for (uint32_t i = 0; i < inputs; ++i) {
+    auto operand = std::make_shared<RuntimeOperand>();
+    operand->name = "input_" + std::to_string(i);
+    op->input_operands_seq.push_back(operand);
+    op->input_operands.insert({operand->name, operand});
+  }
+  return op;
+}
+
+/// 检查由注册的创建函数生成的层和直接构造的层输出相同
+static void ExpectSameForward(const std::shared_ptr<Layer>& created,
+                              Layer& expected,
+                              const std::vector<sftensor>& inputs) {
+  ASSERT_NE(created, nullptr);
+  std::vector<sftensor> created_outputs(1);
+  std::vector<sftensor> expected_outputs(1);
+  ASSERT_EQ(created->Forward(inputs, created_outputs),
+            InferStatus::kInferSuccess);
+  ASSERT_EQ(expected.Forward(inputs, expected_outputs),
+            InferStatus::kInferSuccess);
+  ASSERT_TRUE(
+      TensorIsSame(created_outputs.front(), expected_outputs.front(), 0.f));
+}
+
+TEST(test_transformer, create_layernorm) {
+  const uint32_t features = 16;
+  const std::vector<float> gamma = RandomVector(features);
+  const std::vector<float> beta = RandomVector(features);
+  const sftensor input = RandomTensor(2, 5, features);
+
+  auto op = NewOperator("nn.LayerNorm", 1);
+  op->params["eps"] = std::make_shared<RuntimeParameterFloat>(1e-5f);
+  op->params["normalized_shape"] =
+      std::make_shared<RuntimeParameterIntArray>(std::vector<int>{features});
+  op->params["elementwise_affine"] =
+      std::make_shared<RuntimeParameterBool>(true);
+  op->attribute["weight"] = FloatAttribute(gamma);
+  op->attribute["bias"] = FloatAttribute(beta);
+  LayerNormLayer expected(features, 1e-5f, gamma, beta);
+  ExpectSameForward(LayerRegisterer::CreateLayer(op), expected, {input});
+
+  // 只支持在最后一维上归一化
+  std::shared_ptr<Layer> layer;
+  op->params["normalized_shape"] = std::make_shared<RuntimeParameterIntArray>(
+      std::vector<int>{5, features});
+  ASSERT_EQ(LayerNormLayer::GetInstance(op, layer),
+            ParseParameterAttrStatus::kParameterMissingShape);
+  op->params["normalized_shape"] =
+      std::make_shared<RuntimeParameterIntArray>(std::vector<int>{features});
+  // elementwise_affine为true时缺少权重
+  op->attribute.erase("weight");
+  ASSERT_EQ(LayerNormLayer::GetInstance(op, layer),
+            ParseParameterAttrStatus::kAttrMissingWeight);
+  op->params.erase("eps");
+  ASSERT_EQ(LayerNormLayer::GetInstance(op, layer),
+            ParseParameterAttrStatus::kParameterMissingEps);
+}
+
+TEST(test_transformer, create_gelu) {
+  const sftensor input = RandomTensor(2, 3, 37, 4.f);
+  // 旧版本的pnnx没有approximate参数，为精确的GELU
+  GeluLayer exact(false);
+  ExpectSameForward(LayerRegisterer::CreateLayer(NewOperator("F.gelu", 1)),
+                    exact, {input});
+
+  auto op = NewOperator("nn.GELU", 1);
+  op->params["approximate"] = std::make_shared<RuntimeParameterString>("tanh");
+  GeluLayer tanh_approximate(true);
+  ExpectSameForward(LayerRegisterer::CreateLayer(op), tanh_approximate,
+                    {input});
+  op->params["approximate"] = std::make_shared<RuntimeParameterString>("none");
+  ExpectSameForward(LayerRegisterer::CreateLayer(op), exact, {input});
+
+  std::shared_ptr<Layer> layer;
+  op->params["approximate"] = std::make_shared<RuntimeParameterString>("fast");
+  ASSERT_EQ(GeluLayer::GetInstance(op, layer),
+            ParseParameterAttrStatus::kParameterMissingUnknown);
+}
+
+TEST(test_transformer, create_matmul) {
+  MatMulLayer expected;
+  ExpectSameForward(
+      LayerRegisterer::CreateLayer(NewOperator("torch.matmul", 2)), expected,
+      {RandomTensor(3, 7, 5), RandomTensor(3, 5, 4)});
+
+  std::shared_ptr<Layer> layer;
+  ASSERT_EQ(MatMulLayer::GetInstance(NewOperator("torch.matmul", 3), layer),
+            ParseParameterAttrStatus::kParameterMissingUnknown);
+}
+
+TEST(test_transformer, create_attention) {
+  const std::vector<sftensor> inputs{RandomTensor(2, 9, 8),
+                                     RandomTensor(2, 11, 8),
+                                     RandomTensor(2, 11, 6)};
+  auto op = NewOperator("F.scaled_dot_product_attention", 3);
+  ScaledDotProductAttentionLayer default_scale(false);
+  ExpectSameForward(LayerRegisterer::CreateLayer(op), default_scale, inputs);
+
+  op->params["is_causal"] = std::make_shared<RuntimeParameterBool>(true);
+  op->params["scale"] = std::make_shared<RuntimeParameterFloat>(0.25f);
+  op->params["dropout_p"] = std::make_shared<RuntimeParameterFloat>(0.1f);
+  ScaledDotProductAttentionLayer causal(true, 0.25f);
+  ExpectSameForward(LayerRegisterer::CreateLayer(op), causal, inputs);
+
+  // 不支持attention mask输入
+  std::shared_ptr<Layer> layer;
+  ASSERT_EQ(ScaledDotProductAttentionLayer::GetInstance(
+                NewOperator("F.scaled_dot_product_attention", 4), layer),
+            ParseParameterAttrStatus::kParameterMissingUnknown);
+}
+
+/// 由Transformer算子组成的小型ViT编码器中的一层，维度和DeiT-Tiny相同
+struct VitBlock {
+  VitBlock(uint32_t dim, uint32_t mlp_dim)
+      : norm1(dim, 1e-6f, RandomVector(dim), RandomVector(dim)),
+        query(dim, dim, true),
+        key(dim, dim, true),
+        value(dim, dim, true),
+        proj(dim, dim, true),
+        norm2(dim, 1e-6f, RandomVector(dim), RandomVector(dim)),
+        fc1(dim, mlp_dim, true),
+        fc2(mlp_dim, dim, true) {
+    for (LinearLayer* layer : {&query, &key, &value, &proj, &fc1, &fc2}) {
+      const float range = 1.f / std::sqrt(float(layer->weights().front()->cols()));
+      for (const auto& params : {layer->weights(), layer->bias()}) {
+        for (const sftensor& param : params) {
+          std::uniform_real_distribution<float> distribution(-range, range);
+          param->Transform([&distribution](float) {
+            return distribution(TransformerGenerator());
+          });
+        }
+      }
+    }
+  }
+
+  LayerNormLayer norm1;
+  LinearLayer query;
+  LinearLayer key;
+  LinearLayer value;
+  LinearLayer proj;
+  LayerNormLayer norm2;
+  LinearLayer fc1;
+  GeluLayer gelu;
+  LinearLayer fc2;
+};
+
+/// 每种算子累计的耗时
+struct VitTimes {
+  double layernorm_ms = 0.;
+  double linear_ms = 0.;
+  double attention_ms = 0.;
+  double gelu_ms = 0.;
+};
+
+/**
+ * ViT的一层: x = x + proj(attention(norm1(x))); x = x + fc2(gelu(fc1(norm2(x))))
+ * Linear的输出按列存储，每个头的特征是连续的列，所以(1, T, heads * D)
+ * 可以不拷贝地看作(heads, T, D)
+ * @param fused 为true时使用分块的注意力，否则使用matmul + softmax + matmul
+ */
+static sftensor VitBlockForward(VitBlock& block, const sftensor& input,
+                                uint32_t heads, bool fused, VitTimes& times) {
+  const uint32_t tokens = input->rows();
+  const uint32_t dim = input->cols();
+  const uint32_t head_dim = dim / heads;
+  const auto as_heads = [&](const sftensor& tensor) {
+    return std::make_shared<Tensor<float>>(
+        tensor->raw_ptr(), std::vector<uint32_t>{heads, tokens, head_dim});
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<sftensor> normed(1);
+  block.norm1.Forward({input}, normed);
+  times.layernorm_ms += ElapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<sftensor> q(1), k(1), v(1);
+  block.query.Forward(normed, q);
+  block.key.Forward(normed, k);
+  block.value.Forward(normed, v);
+  times.linear_ms += ElapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  sftensor attention = TensorCreate(heads, tokens, head_dim);
+  std::vector<sftensor> attention_outputs{attention};
+  if (fused) {
+    ScaledDotProductAttentionLayer layer;
+    layer.Forward({as_heads(q.front()), as_heads(k.front()), as_heads(v.front())},
+                  attention_outputs);
+  } else {
+    // 先生成完整的T x T注意力矩阵，再做softmax
+    const sftensor scaled_query = TensorClone(as_heads(q.front()));
+    scaled_query->Transform([head_dim](float x) {
+      return x / std::sqrt(float(head_dim));
+    });
+    const sftensor key_heads = as_heads(k.front());
+    sftensor key_transposed = TensorCreate(heads, head_dim, tokens);
+    for (uint32_t h = 0; h < heads; ++h) {
+      key_transposed->slice(h) = key_heads->slice(h).t();
+    }
+    MatMulLayer matmul;
+    SoftmaxLayer softmax(-1);
+    std::vector<sftensor> scores(1), probs(1);
+    matmul.Forward({scaled_query, key_transposed}, scores);
+    softmax.Forward(scores, probs);
+    matmul.Forward({probs.front(), as_heads(v.front())}, attention_outputs);
+  }
+  times.attention_ms += ElapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<sftensor> projected(1);
+  block.proj.Forward({std::make_shared<Tensor<float>>(
+                         attention->raw_ptr(),
+                         std::vector<uint32_t>{1, tokens, dim})},
+                     projected);
+  times.linear_ms += ElapsedMs(start);
+  sftensor hidden = TensorClone(input);
+  hidden->slice(0) += projected.front()->slice(0);
+
+  start = std::chrono::steady_clock::now();
+  block.norm2.Forward({hidden}, normed);
+  times.layernorm_ms += ElapsedMs(start);
+  start = std::chrono::steady_clock::now();
+  std::vector<sftensor> mlp(1), mlp_output(1);
+  block.fc1.Forward(normed, mlp);
+  times.linear_ms += ElapsedMs(start);
+  start = std::chrono::steady_clock::now();
+  block.gelu.Forward(mlp, mlp);
+  times.gelu_ms += ElapsedMs(start);
+  start = std::chrono::steady_clock::now();
+  block.fc2.Forward(mlp, mlp_output);
+  times.linear_ms += ElapsedMs(start);
+  hidden->slice(0) += mlp_output.front()->slice(0);
+  return hidden;
+}
+
+TEST(test_transformer, vit_tiny) {
+  // DeiT-Tiny: 224x224输入，16x16的patch，196个patch加上cls token
+  const uint32_t tokens = 197;
+  const uint32_t dim = 192;
+  const uint32_t heads = 3;
+  const uint32_t mlp_dim = 768;
+  const uint32_t depth = 4;
+  std::vector<std::unique_ptr<VitBlock>> blocks;
+  for (uint32_t i = 0; i < depth; ++i) {
+    blocks.push_back(std::make_unique<VitBlock>(dim, mlp_dim));
+  }
+  const sftensor input = RandomTensor(1, tokens, dim);
+
+  sftensor results[2];
+  double total_ms[2] = {0., 0.};
+  VitTimes times[2];
+  const uint32_t runs = 3;
+  for (const bool fused : {false, true}) {
+    // 第一次推理用于预热，不计时
+    for (uint32_t run = 0; run <= runs; ++run) {
+      VitTimes run_times;
+      const auto start = std::chrono::steady_clock::now();
+      sftensor hidden = input;
+      for (const auto& block : blocks) {
+        hidden = VitBlockForward(*block, hidden, heads, fused, run_times);
+      }
+      if (run > 0) {
+        total_ms[fused] += ElapsedMs(start) / runs;
+        times[fused].layernorm_ms += run_times.layernorm_ms / runs;
+        times[fused].linear_ms += run_times.linear_ms / runs;
+        times[fused].attention_ms += run_times.attention_ms / runs;
+        times[fused].gelu_ms += run_times.gelu_ms / runs;
+      }
+      results[fused] = hidden;
+    }
+  }
+  ASSERT_LE(MaxRelativeError(results[1], results[0]), 1e-4f);
+
+  for (const bool fused : {false, true}) {
+    LOG(INFO) << "ViT-Tiny " << depth << " blocks, "
+              << (fused ? "blockwise attention: " : "matmul + softmax: ")
+              << total_ms[fused] << " ms (layernorm "
+              << times[fused].layernorm_ms << " ms, linear "
+              << times[fused].linear_ms << " ms, attention "
+              << times[fused].attention_ms << " ms, gelu "
+              << times[fused].gelu_ms << " ms)";
+  }
+}
@@ -0,0 +1,105 @@
+//
+// Created by fss on 23-9-7.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include "data/tensor.hpp"
+#include "utils/math/transpose.hpp"
+
+using namespace kuiper_infer;
+
+TEST(test_transpose, odd_shapes) {
+  for (const uint32_t rows : {1, 3, 8, 15, 16, 17, 33, 100}) {
+    for (const uint32_t cols : {1, 2, 7, 8, 16, 31, 64}) {
+      arma::fmat src(rows, cols, arma::fill::randu);
+      arma::fmat dst(cols, rows);
+      Transpose(src.memptr(), dst.memptr(), rows, cols);
+      ASSERT_TRUE(arma::approx_equal(dst, src.t(), "absdiff", 0.f));
+    }
+  }
+}
+
+TEST(test_transpose, strided) {
+  // 在更大的矩阵中转置一个子块，源和目标的列间隔都大于子块的大小
+  for (const uint32_t rows : {1, 7, 8, 19, 40}) {
+    for (const uint32_t cols : {1, 5, 16, 33}) {
+      arma::fmat src(rows + 3, cols, arma::fill::randu);
+      arma::fmat dst(cols + 5, rows, arma::fill::zeros);
+      TransposeStrided(src.memptr(), src.n_rows, dst.memptr(), dst.n_rows,
+                       rows, cols);
+      ASSERT_TRUE(arma::approx_equal(dst.rows(0, cols - 1),
+                                     src.rows(0, rows - 1).t(), "absdiff",
+                                     0.f));
+      for (uint32_t r = 0; r < rows; ++r) {
+        for (uint32_t k = cols; k < dst.n_rows; ++k) {
+          ASSERT_EQ(dst(k, r), 0.f);
+        }
+      }
+    }
+  }
+}
+
+TEST(test_transpose, tensor_row_major) {
+  Tensor<float> f1(3, 17, 29);
+  f1.Rand();
+  const std::vector<float>& values = f1.values(true);
+  for (uint32_t c = 0; c < f1.channels(); ++c) {
+    for (uint32_t r = 0; r < f1.rows(); ++r) {
+      for (uint32_t col = 0; col < f1.cols(); ++col) {
+        ASSERT_EQ(values.at(c * f1.rows() * f1.cols() + r * f1.cols() + col),
+                  f1.at(c, r, col));
+      }
+    }
+  }
+
+  Tensor<float> f2(3, 17, 29);
+  f2.Fill(values, true);
+  ASSERT_TRUE(arma::approx_equal(f1.data(), f2.data(), "absdiff", 0.f));
+}
+
+TEST(test_transpose, bandwidth) {
+  const uint32_t rows = 640;
+  const uint32_t cols = 640;
+  const uint32_t planes = 3;
+  const uint32_t runs = 20;
+  arma::fcube src(rows, cols, planes, arma::fill::randu);
+  arma::fcube dst(cols, rows, planes);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    TransposePlanes(src.memptr(), dst.memptr(), rows, cols, planes);
+  }
+  const double transpose_cost = std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count() /
+                                runs;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    for (uint32_t p = 0; p < planes; ++p) {
+      dst.slice(p) = src.slice(p).t();
+    }
+  }
+  const double arma_cost = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count() /
+                           runs;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    std::memcpy(dst.memptr(), src.memptr(), src.n_elem * sizeof(float));
+  }
+  const double memcpy_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             runs;
+
+  // 读写各一次，按两倍数据量计算带宽
+  const double gigabytes = 2. * src.n_elem * sizeof(float) / 1e9;
+  LOG(INFO) << "Transpose 3x640x640, blocked: " << transpose_cost << " ms ("
+            << gigabytes / transpose_cost * 1e3 << " GB/s), armadillo: "
+            << arma_cost << " ms, memcpy: " << memcpy_cost << " ms ("
+            << gigabytes / memcpy_cost * 1e3 << " GB/s)";
+}
@@ -1,10 +1,16 @@
 #include <glog/logging.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include "data/tensor.hpp"
 #include "image_util.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "utils/math/transpose.hpp"
 #include <gtest/gtest.h>
+#include <utility>
 #include <vector>
 
 kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
@@ -37,9 +43,10 @@ kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
   int offset = 0;
   for (const auto &split_image : split_images) {
     assert(split_image.total() == input_w * input_h);
-    const cv::Mat &split_image_t = split_image.t();
-    memcpy(input->slice(index).memptr(), split_image_t.data,
-           sizeof(float) * split_image.total());
+    // OpenCV的行主序图像即列主序的input_w x input_h矩阵
+    assert(split_image.isContinuous());
+    TransposePlanes(split_image.ptr<float>(), input->slice(index).memptr(),
+                    input_w, input_h, 1);
     index += 1;
     offset += split_image.total();
   }
@@ -58,10 +65,27 @@ void YoloDemo(const std::vector<std::string> &image_paths,
   graph.Build("pnnx_input_0", "pnnx_output_0");
 
   assert(batch_size == image_paths.size());
+  // 每张图片按模型输入的尺寸缩小解码一次，预处理和画框都使用解码的结果
+  std::vector<DecodedImage> images(batch_size);
   std::vector<sftensor> inputs;
+  double decode_ms = 0.;
+  double preprocess_ms = 0.;
   for (uint32_t i = 0; i < batch_size; ++i) {
-    const auto &input_image = cv::imread(image_paths.at(i));
-    sftensor input = PreProcessImage(input_image, input_h, input_w);
+    DecodedImage &decoded = images.at(i);
+    CHECK(DecodeImage(image_paths.at(i), cv::Size{input_w, input_h}, decoded))
+        << "Decode the image " << image_paths.at(i) << " failed";
+    decode_ms += decoded.decode_ms;
+    LOG(INFO) << "Decode " << image_paths.at(i) << " "
+              << decoded.origin_size.width << "x" << decoded.origin_size.height
+              << " at 1/" << decoded.reduce_factor << " to "
+              << decoded.image.cols << "x" << decoded.image.rows << " in "
+              << decoded.decode_ms << " ms";
+
+    const auto start = std::chrono::steady_clock::now();
+    sftensor input = PreProcessImage(decoded.image, input_h, input_w);
+    preprocess_ms += std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
     assert(input->rows() == 640);
     assert(input->cols() == 640);
     inputs.push_back(input);
@@ -69,12 +93,19 @@ void YoloDemo(const std::vector<std::string> &image_paths,
 
   std::vector<std::shared_ptr<Tensor<float>>> outputs;
 
+  const auto forward_start = std::chrono::steady_clock::now();
   outputs = graph.Forward(inputs, true);
+  const double forward_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - forward_start)
+                                .count();
+  LOG(INFO) << "Batch " << batch_size << ", decode: " << decode_ms
+            << " ms, preprocess: " << preprocess_ms
+            << " ms, inference: " << forward_ms << " ms";
   assert(outputs.size() == inputs.size());
   assert(outputs.size() == batch_size);
 
   for (int i = 0; i < outputs.size(); ++i) {
-    const auto &image = cv::imread(image_paths.at(i));
+    cv::Mat &image = images.at(i).image;
     const int32_t origin_input_h = image.size().height;
     const int32_t origin_input_w = image.size().width;
 
@@ -156,4 +187,98 @@ TEST(test_network, yolov5) {
   const std::string &bin_path = "course9/model_file/yolov5s.pnnx.bin";
 
   YoloDemo(image_paths, param_path, bin_path, batch_size);
-}
\ No newline at end of file
+}
+
+TEST(test_network, reduced_decode) {
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  // 生成一张约1200万像素的JPEG图片
+  cv::Mat large_image;
+  cv::resize(image, large_image, cv::Size(4000, 3000));
+  const std::string &path = "reduced_decode.jpg";
+  ASSERT_TRUE(cv::imwrite(path, large_image, {cv::IMWRITE_JPEG_QUALITY, 90}));
+
+  cv::Size size;
+  ASSERT_TRUE(ReadJpegSize(path, size));
+  ASSERT_EQ(size, cv::Size(4000, 3000));
+  // 640 / 4000 = 0.16，缩小4倍后比例为0.64，缩小8倍后需要放大
+  ASSERT_EQ(ReducedDecodeFactor(size, cv::Size(640, 640)), 4);
+  ASSERT_EQ(ReducedDecodeFactor(cv::Size(640, 480), cv::Size(640, 640)), 1);
+  ASSERT_EQ(ReducedDecodeFactor(cv::Size(1280, 960), cv::Size(640, 640)), 2);
+
+  const uint32_t runs = 3;
+  double full_ms = 0.;
+  for (uint32_t i = 0; i < runs; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    const cv::Mat &full = cv::imread(path);
+    full_ms += std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    ASSERT_EQ(full.size(), cv::Size(4000, 3000));
+  }
+  double reduced_ms = 0.;
+  DecodedImage decoded;
+  for (uint32_t i = 0; i < runs; ++i) {
+    ASSERT_TRUE(DecodeImage(path, cv::Size(640, 640), decoded));
+    reduced_ms += decoded.decode_ms;
+  }
+  ASSERT_EQ(decoded.reduce_factor, 4);
+  ASSERT_EQ(decoded.origin_size, cv::Size(4000, 3000));
+  ASSERT_EQ(decoded.image.size(), cv::Size(1000, 750));
+  LOG(INFO) << "Decode 4000x3000 JPEG, full: " << full_ms / runs
+            << " ms, reduced 1/" << decoded.reduce_factor << ": "
+            << reduced_ms / runs << " ms";
+
+  // 缩小解码的图片预处理后和原图预处理的结果接近
+  const kuiper_infer::sftensor &reduced_input = PreProcessImage(decoded.image, 640, 640);
+  const kuiper_infer::sftensor &full_input = PreProcessImage(cv::imread(path), 640, 640);
+  ASSERT_EQ(reduced_input->shapes(), full_input->shapes());
+  const float *reduced_ptr = std::as_const(*reduced_input).data().memptr();
+  const float *full_ptr = std::as_const(*full_input).data().memptr();
+  double mean_error = 0.;
+  for (uint32_t i = 0; i < full_input->size(); ++i) {
+    mean_error += std::fabs(reduced_ptr[i] - full_ptr[i]);
+  }
+  mean_error /= full_input->size();
+  LOG(INFO) << "Mean difference of the preprocessed inputs: " << mean_error;
+  ASSERT_LT(mean_error, 0.05);
+  std::remove(path.c_str());
+}
+
+TEST(test_network, exif_orientation) {
+  const cv::Mat &image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  cv::Mat large_image;
+  cv::resize(image, large_image, cv::Size(1600, 1200));
+  std::vector<unsigned char> jpeg;
+  ASSERT_TRUE(cv::imencode(".jpg", large_image, jpeg));
+
+  // 在SOI之后插入APP1段，EXIF中只有一个方向条目，方向为6(顺时针旋转90度)
+  const std::vector<unsigned char> app1{
+      0xFF, 0xE1, 0x00, 0x22, 'E',  'x',  'i',  'f',  0x00, 0x00, 'I',  'I',
+      0x2A, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x12, 0x01, 0x03, 0x00,
+      0x01, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  jpeg.insert(jpeg.begin() + 2, app1.begin(), app1.end());
+  const std::string &path = "exif_orientation.jpg";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(jpeg.data()), jpeg.size());
+  }
+
+  cv::Size size;
+  ASSERT_TRUE(ReadJpegSize(path, size));
+  ASSERT_EQ(size, cv::Size(1200, 1600));
+  const cv::Mat &full = cv::imread(path);
+  ASSERT_EQ(full.size(), size);
+
+  // 缩小解码和不缩小解码时，原图尺寸都和imread的结果一致
+  DecodedImage decoded;
+  ASSERT_TRUE(DecodeImage(path, cv::Size(640, 640), decoded));
+  ASSERT_EQ(decoded.reduce_factor, 2);
+  ASSERT_EQ(decoded.origin_size, full.size());
+  ASSERT_EQ(decoded.image.size(), cv::Size(600, 800));
+  ASSERT_TRUE(DecodeImage(path, cv::Size(1600, 1600), decoded));
+  ASSERT_EQ(decoded.reduce_factor, 1);
+  ASSERT_EQ(decoded.origin_size, full.size());
+  std::remove(path.c_str());
+}
@@ -0,0 +1,193 @@
+//
+// Created by fss on 23-9-14.
+//
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <utility>
+#include "data/tensor_util.hpp"
+#include "data/yuv_input.hpp"
+
+using namespace kuiper_infer;
+
+kuiper_infer::sftensor PreProcessImage(const cv::Mat &image,
+                                       const int32_t input_h,
+                                       const int32_t input_w);
+
+/// I420图像为(height * 3 / 2) x width的单通道Mat，依次是Y、U、V平面
+static YuvFrame I420Frame(const cv::Mat &i420, uint32_t width,
+                          uint32_t height) {
+  YuvFrame frame;
+  frame.format = YuvFormat::kI420;
+  frame.width = width;
+  frame.height = height;
+  frame.y = i420.data;
+  frame.y_stride = width;
+  frame.u = i420.data + width * height;
+  frame.u_stride = width / 2;
+  frame.v = frame.u + (width / 2) * (height / 2);
+  frame.v_stride = width / 2;
+  return frame;
+}
+
+/// 把I420的U、V平面交错为NV12的UV平面
+static std::vector<uint8_t> I420ToNV12(const cv::Mat &i420, uint32_t width,
+                                       uint32_t height) {
+  std::vector<uint8_t> nv12(i420.data, i420.data + width * height * 3 / 2);
+  const uint8_t *u = i420.data + width * height;
+  const uint8_t *v = u + (width / 2) * (height / 2);
+  uint8_t *uv = nv12.data() + width * height;
+  for (uint32_t i = 0; i < (width / 2) * (height / 2); ++i) {
+    uv[2 * i] = u[i];
+    uv[2 * i + 1] = v[i];
+  }
+  return nv12;
+}
+
+static YuvFrame NV12Frame(const std::vector<uint8_t> &nv12, uint32_t width,
+                          uint32_t height) {
+  YuvFrame frame;
+  frame.format = YuvFormat::kNV12;
+  frame.width = width;
+  frame.height = height;
+  frame.y = nv12.data();
+  frame.y_stride = width;
+  frame.u = nv12.data() + width * height;
+  frame.u_stride = width;
+  return frame;
+}
+
+TEST(test_yuv_input, uniform_color) {
+  const uint32_t width = 64;
+  const uint32_t height = 32;
+  std::vector<uint8_t> nv12(width * height * 3 / 2, 120);
+  for (uint32_t i = width * height; i < nv12.size(); i += 2) {
+    nv12.at(i) = 90;
+    nv12.at(i + 1) = 170;
+  }
+  const float luma = 1.164f * (120.f - 16.f);
+  const float rgb[3]{luma + 1.596f * 42.f,
+                     luma - 0.391f * -38.f - 0.813f * 42.f,
+                     luma + 2.018f * -38.f};
+
+  // 按BGR输出并做均值方差归一化，上下各填充16行
+  YuvPreprocessOptions options;
+  options.output_h = 64;
+  options.output_w = 64;
+  options.bgr = true;
+  const float mean[3]{103.53f, 116.28f, 123.675f};
+  const float std[3]{57.375f, 57.12f, 58.395f};
+  std::copy(mean, mean + 3, options.mean);
+  std::copy(std, std + 3, options.std);
+  sftensor output;
+  YuvPreprocessInfo info;
+  ASSERT_TRUE(YuvToTensor(NV12Frame(nv12, width, height), options, output,
+                          &info));
+  ASSERT_EQ(output->shapes(), std::vector<uint32_t>({3, 64, 64}));
+  ASSERT_EQ(info.top, 16);
+  ASSERT_EQ(info.left, 0);
+  ASSERT_EQ(info.content_h, 32);
+  ASSERT_EQ(info.content_w, 64);
+  ASSERT_EQ(info.scale, 1.f);
+
+  for (uint32_t c = 0; c < 3; ++c) {
+    const float pixel = rgb[2 - c];
+    for (uint32_t r = 0; r < 64; ++r) {
+      const bool pad = r < 16 || r >= 48;
+      const float target = ((pad ? 114.f : pixel) - mean[c]) / std[c];
+      for (uint32_t w = 0; w < 64; ++w) {
+        ASSERT_NEAR(std::as_const(*output).at(c, r, w), target, 1e-4f)
+            << c << " " << r << " " << w;
+      }
+    }
+  }
+
+  // 输出张量的形状不一致时报错
+  sftensor wrong_output = TensorCreate(3, 32, 32);
+  ASSERT_FALSE(YuvToTensor(NV12Frame(nv12, width, height), options,
+                           wrong_output));
+}
+
+TEST(test_yuv_input, compare_opencv) {
+  cv::Mat image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  // YUV420要求宽和高都是偶数
+  image = image(cv::Rect(0, 0, image.cols & ~1, image.rows & ~1)).clone();
+  const uint32_t width = image.cols;
+  const uint32_t height = image.rows;
+  cv::Mat i420;
+  cv::cvtColor(image, i420, cv::COLOR_BGR2YUV_I420);
+  const std::vector<uint8_t> nv12 = I420ToNV12(i420, width, height);
+
+  YuvPreprocessOptions options;
+  sftensor i420_output;
+  sftensor nv12_output;
+  ASSERT_TRUE(
+      YuvToTensor(I420Frame(i420, width, height), options, i420_output));
+  ASSERT_TRUE(
+      YuvToTensor(NV12Frame(nv12, width, height), options, nv12_output));
+  // 两种排布的数据相同，结果完全一致
+  ASSERT_TRUE(TensorIsSame(i420_output, nv12_output, 0.f));
+
+  // OpenCV先转换为BGR图像再Letterbox和归一化，色度平面按最近邻上采样并且中间结果取整，
+  // 只在色度变化剧烈的边缘有差异
+  cv::Mat bgr;
+  cv::cvtColor(i420, bgr, cv::COLOR_YUV2BGR_I420);
+  const sftensor target = PreProcessImage(bgr, 640, 640);
+  ASSERT_EQ(nv12_output->shapes(), target->shapes());
+  const float *output_ptr = std::as_const(*nv12_output).data().memptr();
+  const float *target_ptr = std::as_const(*target).data().memptr();
+  double mean_error = 0.;
+  float max_error = 0.f;
+  for (uint32_t i = 0; i < target->size(); ++i) {
+    const float error = std::fabs(output_ptr[i] - target_ptr[i]);
+    mean_error += error;
+    max_error = std::max(max_error, error);
+  }
+  mean_error /= target->size();
+  LOG(INFO) << "YUV input against OpenCV, mean error: " << mean_error
+            << ", max error: " << max_error;
+  ASSERT_LT(mean_error, 0.01);
+}
+
+TEST(test_yuv_input, camera_frame_benchmark) {
+  cv::Mat image = cv::imread("./course9/model_file/car.jpg");
+  ASSERT_FALSE(image.empty());
+  const uint32_t width = 1920;
+  const uint32_t height = 1080;
+  cv::resize(image, image, cv::Size(width, height));
+  cv::Mat i420;
+  cv::cvtColor(image, i420, cv::COLOR_BGR2YUV_I420);
+  const std::vector<uint8_t> nv12 = I420ToNV12(i420, width, height);
+  const cv::Mat nv12_mat(height * 3 / 2, width, CV_8UC1,
+                         const_cast<uint8_t *>(nv12.data()));
+  const uint32_t runs = 10;
+
+  YuvPreprocessOptions options;
+  sftensor output;
+  ASSERT_TRUE(YuvToTensor(NV12Frame(nv12, width, height), options, output));
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    YuvToTensor(NV12Frame(nv12, width, height), options, output);
+  }
+  const double direct_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             runs;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < runs; ++i) {
+    cv::Mat bgr;
+    cv::cvtColor(nv12_mat, bgr, cv::COLOR_YUV2BGR_NV12);
+    PreProcessImage(bgr, 640, 640);
+  }
+  const double opencv_cost = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             runs;
+  LOG(INFO) << "NV12 1920x1080 -> 3x640x640, direct: " << direct_cost
+            << " ms, cvtColor + PreProcessImage: " << opencv_cost << " ms";
+}
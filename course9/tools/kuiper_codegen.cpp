@@ -0,0 +1,34 @@
+//
+// Created by fss on 23-9-13.
+//
+
+#include <glog/logging.h>
+#include <iostream>
+#include "runtime/runtime_codegen.hpp"
+
+/// 把形状固定的pnnx模型编译为C++源文件和权重文件
+/// 用法: kuiper_codegen model.pnnx.param model.pnnx.bin name output.cpp output.weights
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging("KuiperCodegen");
+  FLAGS_alsologtostderr = true;
+  if (argc != 6) {
+    std::cerr << "Usage: " << argv[0]
+              << " <param_path> <bin_path> <name> <source_path> <weight_path>"
+              << std::endl;
+    return 1;
+  }
+
+  kuiper_infer::RuntimeCodegen codegen(argv[1], argv[2]);
+  if (!codegen.Generate(argv[3], argv[4], argv[5])) {
+    LOG(ERROR) << "Generate code for " << argv[1] << " failed";
+    return 1;
+  }
+  const kuiper_infer::CodegenReport &report = codegen.report();
+  std::cout << "kernels: " << report.kernels
+            << "\nfused activations: " << report.fused_activations
+            << "\narena bytes: " << report.arena_bytes
+            << "\noutputs without reuse bytes: " << report.unplanned_bytes
+            << "\nworkspace bytes: " << report.workspace_bytes
+            << "\nweight bytes: " << report.weight_bytes << std::endl;
+  return 0;
+}
@@ -0,0 +1,82 @@
+//
+// Created by fss on 23-9-14.
+//
+
+#include <glog/logging.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "runtime/runtime_synthetic.hpp"
+
+/// 生成随机的pnnx计算图，用于拓扑排序、内存规划和执行器的规模化测试
+/// 用法: kuiper_graphgen graph.pnnx.param graph.pnnx.bin depth=32 branches=3 ...
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging("KuiperGraphgen");
+  FLAGS_alsologtostderr = true;
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <param_path> <bin_path> [depth=N] [branches=N]"
+                 " [branch_length=N] [residual_density=F] [pool_every=N]"
+                 " [input_channels=N] [channels=N] [input_h=N] [input_w=N]"
+                 " [batch=N] [seed=N]"
+              << std::endl;
+    return 1;
+  }
+
+  kuiper_infer::SyntheticGraphOptions options;
+  for (int i = 3; i < argc; ++i) {
+    const std::string argument = argv[i];
+    const size_t pos = argument.find('=');
+    if (pos == std::string::npos) {
+      LOG(ERROR) << "The option should be key=value: " << argument;
+      return 1;
+    }
+    const std::string key = argument.substr(0, pos);
+    const char *value = argument.c_str() + pos + 1;
+    if (key == "depth") {
+      options.depth = std::strtoul(value, nullptr, 10);
+    } else if (key == "branches") {
+      options.branches = std::strtoul(value, nullptr, 10);
+    } else if (key == "branch_length") {
+      options.branch_length = std::strtoul(value, nullptr, 10);
+    } else if (key == "residual_density") {
+      options.residual_density = std::strtof(value, nullptr);
+    } else if (key == "pool_every") {
+      options.pool_every = std::strtoul(value, nullptr, 10);
+    } else if (key == "input_channels") {
+      options.input_channels = std::strtoul(value, nullptr, 10);
+    } else if (key == "channels") {
+      options.channels = std::strtoul(value, nullptr, 10);
+    } else if (key == "input_h") {
+      options.input_h = std::strtoul(value, nullptr, 10);
+    } else if (key == "input_w") {
+      options.input_w = std::strtoul(value, nullptr, 10);
+    } else if (key == "batch") {
+      options.batch = std::strtoul(value, nullptr, 10);
+    } else if (key == "seed") {
+      options.seed = std::strtoul(value, nullptr, 10);
+    } else {
+      LOG(ERROR) << "Unknown option: " << key;
+      return 1;
+    }
+  }
+
+  kuiper_infer::SyntheticGraphReport report;
+  if (!kuiper_infer::GenerateSyntheticGraph(options, argv[1], argv[2],
+                                            &report)) {
+    LOG(ERROR) << "Generate the synthetic graph " << argv[1] << " failed";
+    return 1;
+  }
+  std::cout << "operators: " << report.operators
+            << "\noperands: " << report.operands
+            << "\nconvolutions: " << report.convolutions
+            << "\nactivations: " << report.activations
+            << "\nconcats: " << report.concats
+            << "\nresiduals: " << report.residuals
+            << "\npools: " << report.pools
+            << "\nactivation bytes: " << report.activation_bytes
+            << "\nweight bytes: " << report.weight_bytes
+            << "\noutput shape: " << report.output_channels << " x "
+            << report.output_h << " x " << report.output_w << std::endl;
+  return 0;
+}